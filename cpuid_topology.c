@@ -24,11 +24,6 @@
  */
 typedef void (*PFN_DISPATCHFUNC)(unsigned int NumberOfParameters, char **Parameters);
 
-/*
- * Global application data variable
- */
-extern GLOBAL_DATA g_GlobalData;
-
 /*
  * Command Line Dispatch Definition
  */
@@ -41,21 +36,40 @@ typedef struct _DISPATCH_COMMAND {
  * Internal Prototypes 
  */
 void CpuidTopology_DispatchTaskCommand(unsigned int NumberOfParameters, char **Parameters);
+unsigned int CpuidTopology_DispatchTask(unsigned int NumberOfParameters, char **Parameters);
+unsigned int CpuidTopology_DispatchPlacement(unsigned int NumberOfParameters, char **Parameters);
+unsigned int CpuidTopology_DispatchWatchProcessors(unsigned int NumberOfParameters, char **Parameters);
+unsigned int CpuidTopology_DispatchSizingAdvice(unsigned int NumberOfParameters, char **Parameters);
+unsigned int CpuidTopology_DispatchLatency(unsigned int NumberOfParameters, char **Parameters);
+unsigned int CpuidTopology_DispatchLayoutHeader(unsigned int NumberOfParameters, char **Parameters);
 void CpuidTopology_DispatchCommand(unsigned int NumberOfParameters, char **Parameters);
 void CpuidTopology_DispatchReadFile(unsigned int NumberOfParameters, char **Parameters);
 void CpuidTopology_DispatchWriteFile(unsigned int NumberOfParameters, char **Parameters);
-void CpuidTopology_InitGlobal(void);
+void CpuidTopology_DispatchGenerate(unsigned int NumberOfParameters, char **Parameters);
+void CpuidTopology_DispatchTopologyCache(unsigned int NumberOfParameters, char **Parameters);
+void CpuidTopology_DispatchBatch(unsigned int NumberOfParameters, char **Parameters);
+BOOL_TYPE CpuidTopology_ParseFileFormat(char *pszFileFormat, PCPUID_FILE_FORMAT pFileFormat);
+void CpuidTopology_DispatchQuiet(unsigned int NumberOfParameters, char **Parameters);
+void CpuidTopology_DispatchInstrument(unsigned int NumberOfParameters, char **Parameters);
+void CpuidTopology_InitContext(void);
 void CpuidTopology_AllTopologyFromCpuid(void);
+void CpuidTopology_NumaTopology(void);
+void CpuidTopology_WatchProcessors(unsigned int Seconds);
 
 
 
 /*
  * Global to contain the dispatch function to command line input.
  */
-DISPATCH_COMMAND g_DispatchCommand[4] = {
+DISPATCH_COMMAND g_DispatchCommand[9] = {
     {'s', CpuidTopology_DispatchWriteFile   },
+    {'g', CpuidTopology_DispatchGenerate    },
+    {'p', CpuidTopology_DispatchTopologyCache },
+    {'b', CpuidTopology_DispatchBatch       },
     {'l', CpuidTopology_DispatchReadFile    },
     {'c', CpuidTopology_DispatchTaskCommand },
+    {'q', CpuidTopology_DispatchQuiet       },
+    {'i', CpuidTopology_DispatchInstrument  },
     {0,   NULL }
 };
 
@@ -74,17 +88,21 @@ DISPATCH_COMMAND g_DispatchCommand[4] = {
  */
 int main(int argc, char **argv)
 {
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
     if (argc < 2)
     {
         Display_DisplayParameters();
     }
     else
     {
-        CpuidTopology_InitGlobal();
+        CpuidTopology_InitContext();
         CpuidTopology_DispatchCommand(argc - 1, &argv[1]);
     }
 
-    return 0;
+    return pCpuidContext->ExitStatus;
 }
 
 
@@ -128,6 +146,67 @@ void CpuidTopology_DispatchCommand(unsigned int NumberOfParameters, char **Param
 }
 
 
+/*
+ * CpuidTopology_DispatchQuiet
+ *
+ * Command line handler to turn off echoing each CPUID file record and 
+ * dispatch the rest of the command line.
+ *
+ * Arguments:
+ *     Number of Parameters, Paramter List
+ *     
+ * Return:
+ *     None
+ */
+void CpuidTopology_DispatchQuiet(unsigned int NumberOfParameters, char **Parameters)
+{
+    if (NumberOfParameters >= 1) 
+    {
+        File_SetQuietEcho(BOOL_TRUE);
+        CpuidTopology_DispatchCommand(NumberOfParameters, Parameters);
+    }
+    else
+    {
+        Display_DisplayParameters();
+    }
+}
+
+
+/*
+ * CpuidTopology_DispatchInstrument
+ *
+ * Command line handler to count the CPUID instructions, affinity calls,
+ * snapshot reads and parser allocations of the rest of the command line
+ * and display the counters once it completes.
+ *
+ * Arguments:
+ *     Number of Parameters, Paramter List
+ *     
+ * Return:
+ *     None
+ */
+void CpuidTopology_DispatchInstrument(unsigned int NumberOfParameters, char **Parameters)
+{
+    INSTRUMENT_COUNTERS InstrumentCounters;
+
+    if (NumberOfParameters >= 1) 
+    {
+        Instrument_Reset();
+        Instrument_Enable(BOOL_TRUE);
+
+        CpuidTopology_DispatchCommand(NumberOfParameters, Parameters);
+
+        Instrument_Enable(BOOL_FALSE);
+        Instrument_GetCounters(&InstrumentCounters);
+        Display_DisplayInstrumentation(&InstrumentCounters);
+    }
+    else
+    {
+        Display_DisplayParameters();
+    }
+}
+
+
 /*
  * CpuidTopology_DispatchReadFile
  *
@@ -178,10 +257,14 @@ void CpuidTopology_DispatchReadFile(unsigned int NumberOfParameters, char **Para
  */
 void CpuidTopology_DispatchWriteFile(unsigned int NumberOfParameters, char **Parameters)
 {
+    CPUID_FILE_FORMAT FileFormat;
+    BOOL_TYPE FormatValid;
+
+    FormatValid = CpuidTopology_ParseFileFormat((NumberOfParameters >= 2) ? Parameters[1] : NULL, &FileFormat);
 
-    if(NumberOfParameters >= 1)
+    if(NumberOfParameters >= 1 && FormatValid)
     {
-        if(File_WriteCpuidToFile(Parameters[0]) != BOOL_FALSE)
+        if(File_WriteCpuidToFile(Parameters[0], FileFormat) != BOOL_FALSE)
         {
             printf("CPUID saved to %s\n", Parameters[0]);
         }
@@ -193,10 +276,159 @@ void CpuidTopology_DispatchWriteFile(unsigned int NumberOfParameters, char **Par
     }
     else
     {
-        printf("No file name to save CPUID.\n\n");
+        printf("No file name to save CPUID or the file format is not valid.\n\n");
+        Display_DisplayParameters();
+    }
+
+}
+
+
+/*
+ * CpuidTopology_DispatchGenerate
+ *
+ * Command line handler to generate the CPUID of a synthetic platform from a 
+ * specification and save it to a file.
+ *
+ * Arguments:
+ *     Number of Parameters, Paramter List
+ *     
+ * Return:
+ *     None
+ */
+void CpuidTopology_DispatchGenerate(unsigned int NumberOfParameters, char **Parameters)
+{
+    GENERATE_SPECIFICATION Specification;
+    CPUID_FILE_FORMAT FileFormat;
+    BOOL_TYPE FormatValid;
+
+    FormatValid = CpuidTopology_ParseFileFormat((NumberOfParameters >= 3) ? Parameters[2] : NULL, &FileFormat);
+
+    if (NumberOfParameters >= 2 && FormatValid && Generate_ParseSpecification(Parameters[0], &Specification)) 
+    {
+        if (Generate_BuildSnapshot(&Specification) && File_WriteCpuidToFile(Parameters[1], FileFormat)) 
+        {
+            printf("CPUID of %u processors generated to %s\n", Tools_GetNumberOfProcessors(), Parameters[1]);
+        }
+        else
+        {
+            printf("Failed to generate CPUID to %s\n\n", Parameters[1]);
+            Display_DisplayParameters();
+        }
+    }
+    else
+    {
+        printf("No specification and file name to generate CPUID, or the specification or file format is not valid.\n\n");
+        Display_DisplayParameters();
+    }
+}
+
+
+/*
+ * CpuidTopology_DispatchTopologyCache
+ *
+ * Command line handler to load the CPUID of this platform from a topology cache,
+ * or capture it and save the cache when it does not match, and then dispatch 
+ * the commands.
+ *
+ * Arguments:
+ *     Number of Parameters, Paramter List
+ *     
+ * Return:
+ *     None
+ */
+void CpuidTopology_DispatchTopologyCache(unsigned int NumberOfParameters, char **Parameters)
+{
+    if (NumberOfParameters >= 2) 
+    {
+        if (File_ReadTopologyCache(Parameters[0])) 
+        {
+            printf("CPUID loaded from the topology cache %s\n", Parameters[0]);
+        }
+        else if (File_WriteTopologyCache(Parameters[0])) 
+        {
+            printf("CPUID captured and saved to the topology cache %s\n", Parameters[0]);
+        }
+        else
+        {
+            printf("CPUID captured, the topology cache %s could not be saved\n", Parameters[0]);
+        }
+
+        CpuidTopology_DispatchTaskCommand(NumberOfParameters - 1, Parameters + 1);
+    }
+    else
+    {
+        printf("No topology cache file name or no command to dispatch afterwards.\n\n");
         Display_DisplayParameters();
     }
+}
+
 
+/*
+ * CpuidTopology_DispatchBatch
+ *
+ * Command line handler to analyse a batch of CPUID files and display the
+ * index of their topologies.
+ *
+ * Arguments:
+ *     Number of Parameters, Paramter List
+ *     
+ * Return:
+ *     None
+ */
+void CpuidTopology_DispatchBatch(unsigned int NumberOfParameters, char **Parameters)
+{
+    if (NumberOfParameters >= 1) 
+    {
+        Batch_CpuidBatchExample(NumberOfParameters, Parameters);
+    }
+    else
+    {
+        printf("No file names to analyse in the batch.\n\n");
+        Display_DisplayParameters();
+    }
+}
+
+
+/*
+ * CpuidTopology_ParseFileFormat
+ *
+ * Parses the optional file format parameter, T for text or B for binary.
+ *
+ * Arguments:
+ *     File Format Parameter or NULL if there is none, File Format to fill in
+ *     
+ * Return:
+ *     Returns true if there is no format or it is valid
+ */
+BOOL_TYPE CpuidTopology_ParseFileFormat(char *pszFileFormat, PCPUID_FILE_FORMAT pFileFormat)
+{
+    BOOL_TYPE FormatValid;
+
+    *pFileFormat = CpuidFileFormat_Text;
+    FormatValid = BOOL_TRUE;
+
+    if (pszFileFormat) 
+    {
+        switch (*pszFileFormat | ((char)0x20))
+        {
+            case 't':
+                 *pFileFormat = CpuidFileFormat_Text;
+                 break;
+
+            case 'b':
+                 *pFileFormat = CpuidFileFormat_Binary;
+                 break;
+
+            case 'c':
+                 *pFileFormat = CpuidFileFormat_Compressed;
+                 break;
+
+            default:
+                 FormatValid = BOOL_FALSE;
+        }
+    }
+
+    return FormatValid;
 }
 
 
@@ -205,7 +437,9 @@ void CpuidTopology_DispatchWriteFile(unsigned int NumberOfParameters, char **Par
 /*
  * CpuidTopology_DispatchTaskCommand
  *
- * Dispatch a specific action request from the command line.
+ * Dispatch one or more action requests from the command line.  The CPUID of all 
+ * processors is captured once up front and every command is served from that 
+ * same snapshot.
  *
  * Arguments:
  *     Number of Parameters, Parameter List
@@ -215,6 +449,53 @@ void CpuidTopology_DispatchWriteFile(unsigned int NumberOfParameters, char **Par
  */
 void CpuidTopology_DispatchTaskCommand(unsigned int NumberOfParameters, char **Parameters)
 {
+    unsigned int ParameterIndex;
+    unsigned int ParametersUsed;
+
+    if (NumberOfParameters > 0) 
+    {
+        Capture_CaptureProcessors();
+
+        ParameterIndex = 0;
+
+        while (ParameterIndex < NumberOfParameters) 
+        {
+            ParametersUsed = CpuidTopology_DispatchTask(NumberOfParameters - ParameterIndex, Parameters + ParameterIndex);
+
+            if (ParametersUsed == 0) 
+            {
+                Display_DisplayParameters();
+                break;
+            }
+
+            ParameterIndex = ParameterIndex + ParametersUsed;
+        }
+    }
+    else
+    {
+        Display_DisplayParameters();
+    }
+
+}
+
+
+/*
+ * CpuidTopology_DispatchTask
+ *
+ * Dispatch a specific action request from the command line.
+ *
+ * Arguments:
+ *     Number of Parameters, Parameter List
+ *     
+ * Return:
+ *     The number of parameters used by the command, zero if it is not valid.
+ */
+unsigned int CpuidTopology_DispatchTask(unsigned int NumberOfParameters, char **Parameters)
+{
+    unsigned int ParametersUsed;
+    unsigned int Command;
+    char *pszEnd;
+
     /*
      * The Command Reference.
      *
@@ -225,64 +506,359 @@ void CpuidTopology_DispatchTaskCommand(unsigned int NumberOfParameters, char **P
      *   4 - Display APIC ID layout
      *   5 - Display TLB Information
      *   6 - Display Cache Information
+     *   7 - Export the topology as JSON
+     *   8 - Export the topology as CSV
+     *   9 - Plan the processors for a number of workers with a placement policy
+     *  10 - Display the NUMA node of each processor with its package and die (Not valid with File Load.)
+     *  11 - Validate the CPUID topology against the OS topology (Not valid with File Load.)
+     *  12 - Watch for processors going online or offline and update the topology (Not valid with File Load.)
+     *  13 - Advise the sizes of data structures for a working set
+     *  14 - Measure the latency and bandwidth between processors at each topology level (Not valid with File Load.)
+     *  15 - Generate a C header file of the constant domain masks and shifts
      *  
      */
 
-    if (NumberOfParameters > 0) 
+    ParametersUsed = 1;
+
+    Command = (unsigned int)strtoul(Parameters[0], &pszEnd, 10);
+
+    if (pszEnd == Parameters[0] || *pszEnd != 0) 
+    {
+        ParametersUsed = 0;
+    }
+    else
+    {
+        switch (Command)
+        {
+            case 0:
+                 if (Tools_IsNative()) 
+                 {
+                     printf("The following demonstrates OS-provided topology information to applications.\n");
+                     printf("It is reccomended for applications to utilize OS APIs where possible rather than direct CPUID manipulation.\n\n");
+                     Os_DisplayTopology();
+                 }
+                 else
+                 {
+                     ParametersUsed = 0;
+                 }
+                 break;
+
+            case 1:
+                 CpuidTopology_AllTopologyFromCpuid();
+                 break;
+
+            case 2:
+                 Display_DisplayProcessorLeafs(1);
+                 break;
+        
+            case 3:
+                 Display_DisplayProcessorLeafs(Tools_GetNumberOfProcessors());
+                 break;
+
+            case 4: 
+                 ParseCpu_ApicIdTopologyLayout();
+                 break;
+
+            case 5:
+                 ParseTlb_CpuidTlbExample();
+                 break;
+
+            case 6:
+                 ParseCache_CpuidCacheExample();
+                 break;
+
+            case 7:
+                 Export_WriteTopology(stdout, ExportFormat_Json);
+                 break;
+
+            case 8:
+                 Export_WriteTopology(stdout, ExportFormat_Csv);
+                 break;
+
+            case 9:
+                 ParametersUsed = CpuidTopology_DispatchPlacement(NumberOfParameters, Parameters);
+                 break;
+
+            case 10:
+                 if (Tools_IsNative()) 
+                 {
+                     CpuidTopology_NumaTopology();
+                 }
+                 else
+                 {
+                     ParametersUsed = 0;
+                 }
+                 break;
+
+            case 11:
+                 if (Tools_IsNative()) 
+                 {
+                     Validate_CpuidValidationExample();
+                 }
+                 else
+                 {
+                     ParametersUsed = 0;
+                 }
+                 break;
+
+            case 12:
+                 if (Tools_IsNative()) 
+                 {
+                     ParametersUsed = CpuidTopology_DispatchWatchProcessors(NumberOfParameters, Parameters);
+                 }
+                 else
+                 {
+                     ParametersUsed = 0;
+                 }
+                 break;
+
+            case 13:
+                 ParametersUsed = CpuidTopology_DispatchSizingAdvice(NumberOfParameters, Parameters);
+                 break;
+
+            case 14:
+                 if (Tools_IsNative()) 
+                 {
+                     ParametersUsed = CpuidTopology_DispatchLatency(NumberOfParameters, Parameters);
+                 }
+                 else
+                 {
+                     ParametersUsed = 0;
+                 }
+                 break;
+
+            case 15:
+                 ParametersUsed = CpuidTopology_DispatchLayoutHeader(NumberOfParameters, Parameters);
+                 break;
+
+            default: 
+                 ParametersUsed = 0;
+        }
+    }
+
+    return ParametersUsed;
+}
+
+
+
+
+/*
+ * CpuidTopology_DispatchPlacement
+ *
+ * Dispatch the placement planner, the command is followed by the number of 
+ * workers and the placement policy.
+ *
+ * Arguments:
+ *     Number of Parameters, Parameter List starting at the command
+ *     
+ * Return:
+ *     The number of parameters used by the command, zero if it is not valid.
+ */
+unsigned int CpuidTopology_DispatchPlacement(unsigned int NumberOfParameters, char **Parameters)
+{
+    PLACEMENT_POLICY PlacementPolicy;
+    unsigned int NumberOfWorkers;
+    unsigned int ParametersUsed;
+    char *pszEnd;
+
+    ParametersUsed = 0;
+    PlacementPolicy = PlacementPolicy_Spread;
+
+    if (NumberOfParameters >= 3) 
     {
+        NumberOfWorkers = (unsigned int)strtoul(Parameters[1], &pszEnd, 0);
+        ParametersUsed = 3;
 
-        if (*Parameters[0] == '0') 
+        switch (*Parameters[2] | ((char)0x20))
         {
-            if (Tools_IsNative()) 
-            {
-                printf("The following demonstrates OS-provided topology information to applications.\n");
-                printf("It is reccomended for applications to utilize OS APIs where possible rather than direct CPUID manipulation.\n\n");
-                Os_DisplayTopology();
-            }
-            else
-            {
-                Display_DisplayParameters();
-            }
+            case 's':
+                 PlacementPolicy = PlacementPolicy_Spread;
+                 break;
+
+            case 'p':
+                 PlacementPolicy = PlacementPolicy_Pack;
+                 break;
+
+            case 'n':
+                 PlacementPolicy = PlacementPolicy_NoSmt;
+                 break;
+
+            default:
+                 ParametersUsed = 0;
         }
-        else
+
+        if (NumberOfWorkers == 0 || *pszEnd != 0 || Parameters[2][1] != 0) 
         {
+            ParametersUsed = 0;
+        }
 
-            switch (*Parameters[0])
-            {
-                case '1':
-                     CpuidTopology_AllTopologyFromCpuid();
-                     break;
+        if (ParametersUsed) 
+        {
+            Planner_CpuidPlacementExample(NumberOfWorkers, PlacementPolicy);
+        }
+    }
 
-                case '2':
-                     Display_DisplayProcessorLeafs(1);
-                     break;
-            
-                case '3':
-                     Display_DisplayProcessorLeafs(Tools_GetNumberOfProcessors());
-                     break;
+    return ParametersUsed;
+}
 
-                case '4': 
-                     ParseCpu_ApicIdTopologyLayout();
-                     break;
 
-                case '5':
-                     ParseTlb_CpuidTlbExample();
-                     break;
 
-                case '6':
-                     ParseCache_CpuidCacheExample();
-                     break;
+/*
+ * CpuidTopology_DispatchWatchProcessors
+ *
+ * Dispatch the processor watch, the command is followed by the number of 
+ * seconds to watch for.
+ *
+ * Arguments:
+ *     Number of Parameters, Parameter List starting at the command
+ *     
+ * Return:
+ *     The number of parameters used by the command, zero if it is not valid.
+ */
+unsigned int CpuidTopology_DispatchWatchProcessors(unsigned int NumberOfParameters, char **Parameters)
+{
+    unsigned int Seconds;
+    unsigned int ParametersUsed;
+    char *pszEnd;
 
-                default: 
-                     Display_DisplayParameters();
-            }
+    ParametersUsed = 0;
+
+    if (NumberOfParameters >= 2) 
+    {
+        Seconds = (unsigned int)strtoul(Parameters[1], &pszEnd, 0);
+
+        if (Seconds != 0 && *pszEnd == 0) 
+        {
+            ParametersUsed = 2;
+            CpuidTopology_WatchProcessors(Seconds);
         }
     }
-    else
+
+    return ParametersUsed;
+}
+
+
+
+
+/*
+ * CpuidTopology_DispatchSizingAdvice
+ *
+ * Dispatch the sizing advisor, the command is followed by the working set 
+ * of each thread in megabytes.
+ *
+ * Arguments:
+ *     Number of Parameters, Parameter List starting at the command
+ *     
+ * Return:
+ *     The number of parameters used by the command, zero if it is not valid.
+ */
+unsigned int CpuidTopology_DispatchSizingAdvice(unsigned int NumberOfParameters, char **Parameters)
+{
+    unsigned long long WorkingSetMegabytes;
+    unsigned int ParametersUsed;
+    char *pszEnd;
+
+    ParametersUsed = 0;
+
+    if (NumberOfParameters >= 2) 
     {
-        Display_DisplayParameters();
+        WorkingSetMegabytes = strtoull(Parameters[1], &pszEnd, 0);
+
+        if (WorkingSetMegabytes != 0 && WorkingSetMegabytes < (1ULL<<40) && *pszEnd == 0) 
+        {
+            ParametersUsed = 2;
+            Advisor_CpuidSizingExample(WorkingSetMegabytes<<20);
+        }
+    }
+
+    return ParametersUsed;
+}
+
+
+
+
+/*
+ * CpuidTopology_DispatchLatency
+ *
+ * Dispatch the latency benchmark, the command is followed by the number of 
+ * round trips timed for each pair of processors.
+ *
+ * Arguments:
+ *     Number of Parameters, Parameter List starting at the command
+ *     
+ * Return:
+ *     The number of parameters used by the command, zero if it is not valid.
+ */
+unsigned int CpuidTopology_DispatchLatency(unsigned int NumberOfParameters, char **Parameters)
+{
+    unsigned int RoundTrips;
+    unsigned int ParametersUsed;
+    char *pszEnd;
+
+    ParametersUsed = 0;
+
+    if (NumberOfParameters >= 2) 
+    {
+        RoundTrips = (unsigned int)strtoul(Parameters[1], &pszEnd, 0);
+
+        if (RoundTrips != 0 && RoundTrips <= (1U<<30) && *pszEnd == 0) 
+        {
+            ParametersUsed = 2;
+            Latency_CpuidLatencyExample(RoundTrips);
+        }
     }
 
+    return ParametersUsed;
+}
+
+
+
+
+/*
+ * CpuidTopology_DispatchLayoutHeader
+ *
+ * Dispatch the layout header export, the command is followed by the name of 
+ * the header file to write.
+ *
+ * Arguments:
+ *     Number of Parameters, Parameter List starting at the command
+ *     
+ * Return:
+ *     The number of parameters used by the command, zero if it is not valid.
+ */
+unsigned int CpuidTopology_DispatchLayoutHeader(unsigned int NumberOfParameters, char **Parameters)
+{
+    FILE *pHeaderFile;
+    unsigned int ParametersUsed;
+
+    ParametersUsed = 0;
+
+    if (NumberOfParameters >= 2) 
+    {
+        ParametersUsed = 2;
+
+        pHeaderFile = fopen(Parameters[1], "w");
+
+        if (pHeaderFile) 
+        {
+            Export_WriteTopology(pHeaderFile, ExportFormat_Header);
+
+            if (fclose(pHeaderFile) == 0) 
+            {
+                printf("Layout header saved to %s\n", Parameters[1]);
+            }
+            else
+            {
+                printf("Failed to save the layout header to %s\n", Parameters[1]);
+            }
+        }
+        else
+        {
+            printf("Failed to save the layout header to %s\n", Parameters[1]);
+        }
+    }
+
+    return ParametersUsed;
 }
 
 
@@ -369,9 +945,9 @@ void CpuidTopology_AllTopologyFromCpuid(void)
 
 
 /*
- * CpuidTopology_InitGlobal
+ * CpuidTopology_InitContext
  *
- *    Initialize the global structure for this file.
+ *    Initialize the CPUID context of the main thread for native CPUID.
  *
  * Arguments:
  *     None
@@ -379,10 +955,130 @@ void CpuidTopology_AllTopologyFromCpuid(void)
  * Return:
  *     None
  */
-void CpuidTopology_InitGlobal(void)
+void CpuidTopology_InitContext(void)
 {
-    g_GlobalData.UseNativeCpuid = BOOL_TRUE;
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    pCpuidContext->UseNativeCpuid = BOOL_TRUE;
 }
 
 
 
+/*
+ * CpuidTopology_NumaTopology
+ *
+ *    Demonstrates joining the CPUID package and die of each processor with
+ *    the NUMA node the OS reports for it.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     None
+ */
+void CpuidTopology_NumaTopology(void)
+{
+    PCPUID_TOPOLOGY pTopology;
+
+    pTopology = Topology_Create();
+
+    if (pTopology) 
+    {
+        Display_DisplayNumaTopology(pTopology);
+        Topology_Destroy(pTopology);
+    }
+}
+
+
+/*
+ * CpuidTopology_WatchProcessors
+ *
+ *    Demonstrates keeping a topology up to date as processors go online or
+ *    offline.  Only the processors that changed are captured, the topology is
+ *    then recreated from the snapshot without reading CPUID on any processor
+ *    and published, readers of the publisher see the new topology the next
+ *    time they enter a read.
+ *
+ * Arguments:
+ *     Number of Seconds to watch
+ *     
+ * Return:
+ *     None
+ */
+void CpuidTopology_WatchProcessors(unsigned int Seconds)
+{
+    PTOPOLOGY_PUBLISHER pPublisher;
+    PCPUID_TOPOLOGY pTopology;
+    unsigned long long Deadline;
+    unsigned long long CurrentTime;
+    unsigned int ProcessorsAdded;
+    unsigned int ProcessorsRemoved;
+    unsigned int ProcessorIndex;
+    unsigned int ReaderIndex;
+    unsigned int RetiredTopologies;
+
+    pPublisher = Publish_CreatePublisher(1);
+
+    if (pPublisher) 
+    {
+        ReaderIndex = Publish_RegisterReader(pPublisher);
+        pTopology = Topology_Create();
+
+        if (pTopology && Publish_PublishTopology(pPublisher, pTopology) == BOOL_FALSE) 
+        {
+            Topology_Destroy(pTopology);
+            pTopology = NULL;
+        }
+
+        if (pTopology) 
+        {
+            printf("Watching %u processors for %u seconds\n", Topology_GetNumberOfProcessors(pTopology), Seconds);
+
+            CurrentTime = Os_GetTimestampNanoseconds();
+            Deadline = CurrentTime + ((unsigned long long)Seconds*1000000000ULL);
+
+            while (CurrentTime < Deadline) 
+            {
+                if (Os_WaitForProcessorChange((unsigned int)((Deadline - CurrentTime)/1000000ULL)) && Capture_UpdateProcessors(&ProcessorsAdded, &ProcessorsRemoved)) 
+                {
+                    pTopology = Topology_Create();
+
+                    if (pTopology && Publish_PublishTopology(pPublisher, pTopology) == BOOL_FALSE) 
+                    {
+                        Topology_Destroy(pTopology);
+                        pTopology = NULL;
+                    }
+
+                    if (pTopology) 
+                    {
+                        RetiredTopologies = Publish_ReclaimTopologies(pPublisher);
+
+                        pTopology = Publish_EnterRead(pPublisher, ReaderIndex);
+
+                        printf("\nProcessors changed, %u added and %u removed, %u processors online\n", ProcessorsAdded, ProcessorsRemoved, Topology_GetNumberOfProcessors(pTopology));
+                        printf("   Published topology generation %llu, %u replaced topologies waiting for readers\n", pPublisher->Generation, RetiredTopologies);
+                        printf("   APIC IDs:");
+
+                        for (ProcessorIndex = 0; ProcessorIndex < Topology_GetNumberOfProcessors(pTopology); ProcessorIndex++) 
+                        {
+                            printf(" 0x%x", Topology_GetApicId(pTopology, ProcessorIndex));
+                        }
+
+                        printf("\n");
+
+                        Publish_ExitRead(pPublisher, ReaderIndex);
+                    }
+                }
+
+                CurrentTime = Os_GetTimestampNanoseconds();
+            }
+
+            printf("\n");
+        }
+
+        Publish_UnregisterReader(pPublisher, ReaderIndex);
+        Publish_DestroyPublisher(pPublisher);
+    }
+}
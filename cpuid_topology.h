@@ -19,18 +19,31 @@
 
 
 /*
- * The following constants are used to simplify the code and in 
- * many places is used for static array creation as opposed to dynamically 
- * at runtime determining the size. 
+ * The following constants are used to simplify the code.  The processor and CPUID
+ * storage is sized at runtime; the per-LP cache and TLB counts are only the initial
+ * sizes of arrays that grow as needed. 
  * 
  */
-#define MAX_PROCESSORS          1024
-#define MAX_SIMULATED_LEAFS     0x20
-#define MAX_SIMULATED_SUBLEAFS  10
 #define MAX_CACHE_PER_LP        10
 #define MAX_TLB_PER_LP          25
+#define NUMBER_OF_CAPTURED_LEAFS 7
+#define MAX_ENUMERATED_SUBLEAFS 0x100
 #define INVALID_CACHE_INDEX     ((unsigned int)-1)
 #define INVALID_TLB_INDEX       ((unsigned int)-1)
+#define INVALID_REGISTER_INDEX  ((unsigned int)-1)
+#define INVALID_PROCESSOR_INDEX ((unsigned int)-1)
+#define INVALID_NUMA_NODE       ((unsigned int)-1)
+#define INVALID_READER_INDEX    ((unsigned int)-1)
+#define INVALID_LEAF            ((unsigned int)-1)
+
+/*
+ * The instrumentation has a counter for each of the basic leafs and the extended 
+ * leafs from 80000000H below, every other leaf is counted in the last counter.
+ */
+#define INSTRUMENT_BASIC_LEAFS     (0x40)
+#define INSTRUMENT_EXTENDED_LEAFS  (0x20)
+#define INSTRUMENT_LEAF_COUNTERS   (INSTRUMENT_BASIC_LEAFS + INSTRUMENT_EXTENDED_LEAFS + 1)
+#define INSTRUMENT_OTHER_LEAFS     (INSTRUMENT_LEAF_COUNTERS - 1)
  
 /*
  * The maximum number of enumerated domains, since X2APIC is 32 bits there 
@@ -44,6 +57,17 @@
 #define BYTES_IN_KB  (1024)
 #define BYTES_IN_MB  (1048576)
 
+/*
+ * The cache line size the per-processor lookup tables are aligned and padded to.
+ */
+#define CACHE_LINE_SIZE  64
+
+/*
+ * The APIC ID to processor index map is a direct array unless the APIC IDs are
+ * spread over more than this many slots per processor.
+ */
+#define MAX_APIC_ID_MAP_SLOTS_PER_LP  64
+
 
 
 
@@ -74,6 +98,73 @@ typedef enum _BOOL_TYPE {
 } BOOL_TYPE, *PBOOL_TYPE;
 
 
+/*
+ * A set of logical processors stored as a bitmap over the processor index, 
+ * the APIC ID of each member comes from the platform APIC ID list.
+ */
+typedef struct _PROCESSOR_SET
+{
+    unsigned int NumberOfProcessors;
+    unsigned int *pBitmap;
+
+} PROCESSOR_SET, *PPROCESSOR_SET;
+
+#define PROCESSOR_SET_BITS_PER_WORD  (sizeof(unsigned int)*8)
+
+
+/*
+ * Text that is collected in memory and written to a stream in one write.  If 
+ * the buffer cannot grow the text is written to the stream as it is added.
+ */
+typedef struct _TEXT_BUFFER
+{
+    FILE *pStream;
+    char *pBuffer;
+    size_t Length;
+    size_t Maximum;
+
+} TEXT_BUFFER, *PTEXT_BUFFER;
+
+/*
+ * The largest text that can be added to a text buffer at one time.
+ */
+#define MAX_TEXT_RECORD   256
+
+
+/*
+ * A slot in the register index, the key is an identifier such as a Cache ID 
+ * paired with the complete CPUID subleaf that described it.
+ */
+typedef struct _CPUID_REGISTER_INDEX_ENTRY
+{
+    unsigned int Id;
+    CPUID_REGISTERS CpuidRegisters;
+
+    /*
+     * The value stored for this key, INVALID_REGISTER_INDEX marks an empty slot.
+     */
+    unsigned int Value;
+
+} CPUID_REGISTER_INDEX_ENTRY, *PCPUID_REGISTER_INDEX_ENTRY;
+
+
+/*
+ * Open addressed hash index used to find a matching cache or TLB entry in 
+ * constant time rather than comparing every known entry.
+ */
+typedef struct _CPUID_REGISTER_INDEX
+{
+    PCPUID_REGISTER_INDEX_ENTRY pSlots;
+
+    /*
+     * The number of slots is always a power of 2.
+     */
+    unsigned int NumberOfSlots;
+    unsigned int NumberOfEntries;
+
+} CPUID_REGISTER_INDEX, *PCPUID_REGISTER_INDEX;
+
+
 /*
  * Caching Structure
  */
@@ -113,10 +204,10 @@ typedef struct _CPUID_CACHE_INFO
     BOOL_TYPE CacheIsComplex;                
 
     /*
-     * The list of shared APIC IDs sharing this cache.
+     * The set of logical processors sharing this cache.
      */
     unsigned int NumberOfLPsSharingThisCache;
-    unsigned int ListOfApicIDsSharingThisCache[MAX_PROCESSORS];
+    PROCESSOR_SET LPsSharingThisCache;
 
     /*
      * The CPUID description of this cache.
@@ -165,10 +256,10 @@ typedef struct _CPUID_TLB_INFO
     BOOL_TYPE FullyAssociative;
 
     /*
-     * The list of shared APIC IDs sharing this TLB.
+     * The set of logical processors sharing this TLB.
      */
     unsigned int NumberOfLPsSharingThisTlb;
-    unsigned int ListOfApicIDsSharingThisTlb[MAX_PROCESSORS];
+    PROCESSOR_SET LPsSharingThisTlb;
 
     /*
      * The CPUID description of this TLB.
@@ -178,6 +269,36 @@ typedef struct _CPUID_TLB_INFO
 } CPUID_TLB_INFO, *PCPUID_TLB_INFO;
 
 
+/*
+ * The caches enumerated across the platform along with the APIC ID of
+ * each processor index used by the sharing sets.
+ */
+typedef struct _CPUID_CACHE_TOPOLOGY
+{
+    PCPUID_CACHE_INFO pCacheInfo;
+    unsigned int NumberOfCaches;
+
+    unsigned int *pApicIdList;
+    unsigned int NumberOfProcessors;
+
+} CPUID_CACHE_TOPOLOGY, *PCPUID_CACHE_TOPOLOGY;
+
+
+/*
+ * The TLBs enumerated across the platform along with the APIC ID of
+ * each processor index used by the sharing sets.
+ */
+typedef struct _CPUID_TLB_TOPOLOGY
+{
+    PCPUID_TLB_INFO pTlbInfo;
+    unsigned int NumberOfTlbs;
+
+    unsigned int *pApicIdList;
+    unsigned int NumberOfProcessors;
+
+} CPUID_TLB_TOPOLOGY, *PCPUID_TLB_TOPOLOGY;
+
+
 
 
 
@@ -208,6 +329,17 @@ typedef enum _CACHE_TYPE {
 } CACHE_TYPE, *PCACHE_TYPE;
 
 
+/*
+ * The core types of a hybrid processor from CPUID.1AH:EAX[31:24], processors
+ * that are not hybrid report no core type.
+ */
+typedef enum _CORE_TYPE {
+    CoreType_NotHybrid = 0,
+    CoreType_Atom      = 0x20,
+    CoreType_Core      = 0x40
+} CORE_TYPE, *PCORE_TYPE;
+
+
 /*
  * Create an enumeration of tlb types.
  */
@@ -277,11 +409,432 @@ typedef struct _APICID_BIT_LAYOUT_CTX {
 } APICID_BIT_LAYOUT_CTX, *PAPICID_BIT_LAYOUT_CTX;
 
 
+/*
+ * The domains of an APIC ID layout as enumerated, the shift value and domain type
+ * of each domain from the logical processor to the package.  A header generated
+ * for a known platform holds one of these so code using its constant masks can 
+ * check once at startup that it is running on a platform with the same layout.
+ */
+typedef struct _CPUID_DOMAIN_LAYOUT {
+    unsigned int Leaf;
+    unsigned int NumberOfDomains;
+    unsigned int ShiftValues[MAXIMUM_DOMAINS];
+    unsigned int ShiftValueDomain[MAXIMUM_DOMAINS];
+} CPUID_DOMAIN_LAYOUT, *PCPUID_DOMAIN_LAYOUT;
+
+
+/*
+ * The topology model built by Topology_Create, it is not changed once built
+ * and is only read through the Topology query APIs.
+ */
+typedef struct _CPUID_TOPOLOGY
+{
+    unsigned int Leaf;
+    APICID_BIT_LAYOUT_CTX ApicidBitLayoutCtx;
+
+    unsigned int *pApicIdList;
+    unsigned int NumberOfProcessors;
+
+    CPUID_CACHE_TOPOLOGY CacheTopology;
+    CPUID_TLB_TOPOLOGY TlbTopology;
+
+    /*
+     * The domain IDs of every processor laid out as a row per processor, each row is
+     * the domain by relative domain matrix of IDs, with the global IDs on the diagonal,
+     * padded to whole cache lines so a lookup is a single load from one line.
+     */
+    unsigned int *pDomainIdTable;
+    unsigned int DomainIdStride;
+    unsigned int NumberOfDomains;
+
+    /*
+     * The processor index of each APIC ID, INVALID_PROCESSOR_INDEX for unused
+     * APIC IDs, or NULL when the APIC IDs are too sparse for a direct map.
+     */
+    unsigned int *pApicIdToProcessor;
+    unsigned int ApicIdMapSize;
+
+    /*
+     * The processor index of each OS processor ID, INVALID_PROCESSOR_INDEX for
+     * processors not in the topology, or NULL when the CPUID was not captured
+     * on this platform.  It maps the processor a thread is running on without CPUID.
+     */
+    unsigned int *pOsProcessorToProcessor;
+    unsigned int OsProcessorMapSize;
+
+    /*
+     * The hybrid core type and native model ID of each processor from CPUID.1AH.
+     */
+    CORE_TYPE *pCoreTypeList;
+    unsigned int *pNativeModelIdList;
+    BOOL_TYPE IsHybrid;
+
+    /*
+     * The OS NUMA node of each processor, INVALID_NUMA_NODE when the OS does not
+     * report one or the topology was loaded from a file.
+     */
+    unsigned int *pNumaNodeList;
+
+} CPUID_TOPOLOGY, *PCPUID_TOPOLOGY;
+
+
+
+/*
+ * The CPUID values of one leaf as captured on a single logical processor.
+ */
+typedef struct _CPUID_LEAF_SNAPSHOT {
+
+    unsigned int Leaf;
+
+    /*
+     * The subleafs are held up to the highest one captured and the
+     * array grows as needed.  A maximum of zero means the subleafs are
+     * borrowed from the snapshot storage.
+     */
+    unsigned int NumberOfSubleafs;
+    unsigned int MaximumSubleafs;
+    PCPUID_REGISTERS pSubleafs;
+
+} CPUID_LEAF_SNAPSHOT, *PCPUID_LEAF_SNAPSHOT;
+
+
+/*
+ * The snapshot of all captured CPUID leafs for a single logical processor.  The
+ * capture engine fills one of these per processor so the parsers can read CPUID
+ * for any processor without migrating the main thread.  When CPUID is loaded
+ * from a file the same snapshot is built from the file contents.
+ */
+typedef struct _CPUID_PROCESSOR_SNAPSHOT {
+
+    /*
+     * Set once the capture worker has completed on this processor.
+     */
+    BOOL_TYPE Captured;
+
+    /*
+     * The X2APIC ID or legacy APIC ID of this processor derived from the captured leafs.
+     */
+    unsigned int ApicId;
+
+    /*
+     * The OS identity of the processor the leafs were captured on, such as the Linux
+     * CPU number, so the snapshot can be matched to the processors that are online
+     * after processors go online or offline.  It is the processor number when CPUID
+     * is simulated.
+     */
+    unsigned int OsProcessorId;
+
+    /*
+     * Only the leafs that were captured or read from the file are held.  A 
+     * maximum of zero means the leafs are borrowed from the snapshot storage.
+     */
+    unsigned int NumberOfLeafs;
+    unsigned int MaximumLeafs;
+    PCPUID_LEAF_SNAPSHOT pLeafs;
+
+} CPUID_PROCESSOR_SNAPSHOT, *PCPUID_PROCESSOR_SNAPSHOT;
+
+
+/*
+ * The formats CPUID can be saved to a file in.
+ */
+typedef enum _CPUID_FILE_FORMAT {
+    CpuidFileFormat_Text = 0,
+    CpuidFileFormat_Binary,
+    CpuidFileFormat_Compressed
+} CPUID_FILE_FORMAT, *PCPUID_FILE_FORMAT;
+
+
+/*
+ * The levels of a synthetic platform from the logical processor up to the
+ * package, the APIC ID holds a field for each level in this order.
+ */
+typedef enum _GENERATE_LEVEL {
+    GenerateLevel_Thread = 0,
+    GenerateLevel_Core,
+    GenerateLevel_Module,
+    GenerateLevel_Die,
+    GenerateLevel_Package,
+    GenerateLevel_MaximumLevels
+} GENERATE_LEVEL, *PGENERATE_LEVEL;
+
+
+/*
+ * The specification of a synthetic platform; the number of each level in the
+ * level above it, the extra bits of unused core IDs and the level the L2 and L3
+ * caches are shared across.
+ */
+typedef struct _GENERATE_SPECIFICATION {
+    unsigned int LevelCount[GenerateLevel_MaximumLevels];
+    unsigned int CoreIdGapBits;
+    GENERATE_LEVEL L2SharingLevel;
+    GENERATE_LEVEL L3SharingLevel;
+
+} GENERATE_SPECIFICATION, *PGENERATE_SPECIFICATION;
+
+
+/*
+ * The machine readable formats the topology can be exported in.
+ */
+typedef enum _EXPORT_FORMAT {
+    ExportFormat_Json = 0,
+    ExportFormat_Csv,
+    ExportFormat_Header
+} EXPORT_FORMAT, *PEXPORT_FORMAT;
+
 
 /*
- * Internal Structures and types
+ * The policies the planner places workers on processors with.
  */
-typedef struct _GLOBAL_DATA {
+typedef enum _PLACEMENT_POLICY {
+    PlacementPolicy_Spread = 0,
+    PlacementPolicy_Pack,
+    PlacementPolicy_NoSmt
+} PLACEMENT_POLICY, *PPLACEMENT_POLICY;
+
+
+/*
+ * The page sizes the sizing advisor reports the TLB reach of.
+ */
+typedef enum _PAGE_SIZE {
+    PageSize_4K = 0,
+    PageSize_2M,
+    PageSize_1G,
+    PageSize_MaximumSizes
+} PAGE_SIZE, *PPAGE_SIZE;
+
+
+/*
+ * The tuning parameters for sizing data structures on a logical processor, derived
+ * from the geometry of the caches and TLBs it uses.  Sizes are in bytes and are zero
+ * when the cache or TLB is not enumerated.
+ */
+typedef struct _SIZING_ADVICE {
+
+    /*
+     * The line size of the first level data cache, data written by different threads
+     * should be padded and aligned to it.
+     */
+    unsigned int CacheLineSize;
+
+    /*
+     * The share of the L1 data, L2 and last level caches of each logical processor, 
+     * the size of the cache divided by the logical processors sharing it.
+     */
+    unsigned int L1DataSharePerThread;
+    unsigned int L2SharePerThread;
+    unsigned int LastLevelCacheLevel;
+    unsigned int LastLevelSharePerThread;
+
+    /*
+     * The tile that fits in half of the share of the L1 data and L2 caches, as a 
+     * power of two in bytes and as the edge of a square tile of 8 byte elements.
+     */
+    unsigned int L1TileBytes;
+    unsigned int L1TileEdge;
+    unsigned int L2TileBytes;
+    unsigned int L2TileEdge;
+
+    /*
+     * The number of cache line sized hash table buckets that fit in the share of
+     * the last level cache, as a power of two.
+     */
+    unsigned int HashBucketsPerThread;
+
+    /*
+     * The memory the data TLBs can map with each page size and the page size
+     * recommended for the working set.
+     */
+    unsigned long long TlbReach[PageSize_MaximumSizes];
+    PAGE_SIZE RecommendedPageSize;
+
+} SIZING_ADVICE, *PSIZING_ADVICE;
+
+
+/*
+ * The levels of the topology two logical processors can meet at, from the 
+ * closest to the most distant.
+ */
+typedef enum _LATENCY_LEVEL {
+    LatencyLevel_SmtSibling = 0,
+    LatencyLevel_SharedL2,
+    LatencyLevel_SameDie,
+    LatencyLevel_CrossDie,
+    LatencyLevel_CrossPackage,
+    LatencyLevel_MaximumLevels
+} LATENCY_LEVEL, *PLATENCY_LEVEL;
+
+
+/*
+ * The measured cost of communication between the pair of logical processors
+ * representing a level of the topology.
+ */
+typedef struct _LATENCY_COST {
+    BOOL_TYPE PairFound;
+    BOOL_TYPE Measured;
+    unsigned int FirstProcessor;
+    unsigned int SecondProcessor;
+
+    /*
+     * The time a cache line written by one processor takes to be read by the 
+     * other, half of the average round trip.
+     */
+    unsigned long long LatencyPicoseconds;
+
+    /*
+     * The rate the second processor reads a buffer the first processor wrote,
+     * the buffer is half of the closest cache the pair shares.
+     */
+    unsigned long long BandwidthMegabytesPerSecond;
+    unsigned int BufferBytes;
+
+} LATENCY_COST, *PLATENCY_COST;
+
+
+/*
+ * The cost of communication at each level of the topology, indexed by the level
+ * Latency_GetPairLevel returns for any pair of logical processors.
+ */
+typedef struct _LATENCY_MATRIX {
+    unsigned int RoundTrips;
+    LATENCY_COST Cost[LatencyLevel_MaximumLevels];
+} LATENCY_MATRIX, *PLATENCY_MATRIX;
+
+
+/*
+ * A capture file analysed in a batch.  Captures with the same fingerprint have 
+ * an identical topology, regardless of the order the processors were saved in.
+ */
+typedef struct _BATCH_CAPTURE {
+    char *pszFileName;
+    unsigned int CaptureIndex;
+    BOOL_TYPE Loaded;
+    unsigned long long Fingerprint;
+    unsigned int NumberOfProcessors;
+    unsigned int NumberOfDomains;
+    unsigned int NumberOfCaches;
+} BATCH_CAPTURE, *PBATCH_CAPTURE;
+
+
+/*
+ * A reader of published topologies.  The epoch is the publication epoch the reader 
+ * entered in, or zero while it is not reading.  Each reader is on its own cache line
+ * so readers entering and leaving do not write to lines shared with other readers.
+ */
+typedef struct _TOPOLOGY_READER {
+    volatile unsigned long long Epoch;
+    volatile unsigned long long InUse;
+    unsigned char Padding[CACHE_LINE_SIZE - 2*sizeof(unsigned long long)];
+} TOPOLOGY_READER, *PTOPOLOGY_READER;
+
+
+/*
+ * A topology that has been replaced, it is destroyed once every reader has left
+ * the epoch it was replaced in.
+ */
+typedef struct _RETIRED_TOPOLOGY {
+    PCPUID_TOPOLOGY pTopology;
+    unsigned long long RetireEpoch;
+    struct _RETIRED_TOPOLOGY *pNext;
+} RETIRED_TOPOLOGY, *PRETIRED_TOPOLOGY;
+
+
+/*
+ * Publishes immutable topologies to reader threads.  Readers only load the current
+ * topology and record the epoch they are in, they never take a lock.  A single
+ * writer swaps in a new topology, advances the epoch and retires the old topology.
+ */
+typedef struct _TOPOLOGY_PUBLISHER {
+    void * volatile pCurrentTopology;
+    volatile unsigned long long Epoch;
+    unsigned long long Generation;
+    PRETIRED_TOPOLOGY pRetiredTopologies;
+    unsigned int NumberOfRetiredTopologies;
+    unsigned int MaximumReaders;
+    PTOPOLOGY_READER pReaders;
+} TOPOLOGY_PUBLISHER, *PTOPOLOGY_PUBLISHER;
+
+
+/*
+ * The instrumentation counters of the process, they are only counted while the
+ * instrumentation is enabled.  The CPUID instructions executed and their time are
+ * counted by leaf, the affinity calls include the failures and the snapshot reads
+ * are the reads that found or did not find the leaf in the snapshot.  The parser
+ * allocations are those of the cache and TLB parsers.
+ */
+typedef struct _INSTRUMENT_COUNTERS {
+    unsigned long long CpuidCalls[INSTRUMENT_LEAF_COUNTERS];
+    unsigned long long CpuidNanoseconds[INSTRUMENT_LEAF_COUNTERS];
+    unsigned long long AffinityCalls;
+    unsigned long long AffinityFailures;
+    unsigned long long AffinityNanoseconds;
+    unsigned long long SnapshotHits;
+    unsigned long long SnapshotMisses;
+    unsigned long long ParserAllocations;
+    unsigned long long ParserBytesAllocated;
+} INSTRUMENT_COUNTERS, *PINSTRUMENT_COUNTERS;
+
+
+/*
+ * Function Pointer Definition for work to be performed on a specific processor.
+ */
+typedef void (*PFN_PROCESSOR_WORKER)(unsigned int ProcessorNumber, void *pContext);
+
+/*
+ * Function Pointer Definition for receiving each record echoed while a CPUID file 
+ * is loaded or saved, the record includes its newline.
+ */
+typedef void (*PFN_FILE_ECHO_SINK)(char *pszRecord, void *pContext);
+
+
+/*
+ * The relationships the OS reports between its processors.
+ */
+typedef enum _OS_RELATIONSHIP {
+    OsRelationship_Core = 0,
+    OsRelationship_Die,
+    OsRelationship_Package,
+    OsRelationship_Cache
+} OS_RELATIONSHIP, *POS_RELATIONSHIP;
+
+
+/*
+ * One relationship reported by the OS and the processors in it, the processors
+ * are indexes into the ordered processor numbers of the OS topology.  A cache
+ * also describes itself in the same structure as the CPUID path, only the
+ * physical description is filled in and the sharing is given by the processors.
+ */
+typedef struct _OS_TOPOLOGY_ENTRY {
+    OS_RELATIONSHIP Relationship;
+    unsigned int Id;
+    PROCESSOR_SET Processors;
+    CPUID_CACHE_INFO CacheInfo;
+
+} OS_TOPOLOGY_ENTRY, *POS_TOPOLOGY_ENTRY;
+
+
+/*
+ * The topology as reported by the OS, every entry in the order it was enumerated.
+ */
+typedef struct _OS_TOPOLOGY {
+    unsigned int NumberOfProcessors;
+    unsigned int *pProcessorNumbers;
+
+    unsigned int NumberOfEntries;
+    unsigned int MaximumEntries;
+    POS_TOPOLOGY_ENTRY pEntries;
+
+} OS_TOPOLOGY, *POS_TOPOLOGY;
+
+
+
+/*
+ * The CPUID context holds everything CPUID is read from: the snapshot, whether it is
+ * native or simulated and the simulated processor affinity.  Each thread reads CPUID
+ * through the context bound to it, so threads with their own context can capture,
+ * load and parse at the same time without any locking.
+ */
+typedef struct _CPUID_CONTEXT {
     
     /*
      *  This determines if the Virtual CPUID or the Native CPUID should be used.
@@ -289,37 +842,54 @@ typedef struct _GLOBAL_DATA {
     BOOL_TYPE UseNativeCpuid;
 
     /*
-     *  The Virtual CPUID simulation values.
+     * The Processor Affinity Number of the thread using this context, for simulated 
+     * CPUID this only selects the processor of the snapshot that is read.
      */
-    unsigned int SimulatedCpuid[MAX_SIMULATED_LEAFS][MAX_SIMULATED_SUBLEAFS][4];
+    unsigned int CurrentProcessorAffinity;
 
     /*
-     *  The Virtual CPUID simulation value for CPUID.4; since it is asymmetric.
+     * The per-processor snapshot of CPUID that all CPUID reads are served from, filled 
+     * by the capture engine for native CPUID or by the file loader for simulated CPUID.
      */
-    unsigned int SimulatedCpuidLeaf4[MAX_PROCESSORS][MAX_SIMULATED_SUBLEAFS][4];
+    PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot;
+    unsigned int NumberOfSnapshotProcessors;
 
     /*
-     *  The Virtual CPUID simulation value for CPUID.18; since it is asymmetric.
+     * A block the snapshot borrows leafs from, such as a binary capture file 
+     * loaded in one read; it is freed with the snapshot. 
      */
-    unsigned int SimulatedCpuidLeaf18[MAX_PROCESSORS][MAX_SIMULATED_SUBLEAFS][4];
+    void *pSnapshotStorage;
 
     /*
-     * The list of the Simulated APIC IDs.
+     * The records read or written in a CPUID file are echoed to the console in one
+     * buffered write unless quiet, or streamed to the sink if one is set.
      */
-    unsigned int SimulatedApicIds[MAX_PROCESSORS];
+    BOOL_TYPE QuietFileEcho;
+    PFN_FILE_ECHO_SINK pfnFileEchoSink;
+    void *pFileEchoContext;
 
     /*
-     * The number of simulated processors .
+     * The exit status of the application, set when a command detects a failure
+     * such as a validation mismatch so scripts can act on it.
      */
-    unsigned int NumberOfSimulatedProcessors;
+    int ExitStatus;
 
     /*
-     * The main execution thread's Processor Affinity Number.
+     * The CPUID reads found and not found in the snapshot.  They are counted in the
+     * context without atomics since a context is used by one thread at a time, and
+     * are added to the instrumentation when its counters are read or the context
+     * is released.
      */
-    unsigned int CurrentProcessorAffinity;
+    unsigned long long SnapshotHits;
+    unsigned long long SnapshotMisses;
 
+    /*
+     * The context was created for a thread that had none bound and is released 
+     * when that thread exits.
+     */
+    BOOL_TYPE ThreadOwned;
 
-} GLOBAL_DATA, *PGLOBAL_DATA;
+} CPUID_CONTEXT, *PCPUID_CONTEXT;
 
 
 
@@ -330,6 +900,8 @@ void ParseCpu_ApicIdTopologyLayout(void);
 void ParseCpu_CpuidLegacyExample(void);
 void ParseCpu_CpuidThreeDomainExample(unsigned int Leaf);
 void ParseCpu_CpuidManyDomainExample(unsigned int Leaf);
+unsigned int ParseCpu_BuildDomainLayout(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx);
+BOOL_TYPE ParseCpu_MatchDomainLayout(PCPUID_DOMAIN_LAYOUT pDomainLayout);
 
 
 
@@ -337,7 +909,11 @@ void ParseCpu_CpuidManyDomainExample(unsigned int Leaf);
  *  Parse CPUID Cache and Tlbs APIs
  */
 void ParseCache_CpuidCacheExample(void);
+BOOL_TYPE ParseCache_BuildCacheTopology(PCPUID_CACHE_TOPOLOGY pCacheTopology);
+void ParseCache_ReleaseCacheTopology(PCPUID_CACHE_TOPOLOGY pCacheTopology);
 void ParseTlb_CpuidTlbExample(void);
+BOOL_TYPE ParseTlb_BuildTlbTopology(PCPUID_TLB_TOPOLOGY pTlbTopology);
+void ParseTlb_ReleaseTlbTopology(PCPUID_TLB_TOPOLOGY pTlbTopology);
 
 /*
  *  Display APIs
@@ -347,26 +923,185 @@ void Display_ApicIdBitLayout(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx);
 void Display_ThreeDomainDisplay(unsigned int Leaf, unsigned int PackageShift, unsigned int LogicalProcessorShift);
 void Display_DisplayProcessorLeafs(unsigned int NumberOfProcessors);
 void Display_ManyDomainExample(unsigned int Leaf, PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx);
-void Display_DisplayProcessorCaches(PCPUID_CACHE_INFO pCacheInfo, unsigned int NumberOfCaches);
-void Display_DisplayProcessorTlbs(PCPUID_TLB_INFO pTlbInfo, unsigned int NumberOfTlbs);
+void Display_DisplayProcessorCaches(PCPUID_CACHE_INFO pCacheInfo, unsigned int NumberOfCaches, unsigned int *pApicIdList, unsigned int NumberOfProcessors);
+void Display_DisplayProcessorTlbs(PCPUID_TLB_INFO pTlbInfo, unsigned int NumberOfTlbs, unsigned int *pApicIdList, unsigned int NumberOfProcessors);
+void Display_HybridCoreTypes(void);
+void Display_DisplayPlacement(PCPUID_TOPOLOGY pTopology, unsigned int NumberOfWorkers, PLACEMENT_POLICY PlacementPolicy, unsigned int *pProcessorList);
+void Display_DisplayNumaTopology(PCPUID_TOPOLOGY pTopology);
+void Display_DisplayInstrumentation(PINSTRUMENT_COUNTERS pCounters);
+void Display_DisplayBatchIndex(PBATCH_CAPTURE pCaptures, unsigned int NumberOfCaptures);
+void Display_DisplaySizingAdvice(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned long long WorkingSetBytes, PSIZING_ADVICE pSizingAdvice);
+void Display_DisplayLatencyMatrix(PCPUID_TOPOLOGY pTopology, PLATENCY_MATRIX pLatencyMatrix);
 
 /*
  * Common Support Tools and Initialization APIs
  */
+PCPUID_CONTEXT Tools_CreateCpuidContext(BOOL_TYPE UseNativeCpuid);
+void Tools_ReleaseCpuidContext(PCPUID_CONTEXT pCpuidContext);
+PCPUID_CONTEXT Tools_SetCpuidContext(PCPUID_CONTEXT pCpuidContext);
+PCPUID_CONTEXT Tools_GetCpuidContext(void);
+void Tools_ReleaseThreadCpuidContext(void *pCpuidContext);
 void Tools_ReadCpuid(unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters);
 unsigned int Tools_CreateTopologyShift(unsigned int count);
-void Tools_SetAffinity(unsigned int ProcessorNumber);
+BOOL_TYPE Tools_SetAffinity(unsigned int ProcessorNumber);
 unsigned int Tools_GetNumberOfProcessors(void);
 BOOL_TYPE Tools_IsNative(void);
 BOOL_TYPE Tools_IsDomainKnownEnumeration(unsigned int Domain);
 unsigned int Tools_GatherPlatformApicIds(unsigned int *pApicIdArray, unsigned int ArraySize);
+unsigned int *Tools_AllocatePlatformApicIds(unsigned int *pNumberOfProcessors);
+CORE_TYPE Tools_GetProcessorCoreType(unsigned int ProcessorNumber, unsigned int *pNativeModelId);
+BOOL_TYPE Tools_IsHybridPlatform(void);
+BOOL_TYPE Tools_GetProcessorNumaNode(unsigned int ProcessorNumber, unsigned int *pNumaNode);
+BOOL_TYPE Tools_CreateRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex, unsigned int ExpectedEntries);
+unsigned int Tools_FindRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex, unsigned int Id, PCPUID_REGISTERS pCpuidRegisters);
+BOOL_TYPE Tools_InsertRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex, unsigned int Id, PCPUID_REGISTERS pCpuidRegisters, unsigned int Value);
+void Tools_DestroyRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex);
+BOOL_TYPE Tools_CreateProcessorSet(PPROCESSOR_SET pProcessorSet, unsigned int NumberOfProcessors);
+void Tools_AddProcessorToSet(PPROCESSOR_SET pProcessorSet, unsigned int ProcessorIndex);
+BOOL_TYPE Tools_IsProcessorInSet(PPROCESSOR_SET pProcessorSet, unsigned int ProcessorIndex);
+void Tools_DestroyProcessorSet(PPROCESSOR_SET pProcessorSet);
+void Tools_InitializeTextBuffer(PTEXT_BUFFER pTextBuffer, FILE *pStream);
+void Tools_AppendText(PTEXT_BUFFER pTextBuffer, char *pszFormat, ...);
+void Tools_AppendTextRecord(PTEXT_BUFFER pTextBuffer, char *pszRecord);
+void Tools_FlushTextBuffer(PTEXT_BUFFER pTextBuffer);
+void *Tools_AllocateAligned(size_t Size, size_t Alignment);
+void Tools_FreeAligned(void *pMemory);
+
+
+/*
+ *  Parallel CPUID Capture APIs
+ */
+BOOL_TYPE Capture_CaptureProcessors(void);
+BOOL_TYPE Capture_AllocateSnapshot(unsigned int NumberOfProcessors);
+BOOL_TYPE Capture_ResizeSnapshot(unsigned int NumberOfProcessors);
+BOOL_TYPE Capture_SetSnapshotCpuid(unsigned int ProcessorNumber, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters);
+BOOL_TYPE Capture_SetProcessorCpuid(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters);
+void Capture_CompleteProcessor(unsigned int ProcessorNumber);
+BOOL_TYPE Capture_AttachProcessorLeafs(unsigned int ProcessorNumber, PCPUID_LEAF_SNAPSHOT pLeafs, unsigned int NumberOfLeafs, unsigned int ApicId);
+void Capture_AdoptSnapshotStorage(void *pStorage);
+BOOL_TYPE Capture_ReadSnapshotCpuid(PCPUID_CONTEXT pCpuidContext, unsigned int ProcessorNumber, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters);
+BOOL_TYPE Capture_GetSnapshotApicId(unsigned int ProcessorNumber, unsigned int *pApicId);
+BOOL_TYPE Capture_GetSnapshotOsProcessorId(unsigned int ProcessorNumber, unsigned int *pOsProcessorId);
+void Capture_ReleaseProcessor(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot);
+void Capture_ReleaseSnapshot(void);
+void Capture_ReleaseContextSnapshot(PCPUID_CONTEXT pCpuidContext);
+BOOL_TYPE Capture_UpdateProcessors(unsigned int *pProcessorsAdded, unsigned int *pProcessorsRemoved);
 
 
 /*
  *  File Read/Write CPUID APIs
  */
 BOOL_TYPE File_ReadCpuidFromFile(char *pszFileName);
-BOOL_TYPE File_WriteCpuidToFile(char *pszFileName);
+BOOL_TYPE File_WriteCpuidToFile(char *pszFileName, CPUID_FILE_FORMAT FileFormat);
+void File_SetQuietEcho(BOOL_TYPE QuietFileEcho);
+void File_SetEchoSink(PFN_FILE_ECHO_SINK pfnFileEchoSink, void *pContext);
+BOOL_TYPE File_ReadTopologyCache(char *pszFileName);
+BOOL_TYPE File_WriteTopologyCache(char *pszFileName);
+
+/*
+ *  Compressed CPUID File APIs
+ */
+BOOL_TYPE Compress_IsCompressedFile(char *pszFileName);
+BOOL_TYPE Compress_ReadCpuidFromFile(char *pszFileName);
+BOOL_TYPE Compress_WriteCpuidToFile(char *pszFileName);
+
+/*
+ *  Synthetic Topology Generator APIs
+ */
+BOOL_TYPE Generate_ParseSpecification(char *pszSpecification, PGENERATE_SPECIFICATION pSpecification);
+BOOL_TYPE Generate_BuildSnapshot(PGENERATE_SPECIFICATION pSpecification);
+
+/*
+ *  Topology Library APIs
+ */
+PCPUID_TOPOLOGY Topology_Create(void);
+void Topology_Destroy(PCPUID_TOPOLOGY pTopology);
+unsigned int Topology_GetNumberOfProcessors(PCPUID_TOPOLOGY pTopology);
+unsigned int Topology_GetApicId(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex);
+unsigned int Topology_GetNumberOfDomains(PCPUID_TOPOLOGY pTopology);
+unsigned int Topology_GetDomainType(PCPUID_TOPOLOGY pTopology, unsigned int DomainIndex);
+unsigned int Topology_FindDomain(PCPUID_TOPOLOGY pTopology, unsigned int DomainType);
+unsigned int Topology_GetDomainMask(PCPUID_TOPOLOGY pTopology, unsigned int DomainIndex, unsigned int RelativeDomainIndex);
+unsigned int Topology_GetDomainId(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int DomainIndex, unsigned int RelativeDomainIndex);
+unsigned int *Topology_GetProcessorDomainIds(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex);
+unsigned int Topology_GetProcessorIndex(PCPUID_TOPOLOGY pTopology, unsigned int ApicId);
+unsigned int Topology_GetCurrentProcessorIndex(PCPUID_TOPOLOGY pTopology);
+unsigned int *Topology_GetCurrentProcessorDomainIds(PCPUID_TOPOLOGY pTopology);
+BOOL_TYPE Topology_IsHybrid(PCPUID_TOPOLOGY pTopology);
+CORE_TYPE Topology_GetCoreType(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex);
+unsigned int Topology_GetNativeModelId(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex);
+unsigned int Topology_GetNumaNode(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex);
+unsigned int Topology_GetProcessorsSharingDomain(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int DomainIndex, unsigned int *pProcessorList, unsigned int ListSize);
+unsigned int Topology_GetNumberOfCaches(PCPUID_TOPOLOGY pTopology);
+PCPUID_CACHE_INFO Topology_GetCache(PCPUID_TOPOLOGY pTopology, unsigned int CacheIndex);
+unsigned int Topology_FindProcessorCache(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int CacheLevel, CACHE_TYPE CacheType);
+unsigned int Topology_GetProcessorsSharingCache(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int CacheLevel, unsigned int *pProcessorList, unsigned int ListSize);
+unsigned int Topology_GetNumberOfTlbs(PCPUID_TOPOLOGY pTopology);
+PCPUID_TLB_INFO Topology_GetTlb(PCPUID_TOPOLOGY pTopology, unsigned int TlbIndex);
+unsigned int Topology_FindProcessorTlb(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int TlbLevel, TLB_TYPE TlbType);
+
+/*
+ *  Thread Placement Planner APIs
+ */
+void Planner_CpuidPlacementExample(unsigned int NumberOfWorkers, PLACEMENT_POLICY PlacementPolicy);
+BOOL_TYPE Planner_PlaceWorkers(PCPUID_TOPOLOGY pTopology, unsigned int NumberOfWorkers, PLACEMENT_POLICY PlacementPolicy, unsigned int *pProcessorList);
+
+/*
+ *  Data Structure Sizing Advisor APIs
+ */
+void Advisor_CpuidSizingExample(unsigned long long WorkingSetBytes);
+BOOL_TYPE Advisor_GetSizingAdvice(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned long long WorkingSetBytes, PSIZING_ADVICE pSizingAdvice);
+
+/*
+ *  Inter-Core Latency Benchmark APIs
+ */
+void Latency_CpuidLatencyExample(unsigned int RoundTrips);
+BOOL_TYPE Latency_MeasureTopology(PCPUID_TOPOLOGY pTopology, unsigned int RoundTrips, PLATENCY_MATRIX pLatencyMatrix);
+LATENCY_LEVEL Latency_GetPairLevel(PCPUID_TOPOLOGY pTopology, unsigned int FirstProcessor, unsigned int SecondProcessor);
+
+/*
+ *  Batch Capture Analysis APIs
+ */
+void Batch_CpuidBatchExample(unsigned int NumberOfFiles, char **ppszFileNames);
+unsigned int Batch_AnalyzeCaptures(PBATCH_CAPTURE pCaptures, unsigned int NumberOfCaptures);
+unsigned long long Batch_GetTopologyFingerprint(PCPUID_TOPOLOGY pTopology);
+
+/*
+ *  Topology Publication APIs
+ */
+PTOPOLOGY_PUBLISHER Publish_CreatePublisher(unsigned int MaximumReaders);
+void Publish_DestroyPublisher(PTOPOLOGY_PUBLISHER pPublisher);
+unsigned int Publish_RegisterReader(PTOPOLOGY_PUBLISHER pPublisher);
+void Publish_UnregisterReader(PTOPOLOGY_PUBLISHER pPublisher, unsigned int ReaderIndex);
+PCPUID_TOPOLOGY Publish_EnterRead(PTOPOLOGY_PUBLISHER pPublisher, unsigned int ReaderIndex);
+void Publish_ExitRead(PTOPOLOGY_PUBLISHER pPublisher, unsigned int ReaderIndex);
+BOOL_TYPE Publish_PublishTopology(PTOPOLOGY_PUBLISHER pPublisher, PCPUID_TOPOLOGY pTopology);
+unsigned int Publish_ReclaimTopologies(PTOPOLOGY_PUBLISHER pPublisher);
+
+/*
+ *  Instrumentation APIs
+ */
+void Instrument_Enable(BOOL_TYPE Enable);
+BOOL_TYPE Instrument_IsEnabled(void);
+void Instrument_Reset(void);
+void Instrument_GetCounters(PINSTRUMENT_COUNTERS pCounters);
+unsigned int Instrument_GetCounterLeaf(unsigned int CounterIndex);
+unsigned long long Instrument_StartTimer(void);
+void Instrument_CountCpuid(unsigned int Leaf, unsigned long long StartTime);
+void Instrument_CountAffinity(BOOL_TYPE AffinitySet, unsigned long long StartTime);
+void Instrument_AddSnapshotReads(PCPUID_CONTEXT pCpuidContext);
+void Instrument_CountAllocation(unsigned long long Bytes);
+
+/*
+ *  Machine Readable Export APIs
+ */
+void Export_WriteTopology(FILE *pStream, EXPORT_FORMAT ExportFormat);
+
+/*
+ * Topology Validation APIs
+ */
+void Validate_CpuidValidationExample(void);
+unsigned int Validate_CompareTopology(PCPUID_TOPOLOGY pTopology, POS_TOPOLOGY pOsTopology, BOOL_TYPE DisplayMismatches);
 
 /*
  *  OS-Specific Implementation APIs
@@ -374,7 +1109,27 @@ BOOL_TYPE File_WriteCpuidToFile(char *pszFileName);
 void Os_DisplayTopology(void);
 void Os_Platform_Read_Cpuid(unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters);
 unsigned int Os_GetNumberOfProcessors(void);
-void Os_SetAffinity(unsigned int ProcessorNumber);
+BOOL_TYPE Os_SetAffinity(unsigned int ProcessorNumber);
+BOOL_TYPE Os_GetProcessorNumaNode(unsigned int ProcessorNumber, unsigned int *pNumaNode);
+BOOL_TYPE Os_RunOnEachProcessor(unsigned int NumberOfProcessors, PFN_PROCESSOR_WORKER pfnWorker, void *pContext);
+BOOL_TYPE Os_RunOnProcessors(unsigned int NumberOfProcessors, unsigned int *pProcessorNumbers, PFN_PROCESSOR_WORKER pfnWorker, void *pContext);
+BOOL_TYPE Os_BuildTopology(POS_TOPOLOGY pOsTopology);
+unsigned long long Os_GetTimestampNanoseconds(void);
+BOOL_TYPE Os_GetBootId(char *pszBootId, unsigned int BootIdSize);
+void Os_ReleaseTopology(POS_TOPOLOGY pOsTopology);
+unsigned int Os_GetProcessorId(unsigned int ProcessorNumber);
+BOOL_TYPE Os_RefreshProcessors(void);
+BOOL_TYPE Os_WaitForProcessorChange(unsigned int TimeoutMilliseconds);
+void *Os_GetThreadContext(void);
+BOOL_TYPE Os_SetThreadContext(void *pContext);
+BOOL_TYPE Os_GetCurrentProcessorId(unsigned int *pProcessorId);
+void *Os_AtomicExchangePointer(void * volatile *ppTarget, void *pValue);
+void *Os_AtomicLoadPointer(void * volatile *ppTarget);
+unsigned long long Os_AtomicLoad64(volatile unsigned long long *pTarget);
+void Os_AtomicStore64(volatile unsigned long long *pTarget, unsigned long long Value);
+unsigned long long Os_AtomicIncrement64(volatile unsigned long long *pTarget);
+unsigned long long Os_AtomicAdd64(volatile unsigned long long *pTarget, unsigned long long Value);
+BOOL_TYPE Os_AtomicCompareExchange64(volatile unsigned long long *pTarget, unsigned long long Expected, unsigned long long Desired);
 
 
 #endif
@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The advisor sizes a tile to half of a cache share so the rest of the share
+ * is left for the other data of the thread and for conflicts within the sets.
+ */
+#define TILE_SHARE_DIVISOR   (2)
+#define TILE_ELEMENT_SIZE    (8)
+#define NUMBER_OF_CORE_TYPES (256)
+
+const unsigned long long g_PageSizeInBytes[PageSize_MaximumSizes] = { 4096ULL, 2097152ULL, 1073741824ULL };
+
+
+/*
+ * Internal Advisor APIs
+ */
+unsigned int Advisor_Internal_GetCacheShare(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int CacheLevel, unsigned int *pCacheLineSize);
+unsigned int Advisor_Internal_GetLastLevelCache(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex);
+void Advisor_Internal_GetTlbReach(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, PSIZING_ADVICE pSizingAdvice);
+unsigned long long Advisor_Internal_RoundDownToPowerOfTwo(unsigned long long Value);
+unsigned int Advisor_Internal_GetTileEdge(unsigned int TileBytes, unsigned int CacheLineSize);
+
+
+
+/*
+ * Advisor_CpuidSizingExample
+ *
+ *    Displays the sizing advice for a working set on the first processor,
+ *    and on the first processor of each core type of a hybrid platform.
+ *
+ * Arguments:
+ *     Working Set of each thread in bytes
+ *
+ * Return:
+ *     None
+ */
+void Advisor_CpuidSizingExample(unsigned long long WorkingSetBytes)
+{
+    PCPUID_TOPOLOGY pTopology;
+    SIZING_ADVICE SizingAdvice;
+    BOOL_TYPE CoreTypeDisplayed[NUMBER_OF_CORE_TYPES];
+    unsigned int ProcessorIndex;
+    unsigned int CoreType;
+
+    pTopology = Topology_Create();
+
+    if (pTopology)
+    {
+        memset(CoreTypeDisplayed, 0, sizeof(CoreTypeDisplayed));
+
+        for (ProcessorIndex = 0; ProcessorIndex < Topology_GetNumberOfProcessors(pTopology); ProcessorIndex++)
+        {
+            CoreType = ((unsigned int)Topology_GetCoreType(pTopology, ProcessorIndex)) % NUMBER_OF_CORE_TYPES;
+
+            if (CoreTypeDisplayed[CoreType] == BOOL_FALSE && Advisor_GetSizingAdvice(pTopology, ProcessorIndex, WorkingSetBytes, &SizingAdvice))
+            {
+                Display_DisplaySizingAdvice(pTopology, ProcessorIndex, WorkingSetBytes, &SizingAdvice);
+                CoreTypeDisplayed[CoreType] = BOOL_TRUE;
+            }
+        }
+
+        Topology_Destroy(pTopology);
+    }
+}
+
+
+/*
+ * Advisor_GetSizingAdvice
+ *
+ *    Turns the caches and TLBs a processor uses into tuning parameters.
+ *
+ *       Cache share - The size of the L1 data, L2 and last level caches divided
+ *                     by the logical processors sharing each of them.
+ *       Tiles       - The largest power of two that fits in half of the L1 data
+ *                     and L2 shares, with the edge of a square tile of 8 byte
+ *                     elements rounded down to whole cache lines.
+ *       Hash table  - The cache line sized buckets that fit in the share of the
+ *                     last level cache, rounded down to a power of two.
+ *       Page size   - The smallest page size whose data TLB reach covers the
+ *                     working set, or the page size with the largest reach.
+ *
+ * Arguments:
+ *     Topology, Processor Index, Working Set of each thread in bytes, Sizing Advice to fill in
+ *
+ * Return:
+ *     Returns true if the processor is in the topology
+ */
+BOOL_TYPE Advisor_GetSizingAdvice(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned long long WorkingSetBytes, PSIZING_ADVICE pSizingAdvice)
+{
+    unsigned int CacheLineSize;
+    unsigned int PageSize;
+    BOOL_TYPE AdviceCreated;
+
+    AdviceCreated = BOOL_FALSE;
+    memset(pSizingAdvice, 0, sizeof(SIZING_ADVICE));
+
+    if (ProcessorIndex < Topology_GetNumberOfProcessors(pTopology))
+    {
+        pSizingAdvice->L1DataSharePerThread = Advisor_Internal_GetCacheShare(pTopology, ProcessorIndex, 1, &pSizingAdvice->CacheLineSize);
+        pSizingAdvice->L2SharePerThread     = Advisor_Internal_GetCacheShare(pTopology, ProcessorIndex, 2, &CacheLineSize);
+
+        pSizingAdvice->LastLevelCacheLevel = Advisor_Internal_GetLastLevelCache(pTopology, ProcessorIndex);
+
+        if (pSizingAdvice->LastLevelCacheLevel)
+        {
+            pSizingAdvice->LastLevelSharePerThread = Advisor_Internal_GetCacheShare(pTopology, ProcessorIndex, pSizingAdvice->LastLevelCacheLevel, &CacheLineSize);
+        }
+
+        pSizingAdvice->L1TileBytes = (unsigned int)Advisor_Internal_RoundDownToPowerOfTwo(pSizingAdvice->L1DataSharePerThread / TILE_SHARE_DIVISOR);
+        pSizingAdvice->L1TileEdge  = Advisor_Internal_GetTileEdge(pSizingAdvice->L1TileBytes, pSizingAdvice->CacheLineSize);
+        pSizingAdvice->L2TileBytes = (unsigned int)Advisor_Internal_RoundDownToPowerOfTwo(pSizingAdvice->L2SharePerThread / TILE_SHARE_DIVISOR);
+        pSizingAdvice->L2TileEdge  = Advisor_Internal_GetTileEdge(pSizingAdvice->L2TileBytes, pSizingAdvice->CacheLineSize);
+
+        if (pSizingAdvice->CacheLineSize)
+        {
+            pSizingAdvice->HashBucketsPerThread = (unsigned int)Advisor_Internal_RoundDownToPowerOfTwo(pSizingAdvice->LastLevelSharePerThread / pSizingAdvice->CacheLineSize);
+        }
+
+        Advisor_Internal_GetTlbReach(pTopology, ProcessorIndex, pSizingAdvice);
+
+        /*
+         * Use the smallest page that maps the whole working set, the larger pages
+         * cost more memory to fragmentation and are a limited resource of the OS.
+         */
+        pSizingAdvice->RecommendedPageSize = PageSize_MaximumSizes;
+
+        for (PageSize = PageSize_4K; PageSize < PageSize_MaximumSizes && pSizingAdvice->RecommendedPageSize == PageSize_MaximumSizes; PageSize++)
+        {
+            if (pSizingAdvice->TlbReach[PageSize] >= WorkingSetBytes)
+            {
+                pSizingAdvice->RecommendedPageSize = (PAGE_SIZE)PageSize;
+            }
+        }
+
+        if (pSizingAdvice->RecommendedPageSize == PageSize_MaximumSizes)
+        {
+            pSizingAdvice->RecommendedPageSize = PageSize_4K;
+
+            for (PageSize = PageSize_2M; PageSize < PageSize_MaximumSizes; PageSize++)
+            {
+                if (pSizingAdvice->TlbReach[PageSize] > pSizingAdvice->TlbReach[pSizingAdvice->RecommendedPageSize])
+                {
+                    pSizingAdvice->RecommendedPageSize = (PAGE_SIZE)PageSize;
+                }
+            }
+        }
+
+        AdviceCreated = BOOL_TRUE;
+    }
+
+    return AdviceCreated;
+}
+
+
+/*
+ * Advisor_Internal_GetCacheShare
+ *
+ *    The share of one logical processor of the data or unified cache it
+ *    uses at a level.
+ *
+ * Arguments:
+ *     Topology, Processor Index, Cache Level, Returned Cache Line Size
+ *
+ * Return:
+ *     The cache size divided by the processors sharing it, zero if there is no cache
+ */
+unsigned int Advisor_Internal_GetCacheShare(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int CacheLevel, unsigned int *pCacheLineSize)
+{
+    PCPUID_CACHE_INFO pCacheInfo;
+    unsigned int CacheIndex;
+    unsigned int CacheShare;
+
+    CacheShare = 0;
+    *pCacheLineSize = 0;
+
+    CacheIndex = Topology_FindProcessorCache(pTopology, ProcessorIndex, CacheLevel, CacheType_NoMoreCaches);
+
+    if (CacheIndex != INVALID_CACHE_INDEX)
+    {
+        pCacheInfo = Topology_GetCache(pTopology, CacheIndex);
+        *pCacheLineSize = pCacheInfo->CacheLineSize;
+
+        if (pCacheInfo->NumberOfLPsSharingThisCache)
+        {
+            CacheShare = pCacheInfo->CacheSizeInBytes / pCacheInfo->NumberOfLPsSharingThisCache;
+        }
+    }
+
+    return CacheShare;
+}
+
+
+/*
+ * Advisor_Internal_GetLastLevelCache
+ *
+ *    The highest level of data or unified cache a logical processor uses.
+ *
+ * Arguments:
+ *     Topology, Processor Index
+ *
+ * Return:
+ *     The cache level, zero if the processor has no data or unified cache
+ */
+unsigned int Advisor_Internal_GetLastLevelCache(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex)
+{
+    PCPUID_CACHE_INFO pCacheInfo;
+    unsigned int CacheIndex;
+    unsigned int LastLevelCacheLevel;
+
+    LastLevelCacheLevel = 0;
+
+    for (CacheIndex = 0; CacheIndex < Topology_GetNumberOfCaches(pTopology); CacheIndex++)
+    {
+        pCacheInfo = Topology_GetCache(pTopology, CacheIndex);
+
+        if (pCacheInfo->CacheType != CacheType_InstructionCache && pCacheInfo->CacheLevel > LastLevelCacheLevel && Tools_IsProcessorInSet(&pCacheInfo->LPsSharingThisCache, ProcessorIndex))
+        {
+            LastLevelCacheLevel = pCacheInfo->CacheLevel;
+        }
+    }
+
+    return LastLevelCacheLevel;
+}
+
+
+/*
+ * Advisor_Internal_GetTlbReach
+ *
+ *    The memory the TLBs used for data can map with each page size, which is the
+ *    entries of the TLB with the most entries for that page size times the page
+ *    size.  A TLB holds ways times sets entries for every page size it supports.
+ *
+ * Arguments:
+ *     Topology, Processor Index, Sizing Advice
+ *
+ * Return:
+ *     None
+ */
+void Advisor_Internal_GetTlbReach(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, PSIZING_ADVICE pSizingAdvice)
+{
+    PCPUID_TLB_INFO pTlbInfo;
+    unsigned long long TlbEntries;
+    unsigned int TlbIndex;
+    BOOL_TYPE PageSizeSupported[PageSize_MaximumSizes];
+    unsigned int PageSize;
+
+    for (TlbIndex = 0; TlbIndex < Topology_GetNumberOfTlbs(pTopology); TlbIndex++)
+    {
+        pTlbInfo = Topology_GetTlb(pTopology, TlbIndex);
+
+        if ((pTlbInfo->TlbType == TlbType_Data || pTlbInfo->TlbType == TlbType_Unified || pTlbInfo->TlbType == TlbType_LoadOnly) && Tools_IsProcessorInSet(&pTlbInfo->LPsSharingThisTlb, ProcessorIndex))
+        {
+            TlbEntries = (unsigned long long)pTlbInfo->TlbWays*(unsigned long long)pTlbInfo->TlbSets;
+
+            PageSizeSupported[PageSize_4K] = pTlbInfo->_4K_PageSizeEntries;
+            PageSizeSupported[PageSize_2M] = pTlbInfo->_2MB_PageSizeEntries;
+            PageSizeSupported[PageSize_1G] = pTlbInfo->_1GB_PageSizeEntries;
+
+            for (PageSize = PageSize_4K; PageSize < PageSize_MaximumSizes; PageSize++)
+            {
+                if (PageSizeSupported[PageSize] && TlbEntries*g_PageSizeInBytes[PageSize] > pSizingAdvice->TlbReach[PageSize])
+                {
+                    pSizingAdvice->TlbReach[PageSize] = TlbEntries*g_PageSizeInBytes[PageSize];
+                }
+            }
+        }
+    }
+}
+
+
+/*
+ * Advisor_Internal_RoundDownToPowerOfTwo
+ *
+ *    The largest power of two that is not more than a value.
+ *
+ * Arguments:
+ *     Value
+ *
+ * Return:
+ *     Power of two, zero if the value is zero
+ */
+unsigned long long Advisor_Internal_RoundDownToPowerOfTwo(unsigned long long Value)
+{
+    unsigned long long PowerOfTwo;
+
+    PowerOfTwo = 0;
+
+    if (Value)
+    {
+        PowerOfTwo = 1;
+
+        while (PowerOfTwo <= (Value>>1))
+        {
+            PowerOfTwo = PowerOfTwo<<1;
+        }
+    }
+
+    return PowerOfTwo;
+}
+
+
+/*
+ * Advisor_Internal_GetTileEdge
+ *
+ *    The edge of a square tile of 8 byte elements that fits in a number of
+ *    bytes, rounded down so each row of the tile is whole cache lines.
+ *
+ * Arguments:
+ *     Tile Bytes, Cache Line Size
+ *
+ * Return:
+ *     Number of elements on each edge of the tile
+ */
+unsigned int Advisor_Internal_GetTileEdge(unsigned int TileBytes, unsigned int CacheLineSize)
+{
+    unsigned int TileEdge;
+    unsigned int ElementsPerLine;
+
+    TileEdge = 0;
+
+    while ((unsigned long long)(TileEdge + 1)*(TileEdge + 1)*TILE_ELEMENT_SIZE <= TileBytes)
+    {
+        TileEdge++;
+    }
+
+    ElementsPerLine = CacheLineSize / TILE_ELEMENT_SIZE;
+
+    if (ElementsPerLine > 1 && TileEdge >= ElementsPerLine)
+    {
+        TileEdge = TileEdge - (TileEdge % ElementsPerLine);
+    }
+
+    return TileEdge;
+}
@@ -0,0 +1,522 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The fingerprint is a 64 bit FNV-1a hash of the canonical form of the topology.
+ */
+#define FINGERPRINT_OFFSET_BASIS  (0xCBF29CE484222325ULL)
+#define FINGERPRINT_PRIME         (0x00000100000001B3ULL)
+
+
+/*
+ * The captures shared by the batch workers, each worker analyses every 
+ * NumberOfWorkers capture starting from its worker number.
+ */
+typedef struct _BATCH_WORK
+{
+    PBATCH_CAPTURE pCaptures;
+    unsigned int NumberOfCaptures;
+    unsigned int NumberOfWorkers;
+
+} BATCH_WORK, *PBATCH_WORK;
+
+
+/*
+ * Internal Batch APIs
+ */
+void Batch_Internal_AnalyzeWorker(unsigned int WorkerNumber, void *pContext);
+void Batch_Internal_AnalyzeCapture(PBATCH_CAPTURE pCapture);
+unsigned long long Batch_Internal_HashValue(unsigned long long Hash, unsigned int Value);
+unsigned long long Batch_Internal_HashSortedKeys(unsigned long long Hash, unsigned long long *pKeys, unsigned int NumberOfKeys);
+unsigned long long Batch_Internal_HashCache(PCPUID_CACHE_INFO pCacheInfo);
+unsigned long long Batch_Internal_HashTlb(PCPUID_TLB_INFO pTlbInfo);
+int Batch_Internal_CompareKeys(const void *pFirst, const void *pSecond);
+int Batch_Internal_CompareCaptures(const void *pFirst, const void *pSecond);
+
+
+
+/*
+ * Batch_CpuidBatchExample
+ *
+ *    Analyses a list of capture files in one pass and displays the index of
+ *    the captures grouped by their topology.  The exit status of the 
+ *    application is set if any capture could not be loaded.
+ *
+ * Arguments:
+ *     Number of Files, File Names
+ *
+ * Return:
+ *     None
+ */
+void Batch_CpuidBatchExample(unsigned int NumberOfFiles, char **ppszFileNames)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    PBATCH_CAPTURE pCaptures;
+    unsigned int FileIndex;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    pCaptures = (PBATCH_CAPTURE)calloc(NumberOfFiles, sizeof(BATCH_CAPTURE));
+
+    if (pCaptures)
+    {
+        for (FileIndex = 0; FileIndex < NumberOfFiles; FileIndex++)
+        {
+            pCaptures[FileIndex].pszFileName = ppszFileNames[FileIndex];
+        }
+
+        Batch_AnalyzeCaptures(pCaptures, NumberOfFiles);
+        Display_DisplayBatchIndex(pCaptures, NumberOfFiles);
+
+        for (FileIndex = 0; FileIndex < NumberOfFiles; FileIndex++)
+        {
+            if (pCaptures[FileIndex].Loaded == BOOL_FALSE)
+            {
+                pCpuidContext->ExitStatus = 1;
+            }
+        }
+
+        free(pCaptures);
+    }
+    else
+    {
+        printf(" FAILED: the batch could not be allocated.\n\n");
+        pCpuidContext->ExitStatus = 1;
+    }
+}
+
+
+/*
+ * Batch_AnalyzeCaptures
+ *
+ *    Loads each capture, builds its topology and computes its fingerprint, then
+ *    sorts the captures into an index.  The captures are grouped by fingerprint
+ *    in the order they were given, captures that could not be loaded are last.
+ *
+ *    The captures are spread over a worker on each processor, every worker loads
+ *    its captures into a CPUID context of its own so the CPUID context of the 
+ *    calling thread is not changed.  The records of the files are not echoed.
+ *
+ * Arguments:
+ *     Captures with the file names filled in, Number of Captures
+ *
+ * Return:
+ *     The number of distinct topologies
+ */
+unsigned int Batch_AnalyzeCaptures(PBATCH_CAPTURE pCaptures, unsigned int NumberOfCaptures)
+{
+    BATCH_WORK BatchWork;
+    unsigned int CaptureIndex;
+    unsigned int WorkerIndex;
+    unsigned int NumberOfTopologies;
+
+    NumberOfTopologies = 0;
+
+    for (CaptureIndex = 0; CaptureIndex < NumberOfCaptures; CaptureIndex++)
+    {
+        pCaptures[CaptureIndex].CaptureIndex = CaptureIndex;
+        pCaptures[CaptureIndex].Loaded = BOOL_FALSE;
+    }
+
+    BatchWork.pCaptures = pCaptures;
+    BatchWork.NumberOfCaptures = NumberOfCaptures;
+    BatchWork.NumberOfWorkers = Os_GetNumberOfProcessors();
+
+    if (BatchWork.NumberOfWorkers > NumberOfCaptures)
+    {
+        BatchWork.NumberOfWorkers = NumberOfCaptures;
+    }
+
+    if (BatchWork.NumberOfWorkers == 0 && NumberOfCaptures)
+    {
+        BatchWork.NumberOfWorkers = 1;
+    }
+
+    if (BatchWork.NumberOfWorkers)
+    {
+        if (Os_RunOnEachProcessor(BatchWork.NumberOfWorkers, Batch_Internal_AnalyzeWorker, &BatchWork) == BOOL_FALSE)
+        {
+            /*
+             * The OS could not provide the workers, run each of them on this thread.
+             */
+            for (WorkerIndex = 0; WorkerIndex < BatchWork.NumberOfWorkers; WorkerIndex++)
+            {
+                Batch_Internal_AnalyzeWorker(WorkerIndex, &BatchWork);
+            }
+        }
+    }
+
+    qsort(pCaptures, NumberOfCaptures, sizeof(BATCH_CAPTURE), Batch_Internal_CompareCaptures);
+
+    for (CaptureIndex = 0; CaptureIndex < NumberOfCaptures && pCaptures[CaptureIndex].Loaded; CaptureIndex++)
+    {
+        if (CaptureIndex == 0 || pCaptures[CaptureIndex].Fingerprint != pCaptures[CaptureIndex - 1].Fingerprint)
+        {
+            NumberOfTopologies++;
+        }
+    }
+
+    return NumberOfTopologies;
+}
+
+
+/*
+ * Batch_Internal_AnalyzeWorker
+ *
+ *    The batch worker, it binds a CPUID context of its own to this thread for
+ *    its captures and releases it when they are done.
+ *
+ * Arguments:
+ *     Worker Number, Batch Work
+ *
+ * Return:
+ *     None
+ */
+void Batch_Internal_AnalyzeWorker(unsigned int WorkerNumber, void *pContext)
+{
+    PBATCH_WORK pBatchWork;
+    PCPUID_CONTEXT pCpuidContext;
+    PCPUID_CONTEXT pPreviousCpuidContext;
+    unsigned int CaptureIndex;
+
+    pBatchWork = (PBATCH_WORK)pContext;
+
+    pCpuidContext = Tools_CreateCpuidContext(BOOL_FALSE);
+
+    if (pCpuidContext)
+    {
+        pCpuidContext->QuietFileEcho = BOOL_TRUE;
+
+        pPreviousCpuidContext = Tools_SetCpuidContext(pCpuidContext);
+
+        /*
+         * A thread that cannot be bound would share the fallback context, its 
+         * captures are left as not loaded.
+         */
+        if (Tools_GetCpuidContext() == pCpuidContext)
+        {
+            for (CaptureIndex = WorkerNumber; CaptureIndex < pBatchWork->NumberOfCaptures; CaptureIndex += pBatchWork->NumberOfWorkers)
+            {
+                Batch_Internal_AnalyzeCapture(&pBatchWork->pCaptures[CaptureIndex]);
+            }
+        }
+
+        Tools_SetCpuidContext(pPreviousCpuidContext);
+        Tools_ReleaseCpuidContext(pCpuidContext);
+    }
+}
+
+
+/*
+ * Batch_Internal_AnalyzeCapture
+ *
+ *    Loads one capture into the CPUID context of this thread and fills in its
+ *    fingerprint and summary from its topology.
+ *
+ * Arguments:
+ *     Capture
+ *
+ * Return:
+ *     None
+ */
+void Batch_Internal_AnalyzeCapture(PBATCH_CAPTURE pCapture)
+{
+    PCPUID_TOPOLOGY pTopology;
+
+    if (File_ReadCpuidFromFile(pCapture->pszFileName))
+    {
+        pTopology = Topology_Create();
+
+        if (pTopology)
+        {
+            pCapture->Fingerprint        = Batch_GetTopologyFingerprint(pTopology);
+            pCapture->NumberOfProcessors = Topology_GetNumberOfProcessors(pTopology);
+            pCapture->NumberOfDomains    = Topology_GetNumberOfDomains(pTopology);
+            pCapture->NumberOfCaches     = Topology_GetNumberOfCaches(pTopology);
+            pCapture->Loaded             = (pCapture->Fingerprint != 0) ? BOOL_TRUE : BOOL_FALSE;
+
+            Topology_Destroy(pTopology);
+        }
+    }
+}
+
+
+/*
+ * Batch_GetTopologyFingerprint
+ *
+ *    Computes a fingerprint of a topology from its canonical form, which is
+ *    the domains with their masks, the APIC ID and core type of each processor
+ *    and the description of each cache and TLB with the number of processors
+ *    sharing it.  The processors, caches and TLBs are each sorted first so the
+ *    order they were enumerated in does not change the fingerprint.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     The fingerprint, zero if it could not be computed
+ */
+unsigned long long Batch_GetTopologyFingerprint(PCPUID_TOPOLOGY pTopology)
+{
+    unsigned long long *pKeys;
+    unsigned long long Fingerprint;
+    unsigned int NumberOfKeys;
+    unsigned int KeyIndex;
+    unsigned int DomainIndex;
+
+    Fingerprint = 0;
+
+    NumberOfKeys = Topology_GetNumberOfProcessors(pTopology);
+
+    if (Topology_GetNumberOfCaches(pTopology) > NumberOfKeys)
+    {
+        NumberOfKeys = Topology_GetNumberOfCaches(pTopology);
+    }
+
+    if (Topology_GetNumberOfTlbs(pTopology) > NumberOfKeys)
+    {
+        NumberOfKeys = Topology_GetNumberOfTlbs(pTopology);
+    }
+
+    pKeys = (unsigned long long *)malloc((NumberOfKeys + 1)*sizeof(unsigned long long));
+
+    if (pKeys)
+    {
+        Fingerprint = FINGERPRINT_OFFSET_BASIS;
+        Fingerprint = Batch_Internal_HashValue(Fingerprint, Topology_GetNumberOfDomains(pTopology));
+
+        for (DomainIndex = 0; DomainIndex < Topology_GetNumberOfDomains(pTopology); DomainIndex++)
+        {
+            Fingerprint = Batch_Internal_HashValue(Fingerprint, Topology_GetDomainType(pTopology, DomainIndex));
+            Fingerprint = Batch_Internal_HashValue(Fingerprint, Topology_GetDomainMask(pTopology, DomainIndex, DomainIndex));
+        }
+
+        for (KeyIndex = 0; KeyIndex < Topology_GetNumberOfProcessors(pTopology); KeyIndex++)
+        {
+            pKeys[KeyIndex] = (((unsigned long long)Topology_GetApicId(pTopology, KeyIndex))<<32) | (unsigned long long)Topology_GetCoreType(pTopology, KeyIndex);
+        }
+
+        Fingerprint = Batch_Internal_HashSortedKeys(Fingerprint, pKeys, Topology_GetNumberOfProcessors(pTopology));
+
+        for (KeyIndex = 0; KeyIndex < Topology_GetNumberOfCaches(pTopology); KeyIndex++)
+        {
+            pKeys[KeyIndex] = Batch_Internal_HashCache(Topology_GetCache(pTopology, KeyIndex));
+        }
+
+        Fingerprint = Batch_Internal_HashSortedKeys(Fingerprint, pKeys, Topology_GetNumberOfCaches(pTopology));
+
+        for (KeyIndex = 0; KeyIndex < Topology_GetNumberOfTlbs(pTopology); KeyIndex++)
+        {
+            pKeys[KeyIndex] = Batch_Internal_HashTlb(Topology_GetTlb(pTopology, KeyIndex));
+        }
+
+        Fingerprint = Batch_Internal_HashSortedKeys(Fingerprint, pKeys, Topology_GetNumberOfTlbs(pTopology));
+
+        /*
+         * Zero is reserved for a fingerprint that could not be computed.
+         */
+        if (Fingerprint == 0)
+        {
+            Fingerprint = FINGERPRINT_OFFSET_BASIS;
+        }
+
+        free(pKeys);
+    }
+
+    return Fingerprint;
+}
+
+
+/*
+ * Batch_Internal_HashValue
+ *
+ *    Adds the bytes of a value to a fingerprint hash.
+ *
+ * Arguments:
+ *     Hash, Value
+ *
+ * Return:
+ *     The updated Hash
+ */
+unsigned long long Batch_Internal_HashValue(unsigned long long Hash, unsigned int Value)
+{
+    unsigned int ByteIndex;
+
+    for (ByteIndex = 0; ByteIndex < sizeof(unsigned int); ByteIndex++)
+    {
+        Hash = (Hash ^ ((Value >> (ByteIndex*8)) & 0xFF))*FINGERPRINT_PRIME;
+    }
+
+    return Hash;
+}
+
+
+/*
+ * Batch_Internal_HashSortedKeys
+ *
+ *    Sorts a list of keys and adds the count and each key to a fingerprint hash.
+ *
+ * Arguments:
+ *     Hash, Keys, Number of Keys
+ *
+ * Return:
+ *     The updated Hash
+ */
+unsigned long long Batch_Internal_HashSortedKeys(unsigned long long Hash, unsigned long long *pKeys, unsigned int NumberOfKeys)
+{
+    unsigned int KeyIndex;
+
+    qsort(pKeys, NumberOfKeys, sizeof(unsigned long long), Batch_Internal_CompareKeys);
+
+    Hash = Batch_Internal_HashValue(Hash, NumberOfKeys);
+
+    for (KeyIndex = 0; KeyIndex < NumberOfKeys; KeyIndex++)
+    {
+        Hash = Batch_Internal_HashValue(Hash, (unsigned int)(pKeys[KeyIndex]>>32));
+        Hash = Batch_Internal_HashValue(Hash, (unsigned int)pKeys[KeyIndex]);
+    }
+
+    return Hash;
+}
+
+
+/*
+ * Batch_Internal_HashCache
+ *
+ *    The key of a cache from its description, the cache ID is not included
+ *    since it follows from the APIC IDs and the mask.
+ *
+ * Arguments:
+ *     Cache
+ *
+ * Return:
+ *     Cache Key
+ */
+unsigned long long Batch_Internal_HashCache(PCPUID_CACHE_INFO pCacheInfo)
+{
+    unsigned long long Hash;
+
+    Hash = FINGERPRINT_OFFSET_BASIS;
+    Hash = Batch_Internal_HashValue(Hash, pCacheInfo->CacheType);
+    Hash = Batch_Internal_HashValue(Hash, pCacheInfo->CacheLevel);
+    Hash = Batch_Internal_HashValue(Hash, pCacheInfo->CacheMask);
+    Hash = Batch_Internal_HashValue(Hash, pCacheInfo->CacheWays);
+    Hash = Batch_Internal_HashValue(Hash, pCacheInfo->CachePartitions);
+    Hash = Batch_Internal_HashValue(Hash, pCacheInfo->CacheLineSize);
+    Hash = Batch_Internal_HashValue(Hash, pCacheInfo->CacheSets);
+    Hash = Batch_Internal_HashValue(Hash, pCacheInfo->NumberOfLPsSharingThisCache);
+
+    return Hash;
+}
+
+
+/*
+ * Batch_Internal_HashTlb
+ *
+ *    The key of a TLB from its description, the TLB ID is not included
+ *    since it follows from the APIC IDs and the mask.
+ *
+ * Arguments:
+ *     TLB
+ *
+ * Return:
+ *     TLB Key
+ */
+unsigned long long Batch_Internal_HashTlb(PCPUID_TLB_INFO pTlbInfo)
+{
+    unsigned long long Hash;
+
+    Hash = FINGERPRINT_OFFSET_BASIS;
+    Hash = Batch_Internal_HashValue(Hash, pTlbInfo->TlbType);
+    Hash = Batch_Internal_HashValue(Hash, pTlbInfo->TlbLevel);
+    Hash = Batch_Internal_HashValue(Hash, pTlbInfo->TlbMask);
+    Hash = Batch_Internal_HashValue(Hash, pTlbInfo->TlbWays);
+    Hash = Batch_Internal_HashValue(Hash, pTlbInfo->TlbParitioning);
+    Hash = Batch_Internal_HashValue(Hash, pTlbInfo->TlbSets);
+    Hash = Batch_Internal_HashValue(Hash, (pTlbInfo->_4K_PageSizeEntries ? 1 : 0) | (pTlbInfo->_2MB_PageSizeEntries ? 2 : 0) | (pTlbInfo->_4MB_PageSizeEntries ? 4 : 0) | (pTlbInfo->_1GB_PageSizeEntries ? 8 : 0));
+    Hash = Batch_Internal_HashValue(Hash, pTlbInfo->NumberOfLPsSharingThisTlb);
+
+    return Hash;
+}
+
+
+/*
+ * Batch_Internal_CompareKeys
+ *
+ *    The qsort comparison of two fingerprint keys.
+ *
+ * Arguments:
+ *     First Key, Second Key
+ *
+ * Return:
+ *     Less than, equal to or greater than zero
+ */
+int Batch_Internal_CompareKeys(const void *pFirst, const void *pSecond)
+{
+    unsigned long long FirstKey;
+    unsigned long long SecondKey;
+    int Comparison;
+
+    FirstKey  = *(const unsigned long long *)pFirst;
+    SecondKey = *(const unsigned long long *)pSecond;
+
+    Comparison = (FirstKey < SecondKey) ? -1 : ((FirstKey > SecondKey) ? 1 : 0);
+
+    return Comparison;
+}
+
+
+/*
+ * Batch_Internal_CompareCaptures
+ *
+ *    The qsort comparison of two captures, the loaded captures by fingerprint
+ *    then in the order they were given, and the failed captures after them.
+ *
+ * Arguments:
+ *     First Capture, Second Capture
+ *
+ * Return:
+ *     Less than, equal to or greater than zero
+ */
+int Batch_Internal_CompareCaptures(const void *pFirst, const void *pSecond)
+{
+    const BATCH_CAPTURE *pFirstCapture;
+    const BATCH_CAPTURE *pSecondCapture;
+    int Comparison;
+
+    pFirstCapture  = (const BATCH_CAPTURE *)pFirst;
+    pSecondCapture = (const BATCH_CAPTURE *)pSecond;
+
+    if (pFirstCapture->Loaded != pSecondCapture->Loaded)
+    {
+        Comparison = pFirstCapture->Loaded ? -1 : 1;
+    }
+    else if (pFirstCapture->Loaded && pFirstCapture->Fingerprint != pSecondCapture->Fingerprint)
+    {
+        Comparison = (pFirstCapture->Fingerprint < pSecondCapture->Fingerprint) ? -1 : 1;
+    }
+    else
+    {
+        Comparison = (pFirstCapture->CaptureIndex < pSecondCapture->CaptureIndex) ? -1 : ((pFirstCapture->CaptureIndex > pSecondCapture->CaptureIndex) ? 1 : 0);
+    }
+
+    return Comparison;
+}
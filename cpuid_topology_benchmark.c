@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * Constants, values for local use
+ */
+#define BENCHMARK_DEFAULT_ITERATIONS   10
+#define BENCHMARK_CPUID_CALLS          1000
+#define BENCHMARK_TEXT_FILE            "cpuid_topology_benchmark.txt.tmp"
+#define BENCHMARK_BINARY_FILE          "cpuid_topology_benchmark.bin.tmp"
+#define BENCHMARK_COMPRESSED_FILE      "cpuid_topology_benchmark.cpz.tmp"
+
+
+/*
+ * Function Pointer Definition for one timed phase, it returns the number of
+ * units the phase covered such as processors or calls.
+ */
+typedef unsigned int (*PFN_BENCHMARK_PHASE)(void *pContext);
+
+/*
+ * The context of the phases of one benchmark run.
+ */
+typedef struct _BENCHMARK_CONTEXT
+{
+    char *pszFileName;
+    unsigned int Iterations;
+    BOOL_TYPE PhaseFailed;
+    PCPUID_TOPOLOGY pTopology;
+
+} BENCHMARK_CONTEXT, *PBENCHMARK_CONTEXT;
+
+
+/*
+ * Prototypes
+ */
+void Benchmark_RunCapture(PBENCHMARK_CONTEXT pBenchmarkContext);
+void Benchmark_RunPhase(PBENCHMARK_CONTEXT pBenchmarkContext, char *pszPhase, char *pszUnit, PFN_BENCHMARK_PHASE pfnPhase);
+unsigned int Benchmark_Phase_NativeCapture(void *pContext);
+unsigned int Benchmark_Phase_LoadFile(void *pContext);
+unsigned int Benchmark_Phase_CpuidInstruction(void *pContext);
+unsigned int Benchmark_Phase_SetAffinity(void *pContext);
+unsigned int Benchmark_Phase_GatherApicIds(void *pContext);
+unsigned int Benchmark_Phase_DomainLayout(void *pContext);
+unsigned int Benchmark_Phase_ParseCaches(void *pContext);
+unsigned int Benchmark_Phase_ParseTlbs(void *pContext);
+unsigned int Benchmark_Phase_CreateTopology(void *pContext);
+unsigned int Benchmark_Phase_CurrentProcessor(void *pContext);
+unsigned int Benchmark_Phase_SaveTextFile(void *pContext);
+unsigned int Benchmark_Phase_SaveBinaryFile(void *pContext);
+unsigned int Benchmark_Phase_SaveCompressedFile(void *pContext);
+unsigned int Benchmark_Phase_LoadTextFile(void *pContext);
+unsigned int Benchmark_Phase_LoadBinaryFile(void *pContext);
+unsigned int Benchmark_Phase_LoadCompressedFile(void *pContext);
+void Benchmark_DisplayParameters(void);
+
+
+
+/*
+ * main
+ *
+ * Entry point of the benchmark, the native CPUID is measured first followed
+ * by each capture file given.
+ *
+ * Arguments:
+ *     Number of Arguments, Argument List
+ *
+ * Return:
+ *     Zero when every phase completed
+ */
+int main(int argc, char **argv)
+{
+    BENCHMARK_CONTEXT BenchmarkContext;
+    int ArgumentIndex;
+    int ExitStatus;
+    char *pszEnd;
+
+    ExitStatus = 0;
+    memset(&BenchmarkContext, 0, sizeof(BenchmarkContext));
+    BenchmarkContext.Iterations = BENCHMARK_DEFAULT_ITERATIONS;
+    ArgumentIndex = 1;
+
+    if (argc > 1 && (*argv[1] | ((char)0x20)) == 'h')
+    {
+        Benchmark_DisplayParameters();
+    }
+    else
+    {
+        if (argc > 1)
+        {
+            BenchmarkContext.Iterations = (unsigned int)strtoul(argv[1], &pszEnd, 10);
+
+            if (pszEnd != argv[1] && *pszEnd == 0 && BenchmarkContext.Iterations != 0)
+            {
+                ArgumentIndex = 2;
+            }
+            else
+            {
+                BenchmarkContext.Iterations = BENCHMARK_DEFAULT_ITERATIONS;
+            }
+        }
+
+        File_SetQuietEcho(BOOL_TRUE);
+
+        Benchmark_RunCapture(&BenchmarkContext);
+
+        for (; ArgumentIndex < argc; ArgumentIndex++)
+        {
+            BenchmarkContext.pszFileName = argv[ArgumentIndex];
+            Benchmark_RunCapture(&BenchmarkContext);
+        }
+
+        remove(BENCHMARK_TEXT_FILE);
+        remove(BENCHMARK_BINARY_FILE);
+        remove(BENCHMARK_COMPRESSED_FILE);
+
+        if (BenchmarkContext.PhaseFailed)
+        {
+            ExitStatus = 1;
+        }
+    }
+
+    return ExitStatus;
+}
+
+
+/*
+ * Benchmark_RunCapture
+ *
+ * Times every phase of the enumeration on the native CPUID or on a capture
+ * file, the native CPUID also times the CPUID instruction, the migration
+ * of a thread between processors and the lookup of the current processor.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     None
+ */
+void Benchmark_RunCapture(PBENCHMARK_CONTEXT pBenchmarkContext)
+{
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    Capture_ReleaseSnapshot();
+
+    if (pBenchmarkContext->pszFileName)
+    {
+        pCpuidContext->UseNativeCpuid = BOOL_FALSE;
+
+        if (File_ReadCpuidFromFile(pBenchmarkContext->pszFileName))
+        {
+            printf("\nBenchmark of %s, %u processors, %u iterations\n\n", pBenchmarkContext->pszFileName, Tools_GetNumberOfProcessors(), pBenchmarkContext->Iterations);
+            printf("   Phase                        Minimum(us)    Average(us)    Maximum(us)  Average per unit(ns)\n");
+            Benchmark_RunPhase(pBenchmarkContext, "Load Capture File", "processor", Benchmark_Phase_LoadFile);
+        }
+        else
+        {
+            printf("\nError; the capture file %s could not be loaded.\n", pBenchmarkContext->pszFileName);
+            pBenchmarkContext->PhaseFailed = BOOL_TRUE;
+        }
+    }
+    else
+    {
+        pCpuidContext->UseNativeCpuid = BOOL_TRUE;
+
+        printf("\nBenchmark of the native CPUID, %u processors, %u iterations\n\n", Os_GetNumberOfProcessors(), pBenchmarkContext->Iterations);
+        printf("   Phase                        Minimum(us)    Average(us)    Maximum(us)  Average per unit(ns)\n");
+        Benchmark_RunPhase(pBenchmarkContext, "CPUID Instruction", "call", Benchmark_Phase_CpuidInstruction);
+        Benchmark_RunPhase(pBenchmarkContext, "Os_SetAffinity Migration", "migration", Benchmark_Phase_SetAffinity);
+        Benchmark_RunPhase(pBenchmarkContext, "Capture All Processors", "processor", Benchmark_Phase_NativeCapture);
+    }
+
+    if (pCpuidContext->pProcessorSnapshot)
+    {
+        Benchmark_RunPhase(pBenchmarkContext, "Gather Platform APIC IDs", "processor", Benchmark_Phase_GatherApicIds);
+        Benchmark_RunPhase(pBenchmarkContext, "Build Domain Layout", "processor", Benchmark_Phase_DomainLayout);
+        Benchmark_RunPhase(pBenchmarkContext, "Parse Caches", "processor", Benchmark_Phase_ParseCaches);
+        Benchmark_RunPhase(pBenchmarkContext, "Parse TLBs", "processor", Benchmark_Phase_ParseTlbs);
+        Benchmark_RunPhase(pBenchmarkContext, "Create Topology Library", "processor", Benchmark_Phase_CreateTopology);
+
+        if (pCpuidContext->UseNativeCpuid)
+        {
+            pBenchmarkContext->pTopology = Topology_Create();
+
+            if (pBenchmarkContext->pTopology)
+            {
+                Benchmark_RunPhase(pBenchmarkContext, "Current Processor Lookup", "call", Benchmark_Phase_CurrentProcessor);
+                Topology_Destroy(pBenchmarkContext->pTopology);
+                pBenchmarkContext->pTopology = NULL;
+            }
+        }
+
+        Benchmark_RunPhase(pBenchmarkContext, "Save Text File", "processor", Benchmark_Phase_SaveTextFile);
+        Benchmark_RunPhase(pBenchmarkContext, "Save Binary File", "processor", Benchmark_Phase_SaveBinaryFile);
+        Benchmark_RunPhase(pBenchmarkContext, "Save Compressed File", "processor", Benchmark_Phase_SaveCompressedFile);
+        Benchmark_RunPhase(pBenchmarkContext, "Load Text File", "processor", Benchmark_Phase_LoadTextFile);
+        Benchmark_RunPhase(pBenchmarkContext, "Load Binary File", "processor", Benchmark_Phase_LoadBinaryFile);
+        Benchmark_RunPhase(pBenchmarkContext, "Load Compressed File", "processor", Benchmark_Phase_LoadCompressedFile);
+    }
+}
+
+
+/*
+ * Benchmark_RunPhase
+ *
+ * Runs a phase for every iteration and displays the minimum, average and
+ * maximum time and the average time of each unit the phase covered.
+ *
+ * Arguments:
+ *     Benchmark Context, Phase Name, Unit Name, Phase Function
+ *
+ * Return:
+ *     None
+ */
+void Benchmark_RunPhase(PBENCHMARK_CONTEXT pBenchmarkContext, char *pszPhase, char *pszUnit, PFN_BENCHMARK_PHASE pfnPhase)
+{
+    unsigned long long StartTime;
+    unsigned long long ElapsedTime;
+    unsigned long long MinimumTime;
+    unsigned long long MaximumTime;
+    unsigned long long TotalTime;
+    unsigned long long TotalUnits;
+    unsigned int Iteration;
+    unsigned int NumberOfUnits;
+
+    MinimumTime = (unsigned long long)-1;
+    MaximumTime = 0;
+    TotalTime   = 0;
+    TotalUnits  = 0;
+
+    for (Iteration = 0; Iteration < pBenchmarkContext->Iterations; Iteration++)
+    {
+        StartTime = Os_GetTimestampNanoseconds();
+        NumberOfUnits = pfnPhase(pBenchmarkContext);
+        ElapsedTime = Os_GetTimestampNanoseconds() - StartTime;
+
+        if (NumberOfUnits == 0)
+        {
+            pBenchmarkContext->PhaseFailed = BOOL_TRUE;
+        }
+
+        MinimumTime = (ElapsedTime < MinimumTime) ? ElapsedTime : MinimumTime;
+        MaximumTime = (ElapsedTime > MaximumTime) ? ElapsedTime : MaximumTime;
+        TotalTime  += ElapsedTime;
+        TotalUnits += NumberOfUnits;
+    }
+
+    printf("   %-26s %12.3f   %12.3f   %12.3f   %12.1f per %s\n", pszPhase, (double)MinimumTime / 1000.0, ((double)TotalTime / (double)pBenchmarkContext->Iterations) / 1000.0, (double)MaximumTime / 1000.0,
+                                                                   TotalUnits ? (double)TotalTime / (double)TotalUnits : 0.0, pszUnit);
+}
+
+
+/*
+ * Benchmark_Phase_NativeCapture
+ *
+ * Captures the CPUID of every processor again.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors captured
+ */
+unsigned int Benchmark_Phase_NativeCapture(void *pContext)
+{
+    unsigned int NumberOfProcessors;
+
+    NumberOfProcessors = 0;
+
+    Capture_ReleaseSnapshot();
+
+    if (Capture_CaptureProcessors())
+    {
+        NumberOfProcessors = Tools_GetNumberOfProcessors();
+    }
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * Benchmark_Phase_LoadFile
+ *
+ * Loads the capture file being measured again.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors loaded
+ */
+unsigned int Benchmark_Phase_LoadFile(void *pContext)
+{
+    PBENCHMARK_CONTEXT pBenchmarkContext;
+    unsigned int NumberOfProcessors;
+
+    pBenchmarkContext = (PBENCHMARK_CONTEXT)pContext;
+    NumberOfProcessors = 0;
+
+    if (File_ReadCpuidFromFile(pBenchmarkContext->pszFileName))
+    {
+        NumberOfProcessors = Tools_GetNumberOfProcessors();
+    }
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * Benchmark_Phase_CpuidInstruction
+ *
+ * Executes the CPUID instruction directly on the current processor.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of CPUID instructions executed
+ */
+unsigned int Benchmark_Phase_CpuidInstruction(void *pContext)
+{
+    CPUID_REGISTERS CpuidRegisters;
+    unsigned int CallIndex;
+
+    for (CallIndex = 0; CallIndex < BENCHMARK_CPUID_CALLS; CallIndex++)
+    {
+        Os_Platform_Read_Cpuid(0xB, 0, &CpuidRegisters);
+    }
+
+    return BENCHMARK_CPUID_CALLS;
+}
+
+
+/*
+ * Benchmark_Phase_SetAffinity
+ *
+ * Migrates this thread through every processor and back to the first.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of migrations
+ */
+unsigned int Benchmark_Phase_SetAffinity(void *pContext)
+{
+    unsigned int NumberOfProcessors;
+    unsigned int ProcessorIndex;
+
+    NumberOfProcessors = Os_GetNumberOfProcessors();
+
+    for (ProcessorIndex = 1; ProcessorIndex <= NumberOfProcessors; ProcessorIndex++)
+    {
+        Os_SetAffinity(ProcessorIndex % NumberOfProcessors);
+    }
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * Benchmark_Phase_GatherApicIds
+ *
+ * Gathers the APIC ID of every processor.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_GatherApicIds(void *pContext)
+{
+    unsigned int *pApicIdArray;
+    unsigned int NumberOfProcessors;
+
+    NumberOfProcessors = 0;
+
+    pApicIdArray = Tools_AllocatePlatformApicIds(&NumberOfProcessors);
+
+    if (pApicIdArray)
+    {
+        free(pApicIdArray);
+    }
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * Benchmark_Phase_DomainLayout
+ *
+ * Builds the APIC ID domain layout from CPUID.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_DomainLayout(void *pContext)
+{
+    APICID_BIT_LAYOUT_CTX ApicidBitLayoutCtx;
+
+    memset(&ApicidBitLayoutCtx, 0, sizeof(ApicidBitLayoutCtx));
+
+    ParseCpu_BuildDomainLayout(&ApicidBitLayoutCtx);
+
+    return Tools_GetNumberOfProcessors();
+}
+
+
+/*
+ * Benchmark_Phase_ParseCaches
+ *
+ * Builds and releases the cache topology.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_ParseCaches(void *pContext)
+{
+    CPUID_CACHE_TOPOLOGY CacheTopology;
+    unsigned int NumberOfProcessors;
+
+    NumberOfProcessors = 0;
+
+    if (ParseCache_BuildCacheTopology(&CacheTopology))
+    {
+        NumberOfProcessors = CacheTopology.NumberOfProcessors;
+        ParseCache_ReleaseCacheTopology(&CacheTopology);
+    }
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * Benchmark_Phase_ParseTlbs
+ *
+ * Builds and releases the TLB topology.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_ParseTlbs(void *pContext)
+{
+    CPUID_TLB_TOPOLOGY TlbTopology;
+    unsigned int NumberOfProcessors;
+
+    NumberOfProcessors = 0;
+
+    if (ParseTlb_BuildTlbTopology(&TlbTopology))
+    {
+        NumberOfProcessors = TlbTopology.NumberOfProcessors;
+        ParseTlb_ReleaseTlbTopology(&TlbTopology);
+    }
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * Benchmark_Phase_CreateTopology
+ *
+ * Creates and destroys the topology library model.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_CreateTopology(void *pContext)
+{
+    PCPUID_TOPOLOGY pTopology;
+    unsigned int NumberOfProcessors;
+
+    NumberOfProcessors = 0;
+
+    pTopology = Topology_Create();
+
+    if (pTopology)
+    {
+        NumberOfProcessors = Topology_GetNumberOfProcessors(pTopology);
+        Topology_Destroy(pTopology);
+    }
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * Benchmark_Phase_CurrentProcessor
+ *
+ * Looks up the domain IDs of the processor this thread is running on.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of lookups
+ */
+unsigned int Benchmark_Phase_CurrentProcessor(void *pContext)
+{
+    PBENCHMARK_CONTEXT pBenchmarkContext;
+    unsigned int CallIndex;
+    unsigned int NumberOfLookups;
+
+    pBenchmarkContext = (PBENCHMARK_CONTEXT)pContext;
+    NumberOfLookups = 0;
+
+    for (CallIndex = 0; CallIndex < BENCHMARK_CPUID_CALLS; CallIndex++)
+    {
+        if (Topology_GetCurrentProcessorDomainIds(pBenchmarkContext->pTopology))
+        {
+            NumberOfLookups++;
+        }
+    }
+
+    return NumberOfLookups;
+}
+
+
+/*
+ * Benchmark_Phase_SaveTextFile
+ *
+ * Saves the CPUID as a text file.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_SaveTextFile(void *pContext)
+{
+    return File_WriteCpuidToFile(BENCHMARK_TEXT_FILE, CpuidFileFormat_Text) ? Tools_GetNumberOfProcessors() : 0;
+}
+
+
+/*
+ * Benchmark_Phase_SaveBinaryFile
+ *
+ * Saves the CPUID as a binary file.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_SaveBinaryFile(void *pContext)
+{
+    return File_WriteCpuidToFile(BENCHMARK_BINARY_FILE, CpuidFileFormat_Binary) ? Tools_GetNumberOfProcessors() : 0;
+}
+
+
+/*
+ * Benchmark_Phase_SaveCompressedFile
+ *
+ * Saves the CPUID as a compressed file.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_SaveCompressedFile(void *pContext)
+{
+    return File_WriteCpuidToFile(BENCHMARK_COMPRESSED_FILE, CpuidFileFormat_Compressed) ? Tools_GetNumberOfProcessors() : 0;
+}
+
+
+/*
+ * Benchmark_Phase_LoadTextFile
+ *
+ * Loads the text file that was saved, replacing the snapshot with the same CPUID.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_LoadTextFile(void *pContext)
+{
+    return File_ReadCpuidFromFile(BENCHMARK_TEXT_FILE) ? Tools_GetNumberOfProcessors() : 0;
+}
+
+
+/*
+ * Benchmark_Phase_LoadBinaryFile
+ *
+ * Loads the binary file that was saved, replacing the snapshot with the same CPUID.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_LoadBinaryFile(void *pContext)
+{
+    return File_ReadCpuidFromFile(BENCHMARK_BINARY_FILE) ? Tools_GetNumberOfProcessors() : 0;
+}
+
+
+/*
+ * Benchmark_Phase_LoadCompressedFile
+ *
+ * Loads the compressed file that was saved, replacing the snapshot with the same CPUID.
+ *
+ * Arguments:
+ *     Benchmark Context
+ *
+ * Return:
+ *     Number of processors
+ */
+unsigned int Benchmark_Phase_LoadCompressedFile(void *pContext)
+{
+    return File_ReadCpuidFromFile(BENCHMARK_COMPRESSED_FILE) ? Tools_GetNumberOfProcessors() : 0;
+}
+
+
+/*
+ * Benchmark_DisplayParameters
+ *
+ * Displays the command line of the benchmark.
+ *
+ * Arguments:
+ *     None
+ *
+ * Return:
+ *     None
+ */
+void Benchmark_DisplayParameters(void)
+{
+    printf("Processor Topology Enumeration Benchmark.\n");
+    printf("   Command Line Options:\n\n");
+    printf("      H                      - Display this message\n");
+    printf("      [ITERATIONS] [File...] - Time each phase ITERATIONS times (default %u) on the native CPUID\n", BENCHMARK_DEFAULT_ITERATIONS);
+    printf("                               followed by each CPUID capture File, i.e. 20 Capture8.DAT Capture4096.DAT\n\n");
+}
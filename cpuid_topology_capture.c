@@ -0,0 +1,1061 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+
+/*
+ * The list of leafs captured on every processor.
+ */
+const unsigned int g_CapturedLeafs[NUMBER_OF_CAPTURED_LEAFS] = { 0, 1, 4, 0xB, 0x18, 0x1A, 0x1F };
+
+
+/*
+ *  Internal Prototypes
+ */
+void Capture_Internal_CaptureProcessor(unsigned int ProcessorNumber, void *pContext);
+BOOL_TYPE Capture_Internal_CaptureLeaf(PCPUID_CONTEXT pCpuidContext, unsigned int ProcessorNumber, unsigned int Leaf);
+void Capture_Internal_CompleteProcessor(PCPUID_CONTEXT pCpuidContext, unsigned int ProcessorNumber);
+void Capture_Internal_ClampMaximumSubleaf(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot);
+BOOL_TYPE Capture_Internal_ReadProcessorCpuid(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters);
+PCPUID_LEAF_SNAPSHOT Capture_Internal_FindLeaf(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot, unsigned int Leaf);
+PCPUID_LEAF_SNAPSHOT Capture_Internal_AddLeaf(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot, unsigned int Leaf);
+unsigned int Capture_Internal_ComputeApicId(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot);
+
+
+
+/*
+ * Capture_CaptureProcessors
+ *
+ *    Captures the CPUID leafs of every logical processor into the per-processor
+ *    snapshot.  Each processor is captured by a worker that the OS layer has already
+ *    pinned to that processor, so all processors are read concurrently and the main
+ *    thread is never migrated.  The workers are given the CPUID context of the 
+ *    calling thread so the snapshot is filled in for that context.
+ *
+ *    This only applies to native CPUID; it does nothing if a snapshot already
+ *    exists or CPUID is being simulated from a file.
+ *
+ * Arguments:
+ *     None
+ *
+ * Return:
+ *     Returns true if a snapshot is available
+ */
+BOOL_TYPE Capture_CaptureProcessors(void)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    unsigned int NumberOfProcessors;
+    unsigned int ProcessorIndex;
+    BOOL_TYPE SnapshotCaptured;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    SnapshotCaptured = BOOL_FALSE;
+
+    if (pCpuidContext->UseNativeCpuid && pCpuidContext->pProcessorSnapshot == NULL)
+    {
+        NumberOfProcessors = Os_GetNumberOfProcessors();
+
+        if (Capture_AllocateSnapshot(NumberOfProcessors))
+        {
+            if (Os_RunOnEachProcessor(NumberOfProcessors, Capture_Internal_CaptureProcessor, pCpuidContext) == BOOL_FALSE)
+            {
+                /*
+                 * The OS could not provide pinned workers, fall back to migrating
+                 * this thread through each processor.  A processor the thread could
+                 * not be moved to is not captured rather than captured from another.
+                 */
+                for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++)
+                {
+                    if (Os_SetAffinity(ProcessorIndex))
+                    {
+                        Capture_Internal_CaptureProcessor(ProcessorIndex, pCpuidContext);
+                    }
+                }
+            }
+        }
+        else
+        {
+            /*
+             * Memory Allocation Failure, continue to use live CPUID.
+             */
+        }
+    }
+
+    if (pCpuidContext->pProcessorSnapshot)
+    {
+        SnapshotCaptured = BOOL_TRUE;
+    }
+
+    return SnapshotCaptured;
+}
+
+
+/*
+ * Capture_AllocateSnapshot
+ *
+ *    Replaces any existing snapshot with an empty snapshot for the
+ *    number of processors specified.
+ *
+ * Arguments:
+ *     Number of Processors
+ *
+ * Return:
+ *     Returns true if the snapshot was allocated
+ */
+BOOL_TYPE Capture_AllocateSnapshot(unsigned int NumberOfProcessors)
+{
+    BOOL_TYPE SnapshotAllocated;
+
+    SnapshotAllocated = BOOL_FALSE;
+
+    Capture_ReleaseSnapshot();
+
+    if (NumberOfProcessors)
+    {
+        SnapshotAllocated = Capture_ResizeSnapshot(NumberOfProcessors);
+    }
+
+    return SnapshotAllocated;
+}
+
+
+/*
+ * Capture_ResizeSnapshot
+ *
+ *    Grows or shrinks the snapshot to the number of processors specified,
+ *    the processors that remain keep their captured leafs.  This allows the
+ *    snapshot to be built when the number of processors is not known up front.
+ *
+ * Arguments:
+ *     Number of Processors
+ *
+ * Return:
+ *     Returns true if the snapshot holds the number of processors specified
+ */
+BOOL_TYPE Capture_ResizeSnapshot(unsigned int NumberOfProcessors)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot;
+    unsigned int ProcessorIndex;
+    BOOL_TYPE SnapshotResized;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    SnapshotResized = BOOL_FALSE;
+
+    for (ProcessorIndex = NumberOfProcessors; ProcessorIndex < pCpuidContext->NumberOfSnapshotProcessors; ProcessorIndex++)
+    {
+        Capture_ReleaseProcessor(&pCpuidContext->pProcessorSnapshot[ProcessorIndex]);
+    }
+
+    if (NumberOfProcessors == 0)
+    {
+        Capture_ReleaseSnapshot();
+        SnapshotResized = BOOL_TRUE;
+    }
+    else
+    {
+        pProcessorSnapshot = (PCPUID_PROCESSOR_SNAPSHOT)realloc(pCpuidContext->pProcessorSnapshot, NumberOfProcessors*sizeof(CPUID_PROCESSOR_SNAPSHOT));
+
+        if (pProcessorSnapshot)
+        {
+            if (NumberOfProcessors > pCpuidContext->NumberOfSnapshotProcessors)
+            {
+                memset(&pProcessorSnapshot[pCpuidContext->NumberOfSnapshotProcessors], 0, (NumberOfProcessors - pCpuidContext->NumberOfSnapshotProcessors)*sizeof(CPUID_PROCESSOR_SNAPSHOT));
+            }
+
+            if (pCpuidContext->CurrentProcessorAffinity >= NumberOfProcessors)
+            {
+                pCpuidContext->CurrentProcessorAffinity = 0;
+            }
+
+            pCpuidContext->pProcessorSnapshot = pProcessorSnapshot;
+            pCpuidContext->NumberOfSnapshotProcessors = NumberOfProcessors;
+            SnapshotResized = BOOL_TRUE;
+        }
+    }
+
+    return SnapshotResized;
+}
+
+
+/*
+ * Capture_SetSnapshotCpuid
+ *
+ *    Stores a leaf and subleaf for a processor into the snapshot; this is
+ *    used to build the snapshot from CPUID that was not read from this
+ *    platform.
+ *
+ * Arguments:
+ *     Processor Number, Leaf, Subleaf, CPUID Data Structure
+ *
+ * Return:
+ *     Returns true if this leaf and subleaf are held by the snapshot
+ */
+BOOL_TYPE Capture_SetSnapshotCpuid(unsigned int ProcessorNumber, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    BOOL_TYPE LeafStored;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    LeafStored = BOOL_FALSE;
+
+    if (pCpuidContext->pProcessorSnapshot && ProcessorNumber < pCpuidContext->NumberOfSnapshotProcessors)
+    {
+        LeafStored = Capture_SetProcessorCpuid(&pCpuidContext->pProcessorSnapshot[ProcessorNumber], Leaf, Subleaf, pCpuidRegisters);
+    }
+
+    return LeafStored;
+}
+
+
+/*
+ * Capture_SetProcessorCpuid
+ *
+ *    Stores a leaf and subleaf into a processor snapshot.  Only the leafs that
+ *    are stored take any space and each leaf holds its subleafs up to the 
+ *    highest one stored, skipped subleafs read as zero.
+ *
+ * Arguments:
+ *     Processor Snapshot, Leaf, Subleaf, CPUID Data Structure
+ *
+ * Return:
+ *     Returns true if this leaf and subleaf are held by the snapshot
+ */
+BOOL_TYPE Capture_SetProcessorCpuid(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
+{
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshot;
+    PCPUID_REGISTERS pSubleafs;
+    unsigned int MaximumSubleafs;
+    BOOL_TYPE LeafStored;
+
+    LeafStored = BOOL_FALSE;
+
+    pLeafSnapshot = Capture_Internal_FindLeaf(pProcessorSnapshot, Leaf);
+
+    if (pLeafSnapshot == NULL)
+    {
+        pLeafSnapshot = Capture_Internal_AddLeaf(pProcessorSnapshot, Leaf);
+    }
+
+    if (pLeafSnapshot)
+    {
+        if (Subleaf >= pLeafSnapshot->MaximumSubleafs)
+        {
+            MaximumSubleafs = pLeafSnapshot->MaximumSubleafs ? pLeafSnapshot->MaximumSubleafs : 4;
+
+            while ((MaximumSubleafs <= Subleaf || MaximumSubleafs < pLeafSnapshot->NumberOfSubleafs) && MaximumSubleafs < 0x80000000)
+            {
+                MaximumSubleafs = MaximumSubleafs*2;
+            }
+
+            pSubleafs = NULL;
+
+            if (MaximumSubleafs > Subleaf)
+            {
+                if (pLeafSnapshot->MaximumSubleafs)
+                {
+                    pSubleafs = (PCPUID_REGISTERS)realloc(pLeafSnapshot->pSubleafs, MaximumSubleafs*sizeof(CPUID_REGISTERS));
+                }
+                else
+                {
+                    /*
+                     * Subleafs borrowed from the snapshot storage are copied before they are changed.
+                     */
+                    pSubleafs = (PCPUID_REGISTERS)malloc(MaximumSubleafs*sizeof(CPUID_REGISTERS));
+
+                    if (pSubleafs && pLeafSnapshot->NumberOfSubleafs)
+                    {
+                        memcpy(pSubleafs, pLeafSnapshot->pSubleafs, pLeafSnapshot->NumberOfSubleafs*sizeof(CPUID_REGISTERS));
+                    }
+                }
+            }
+
+            if (pSubleafs)
+            {
+                pLeafSnapshot->pSubleafs = pSubleafs;
+                pLeafSnapshot->MaximumSubleafs = MaximumSubleafs;
+            }
+        }
+
+        if (Subleaf < pLeafSnapshot->MaximumSubleafs)
+        {
+            /*
+             * Any subleafs skipped over read as zero.
+             */
+            if (Subleaf > pLeafSnapshot->NumberOfSubleafs)
+            {
+                memset(&pLeafSnapshot->pSubleafs[pLeafSnapshot->NumberOfSubleafs], 0, (Subleaf - pLeafSnapshot->NumberOfSubleafs)*sizeof(CPUID_REGISTERS));
+            }
+
+            memcpy(&pLeafSnapshot->pSubleafs[Subleaf], pCpuidRegisters, sizeof(CPUID_REGISTERS));
+
+            if (Subleaf >= pLeafSnapshot->NumberOfSubleafs)
+            {
+                pLeafSnapshot->NumberOfSubleafs = Subleaf + 1;
+            }
+
+            LeafStored = BOOL_TRUE;
+        }
+    }
+
+    return LeafStored;
+}
+
+
+/*
+ * Capture_CompleteProcessor
+ *
+ *    Marks a processor's snapshot as complete and caches its APIC ID
+ *    from the captured leafs so it does not need to be rediscovered.  The
+ *    OS identity of the processor is recorded with native CPUID.
+ *
+ * Arguments:
+ *     Processor Number
+ *
+ * Return:
+ *     None
+ */
+void Capture_CompleteProcessor(unsigned int ProcessorNumber)
+{
+    Capture_Internal_CompleteProcessor(Tools_GetCpuidContext(), ProcessorNumber);
+}
+
+
+/*
+ * Capture_AttachProcessorLeafs
+ *
+ *    Completes a processor's snapshot with a table of leafs that are already 
+ *    built, such as one loaded in a single read from a binary capture.  The 
+ *    leafs and their subleafs are borrowed and not copied, they must live in 
+ *    storage given to Capture_AdoptSnapshotStorage.
+ *
+ * Arguments:
+ *     Processor Number, Leaf Table, Number of Leafs, APIC ID
+ *
+ * Return:
+ *     Returns true if the processor is in the snapshot
+ */
+BOOL_TYPE Capture_AttachProcessorLeafs(unsigned int ProcessorNumber, PCPUID_LEAF_SNAPSHOT pLeafs, unsigned int NumberOfLeafs, unsigned int ApicId)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot;
+    BOOL_TYPE LeafsAttached;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    LeafsAttached = BOOL_FALSE;
+
+    if (pCpuidContext->pProcessorSnapshot && ProcessorNumber < pCpuidContext->NumberOfSnapshotProcessors)
+    {
+        pProcessorSnapshot = &pCpuidContext->pProcessorSnapshot[ProcessorNumber];
+
+        Capture_ReleaseProcessor(pProcessorSnapshot);
+
+        pProcessorSnapshot->pLeafs = pLeafs;
+        pProcessorSnapshot->NumberOfLeafs = NumberOfLeafs;
+        pProcessorSnapshot->MaximumLeafs = 0;
+        Capture_Internal_ClampMaximumSubleaf(pProcessorSnapshot);
+        pProcessorSnapshot->ApicId = ApicId;
+        pProcessorSnapshot->OsProcessorId = pCpuidContext->UseNativeCpuid ? Os_GetProcessorId(ProcessorNumber) : ProcessorNumber;
+        pProcessorSnapshot->Captured = BOOL_TRUE;
+
+        LeafsAttached = BOOL_TRUE;
+    }
+
+    return LeafsAttached;
+}
+
+
+/*
+ * Capture_AdoptSnapshotStorage
+ *
+ *    Takes ownership of a memory block that the snapshot borrows leafs from,
+ *    it is freed when the snapshot is released.
+ *
+ * Arguments:
+ *     Storage allocated with malloc
+ *
+ * Return:
+ *     None
+ */
+void Capture_AdoptSnapshotStorage(void *pStorage)
+{
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    if (pCpuidContext->pSnapshotStorage)
+    {
+        free(pCpuidContext->pSnapshotStorage);
+    }
+
+    pCpuidContext->pSnapshotStorage = pStorage;
+}
+
+
+/*
+ * Capture_GetSnapshotApicId
+ *
+ *    Returns the cached APIC ID of a processor in the snapshot.
+ *
+ * Arguments:
+ *     Processor Number, Returned APIC ID
+ *
+ * Return:
+ *     Returns true if the processor is in the snapshot
+ */
+BOOL_TYPE Capture_GetSnapshotApicId(unsigned int ProcessorNumber, unsigned int *pApicId)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    BOOL_TYPE ApicIdFound;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    ApicIdFound = BOOL_FALSE;
+
+    if (pCpuidContext->pProcessorSnapshot && ProcessorNumber < pCpuidContext->NumberOfSnapshotProcessors)
+    {
+        if (pCpuidContext->pProcessorSnapshot[ProcessorNumber].Captured)
+        {
+            *pApicId = pCpuidContext->pProcessorSnapshot[ProcessorNumber].ApicId;
+            ApicIdFound = BOOL_TRUE;
+        }
+    }
+
+    return ApicIdFound;
+}
+
+
+/*
+ * Capture_GetSnapshotOsProcessorId
+ *
+ *    Returns the OS processor ID a processor in the snapshot was captured on.
+ *
+ * Arguments:
+ *     Processor Number, Returned OS Processor ID
+ *
+ * Return:
+ *     Returns true if the processor is in the snapshot
+ */
+BOOL_TYPE Capture_GetSnapshotOsProcessorId(unsigned int ProcessorNumber, unsigned int *pOsProcessorId)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    BOOL_TYPE OsProcessorIdFound;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    OsProcessorIdFound = BOOL_FALSE;
+
+    if (pCpuidContext->pProcessorSnapshot && ProcessorNumber < pCpuidContext->NumberOfSnapshotProcessors)
+    {
+        if (pCpuidContext->pProcessorSnapshot[ProcessorNumber].Captured)
+        {
+            *pOsProcessorId = pCpuidContext->pProcessorSnapshot[ProcessorNumber].OsProcessorId;
+            OsProcessorIdFound = BOOL_TRUE;
+        }
+    }
+
+    return OsProcessorIdFound;
+}
+
+
+/*
+ * Capture_ReadSnapshotCpuid
+ *
+ *    Reads a leaf and subleaf for a processor from the snapshot of a CPUID context.
+ *    Subleafs beyond those captured return zero, the same as the end of enumeration.
+ *    The context is given by the caller as this is read for every CPUID read.
+ *
+ * Arguments:
+ *     CPUID Context, Processor Number, Leaf, Subleaf, CPUID Data Structure
+ *
+ * Return:
+ *     Returns true if this leaf was captured for this processor
+ */
+BOOL_TYPE Capture_ReadSnapshotCpuid(PCPUID_CONTEXT pCpuidContext, unsigned int ProcessorNumber, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
+{
+    BOOL_TYPE LeafFound;
+
+    LeafFound = BOOL_FALSE;
+
+    if (pCpuidContext->pProcessorSnapshot && ProcessorNumber < pCpuidContext->NumberOfSnapshotProcessors)
+    {
+        if (pCpuidContext->pProcessorSnapshot[ProcessorNumber].Captured)
+        {
+            LeafFound = Capture_Internal_ReadProcessorCpuid(&pCpuidContext->pProcessorSnapshot[ProcessorNumber], Leaf, Subleaf, pCpuidRegisters);
+        }
+    }
+
+    return LeafFound;
+}
+
+
+/*
+ * Capture_ReleaseProcessor
+ *
+ *    Frees the leafs held by a processor snapshot.
+ *
+ * Arguments:
+ *     Processor Snapshot
+ *
+ * Return:
+ *     None
+ */
+void Capture_ReleaseProcessor(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot)
+{
+    unsigned int LeafIndex;
+
+    /*
+     * Leafs and subleafs with no maximum are borrowed from the snapshot storage
+     * and are freed along with it.
+     */
+    for (LeafIndex = 0; LeafIndex < pProcessorSnapshot->NumberOfLeafs; LeafIndex++)
+    {
+        if (pProcessorSnapshot->pLeafs[LeafIndex].MaximumSubleafs)
+        {
+            free(pProcessorSnapshot->pLeafs[LeafIndex].pSubleafs);
+        }
+    }
+
+    if (pProcessorSnapshot->MaximumLeafs)
+    {
+        free(pProcessorSnapshot->pLeafs);
+    }
+
+    memset(pProcessorSnapshot, 0, sizeof(CPUID_PROCESSOR_SNAPSHOT));
+}
+
+
+/*
+ * Capture_ReleaseSnapshot
+ *
+ *    Frees the snapshot, subsequent native CPUID reads will go to the hardware.
+ *
+ * Arguments:
+ *     None
+ *
+ * Return:
+ *     None
+ */
+void Capture_ReleaseSnapshot(void)
+{
+    Capture_ReleaseContextSnapshot(Tools_GetCpuidContext());
+}
+
+
+/*
+ * Capture_ReleaseContextSnapshot
+ *
+ *    Frees the snapshot of a CPUID context whether or not it is bound to the 
+ *    calling thread.
+ *
+ * Arguments:
+ *     CPUID Context
+ *
+ * Return:
+ *     None
+ */
+void Capture_ReleaseContextSnapshot(PCPUID_CONTEXT pCpuidContext)
+{
+    unsigned int ProcessorIndex;
+
+    if (pCpuidContext->pProcessorSnapshot)
+    {
+        for (ProcessorIndex = 0; ProcessorIndex < pCpuidContext->NumberOfSnapshotProcessors; ProcessorIndex++)
+        {
+            Capture_ReleaseProcessor(&pCpuidContext->pProcessorSnapshot[ProcessorIndex]);
+        }
+
+        free(pCpuidContext->pProcessorSnapshot);
+        pCpuidContext->pProcessorSnapshot = NULL;
+        pCpuidContext->NumberOfSnapshotProcessors = 0;
+        pCpuidContext->CurrentProcessorAffinity = 0;
+    }
+
+    if (pCpuidContext->pSnapshotStorage)
+    {
+        free(pCpuidContext->pSnapshotStorage);
+        pCpuidContext->pSnapshotStorage = NULL;
+    }
+}
+
+
+/*
+ * Capture_UpdateProcessors
+ *
+ *    Brings a native snapshot up to date after processors have gone online or 
+ *    offline.  The snapshot and the OS processors are both in ascending order of
+ *    their OS identity, so they are merged in a single pass; processors that are
+ *    still online keep their captured leafs, processors that went offline are 
+ *    released and only the processors that came online are captured.
+ *
+ *    The processors that came online are captured by migrating this thread
+ *    to each of them, the same as the capture fallback.
+ *
+ * Arguments:
+ *     Returned Number of Processors Added, Returned Number of Processors Removed
+ *
+ * Return:
+ *     Returns true if the snapshot matches the processors that are online
+ */
+BOOL_TYPE Capture_UpdateProcessors(unsigned int *pProcessorsAdded, unsigned int *pProcessorsRemoved)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot;
+    unsigned int NumberOfProcessors;
+    unsigned int ProcessorIndex;
+    unsigned int SnapshotIndex;
+    unsigned int OsProcessorId;
+    unsigned int CurrentProcessorAffinity;
+    BOOL_TYPE SnapshotUpdated;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    SnapshotUpdated = BOOL_FALSE;
+    *pProcessorsAdded = 0;
+    *pProcessorsRemoved = 0;
+
+    if (pCpuidContext->UseNativeCpuid && pCpuidContext->pProcessorSnapshot)
+    {
+        Os_RefreshProcessors();
+
+        NumberOfProcessors = Os_GetNumberOfProcessors();
+
+        pProcessorSnapshot = (PCPUID_PROCESSOR_SNAPSHOT)calloc(NumberOfProcessors + 1, sizeof(CPUID_PROCESSOR_SNAPSHOT));
+
+        if (pProcessorSnapshot)
+        {
+            CurrentProcessorAffinity = 0;
+            SnapshotIndex = 0;
+
+            for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++)
+            {
+                OsProcessorId = Os_GetProcessorId(ProcessorIndex);
+
+                while (SnapshotIndex < pCpuidContext->NumberOfSnapshotProcessors && pCpuidContext->pProcessorSnapshot[SnapshotIndex].OsProcessorId < OsProcessorId)
+                {
+                    Capture_ReleaseProcessor(&pCpuidContext->pProcessorSnapshot[SnapshotIndex]);
+                    (*pProcessorsRemoved)++;
+                    SnapshotIndex++;
+                }
+
+                if (SnapshotIndex < pCpuidContext->NumberOfSnapshotProcessors && pCpuidContext->pProcessorSnapshot[SnapshotIndex].OsProcessorId == OsProcessorId)
+                {
+                    if (SnapshotIndex == pCpuidContext->CurrentProcessorAffinity)
+                    {
+                        CurrentProcessorAffinity = ProcessorIndex;
+                    }
+
+                    memcpy(&pProcessorSnapshot[ProcessorIndex], &pCpuidContext->pProcessorSnapshot[SnapshotIndex], sizeof(CPUID_PROCESSOR_SNAPSHOT));
+                    SnapshotIndex++;
+                }
+                else
+                {
+                    (*pProcessorsAdded)++;
+                }
+            }
+
+            while (SnapshotIndex < pCpuidContext->NumberOfSnapshotProcessors)
+            {
+                Capture_ReleaseProcessor(&pCpuidContext->pProcessorSnapshot[SnapshotIndex]);
+                (*pProcessorsRemoved)++;
+                SnapshotIndex++;
+            }
+
+            /*
+             * The leafs of the processors that remain moved to the new snapshot, any 
+             * leafs borrowed from the snapshot storage are still held by it.
+             */
+            free(pCpuidContext->pProcessorSnapshot);
+            pCpuidContext->pProcessorSnapshot = pProcessorSnapshot;
+            pCpuidContext->NumberOfSnapshotProcessors = NumberOfProcessors;
+            pCpuidContext->CurrentProcessorAffinity = CurrentProcessorAffinity;
+
+            for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++)
+            {
+                if (pCpuidContext->pProcessorSnapshot[ProcessorIndex].Captured == BOOL_FALSE && Os_SetAffinity(ProcessorIndex))
+                {
+                    Capture_Internal_CaptureProcessor(ProcessorIndex, pCpuidContext);
+                }
+            }
+
+            SnapshotUpdated = BOOL_TRUE;
+        }
+    }
+
+    return SnapshotUpdated;
+}
+
+
+/*
+ * Capture_Internal_CaptureProcessor
+ *
+ *    The capture worker; this is executed on the processor being captured and
+ *    so it reads the hardware directly.  The worker thread has no CPUID context
+ *    of its own, it fills in the snapshot of the context it is given.
+ *
+ * Arguments:
+ *     Processor Number, CPUID Context
+ *
+ * Return:
+ *     None
+ */
+void Capture_Internal_CaptureProcessor(unsigned int ProcessorNumber, void *pContext)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    CPUID_REGISTERS CpuidRegisters;
+    unsigned int LeafIndex;
+
+    pCpuidContext = (PCPUID_CONTEXT)pContext;
+
+    Os_Platform_Read_Cpuid(0, 0, &CpuidRegisters);
+
+    for (LeafIndex = 0; LeafIndex < NUMBER_OF_CAPTURED_LEAFS; LeafIndex++)
+    {
+        if (g_CapturedLeafs[LeafIndex] <= CpuidRegisters.x.Register.Eax)
+        {
+            Capture_Internal_CaptureLeaf(pCpuidContext, ProcessorNumber, g_CapturedLeafs[LeafIndex]);
+        }
+    }
+
+    Capture_Internal_CompleteProcessor(pCpuidContext, ProcessorNumber);
+}
+
+
+/*
+ * Capture_Internal_CompleteProcessor
+ *
+ *    Marks a processor's snapshot in a CPUID context as complete and caches 
+ *    its APIC ID and OS identity.
+ *
+ * Arguments:
+ *     CPUID Context, Processor Number
+ *
+ * Return:
+ *     None
+ */
+void Capture_Internal_CompleteProcessor(PCPUID_CONTEXT pCpuidContext, unsigned int ProcessorNumber)
+{
+    PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot;
+
+    if (pCpuidContext->pProcessorSnapshot && ProcessorNumber < pCpuidContext->NumberOfSnapshotProcessors)
+    {
+        pProcessorSnapshot = &pCpuidContext->pProcessorSnapshot[ProcessorNumber];
+
+        Capture_Internal_ClampMaximumSubleaf(pProcessorSnapshot);
+        pProcessorSnapshot->Captured = BOOL_TRUE;
+        pProcessorSnapshot->ApicId = Capture_Internal_ComputeApicId(pProcessorSnapshot);
+        pProcessorSnapshot->OsProcessorId = pCpuidContext->UseNativeCpuid ? Os_GetProcessorId(ProcessorNumber) : ProcessorNumber;
+    }
+}
+
+
+/*
+ * Capture_Internal_ClampMaximumSubleaf
+ *
+ *    Limits the maximum subleaf that CPUID.18H subleaf 0 reports in EAX to the 
+ *    subleafs a processor's snapshot holds.  A file could report billions of 
+ *    subleafs that are not stored and the TLB parser reads each one.  The 
+ *    subleafs of CPUID.4 end with the null cache type, which is what a subleaf 
+ *    that is not stored returns, so that leaf needs no limit.
+ *
+ * Arguments:
+ *     Processor Snapshot
+ *
+ * Return:
+ *     None
+ */
+void Capture_Internal_ClampMaximumSubleaf(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot)
+{
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshot;
+
+    pLeafSnapshot = Capture_Internal_FindLeaf(pProcessorSnapshot, 0x18);
+
+    if (pLeafSnapshot && pLeafSnapshot->NumberOfSubleafs) 
+    {
+        if (pLeafSnapshot->pSubleafs[0].x.Register.Eax >= pLeafSnapshot->NumberOfSubleafs) 
+        {
+            pLeafSnapshot->pSubleafs[0].x.Register.Eax = pLeafSnapshot->NumberOfSubleafs - 1;
+        }
+    }
+}
+
+
+/*
+ * Capture_Internal_CaptureLeaf
+ *
+ *    Reads all subleafs of a leaf on the current processor.  The subleafs are
+ *    enumerated the same way as the file and display code, including the
+ *    subleaf that terminates the enumeration.
+ *
+ * Arguments:
+ *     CPUID Context, Processor Number, Leaf
+ *
+ * Return:
+ *     Returns true if the leaf was captured
+ */
+BOOL_TYPE Capture_Internal_CaptureLeaf(PCPUID_CONTEXT pCpuidContext, unsigned int ProcessorNumber, unsigned int Leaf)
+{
+    CPUID_REGISTERS OriginalCpuidRegisters;
+    CPUID_REGISTERS CpuidRegisters;
+    PCPUID_REGISTERS pCpuidReadValues;
+    unsigned int CurrentSubleaf;
+    BOOL_TYPE LeafCaptured;
+    BOOL_TYPE NextSubleaf;
+
+    CurrentSubleaf = 0;
+    pCpuidReadValues = &OriginalCpuidRegisters;
+    LeafCaptured = BOOL_FALSE;
+
+    do {
+
+        Os_Platform_Read_Cpuid(Leaf, CurrentSubleaf, pCpuidReadValues);
+
+        if (ProcessorNumber < pCpuidContext->NumberOfSnapshotProcessors)
+        {
+            LeafCaptured = Capture_SetProcessorCpuid(&pCpuidContext->pProcessorSnapshot[ProcessorNumber], Leaf, CurrentSubleaf, pCpuidReadValues);
+        }
+
+
+        CurrentSubleaf++;
+
+        switch (Leaf)
+        {
+            case 4:
+               NextSubleaf = ((pCpuidReadValues->x.Register.Eax & 0x1F) != 0) ? BOOL_TRUE : BOOL_FALSE;
+               break;
+
+            case 0x18:
+               NextSubleaf = (CurrentSubleaf <= OriginalCpuidRegisters.x.Register.Eax) ? BOOL_TRUE : BOOL_FALSE;
+               break;
+
+            case 0xB:
+            case 0x1F:
+               NextSubleaf = (pCpuidReadValues->x.Register.Ebx != 0) ? BOOL_TRUE : BOOL_FALSE;
+               break;
+
+            default:
+                NextSubleaf = BOOL_FALSE;
+        }
+
+        pCpuidReadValues = &CpuidRegisters;
+
+        /*
+         * The enumeration limit only guards against hardware or a hypervisor that never 
+         * reports the end of the subleafs. 
+         */
+    } while(NextSubleaf && LeafCaptured && CurrentSubleaf < MAX_ENUMERATED_SUBLEAFS);
+
+    return LeafCaptured;
+}
+
+
+/*
+ * Capture_Internal_FindLeaf
+ *
+ *    Finds a leaf in a processor snapshot.
+ *
+ * Arguments:
+ *     Processor Snapshot, Leaf
+ *
+ * Return:
+ *     The leaf snapshot or NULL if the leaf is not held
+ */
+PCPUID_LEAF_SNAPSHOT Capture_Internal_FindLeaf(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot, unsigned int Leaf)
+{
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshot;
+    unsigned int LeafIndex;
+
+    pLeafSnapshot = NULL;
+
+    for (LeafIndex = 0; LeafIndex < pProcessorSnapshot->NumberOfLeafs && pLeafSnapshot == NULL; LeafIndex++)
+    {
+        if (pProcessorSnapshot->pLeafs[LeafIndex].Leaf == Leaf)
+        {
+            pLeafSnapshot = &pProcessorSnapshot->pLeafs[LeafIndex];
+        }
+    }
+
+    return pLeafSnapshot;
+}
+
+
+/*
+ * Capture_Internal_AddLeaf
+ *
+ *    Adds an empty leaf to a processor snapshot.
+ *
+ * Arguments:
+ *     Processor Snapshot, Leaf
+ *
+ * Return:
+ *     The new leaf snapshot or NULL on memory allocation failure
+ */
+PCPUID_LEAF_SNAPSHOT Capture_Internal_AddLeaf(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot, unsigned int Leaf)
+{
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshot;
+    PCPUID_LEAF_SNAPSHOT pLeafs;
+    unsigned int MaximumLeafs;
+
+    pLeafSnapshot = NULL;
+
+    if (pProcessorSnapshot->NumberOfLeafs >= pProcessorSnapshot->MaximumLeafs)
+    {
+        MaximumLeafs = pProcessorSnapshot->MaximumLeafs ? pProcessorSnapshot->MaximumLeafs*2 : NUMBER_OF_CAPTURED_LEAFS;
+
+        while (MaximumLeafs <= pProcessorSnapshot->NumberOfLeafs)
+        {
+            MaximumLeafs = MaximumLeafs*2;
+        }
+
+        if (pProcessorSnapshot->MaximumLeafs)
+        {
+            pLeafs = (PCPUID_LEAF_SNAPSHOT)realloc(pProcessorSnapshot->pLeafs, MaximumLeafs*sizeof(CPUID_LEAF_SNAPSHOT));
+        }
+        else
+        {
+            /*
+             * Leafs borrowed from the snapshot storage are copied before they are changed.
+             */
+            pLeafs = (PCPUID_LEAF_SNAPSHOT)malloc(MaximumLeafs*sizeof(CPUID_LEAF_SNAPSHOT));
+
+            if (pLeafs && pProcessorSnapshot->NumberOfLeafs)
+            {
+                memcpy(pLeafs, pProcessorSnapshot->pLeafs, pProcessorSnapshot->NumberOfLeafs*sizeof(CPUID_LEAF_SNAPSHOT));
+            }
+        }
+
+        if (pLeafs)
+        {
+            pProcessorSnapshot->pLeafs = pLeafs;
+            pProcessorSnapshot->MaximumLeafs = MaximumLeafs;
+        }
+    }
+
+    if (pProcessorSnapshot->NumberOfLeafs < pProcessorSnapshot->MaximumLeafs)
+    {
+        pLeafSnapshot = &pProcessorSnapshot->pLeafs[pProcessorSnapshot->NumberOfLeafs];
+        pProcessorSnapshot->NumberOfLeafs++;
+
+        memset(pLeafSnapshot, 0, sizeof(CPUID_LEAF_SNAPSHOT));
+        pLeafSnapshot->Leaf = Leaf;
+    }
+
+    return pLeafSnapshot;
+}
+
+
+/*
+ * Capture_Internal_ComputeApicId
+ *
+ *    Determines the X2APIC ID of a processor from its snapshot, falling
+ *    back to the legacy 8 bit APIC ID when Leaf 1Fh and Leaf Bh do not
+ *    enumerate topology.
+ *
+ * Arguments:
+ *     Processor Snapshot
+ *
+ * Return:
+ *     APIC ID
+ */
+unsigned int Capture_Internal_ComputeApicId(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot)
+{
+    CPUID_REGISTERS CpuidRegisters;
+    unsigned int MaximumLeaf;
+    unsigned int ApicId;
+    BOOL_TYPE bApicIdFound;
+
+    memset(&CpuidRegisters, 0, sizeof(CPUID_REGISTERS));
+    Capture_Internal_ReadProcessorCpuid(pProcessorSnapshot, 0, 0, &CpuidRegisters);
+    MaximumLeaf = CpuidRegisters.x.Register.Eax;
+
+    ApicId = 0;
+    bApicIdFound = BOOL_FALSE;
+
+    if (MaximumLeaf >= 0x1F && Capture_Internal_ReadProcessorCpuid(pProcessorSnapshot, 0x1F, 0, &CpuidRegisters))
+    {
+        if (CpuidRegisters.x.Register.Ebx != 0)
+        {
+            ApicId = CpuidRegisters.x.Register.Edx;
+            bApicIdFound = BOOL_TRUE;
+        }
+    }
+
+    if (bApicIdFound == BOOL_FALSE && MaximumLeaf >= 0xB && Capture_Internal_ReadProcessorCpuid(pProcessorSnapshot, 0xB, 0, &CpuidRegisters))
+    {
+        if (CpuidRegisters.x.Register.Ebx != 0)
+        {
+            ApicId = CpuidRegisters.x.Register.Edx;
+            bApicIdFound = BOOL_TRUE;
+        }
+    }
+
+    if (bApicIdFound == BOOL_FALSE && Capture_Internal_ReadProcessorCpuid(pProcessorSnapshot, 1, 0, &CpuidRegisters))
+    {
+        /*
+         *  Fall back to Legacy 8 bit APIC ID.
+         */
+        ApicId = (CpuidRegisters.x.Register.Ebx >> 24);
+    }
+
+    return ApicId;
+}
+
+
+/*
+ * Capture_Internal_ReadProcessorCpuid
+ *
+ *    Reads a leaf and subleaf from a processor snapshot.  Subleafs beyond
+ *    those captured return zero, the same as the end of enumeration.
+ *
+ * Arguments:
+ *     Processor Snapshot, Leaf, Subleaf, CPUID Data Structure
+ *
+ * Return:
+ *     Returns true if this leaf is held by the processor snapshot
+ */
+BOOL_TYPE Capture_Internal_ReadProcessorCpuid(PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
+{
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshot;
+    BOOL_TYPE LeafFound;
+
+    LeafFound = BOOL_FALSE;
+
+    pLeafSnapshot = Capture_Internal_FindLeaf(pProcessorSnapshot, Leaf);
+
+    if (pLeafSnapshot)
+    {
+        LeafFound = BOOL_TRUE;
+
+        if (Subleaf < pLeafSnapshot->NumberOfSubleafs)
+        {
+            memcpy(pCpuidRegisters, &pLeafSnapshot->pSubleafs[Subleaf], sizeof(CPUID_REGISTERS));
+        }
+        else
+        {
+            memset(pCpuidRegisters, 0, sizeof(CPUID_REGISTERS));
+        }
+    }
+
+    return LeafFound;
+}
@@ -0,0 +1,1084 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The compressed capture format.  Nearly every processor reports the same leafs as
+ * its siblings, so each distinct leaf is stored once in a dictionary of blocks and
+ * each distinct list of blocks is stored once as a leaf set.  A processor is then
+ * just the index of its leaf set and its APIC ID.  All values are 32 bits except
+ * the processor stream and the offsets are in bytes from the start of the file.
+ *
+ *    COMPRESS_HEADER
+ *    COMPRESS_BLOCK           [NumberOfBlocks]
+ *    CPUID_REGISTERS          [NumberOfSubleafs]
+ *    COMPRESS_LEAF_SET        [NumberOfLeafSets]
+ *    Block Index              [NumberOfLeafSetEntries]
+ *    Processor Stream         [ProcessorStreamSize bytes]
+ *
+ * The processor stream holds the leaf set index and the difference from the previous
+ * APIC ID of each processor, each as a variable length number of 7 bits per byte with
+ * the top bit set when more bytes follow.  The difference is zigzag encoded so small
+ * negative differences are also a single byte.
+ *
+ * The fields that hold the APIC ID, EBX[31:24] of CPUID.1 and EDX of CPUID.B and
+ * CPUID.1F, differ on every processor.  These are stored as zero and the APIC ID
+ * mask of the block marks the subleafs they are rebuilt in from the APIC ID of the
+ * processor, so the block is still shared.
+ */
+#define COMPRESS_SIGNATURE            0x5A495043       /* "CPIZ" */
+#define COMPRESS_VERSION              1
+
+/*
+ * The largest variable length number is 5 bytes for 32 bits.
+ */
+#define COMPRESS_MAXIMUM_NUMBER_SIZE  5
+
+/*
+ * The APIC ID mask only describes the first 32 subleafs of a block.
+ */
+#define COMPRESS_APIC_ID_SUBLEAFS     32
+
+/*
+ * The blocks and leaf sets are found by a 32 bit FNV-1a hash of their contents.
+ */
+#define COMPRESS_OFFSET_BASIS         (2166136261u)
+#define COMPRESS_PRIME                (16777619u)
+
+/*
+ * Rejects files that would expand to more than this in memory.
+ */
+#define COMPRESS_MAXIMUM_STORAGE      (0x40000000ULL)
+
+typedef struct _COMPRESS_HEADER
+{
+    unsigned int Signature;
+    unsigned int Version;
+    unsigned int HeaderSize;
+    unsigned int FileSize;
+
+    unsigned int NumberOfProcessors;
+    unsigned int NumberOfBlocks;
+    unsigned int NumberOfSubleafs;
+    unsigned int NumberOfLeafSets;
+    unsigned int NumberOfLeafSetEntries;
+    unsigned int ProcessorStreamSize;
+
+    unsigned int BlockTableOffset;
+    unsigned int SubleafTableOffset;
+    unsigned int LeafSetTableOffset;
+    unsigned int LeafSetEntryTableOffset;
+    unsigned int ProcessorStreamOffset;
+
+} COMPRESS_HEADER, *PCOMPRESS_HEADER;
+
+typedef struct _COMPRESS_BLOCK
+{
+    unsigned int Leaf;
+    unsigned int FirstSubleaf;
+    unsigned int NumberOfSubleafs;
+    unsigned int ApicIdMask;
+
+} COMPRESS_BLOCK, *PCOMPRESS_BLOCK;
+
+typedef struct _COMPRESS_LEAF_SET
+{
+    unsigned int FirstEntry;
+    unsigned int NumberOfEntries;
+
+} COMPRESS_LEAF_SET, *PCOMPRESS_LEAF_SET;
+
+
+/*
+ * The dictionary as it is built from the snapshot.  The tables are sized for a
+ * snapshot with nothing in common, a candidate is built at the end of its table
+ * and only kept if it is not already in the dictionary.
+ */
+typedef struct _COMPRESS_WRITE_CONTEXT
+{
+    PCOMPRESS_BLOCK pBlocks;
+    unsigned int NumberOfBlocks;
+
+    PCPUID_REGISTERS pSubleafs;
+    unsigned int NumberOfSubleafs;
+
+    PCOMPRESS_LEAF_SET pLeafSets;
+    unsigned int NumberOfLeafSets;
+
+    unsigned int *pLeafSetEntries;
+    unsigned int NumberOfLeafSetEntries;
+
+    unsigned char *pProcessorStream;
+    unsigned int ProcessorStreamSize;
+
+    CPUID_REGISTER_INDEX BlockIndex;
+    CPUID_REGISTER_INDEX LeafSetIndex;
+
+} COMPRESS_WRITE_CONTEXT, *PCOMPRESS_WRITE_CONTEXT;
+
+
+/*
+ * Internal Compressed File APIs
+ */
+BOOL_TYPE Compress_Internal_BuildDictionary(PCOMPRESS_WRITE_CONTEXT pWriteContext, unsigned int NumberOfLeafs, unsigned int NumberOfSubleafs);
+unsigned int Compress_Internal_AddBlock(PCOMPRESS_WRITE_CONTEXT pWriteContext, PCPUID_LEAF_SNAPSHOT pLeafSnapshot, unsigned int ApicId);
+unsigned int Compress_Internal_AddLeafSet(PCOMPRESS_WRITE_CONTEXT pWriteContext, unsigned int NumberOfEntries);
+void Compress_Internal_ReleaseWriteContext(PCOMPRESS_WRITE_CONTEXT pWriteContext);
+BOOL_TYPE Compress_Internal_IsApicIdSubleaf(unsigned int Leaf, PCPUID_REGISTERS pCpuidRegisters, unsigned int ApicId);
+void Compress_Internal_SetApicIdSubleaf(unsigned int Leaf, PCPUID_REGISTERS pCpuidRegisters, unsigned int ApicId);
+unsigned int Compress_Internal_HashValues(unsigned int Hash, unsigned int *pValues, unsigned int NumberOfValues);
+unsigned int Compress_Internal_WriteNumber(unsigned char *pStream, unsigned int Value);
+BOOL_TYPE Compress_Internal_ReadNumber(unsigned char *pStream, unsigned int StreamSize, unsigned int *pOffset, unsigned int *pValue);
+BOOL_TYPE Compress_Internal_ReadProcessor(unsigned char *pStream, unsigned int StreamSize, unsigned int *pOffset, unsigned int *pLeafSetIndex, unsigned int *pApicId);
+BOOL_TYPE Compress_Internal_IsTableValid(unsigned int FileSize, unsigned int TableOffset, unsigned int NumberOfEntries, unsigned int EntrySize);
+BOOL_TYPE Compress_Internal_IsRangeValid(unsigned int First, unsigned int Count, unsigned int Total);
+
+
+
+/*
+ * Compress_IsCompressedFile
+ *
+ *    Checks if the file starts with the compressed capture signature.
+ *
+ * Arguments:
+ *     File Name
+ *
+ * Return:
+ *     Returns true if this is a compressed capture
+ */
+BOOL_TYPE Compress_IsCompressedFile(char *pszFileName)
+{
+    FILE *CpuidFile;
+    unsigned int Signature;
+    BOOL_TYPE CompressedFile;
+
+    CompressedFile = BOOL_FALSE;
+
+    CpuidFile = fopen(pszFileName, "rb");
+
+    if (CpuidFile)
+    {
+        if (fread(&Signature, sizeof(Signature), 1, CpuidFile) == 1 && Signature == COMPRESS_SIGNATURE)
+        {
+            CompressedFile = BOOL_TRUE;
+        }
+
+        fclose(CpuidFile);
+    }
+
+    return CompressedFile;
+}
+
+
+/*
+ * Compress_WriteCpuidToFile
+ *
+ *    Writes the CPUID snapshot of every processor to a compressed capture.  The
+ *    dictionary is built with the same register index the cache and TLB parsers
+ *    use to find matching subleafs, and the file is written with a single write.
+ *
+ * Arguments:
+ *     File Name
+ *
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE Compress_WriteCpuidToFile(char *pszFileName)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    COMPRESS_WRITE_CONTEXT WriteContext;
+    PCOMPRESS_HEADER pHeader;
+    PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot;
+    unsigned char *pImage;
+    unsigned int NumberOfLeafs;
+    unsigned int NumberOfSubleafs;
+    unsigned int ProcessorIndex;
+    unsigned int LeafIndex;
+    FILE *CpuidFile;
+    size_t FileSize;
+    BOOL_TYPE FileWritten;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    FileWritten = BOOL_FALSE;
+
+    memset(&WriteContext, 0, sizeof(COMPRESS_WRITE_CONTEXT));
+
+    Capture_CaptureProcessors();
+
+    if (pCpuidContext->pProcessorSnapshot)
+    {
+        NumberOfLeafs = 0;
+        NumberOfSubleafs = 0;
+
+        for (ProcessorIndex = 0; ProcessorIndex < pCpuidContext->NumberOfSnapshotProcessors; ProcessorIndex++)
+        {
+            pProcessorSnapshot = &pCpuidContext->pProcessorSnapshot[ProcessorIndex];
+            NumberOfLeafs = NumberOfLeafs + pProcessorSnapshot->NumberOfLeafs;
+
+            for (LeafIndex = 0; LeafIndex < pProcessorSnapshot->NumberOfLeafs; LeafIndex++)
+            {
+                NumberOfSubleafs = NumberOfSubleafs + pProcessorSnapshot->pLeafs[LeafIndex].NumberOfSubleafs;
+            }
+        }
+
+        if (Compress_Internal_BuildDictionary(&WriteContext, NumberOfLeafs, NumberOfSubleafs))
+        {
+            FileSize = sizeof(COMPRESS_HEADER) + WriteContext.NumberOfBlocks*sizeof(COMPRESS_BLOCK) + WriteContext.NumberOfSubleafs*sizeof(CPUID_REGISTERS) +
+                       WriteContext.NumberOfLeafSets*sizeof(COMPRESS_LEAF_SET) + WriteContext.NumberOfLeafSetEntries*sizeof(unsigned int) + WriteContext.ProcessorStreamSize;
+
+            pImage = (unsigned char *)calloc(1, FileSize);
+
+            if (pImage)
+            {
+                pHeader = (PCOMPRESS_HEADER)pImage;
+
+                pHeader->Signature               = COMPRESS_SIGNATURE;
+                pHeader->Version                 = COMPRESS_VERSION;
+                pHeader->HeaderSize              = sizeof(COMPRESS_HEADER);
+                pHeader->FileSize                = (unsigned int)FileSize;
+                pHeader->NumberOfProcessors      = pCpuidContext->NumberOfSnapshotProcessors;
+                pHeader->NumberOfBlocks          = WriteContext.NumberOfBlocks;
+                pHeader->NumberOfSubleafs        = WriteContext.NumberOfSubleafs;
+                pHeader->NumberOfLeafSets        = WriteContext.NumberOfLeafSets;
+                pHeader->NumberOfLeafSetEntries  = WriteContext.NumberOfLeafSetEntries;
+                pHeader->ProcessorStreamSize     = WriteContext.ProcessorStreamSize;
+                pHeader->BlockTableOffset        = sizeof(COMPRESS_HEADER);
+                pHeader->SubleafTableOffset      = pHeader->BlockTableOffset + pHeader->NumberOfBlocks*sizeof(COMPRESS_BLOCK);
+                pHeader->LeafSetTableOffset      = pHeader->SubleafTableOffset + pHeader->NumberOfSubleafs*sizeof(CPUID_REGISTERS);
+                pHeader->LeafSetEntryTableOffset = pHeader->LeafSetTableOffset + pHeader->NumberOfLeafSets*sizeof(COMPRESS_LEAF_SET);
+                pHeader->ProcessorStreamOffset   = pHeader->LeafSetEntryTableOffset + pHeader->NumberOfLeafSetEntries*sizeof(unsigned int);
+
+                memcpy(pImage + pHeader->BlockTableOffset, WriteContext.pBlocks, pHeader->NumberOfBlocks*sizeof(COMPRESS_BLOCK));
+                memcpy(pImage + pHeader->SubleafTableOffset, WriteContext.pSubleafs, pHeader->NumberOfSubleafs*sizeof(CPUID_REGISTERS));
+                memcpy(pImage + pHeader->LeafSetTableOffset, WriteContext.pLeafSets, pHeader->NumberOfLeafSets*sizeof(COMPRESS_LEAF_SET));
+                memcpy(pImage + pHeader->LeafSetEntryTableOffset, WriteContext.pLeafSetEntries, pHeader->NumberOfLeafSetEntries*sizeof(unsigned int));
+                memcpy(pImage + pHeader->ProcessorStreamOffset, WriteContext.pProcessorStream, pHeader->ProcessorStreamSize);
+
+                CpuidFile = fopen(pszFileName, "wb");
+
+                if (CpuidFile)
+                {
+                    if (fwrite(pImage, FileSize, 1, CpuidFile) == 1)
+                    {
+                        FileWritten = BOOL_TRUE;
+
+                        if (pCpuidContext->QuietFileEcho == BOOL_FALSE)
+                        {
+                            printf("Compressed CPUID version %u, %u processors, %u unique leafs in %u leaf sets, %u bytes\n", COMPRESS_VERSION, pHeader->NumberOfProcessors, pHeader->NumberOfBlocks, pHeader->NumberOfLeafSets, pHeader->FileSize);
+                        }
+                    }
+
+                    fclose(CpuidFile);
+                }
+
+                free(pImage);
+            }
+        }
+
+        Compress_Internal_ReleaseWriteContext(&WriteContext);
+    }
+
+    return FileWritten;
+}
+
+
+/*
+ * Compress_Internal_BuildDictionary
+ *
+ *    Builds the blocks, leaf sets and the processor stream from the snapshot.
+ *
+ * Arguments:
+ *     Write Context, Number of Leafs and Subleafs in the snapshot
+ *
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE Compress_Internal_BuildDictionary(PCOMPRESS_WRITE_CONTEXT pWriteContext, unsigned int NumberOfLeafs, unsigned int NumberOfSubleafs)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot;
+    unsigned int ProcessorIndex;
+    unsigned int LeafIndex;
+    unsigned int BlockIndex;
+    unsigned int LeafSetIndex;
+    unsigned int PreviousApicId;
+    unsigned int ApicIdDelta;
+    BOOL_TYPE DictionaryBuilt;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    DictionaryBuilt = BOOL_FALSE;
+
+    pWriteContext->pBlocks          = (PCOMPRESS_BLOCK)malloc((NumberOfLeafs + 1)*sizeof(COMPRESS_BLOCK));
+    pWriteContext->pSubleafs        = (PCPUID_REGISTERS)malloc((NumberOfSubleafs + 1)*sizeof(CPUID_REGISTERS));
+    pWriteContext->pLeafSets        = (PCOMPRESS_LEAF_SET)malloc(pCpuidContext->NumberOfSnapshotProcessors*sizeof(COMPRESS_LEAF_SET));
+    pWriteContext->pLeafSetEntries  = (unsigned int *)malloc((NumberOfLeafs + 1)*sizeof(unsigned int));
+    pWriteContext->pProcessorStream = (unsigned char *)malloc(pCpuidContext->NumberOfSnapshotProcessors*2*COMPRESS_MAXIMUM_NUMBER_SIZE);
+
+    if (pWriteContext->pBlocks && pWriteContext->pSubleafs && pWriteContext->pLeafSets && pWriteContext->pLeafSetEntries && pWriteContext->pProcessorStream &&
+        Tools_CreateRegisterIndex(&pWriteContext->BlockIndex, 64) && Tools_CreateRegisterIndex(&pWriteContext->LeafSetIndex, 16))
+    {
+        DictionaryBuilt = BOOL_TRUE;
+        PreviousApicId = 0;
+
+        for (ProcessorIndex = 0; ProcessorIndex < pCpuidContext->NumberOfSnapshotProcessors && DictionaryBuilt; ProcessorIndex++)
+        {
+            pProcessorSnapshot = &pCpuidContext->pProcessorSnapshot[ProcessorIndex];
+
+            /*
+             * The processor's block indices are built as a candidate leaf set.
+             */
+            for (LeafIndex = 0; LeafIndex < pProcessorSnapshot->NumberOfLeafs && DictionaryBuilt; LeafIndex++)
+            {
+                BlockIndex = Compress_Internal_AddBlock(pWriteContext, &pProcessorSnapshot->pLeafs[LeafIndex], pProcessorSnapshot->ApicId);
+                pWriteContext->pLeafSetEntries[pWriteContext->NumberOfLeafSetEntries + LeafIndex] = BlockIndex;
+
+                if (BlockIndex == INVALID_REGISTER_INDEX)
+                {
+                    DictionaryBuilt = BOOL_FALSE;
+                }
+            }
+
+            if (DictionaryBuilt)
+            {
+                LeafSetIndex = Compress_Internal_AddLeafSet(pWriteContext, pProcessorSnapshot->NumberOfLeafs);
+
+                if (LeafSetIndex == INVALID_REGISTER_INDEX)
+                {
+                    DictionaryBuilt = BOOL_FALSE;
+                }
+                else
+                {
+                    ApicIdDelta = pProcessorSnapshot->ApicId - PreviousApicId;
+                    ApicIdDelta = (ApicIdDelta << 1) ^ (0u - (ApicIdDelta >> 31));
+                    PreviousApicId = pProcessorSnapshot->ApicId;
+
+                    pWriteContext->ProcessorStreamSize += Compress_Internal_WriteNumber(&pWriteContext->pProcessorStream[pWriteContext->ProcessorStreamSize], LeafSetIndex);
+                    pWriteContext->ProcessorStreamSize += Compress_Internal_WriteNumber(&pWriteContext->pProcessorStream[pWriteContext->ProcessorStreamSize], ApicIdDelta);
+                }
+            }
+        }
+    }
+
+    return DictionaryBuilt;
+}
+
+
+/*
+ * Compress_Internal_AddBlock
+ *
+ *    Finds a leaf in the dictionary with the APIC ID fields removed, or adds it
+ *    if this is the first processor to report it.
+ *
+ * Arguments:
+ *     Write Context, Leaf Snapshot, APIC ID of the processor
+ *
+ * Return:
+ *     The block index or INVALID_REGISTER_INDEX on memory allocation failure
+ */
+unsigned int Compress_Internal_AddBlock(PCOMPRESS_WRITE_CONTEXT pWriteContext, PCPUID_LEAF_SNAPSHOT pLeafSnapshot, unsigned int ApicId)
+{
+    COMPRESS_BLOCK Block;
+    CPUID_REGISTERS KeyRegisters;
+    PCPUID_REGISTERS pCandidate;
+    PCOMPRESS_BLOCK pFoundBlock;
+    unsigned int Subleaf;
+    unsigned int Hash;
+    unsigned int BlockIndex;
+
+    pCandidate = &pWriteContext->pSubleafs[pWriteContext->NumberOfSubleafs];
+    memcpy(pCandidate, pLeafSnapshot->pSubleafs, pLeafSnapshot->NumberOfSubleafs*sizeof(CPUID_REGISTERS));
+
+    Block.Leaf             = pLeafSnapshot->Leaf;
+    Block.FirstSubleaf     = pWriteContext->NumberOfSubleafs;
+    Block.NumberOfSubleafs = pLeafSnapshot->NumberOfSubleafs;
+    Block.ApicIdMask       = 0;
+
+    for (Subleaf = 0; Subleaf < Block.NumberOfSubleafs && Subleaf < COMPRESS_APIC_ID_SUBLEAFS; Subleaf++)
+    {
+        if (Compress_Internal_IsApicIdSubleaf(Block.Leaf, &pCandidate[Subleaf], ApicId))
+        {
+            Compress_Internal_SetApicIdSubleaf(Block.Leaf, &pCandidate[Subleaf], 0);
+            Block.ApicIdMask = Block.ApicIdMask | (1u << Subleaf);
+        }
+    }
+
+    memset(&KeyRegisters, 0, sizeof(CPUID_REGISTERS));
+
+    if (Block.NumberOfSubleafs)
+    {
+        memcpy(&KeyRegisters, pCandidate, sizeof(CPUID_REGISTERS));
+    }
+
+    Hash = Compress_Internal_HashValues(COMPRESS_OFFSET_BASIS, &Block.Leaf, 1);
+    Hash = Compress_Internal_HashValues(Hash, &Block.NumberOfSubleafs, 1);
+    Hash = Compress_Internal_HashValues(Hash, &Block.ApicIdMask, 1);
+    Hash = Compress_Internal_HashValues(Hash, &pCandidate->x.Registers[0], Block.NumberOfSubleafs*4);
+
+    BlockIndex = Tools_FindRegisterIndex(&pWriteContext->BlockIndex, Hash, &KeyRegisters);
+
+    /*
+     * The index only keys the hash and the first subleaf, so the block found must
+     * be compared.  A block that only shares the key is added without being indexed.
+     */
+    if (BlockIndex != INVALID_REGISTER_INDEX)
+    {
+        pFoundBlock = &pWriteContext->pBlocks[BlockIndex];
+
+        if (pFoundBlock->Leaf != Block.Leaf || pFoundBlock->NumberOfSubleafs != Block.NumberOfSubleafs || pFoundBlock->ApicIdMask != Block.ApicIdMask ||
+            memcmp(&pWriteContext->pSubleafs[pFoundBlock->FirstSubleaf], pCandidate, Block.NumberOfSubleafs*sizeof(CPUID_REGISTERS)) != 0)
+        {
+            BlockIndex = pWriteContext->NumberOfBlocks;
+            pWriteContext->pBlocks[BlockIndex] = Block;
+            pWriteContext->NumberOfBlocks++;
+            pWriteContext->NumberOfSubleafs = pWriteContext->NumberOfSubleafs + Block.NumberOfSubleafs;
+        }
+    }
+    else
+    {
+        BlockIndex = pWriteContext->NumberOfBlocks;
+
+        if (Tools_InsertRegisterIndex(&pWriteContext->BlockIndex, Hash, &KeyRegisters, BlockIndex))
+        {
+            pWriteContext->pBlocks[BlockIndex] = Block;
+            pWriteContext->NumberOfBlocks++;
+            pWriteContext->NumberOfSubleafs = pWriteContext->NumberOfSubleafs + Block.NumberOfSubleafs;
+        }
+        else
+        {
+            BlockIndex = INVALID_REGISTER_INDEX;
+        }
+    }
+
+    return BlockIndex;
+}
+
+
+/*
+ * Compress_Internal_AddLeafSet
+ *
+ *    Finds the candidate leaf set at the end of the leaf set entries in the
+ *    dictionary, or adds it if this is the first processor with these blocks.
+ *
+ * Arguments:
+ *     Write Context, Number of Entries in the candidate
+ *
+ * Return:
+ *     The leaf set index or INVALID_REGISTER_INDEX on memory allocation failure
+ */
+unsigned int Compress_Internal_AddLeafSet(PCOMPRESS_WRITE_CONTEXT pWriteContext, unsigned int NumberOfEntries)
+{
+    CPUID_REGISTERS KeyRegisters;
+    PCOMPRESS_LEAF_SET pFoundLeafSet;
+    unsigned int *pCandidate;
+    unsigned int Hash;
+    unsigned int LeafSetIndex;
+    BOOL_TYPE AddLeafSet;
+
+    pCandidate = &pWriteContext->pLeafSetEntries[pWriteContext->NumberOfLeafSetEntries];
+
+    memset(&KeyRegisters, 0, sizeof(CPUID_REGISTERS));
+    KeyRegisters.x.Register.Eax = NumberOfEntries;
+
+    if (NumberOfEntries)
+    {
+        KeyRegisters.x.Register.Ebx = pCandidate[0];
+        KeyRegisters.x.Register.Ecx = pCandidate[NumberOfEntries - 1];
+    }
+
+    Hash = Compress_Internal_HashValues(COMPRESS_OFFSET_BASIS, pCandidate, NumberOfEntries);
+
+    LeafSetIndex = Tools_FindRegisterIndex(&pWriteContext->LeafSetIndex, Hash, &KeyRegisters);
+    AddLeafSet = BOOL_FALSE;
+
+    if (LeafSetIndex != INVALID_REGISTER_INDEX)
+    {
+        pFoundLeafSet = &pWriteContext->pLeafSets[LeafSetIndex];
+
+        if (pFoundLeafSet->NumberOfEntries != NumberOfEntries ||
+            memcmp(&pWriteContext->pLeafSetEntries[pFoundLeafSet->FirstEntry], pCandidate, NumberOfEntries*sizeof(unsigned int)) != 0)
+        {
+            LeafSetIndex = pWriteContext->NumberOfLeafSets;
+            AddLeafSet = BOOL_TRUE;
+        }
+    }
+    else
+    {
+        LeafSetIndex = pWriteContext->NumberOfLeafSets;
+
+        if (Tools_InsertRegisterIndex(&pWriteContext->LeafSetIndex, Hash, &KeyRegisters, LeafSetIndex))
+        {
+            AddLeafSet = BOOL_TRUE;
+        }
+        else
+        {
+            LeafSetIndex = INVALID_REGISTER_INDEX;
+        }
+    }
+
+    if (AddLeafSet)
+    {
+        pWriteContext->pLeafSets[LeafSetIndex].FirstEntry      = pWriteContext->NumberOfLeafSetEntries;
+        pWriteContext->pLeafSets[LeafSetIndex].NumberOfEntries = NumberOfEntries;
+        pWriteContext->NumberOfLeafSets++;
+        pWriteContext->NumberOfLeafSetEntries = pWriteContext->NumberOfLeafSetEntries + NumberOfEntries;
+    }
+
+    return LeafSetIndex;
+}
+
+
+/*
+ * Compress_Internal_ReleaseWriteContext
+ *
+ *    Frees the dictionary that was built.
+ *
+ * Arguments:
+ *     Write Context
+ *
+ * Return:
+ *     None
+ */
+void Compress_Internal_ReleaseWriteContext(PCOMPRESS_WRITE_CONTEXT pWriteContext)
+{
+    if (pWriteContext->BlockIndex.pSlots)
+    {
+        Tools_DestroyRegisterIndex(&pWriteContext->BlockIndex);
+    }
+
+    if (pWriteContext->LeafSetIndex.pSlots)
+    {
+        Tools_DestroyRegisterIndex(&pWriteContext->LeafSetIndex);
+    }
+
+    free(pWriteContext->pBlocks);
+    free(pWriteContext->pSubleafs);
+    free(pWriteContext->pLeafSets);
+    free(pWriteContext->pLeafSetEntries);
+    free(pWriteContext->pProcessorStream);
+
+    memset(pWriteContext, 0, sizeof(COMPRESS_WRITE_CONTEXT));
+}
+
+
+/*
+ * Compress_ReadCpuidFromFile
+ *
+ *    Loads a compressed capture.  The whole file is read into one block and the
+ *    processors borrow the shared blocks in place, so a block reported by every
+ *    processor is held once.  Only the blocks that hold the APIC ID are copied
+ *    for each processor to rebuild it.
+ *
+ * Arguments:
+ *     File Name
+ *
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE Compress_ReadCpuidFromFile(char *pszFileName)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    COMPRESS_HEADER Header;
+    PCOMPRESS_BLOCK pBlocks;
+    PCOMPRESS_BLOCK pBlock;
+    PCOMPRESS_LEAF_SET pLeafSets;
+    PCPUID_REGISTERS pSubleafs;
+    PCPUID_REGISTERS pProcessorSubleafs;
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshots;
+    unsigned int *pLeafSetEntries;
+    unsigned char *pProcessorStream;
+    unsigned char *pImage;
+    unsigned char *pStorage;
+    unsigned long long NumberOfLeafSnapshots;
+    unsigned long long NumberOfProcessorSubleafs;
+    unsigned int ImageSize;
+    unsigned int Index;
+    unsigned int EntryIndex;
+    unsigned int Subleaf;
+    unsigned int StreamOffset;
+    unsigned int LeafSetIndex;
+    unsigned int ApicId;
+    FILE *CpuidFile;
+    long FileSize;
+    BOOL_TYPE FileReadStatus;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    FileReadStatus = BOOL_FALSE;
+    pImage = NULL;
+    ImageSize = 0;
+
+    Capture_ReleaseSnapshot();
+
+    CpuidFile = fopen(pszFileName, "rb");
+
+    if (CpuidFile)
+    {
+        fseek(CpuidFile, 0, SEEK_END);
+        FileSize = ftell(CpuidFile);
+        fseek(CpuidFile, 0, SEEK_SET);
+
+        if (fread(&Header, sizeof(COMPRESS_HEADER), 1, CpuidFile) == 1)
+        {
+            FileReadStatus = BOOL_TRUE;
+
+            if (Header.Version != COMPRESS_VERSION || Header.HeaderSize < sizeof(COMPRESS_HEADER))
+            {
+                printf("Unsupported compressed CPUID file version %u\n", Header.Version);
+                FileReadStatus = BOOL_FALSE;
+            }
+        }
+
+        /*
+         * Every table must be within the file before anything is used.
+         */
+        if (FileReadStatus)
+        {
+            if ((long)Header.FileSize != FileSize || Header.NumberOfProcessors == 0 ||
+                Compress_Internal_IsTableValid(Header.FileSize, Header.BlockTableOffset, Header.NumberOfBlocks, sizeof(COMPRESS_BLOCK)) == BOOL_FALSE ||
+                Compress_Internal_IsTableValid(Header.FileSize, Header.SubleafTableOffset, Header.NumberOfSubleafs, sizeof(CPUID_REGISTERS)) == BOOL_FALSE ||
+                Compress_Internal_IsTableValid(Header.FileSize, Header.LeafSetTableOffset, Header.NumberOfLeafSets, sizeof(COMPRESS_LEAF_SET)) == BOOL_FALSE ||
+                Compress_Internal_IsTableValid(Header.FileSize, Header.LeafSetEntryTableOffset, Header.NumberOfLeafSetEntries, sizeof(unsigned int)) == BOOL_FALSE ||
+                Header.ProcessorStreamOffset < sizeof(COMPRESS_HEADER) || Compress_Internal_IsRangeValid(Header.ProcessorStreamOffset, Header.ProcessorStreamSize, Header.FileSize) == BOOL_FALSE)
+            {
+                printf("Compressed CPUID file is corrupt\n");
+                FileReadStatus = BOOL_FALSE;
+            }
+        }
+
+        if (FileReadStatus)
+        {
+            ImageSize = (Header.FileSize + 15) & ~15;
+            pImage = (unsigned char *)malloc(ImageSize);
+            FileReadStatus = BOOL_FALSE;
+
+            if (pImage)
+            {
+                fseek(CpuidFile, 0, SEEK_SET);
+
+                if (fread(pImage, Header.FileSize, 1, CpuidFile) == 1)
+                {
+                    FileReadStatus = BOOL_TRUE;
+                }
+            }
+        }
+
+        fclose(CpuidFile);
+        CpuidFile = NULL;
+    }
+
+    /*
+     * The dictionary is checked and the processor stream is decoded once to size the
+     * leaf tables of the processors and the blocks that are rebuilt for each of them.
+     */
+    NumberOfLeafSnapshots = 0;
+    NumberOfProcessorSubleafs = 0;
+
+    if (FileReadStatus)
+    {
+        pBlocks          = (PCOMPRESS_BLOCK)(pImage + Header.BlockTableOffset);
+        pLeafSets        = (PCOMPRESS_LEAF_SET)(pImage + Header.LeafSetTableOffset);
+        pLeafSetEntries  = (unsigned int *)(pImage + Header.LeafSetEntryTableOffset);
+        pProcessorStream = pImage + Header.ProcessorStreamOffset;
+
+        for (Index = 0; Index < Header.NumberOfBlocks && FileReadStatus; Index++)
+        {
+            FileReadStatus = Compress_Internal_IsRangeValid(pBlocks[Index].FirstSubleaf, pBlocks[Index].NumberOfSubleafs, Header.NumberOfSubleafs);
+        }
+
+        for (Index = 0; Index < Header.NumberOfLeafSets && FileReadStatus; Index++)
+        {
+            FileReadStatus = Compress_Internal_IsRangeValid(pLeafSets[Index].FirstEntry, pLeafSets[Index].NumberOfEntries, Header.NumberOfLeafSetEntries);
+        }
+
+        for (Index = 0; Index < Header.NumberOfLeafSetEntries && FileReadStatus; Index++)
+        {
+            if (pLeafSetEntries[Index] >= Header.NumberOfBlocks)
+            {
+                FileReadStatus = BOOL_FALSE;
+            }
+        }
+
+        StreamOffset = 0;
+        ApicId = 0;
+
+        for (Index = 0; Index < Header.NumberOfProcessors && FileReadStatus; Index++)
+        {
+            FileReadStatus = Compress_Internal_ReadProcessor(pProcessorStream, Header.ProcessorStreamSize, &StreamOffset, &LeafSetIndex, &ApicId);
+
+            if (FileReadStatus && LeafSetIndex < Header.NumberOfLeafSets)
+            {
+                NumberOfLeafSnapshots = NumberOfLeafSnapshots + pLeafSets[LeafSetIndex].NumberOfEntries;
+
+                for (EntryIndex = 0; EntryIndex < pLeafSets[LeafSetIndex].NumberOfEntries; EntryIndex++)
+                {
+                    pBlock = &pBlocks[pLeafSetEntries[pLeafSets[LeafSetIndex].FirstEntry + EntryIndex]];
+
+                    if (pBlock->ApicIdMask)
+                    {
+                        NumberOfProcessorSubleafs = NumberOfProcessorSubleafs + pBlock->NumberOfSubleafs;
+                    }
+                }
+            }
+            else
+            {
+                FileReadStatus = BOOL_FALSE;
+            }
+        }
+
+        if (FileReadStatus && NumberOfLeafSnapshots*sizeof(CPUID_LEAF_SNAPSHOT) + NumberOfProcessorSubleafs*sizeof(CPUID_REGISTERS) > COMPRESS_MAXIMUM_STORAGE)
+        {
+            FileReadStatus = BOOL_FALSE;
+        }
+
+        if (FileReadStatus == BOOL_FALSE)
+        {
+            printf("Compressed CPUID file is corrupt\n");
+        }
+    }
+
+    if (FileReadStatus)
+    {
+        pStorage = (unsigned char *)realloc(pImage, ImageSize + (size_t)(NumberOfLeafSnapshots*sizeof(CPUID_LEAF_SNAPSHOT) + NumberOfProcessorSubleafs*sizeof(CPUID_REGISTERS)));
+
+        if (pStorage)
+        {
+            pImage = pStorage;
+            FileReadStatus = Capture_AllocateSnapshot(Header.NumberOfProcessors);
+        }
+        else
+        {
+            FileReadStatus = BOOL_FALSE;
+        }
+    }
+
+    if (FileReadStatus)
+    {
+        pBlocks            = (PCOMPRESS_BLOCK)(pImage + Header.BlockTableOffset);
+        pSubleafs          = (PCPUID_REGISTERS)(pImage + Header.SubleafTableOffset);
+        pLeafSets          = (PCOMPRESS_LEAF_SET)(pImage + Header.LeafSetTableOffset);
+        pLeafSetEntries    = (unsigned int *)(pImage + Header.LeafSetEntryTableOffset);
+        pProcessorStream   = pImage + Header.ProcessorStreamOffset;
+        pLeafSnapshots     = (PCPUID_LEAF_SNAPSHOT)(pImage + ImageSize);
+        pProcessorSubleafs = (PCPUID_REGISTERS)(pLeafSnapshots + NumberOfLeafSnapshots);
+
+        Capture_AdoptSnapshotStorage(pImage);
+        pImage = NULL;
+
+        StreamOffset = 0;
+        ApicId = 0;
+
+        for (Index = 0; Index < Header.NumberOfProcessors; Index++)
+        {
+            Compress_Internal_ReadProcessor(pProcessorStream, Header.ProcessorStreamSize, &StreamOffset, &LeafSetIndex, &ApicId);
+
+            for (EntryIndex = 0; EntryIndex < pLeafSets[LeafSetIndex].NumberOfEntries; EntryIndex++)
+            {
+                pBlock = &pBlocks[pLeafSetEntries[pLeafSets[LeafSetIndex].FirstEntry + EntryIndex]];
+
+                pLeafSnapshots[EntryIndex].Leaf             = pBlock->Leaf;
+                pLeafSnapshots[EntryIndex].NumberOfSubleafs = pBlock->NumberOfSubleafs;
+                pLeafSnapshots[EntryIndex].MaximumSubleafs  = 0;
+                pLeafSnapshots[EntryIndex].pSubleafs        = &pSubleafs[pBlock->FirstSubleaf];
+
+                if (pBlock->ApicIdMask)
+                {
+                    memcpy(pProcessorSubleafs, &pSubleafs[pBlock->FirstSubleaf], pBlock->NumberOfSubleafs*sizeof(CPUID_REGISTERS));
+
+                    for (Subleaf = 0; Subleaf < pBlock->NumberOfSubleafs && Subleaf < COMPRESS_APIC_ID_SUBLEAFS; Subleaf++)
+                    {
+                        if (pBlock->ApicIdMask & (1u << Subleaf))
+                        {
+                            Compress_Internal_SetApicIdSubleaf(pBlock->Leaf, &pProcessorSubleafs[Subleaf], ApicId);
+                        }
+                    }
+
+                    pLeafSnapshots[EntryIndex].pSubleafs = pProcessorSubleafs;
+                    pProcessorSubleafs = pProcessorSubleafs + pBlock->NumberOfSubleafs;
+                }
+            }
+
+            Capture_AttachProcessorLeafs(Index, pLeafSnapshots, pLeafSets[LeafSetIndex].NumberOfEntries, ApicId);
+            pLeafSnapshots = pLeafSnapshots + pLeafSets[LeafSetIndex].NumberOfEntries;
+        }
+
+        if (pCpuidContext->QuietFileEcho == BOOL_FALSE)
+        {
+            printf("Compressed CPUID version %u, %u processors, %u unique leafs in %u leaf sets\n", Header.Version, Header.NumberOfProcessors, Header.NumberOfBlocks, Header.NumberOfLeafSets);
+        }
+    }
+
+    if (pImage)
+    {
+        free(pImage);
+        pImage = NULL;
+    }
+
+    return FileReadStatus;
+}
+
+
+/*
+ * Compress_Internal_IsApicIdSubleaf
+ *
+ *    Checks if the subleaf holds the APIC ID of the processor in the field that
+ *    is rebuilt when the file is loaded.
+ *
+ * Arguments:
+ *     Leaf, CPUID Data Structure, APIC ID
+ *
+ * Return:
+ *     Returns true if the field holds the APIC ID
+ */
+BOOL_TYPE Compress_Internal_IsApicIdSubleaf(unsigned int Leaf, PCPUID_REGISTERS pCpuidRegisters, unsigned int ApicId)
+{
+    BOOL_TYPE ApicIdSubleaf;
+
+    ApicIdSubleaf = BOOL_FALSE;
+
+    switch (Leaf)
+    {
+        case 0x1:
+             if ((pCpuidRegisters->x.Register.Ebx >> 24) == (ApicId & 0xFF))
+             {
+                 ApicIdSubleaf = BOOL_TRUE;
+             }
+             break;
+
+        case 0xB:
+        case 0x1F:
+             if (pCpuidRegisters->x.Register.Edx == ApicId)
+             {
+                 ApicIdSubleaf = BOOL_TRUE;
+             }
+             break;
+    }
+
+    return ApicIdSubleaf;
+}
+
+
+/*
+ * Compress_Internal_SetApicIdSubleaf
+ *
+ *    Places the APIC ID in the field of the subleaf that holds it.
+ *
+ * Arguments:
+ *     Leaf, CPUID Data Structure, APIC ID
+ *
+ * Return:
+ *     None
+ */
+void Compress_Internal_SetApicIdSubleaf(unsigned int Leaf, PCPUID_REGISTERS pCpuidRegisters, unsigned int ApicId)
+{
+    switch (Leaf)
+    {
+        case 0x1:
+             pCpuidRegisters->x.Register.Ebx = (pCpuidRegisters->x.Register.Ebx & 0x00FFFFFF) | ((ApicId & 0xFF) << 24);
+             break;
+
+        case 0xB:
+        case 0x1F:
+             pCpuidRegisters->x.Register.Edx = ApicId;
+             break;
+    }
+}
+
+
+/*
+ * Compress_Internal_HashValues
+ *
+ *    Continues the FNV-1a hash over a list of values.
+ *
+ * Arguments:
+ *     Hash so far, Values, Number of Values
+ *
+ * Return:
+ *     Hash value
+ */
+unsigned int Compress_Internal_HashValues(unsigned int Hash, unsigned int *pValues, unsigned int NumberOfValues)
+{
+    unsigned int Index;
+
+    for (Index = 0; Index < NumberOfValues; Index++)
+    {
+        Hash = Hash ^ pValues[Index];
+        Hash = Hash * COMPRESS_PRIME;
+    }
+
+    return Hash;
+}
+
+
+/*
+ * Compress_Internal_WriteNumber
+ *
+ *    Writes a variable length number to the processor stream.
+ *
+ * Arguments:
+ *     Stream position with room for the largest number, Value
+ *
+ * Return:
+ *     The number of bytes written
+ */
+unsigned int Compress_Internal_WriteNumber(unsigned char *pStream, unsigned int Value)
+{
+    unsigned int NumberOfBytes;
+
+    NumberOfBytes = 0;
+
+    while (Value >= 0x80)
+    {
+        pStream[NumberOfBytes] = (unsigned char)((Value & 0x7F) | 0x80);
+        Value = Value >> 7;
+        NumberOfBytes++;
+    }
+
+    pStream[NumberOfBytes] = (unsigned char)Value;
+    NumberOfBytes++;
+
+    return NumberOfBytes;
+}
+
+
+/*
+ * Compress_Internal_ReadNumber
+ *
+ *    Reads a variable length number from the processor stream.
+ *
+ * Arguments:
+ *     Stream, Stream Size, Offset to read from and advance, Returned Value
+ *
+ * Return:
+ *     Returns true if a complete number was within the stream
+ */
+BOOL_TYPE Compress_Internal_ReadNumber(unsigned char *pStream, unsigned int StreamSize, unsigned int *pOffset, unsigned int *pValue)
+{
+    unsigned int NumberOfBytes;
+    unsigned int Value;
+    BOOL_TYPE NumberRead;
+    BOOL_TYPE MoreBytes;
+
+    NumberRead = BOOL_FALSE;
+    MoreBytes = BOOL_TRUE;
+    Value = 0;
+
+    for (NumberOfBytes = 0; NumberOfBytes < COMPRESS_MAXIMUM_NUMBER_SIZE && MoreBytes && *pOffset < StreamSize; NumberOfBytes++)
+    {
+        Value = Value | ((unsigned int)(pStream[*pOffset] & 0x7F) << (7*NumberOfBytes));
+        MoreBytes = (pStream[*pOffset] & 0x80) ? BOOL_TRUE : BOOL_FALSE;
+        *pOffset = *pOffset + 1;
+    }
+
+    if (MoreBytes == BOOL_FALSE)
+    {
+        *pValue = Value;
+        NumberRead = BOOL_TRUE;
+    }
+
+    return NumberRead;
+}
+
+
+/*
+ * Compress_Internal_ReadProcessor
+ *
+ *    Reads the leaf set index and APIC ID of the next processor in the stream.
+ *
+ * Arguments:
+ *     Stream, Stream Size, Offset to read from and advance, Returned Leaf Set Index,
+ *     APIC ID of the previous processor which is replaced with this processor's
+ *
+ * Return:
+ *     Returns true if the processor was within the stream
+ */
+BOOL_TYPE Compress_Internal_ReadProcessor(unsigned char *pStream, unsigned int StreamSize, unsigned int *pOffset, unsigned int *pLeafSetIndex, unsigned int *pApicId)
+{
+    unsigned int ApicIdDelta;
+    BOOL_TYPE ProcessorRead;
+
+    ProcessorRead = BOOL_FALSE;
+
+    if (Compress_Internal_ReadNumber(pStream, StreamSize, pOffset, pLeafSetIndex) &&
+        Compress_Internal_ReadNumber(pStream, StreamSize, pOffset, &ApicIdDelta))
+    {
+        ApicIdDelta = (ApicIdDelta >> 1) ^ (0u - (ApicIdDelta & 1));
+        *pApicId = *pApicId + ApicIdDelta;
+        ProcessorRead = BOOL_TRUE;
+    }
+
+    return ProcessorRead;
+}
+
+
+/*
+ * Compress_Internal_IsTableValid
+ *
+ *    Checks that a table lies within the compressed file.
+ *
+ * Arguments:
+ *     File Size, Table Offset, Number of Entries, Entry Size
+ *
+ * Return:
+ *     Returns true if the table is within the file
+ */
+BOOL_TYPE Compress_Internal_IsTableValid(unsigned int FileSize, unsigned int TableOffset, unsigned int NumberOfEntries, unsigned int EntrySize)
+{
+    BOOL_TYPE TableValid;
+
+    TableValid = BOOL_FALSE;
+
+    if ((TableOffset & 3) == 0 && TableOffset >= sizeof(COMPRESS_HEADER) && TableOffset <= FileSize)
+    {
+        if (NumberOfEntries <= (FileSize - TableOffset) / EntrySize)
+        {
+            TableValid = BOOL_TRUE;
+        }
+    }
+
+    return TableValid;
+}
+
+
+/*
+ * Compress_Internal_IsRangeValid
+ *
+ *    Checks that a range of entries lies within a table.
+ *
+ * Arguments:
+ *     First Entry, Number of Entries, Number of Entries in the table
+ *
+ * Return:
+ *     Returns true if the range is within the table
+ */
+BOOL_TYPE Compress_Internal_IsRangeValid(unsigned int First, unsigned int Count, unsigned int Total)
+{
+    BOOL_TYPE RangeValid;
+
+    RangeValid = BOOL_FALSE;
+
+    if (Count <= Total && First <= Total - Count)
+    {
+        RangeValid = BOOL_TRUE;
+    }
+
+    return RangeValid;
+}
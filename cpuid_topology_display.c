@@ -19,15 +19,19 @@
 #include "cpuid_topology.h"
 
 /*
- * Global application data variable
+ * Constants, values for local use
  */
-extern GLOBAL_DATA g_GlobalData;
+#define INVALID_DOMAIN_INDEX ((unsigned int)-1)
 
 
 /*
  * Internal Display APIs
  */
-void Display_Internal_DisplaySubLeafs(unsigned int Leaf);
+void Display_Internal_DisplaySubLeafs(unsigned int Leaf, unsigned int MaximumLeaf);
+char *Display_Internal_CoreTypeName(CORE_TYPE CoreType);
+void Display_Internal_DisplaySetCoreType(PPROCESSOR_SET pProcessorSet, unsigned int NumberOfProcessors);
+BOOL_TYPE Display_Internal_DisplayNumaDomainIds(PCPUID_TOPOLOGY pTopology, unsigned int NumaNode, unsigned int DomainIndex, char *pszPrefix);
+void Display_Internal_DisplaySize(unsigned long long SizeInBytes);
 
 
 
@@ -47,9 +51,19 @@ void Display_DisplayParameters(void)
     printf("Processor Topology Example.\n");
     printf("   Command Line Options:\n\n");
     printf("      H                  - Display this message\n");
-    printf("      S [File]           - Saves raw CPUID to a file.\n");
-    printf("      L [File] [COMMAND] - Loads raw CPUID from a file and perform a numbered COMMAND.\n");
-    printf("      C [COMMAND]        - Execute the numbered command from below.\n\n");
+    printf("      S [File] [FORMAT]  - Saves raw CPUID to a file, FORMAT is T for text (default), B for binary or C for compressed.\n");
+    printf("      L [File] [COMMAND] - Loads raw CPUID from a file and perform one or more numbered COMMANDs.\n");
+    printf("      C [COMMAND]        - Execute one or more numbered commands from below, i.e. C 1 4 5 6.\n");
+    printf("      G [SPEC] [File] [FORMAT] - Generates the CPUID of a synthetic platform to a file, SPEC sets the\n");
+    printf("                           number of P packages, D dies, M modules, C cores and T threads, G core ID\n");
+    printf("                           gap bits and the L2 and L3 sharing level, i.e. G P=8,D=2,C=64,T=2,L3=D Big.DAT\n");
+    printf("      P [File] [COMMAND] - Loads CPUID from a topology cache saved on this boot, or captures and saves\n");
+    printf("                           it if the cache does not match, and perform one or more numbered COMMANDs.\n");
+    printf("      B [File...]        - Loads each CPUID file in a batch and displays an index of the files grouped\n");
+    printf("                           by a fingerprint of their topology, i.e. B Fleet/*.DAT\n");
+    printf("      Q [S|L|C|G|P ...]  - Quiet, do not echo each CPUID record while loading or saving a file.\n");
+    printf("      I [S|L|C|G|P|B|Q ...] - Instrument, count the CPUID instructions by leaf, the affinity calls, the\n");
+    printf("                           snapshot reads and the parser allocations and display them at the end.\n\n");
     printf("   List of commands\n");
     printf("      0 - Display the topology via OS APIs (Not valid with File Load)\n");
     printf("      1 - Display the topology via CPUID\n");
@@ -58,6 +72,21 @@ void Display_DisplayParameters(void)
     printf("      4 - Display APIC ID layout\n");
     printf("      5 - Display TLB Information\n");
     printf("      6 - Display Cache Information\n");
+    printf("      7 - Export the topology as JSON\n");
+    printf("      8 - Export the topology as CSV\n");
+    printf("      9 [WORKERS] [POLICY] - Plan the processors for a number of workers, POLICY is\n");
+    printf("                             S to spread across packages and dies, P to pack on shared\n");
+    printf("                             caches or N to avoid SMT siblings, i.e. C 9 8 S\n");
+    printf("     10 - Display the NUMA node of each processor with its package and die (Not valid with File Load)\n");
+    printf("     11 - Validate the CPUID topology against the OS topology (Not valid with File Load)\n");
+    printf("     12 [SECONDS] - Watch for processors going online or offline and update the topology,\n");
+    printf("                    only the processors that changed are captured (Not valid with File Load)\n");
+    printf("     13 [MEGABYTES] - Advise the cache share, tile sizes, hash table buckets and page size\n");
+    printf("                      for a working set of MEGABYTES per thread, i.e. C 13 256\n");
+    printf("     14 [ROUND TRIPS] - Measure the cache line latency and bandwidth between a pair of processors\n");
+    printf("                        at each level of the topology, i.e. C 14 100000 (Not valid with File Load)\n");
+    printf("     15 [FILE] - Generate a C header file of the constant domain masks and shifts,\n");
+    printf("                 i.e. L MyMachine.DAT 15 MyMachineLayout.h\n");
     printf("\n");
 }
 
@@ -76,20 +105,29 @@ void Display_DisplayParameters(void)
 void Display_DisplayProcessorLeafs(unsigned int NumberOfProcessors)
 {
     unsigned int ProcessorIndex;
+    unsigned int MaximumLeaf;
+    CPUID_REGISTERS CpuidRegisters;
+
+    Capture_CaptureProcessors();
 
-    printf("Displaying CPUID Leafs 0, 1, 4, 0Bh, 018h, 01Fh if they exist\n");
+    printf("Displaying CPUID Leafs 0, 1, 4, 0Bh, 018h, 01Ah, 01Fh if they exist\n");
 
     for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
     {
          Tools_SetAffinity(ProcessorIndex);
          printf("*******************************\n");
          printf("Processor: %i\n", ProcessorIndex);
-         Display_Internal_DisplaySubLeafs(0);
-         Display_Internal_DisplaySubLeafs(1);
-         Display_Internal_DisplaySubLeafs(4);
-         Display_Internal_DisplaySubLeafs(0xB);
-         Display_Internal_DisplaySubLeafs(0x18);
-         Display_Internal_DisplaySubLeafs(0x1F);
+
+         Tools_ReadCpuid(0, 0, &CpuidRegisters);
+         MaximumLeaf = CpuidRegisters.x.Register.Eax;
+
+         Display_Internal_DisplaySubLeafs(0, MaximumLeaf);
+         Display_Internal_DisplaySubLeafs(1, MaximumLeaf);
+         Display_Internal_DisplaySubLeafs(4, MaximumLeaf);
+         Display_Internal_DisplaySubLeafs(0xB, MaximumLeaf);
+         Display_Internal_DisplaySubLeafs(0x18, MaximumLeaf);
+         Display_Internal_DisplaySubLeafs(0x1A, MaximumLeaf);
+         Display_Internal_DisplaySubLeafs(0x1F, MaximumLeaf);
          printf("\n");
     }
 }
@@ -103,12 +141,12 @@ void Display_DisplayProcessorLeafs(unsigned int NumberOfProcessors)
  * for topology as called by Display_DisplayProcessorLeafs()
  *
  * Arguments:
- *     Leaf Number
+ *     Leaf Number, Maximum Leaf from CPUID.0
  *     
  * Return:
  *     None
  */
-void Display_Internal_DisplaySubLeafs(unsigned int Leaf)
+void Display_Internal_DisplaySubLeafs(unsigned int Leaf, unsigned int MaximumLeaf)
 {
     CPUID_REGISTERS OriginalCpuidRegisters;
     CPUID_REGISTERS CpuidRegisters;
@@ -119,9 +157,7 @@ void Display_Internal_DisplaySubLeafs(unsigned int Leaf)
     CurrentSubleaf = 0;
     pCpuidReadValues = &OriginalCpuidRegisters;
 
-    Tools_ReadCpuid(0, 0, pCpuidReadValues);
-
-    if (pCpuidReadValues->x.Register.Eax >= Leaf) 
+    if (MaximumLeaf >= Leaf) 
     {
         do {
 
@@ -231,8 +267,11 @@ void Display_ThreeDomainDisplay(unsigned int Leaf, unsigned int PackageShift, un
     unsigned int LogicalProcessorPackageMask;
     unsigned int CorePackageMask;
     unsigned int LogicalProcessorMask;
-    unsigned int ApicIdArray[MAX_PROCESSORS];
+    unsigned int *pApicIdArray;
     unsigned int NumberOfLogicalProcessors;
+    unsigned int NativeModelId;
+    CORE_TYPE CoreType;
+    BOOL_TYPE IsHybrid;
 
     printf("\n**************************\n");
 
@@ -255,17 +294,27 @@ void Display_ThreeDomainDisplay(unsigned int Leaf, unsigned int PackageShift, un
     printf("**Core Mask:    0x%08x\n", CorePackageMask);
     printf("**Package Logical Processor Mask: 0x%08x\n\n", LogicalProcessorPackageMask);
 
-    /*
-     * Optionally could dynamically allocate this based on the number of logical processors.
-     */
-    NumberOfLogicalProcessors = Tools_GatherPlatformApicIds(ApicIdArray, MAX_PROCESSORS);
+    pApicIdArray = Tools_AllocatePlatformApicIds(&NumberOfLogicalProcessors);
+    IsHybrid     = Tools_IsHybridPlatform();
     
     for (ProcessorIndex = 0; ProcessorIndex < NumberOfLogicalProcessors; ProcessorIndex++) 
     {
-        printf(" - Processor %i APIC ID(0x%x)  PKG_ID(%i)  CORE_ID(%i)  LP_ID(%i)\n", ProcessorIndex, ApicIdArray[ProcessorIndex],
-                                                                                    (ApicIdArray[ProcessorIndex] & PackageMask)>>PackageShift,
-                                                                                    (ApicIdArray[ProcessorIndex] & CorePackageMask)>>LogicalProcessorShift,
-                                                                                    ApicIdArray[ProcessorIndex] & LogicalProcessorMask);
+        printf(" - Processor %i APIC ID(0x%x)  PKG_ID(%i)  CORE_ID(%i)  LP_ID(%i)", ProcessorIndex, pApicIdArray[ProcessorIndex],
+                                                                                    (pApicIdArray[ProcessorIndex] & PackageMask)>>PackageShift,
+                                                                                    (pApicIdArray[ProcessorIndex] & CorePackageMask)>>LogicalProcessorShift,
+                                                                                    pApicIdArray[ProcessorIndex] & LogicalProcessorMask);
+        if (IsHybrid) 
+        {
+            CoreType = Tools_GetProcessorCoreType(ProcessorIndex, &NativeModelId);
+            printf("  CORE_TYPE(%s)  NATIVE_MODEL_ID(0x%06x)", Display_Internal_CoreTypeName(CoreType), NativeModelId);
+        }
+
+        printf("\n");
+    }
+
+    if (pApicIdArray) 
+    {
+        free(pApicIdArray);
     }
 
 }
@@ -291,8 +340,11 @@ void Display_ManyDomainExample(unsigned int Leaf, PAPICID_BIT_LAYOUT_CTX pApicid
     unsigned int TopDomainIndex;
     unsigned int ProcessorIndex;
     unsigned int DomainShift;
-    unsigned int ApicIdArray[MAX_PROCESSORS];
+    unsigned int *pApicIdArray;
     unsigned int NumberOfLogicalProcessors;
+    unsigned int NativeModelId;
+    CORE_TYPE CoreType;
+    BOOL_TYPE IsHybrid;
 
     printf("***********************************\n");
     printf("CPUID Leaf %i - Parse all known domains\n\n", Leaf);
@@ -322,15 +374,20 @@ void Display_ManyDomainExample(unsigned int Leaf, PAPICID_BIT_LAYOUT_CTX pApicid
 
     printf("\n Enumerating Processors\n");
 
-    /*
-     * Optionally could dynamically allocate this based on the number of logical processors.
-     */
-    NumberOfLogicalProcessors = Tools_GatherPlatformApicIds(ApicIdArray, MAX_PROCESSORS);
+    pApicIdArray = Tools_AllocatePlatformApicIds(&NumberOfLogicalProcessors);
+    IsHybrid     = Tools_IsHybridPlatform();
 
     for (ProcessorIndex = 0; ProcessorIndex < NumberOfLogicalProcessors; ProcessorIndex++) 
     {
-        printf("\n - Processor %i APIC ID(0x%x)\n", ProcessorIndex, ApicIdArray[ProcessorIndex]);
-        printf("   + Package ID:  0x%08x\n", (pApicidBitLayoutCtx->DomainRelativeMasks[pApicidBitLayoutCtx->PackageDomainIndex][pApicidBitLayoutCtx->PackageDomainIndex] & ApicIdArray[ProcessorIndex])>>pApicidBitLayoutCtx->ShiftValues[pApicidBitLayoutCtx->PackageDomainIndex-1]);
+        printf("\n - Processor %i APIC ID(0x%x)\n", ProcessorIndex, pApicIdArray[ProcessorIndex]);
+
+        if (IsHybrid) 
+        {
+            CoreType = Tools_GetProcessorCoreType(ProcessorIndex, &NativeModelId);
+            printf("   + Core Type:  %s (0x%02x), Native Model ID: 0x%06x\n", Display_Internal_CoreTypeName(CoreType), CoreType, NativeModelId);
+        }
+
+        printf("   + Package ID:  0x%08x\n", (pApicidBitLayoutCtx->DomainRelativeMasks[pApicidBitLayoutCtx->PackageDomainIndex][pApicidBitLayoutCtx->PackageDomainIndex] & pApicIdArray[ProcessorIndex])>>pApicidBitLayoutCtx->ShiftValues[pApicidBitLayoutCtx->PackageDomainIndex-1]);
 
         for (DomainIndex = 0, DomainShift = 0; DomainIndex < pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++) 
         {
@@ -338,16 +395,20 @@ void Display_ManyDomainExample(unsigned int Leaf, PAPICID_BIT_LAYOUT_CTX pApicid
             {
                 for (TopDomainIndex = DomainIndex+1; TopDomainIndex < pApicidBitLayoutCtx->PackageDomainIndex; TopDomainIndex++) 
                 {
-                    printf("   + %s Relative to %s ID:  0x%08x\n", pszTopologyNames[pApicidBitLayoutCtx->ShiftValueDomain[DomainIndex]], pszTopologyNames[pApicidBitLayoutCtx->ShiftValueDomain[TopDomainIndex]], (pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][TopDomainIndex] & ApicIdArray[ProcessorIndex])>>DomainShift);
+                    printf("   + %s Relative to %s ID:  0x%08x\n", pszTopologyNames[pApicidBitLayoutCtx->ShiftValueDomain[DomainIndex]], pszTopologyNames[pApicidBitLayoutCtx->ShiftValueDomain[TopDomainIndex]], (pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][TopDomainIndex] & pApicIdArray[ProcessorIndex])>>DomainShift);
                 }
 
-                printf("   + %s Relative to Package ID:  0x%08x\n", pszTopologyNames[pApicidBitLayoutCtx->ShiftValueDomain[DomainIndex]], (pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][TopDomainIndex] & ApicIdArray[ProcessorIndex])>>DomainShift);
+                printf("   + %s Relative to Package ID:  0x%08x\n", pszTopologyNames[pApicidBitLayoutCtx->ShiftValueDomain[DomainIndex]], (pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][TopDomainIndex] & pApicIdArray[ProcessorIndex])>>DomainShift);
             }
             DomainShift = pApicidBitLayoutCtx->ShiftValues[DomainIndex];
         }
 
     }
 
+    if (pApicIdArray) 
+    {
+        free(pApicIdArray);
+    }
 
     printf("***********************************\n");
 }
@@ -363,16 +424,20 @@ void Display_ManyDomainExample(unsigned int Leaf, PAPICID_BIT_LAYOUT_CTX pApicid
  *    associated with them and their details.
  *
  * Arguments:
- *     List of Caches, number of Caches
+ *     List of Caches, number of Caches, APIC ID of each processor, number of processors
  *     
  * Return:
  *     None
  */
-void Display_DisplayProcessorCaches(PCPUID_CACHE_INFO pCacheInfo, unsigned int NumberOfCaches)
+void Display_DisplayProcessorCaches(PCPUID_CACHE_INFO pCacheInfo, unsigned int NumberOfCaches, unsigned int *pApicIdList, unsigned int NumberOfProcessors)
 {
     unsigned int CacheIndex;
     unsigned int CacheProcessorIndex;
+    unsigned int ProcessorIndex;
     char *pszCacheType[] = { "Data Cache", "Instruction Cache", "Unified Cache" };
+    BOOL_TYPE IsHybrid;
+
+    IsHybrid = Tools_IsHybridPlatform();
 
     for (CacheIndex = 0; CacheIndex < NumberOfCaches; CacheIndex++) 
     {
@@ -393,22 +458,33 @@ void Display_DisplayProcessorCaches(PCPUID_CACHE_INFO pCacheInfo, unsigned int N
         
         printf(" Processors sharing this cache: %i", pCacheInfo[CacheIndex].NumberOfLPsSharingThisCache);
 
-        for (CacheProcessorIndex = 0; CacheProcessorIndex < pCacheInfo[CacheIndex].NumberOfLPsSharingThisCache; CacheProcessorIndex++) 
+        CacheProcessorIndex = 0;
+
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
         {
-            if ((CacheProcessorIndex % 6) == 0) 
+            if (Tools_IsProcessorInSet(&pCacheInfo[CacheIndex].LPsSharingThisCache, ProcessorIndex)) 
             {
-                printf("\n     ");
-            }
-            else
-            {
-                printf(", ");
-            }
+                if ((CacheProcessorIndex % 6) == 0) 
+                {
+                    printf("\n     ");
+                }
+                else
+                {
+                    printf(", ");
+                }
 
-            printf("0x%03x", pCacheInfo[CacheIndex].ListOfApicIDsSharingThisCache[CacheProcessorIndex]);
+                printf("0x%03x", pApicIdList[ProcessorIndex]);
+                CacheProcessorIndex++;
+            }
         }
 
         printf("\n\n");
 
+        if (IsHybrid) 
+        {
+            Display_Internal_DisplaySetCoreType(&pCacheInfo[CacheIndex].LPsSharingThisCache, NumberOfProcessors);
+        }
+
         printf(" Number of Ways: %i\n Partitions: %i\n Cache Line Size: %i Bytes\n Number of Sets: %i\n Cache Size: %i Bytes, %1.2f Kb, %1.2f MB\n", pCacheInfo[CacheIndex].CacheWays, pCacheInfo[CacheIndex].CachePartitions, 
                                                                                                                                                       pCacheInfo[CacheIndex].CacheLineSize, pCacheInfo[CacheIndex].CacheSets, pCacheInfo[CacheIndex].CacheSizeInBytes,
                                                                                                                                                       (float)pCacheInfo[CacheIndex].CacheSizeInBytes/1024.0, ((float)pCacheInfo[CacheIndex].CacheSizeInBytes/1024.0)/1024.0);
@@ -434,16 +510,20 @@ void Display_DisplayProcessorCaches(PCPUID_CACHE_INFO pCacheInfo, unsigned int N
  *    
  *
  * Arguments:
- *     List of TLBs, Number of TLBs
+ *     List of TLBs, Number of TLBs, APIC ID of each processor, number of processors
  *     
  * Return:
  *     None
  */
-void Display_DisplayProcessorTlbs(PCPUID_TLB_INFO pTlbInfo, unsigned int NumberOfTlbs)
+void Display_DisplayProcessorTlbs(PCPUID_TLB_INFO pTlbInfo, unsigned int NumberOfTlbs, unsigned int *pApicIdList, unsigned int NumberOfProcessors)
 {
     unsigned int TlbIndex;
     unsigned int TlbProcessorIndex;
+    unsigned int ProcessorIndex;
     char *pszTlbType[] = { "Data TLB", "Instruction TLB", "Unified TLB", "Load-Only TLB", "Store-Only TLB" };
+    BOOL_TYPE IsHybrid;
+
+    IsHybrid = Tools_IsHybridPlatform();
 
     for (TlbIndex = 0; TlbIndex < NumberOfTlbs; TlbIndex++) 
     {
@@ -466,22 +546,33 @@ void Display_DisplayProcessorTlbs(PCPUID_TLB_INFO pTlbInfo, unsigned int NumberO
         
         printf(" Processors sharing this TLB: %i", pTlbInfo[TlbIndex].NumberOfLPsSharingThisTlb);
 
-        for (TlbProcessorIndex = 0; TlbProcessorIndex < pTlbInfo[TlbIndex].NumberOfLPsSharingThisTlb; TlbProcessorIndex++) 
+        TlbProcessorIndex = 0;
+
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
         {
-            if ((TlbProcessorIndex % 6) == 0) 
-            {
-                printf("\n     ");
-            }
-            else
+            if (Tools_IsProcessorInSet(&pTlbInfo[TlbIndex].LPsSharingThisTlb, ProcessorIndex)) 
             {
-                printf(", ");
-            }
+                if ((TlbProcessorIndex % 6) == 0) 
+                {
+                    printf("\n     ");
+                }
+                else
+                {
+                    printf(", ");
+                }
 
-            printf("0x%03x", pTlbInfo[TlbIndex].ListOfApicIDsSharingThisTlb[TlbProcessorIndex]);
+                printf("0x%03x", pApicIdList[ProcessorIndex]);
+                TlbProcessorIndex++;
+            }
         }
 
         printf("\n\n");
 
+        if (IsHybrid) 
+        {
+            Display_Internal_DisplaySetCoreType(&pTlbInfo[TlbIndex].LPsSharingThisTlb, NumberOfProcessors);
+        }
+
         printf(" Number of Ways: %i\n TLB Paritioning: %i\n Number of Sets: %i\n", pTlbInfo[TlbIndex].TlbWays, pTlbInfo[TlbIndex].TlbParitioning, pTlbInfo[TlbIndex].TlbSets);
 
 
@@ -498,4 +589,656 @@ void Display_DisplayProcessorTlbs(PCPUID_TLB_INFO pTlbInfo, unsigned int NumberO
 }
 
 
+/*
+ * Display_DisplayPlacement
+ *
+ * Display the processor chosen for each worker along with the list and
+ * affinity mask of those processors for tools such as taskset.
+ *
+ * Arguments:
+ *     Topology, Number of Workers, Placement Policy, Processor List for each worker
+ *     
+ * Return:
+ *     None
+ */
+void Display_DisplayPlacement(PCPUID_TOPOLOGY pTopology, unsigned int NumberOfWorkers, PLACEMENT_POLICY PlacementPolicy, unsigned int *pProcessorList)
+{
+    PROCESSOR_SET PlacementSet;
+    unsigned int WorkerIndex;
+    unsigned int WordIndex;
+    unsigned int NumberOfWords;
+    char *pszPolicy[] = { "Spread across packages and dies", "Pack on shared caches", "Avoid SMT siblings" };
+
+    printf("\n*************************************\n");
+    printf(" Placement of %u workers: %s\n", NumberOfWorkers, pszPolicy[PlacementPolicy]);
+
+    if (NumberOfWorkers > Topology_GetNumberOfProcessors(pTopology)) 
+    {
+        printf(" There are more workers than the %u processors, processors are reused.\n", Topology_GetNumberOfProcessors(pTopology));
+    }
+
+    printf("*************************************\n\n");
+    printf("   Worker  Processor  APIC ID%s\n", Topology_IsHybrid(pTopology) ? "  Core Type" : "");
+
+    for (WorkerIndex = 0; WorkerIndex < NumberOfWorkers; WorkerIndex++) 
+    {
+        printf("   %6u  %9u  0x%03x", WorkerIndex, pProcessorList[WorkerIndex], Topology_GetApicId(pTopology, pProcessorList[WorkerIndex]));
+
+        if (Topology_IsHybrid(pTopology)) 
+        {
+            printf("    %s", Display_Internal_CoreTypeName(Topology_GetCoreType(pTopology, pProcessorList[WorkerIndex])));
+        }
+
+        printf("\n");
+    }
+
+    printf("\n CPU List: ");
+
+    for (WorkerIndex = 0; WorkerIndex < NumberOfWorkers; WorkerIndex++) 
+    {
+        printf("%s%u", (WorkerIndex == 0) ? "" : ",", pProcessorList[WorkerIndex]);
+    }
+
+    printf("\n");
+
+    if (Tools_CreateProcessorSet(&PlacementSet, Topology_GetNumberOfProcessors(pTopology))) 
+    {
+        for (WorkerIndex = 0; WorkerIndex < NumberOfWorkers; WorkerIndex++) 
+        {
+            Tools_AddProcessorToSet(&PlacementSet, pProcessorList[WorkerIndex]);
+        }
+
+        NumberOfWords = (PlacementSet.NumberOfProcessors + PROCESSOR_SET_BITS_PER_WORD - 1) / PROCESSOR_SET_BITS_PER_WORD;
+
+        /*
+         * Skip the leading words without processors so the mask starts at the highest bit set.
+         */
+        while (NumberOfWords > 1 && PlacementSet.pBitmap[NumberOfWords - 1] == 0) 
+        {
+            NumberOfWords--;
+        }
+
+        printf(" Affinity Mask: 0x");
+
+        for (WordIndex = NumberOfWords; WordIndex > 0; WordIndex--) 
+        {
+            printf((WordIndex == NumberOfWords) ? "%x" : "%08x", PlacementSet.pBitmap[WordIndex - 1]);
+        }
+
+        printf("\n\n");
 
+        Tools_DestroyProcessorSet(&PlacementSet);
+    }
+}
+
+
+/*
+ * Display_DisplayBatchIndex
+ *
+ * Display the index of a batch of captures, each topology with the captures
+ * that have it, then the captures that could not be loaded.
+ *
+ * Arguments:
+ *     Captures sorted by Batch_AnalyzeCaptures, Number of Captures
+ *     
+ * Return:
+ *     None
+ */
+void Display_DisplayBatchIndex(PBATCH_CAPTURE pCaptures, unsigned int NumberOfCaptures)
+{
+    unsigned int CaptureIndex;
+    unsigned int GroupIndex;
+    unsigned int NumberOfTopologies;
+    unsigned int NumberOfFailed;
+
+    NumberOfTopologies = 0;
+    NumberOfFailed = 0;
+
+    for (CaptureIndex = 0; CaptureIndex < NumberOfCaptures; CaptureIndex++) 
+    {
+        if (pCaptures[CaptureIndex].Loaded == BOOL_FALSE) 
+        {
+            NumberOfFailed++;
+        }
+        else if (CaptureIndex == 0 || pCaptures[CaptureIndex].Fingerprint != pCaptures[CaptureIndex - 1].Fingerprint) 
+        {
+            NumberOfTopologies++;
+        }
+    }
+
+    printf("\n*************************************\n");
+    printf(" Topology index of %u captures: %u topologies, %u could not be loaded\n", NumberOfCaptures, NumberOfTopologies, NumberOfFailed);
+    printf("*************************************\n");
+
+    CaptureIndex = 0;
+
+    while (CaptureIndex < NumberOfCaptures && pCaptures[CaptureIndex].Loaded) 
+    {
+        GroupIndex = CaptureIndex;
+
+        while (GroupIndex < NumberOfCaptures && pCaptures[GroupIndex].Loaded && pCaptures[GroupIndex].Fingerprint == pCaptures[CaptureIndex].Fingerprint) 
+        {
+            GroupIndex++;
+        }
+
+        printf("\n Topology 0x%016llx: %u captures, %u processors, %u domains, %u caches\n", pCaptures[CaptureIndex].Fingerprint, GroupIndex - CaptureIndex, pCaptures[CaptureIndex].NumberOfProcessors, pCaptures[CaptureIndex].NumberOfDomains, pCaptures[CaptureIndex].NumberOfCaches);
+
+        for (; CaptureIndex < GroupIndex; CaptureIndex++) 
+        {
+            printf("     %s\n", pCaptures[CaptureIndex].pszFileName);
+        }
+    }
+
+    if (NumberOfFailed) 
+    {
+        printf("\n Could not be loaded:\n");
+
+        for (; CaptureIndex < NumberOfCaptures; CaptureIndex++) 
+        {
+            printf("     %s\n", pCaptures[CaptureIndex].pszFileName);
+        }
+    }
+
+    printf("\n");
+}
+
+
+/*
+ * Display_DisplaySizingAdvice
+ *
+ * Display the tuning parameters the sizing advisor derived for a processor.
+ *
+ * Arguments:
+ *     Topology, Processor Index, Working Set of each thread in bytes, Sizing Advice
+ *     
+ * Return:
+ *     None
+ */
+void Display_DisplaySizingAdvice(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned long long WorkingSetBytes, PSIZING_ADVICE pSizingAdvice)
+{
+    char *pszPageSize[] = { "4K", "2M", "1G" };
+    unsigned int PageSize;
+
+    printf("\n*************************************\n");
+    printf(" Sizing advice for processor %u APIC ID 0x%03x", ProcessorIndex, Topology_GetApicId(pTopology, ProcessorIndex));
+
+    if (Topology_IsHybrid(pTopology)) 
+    {
+        printf(" %s", Display_Internal_CoreTypeName(Topology_GetCoreType(pTopology, ProcessorIndex)));
+    }
+
+    printf("\n*************************************\n\n");
+
+    printf("   Cache Line Size:               %u bytes\n", pSizingAdvice->CacheLineSize);
+    printf("   L1 Data Cache per Thread:      %u KB\n", pSizingAdvice->L1DataSharePerThread / 1024);
+    printf("   L2 Cache per Thread:           %u KB\n", pSizingAdvice->L2SharePerThread / 1024);
+
+    if (pSizingAdvice->LastLevelCacheLevel > 2) 
+    {
+        printf("   L%u Cache per Thread:           %u KB\n", pSizingAdvice->LastLevelCacheLevel, pSizingAdvice->LastLevelSharePerThread / 1024);
+    }
+
+    printf("   L1 Tile:                       %u KB, %u x %u elements of 8 bytes\n", pSizingAdvice->L1TileBytes / 1024, pSizingAdvice->L1TileEdge, pSizingAdvice->L1TileEdge);
+    printf("   L2 Tile:                       %u KB, %u x %u elements of 8 bytes\n", pSizingAdvice->L2TileBytes / 1024, pSizingAdvice->L2TileEdge, pSizingAdvice->L2TileEdge);
+    printf("   Hash Table Buckets per Thread: %u of %u bytes\n\n", pSizingAdvice->HashBucketsPerThread, pSizingAdvice->CacheLineSize);
+
+    printf("   Data TLB Reach:\n");
+
+    for (PageSize = PageSize_4K; PageSize < PageSize_MaximumSizes; PageSize++) 
+    {
+        printf("      %s Pages:                   ", pszPageSize[PageSize]);
+
+        if (pSizingAdvice->TlbReach[PageSize]) 
+        {
+            Display_Internal_DisplaySize(pSizingAdvice->TlbReach[PageSize]);
+        }
+        else
+        {
+            printf("Not Enumerated");
+        }
+
+        printf("\n");
+    }
+
+    printf("\n   Recommended Page Size for a ");
+    Display_Internal_DisplaySize(WorkingSetBytes);
+    printf(" working set: %s", pszPageSize[pSizingAdvice->RecommendedPageSize]);
+
+    if (pSizingAdvice->TlbReach[pSizingAdvice->RecommendedPageSize] == 0) 
+    {
+        printf(", the data TLBs are not enumerated");
+    }
+    else if (pSizingAdvice->TlbReach[pSizingAdvice->RecommendedPageSize] < WorkingSetBytes) 
+    {
+        printf(", the largest reach which does not cover the working set");
+    }
+
+    printf("\n\n");
+}
+
+
+/*
+ * Display_DisplayLatencyMatrix
+ *
+ * Display the latency and bandwidth measured between the pair of processors at 
+ * each level of the topology.
+ *
+ * Arguments:
+ *     Topology, Latency Matrix
+ *     
+ * Return:
+ *     None
+ */
+void Display_DisplayLatencyMatrix(PCPUID_TOPOLOGY pTopology, PLATENCY_MATRIX pLatencyMatrix)
+{
+    char *pszLatencyLevel[] = { "SMT Sibling", "Shared L2", "Same Die", "Cross Die", "Cross Package" };
+    PLATENCY_COST pLatencyCost;
+    unsigned int LatencyLevel;
+
+    printf("\n*************************************\n");
+    printf(" Inter-core latency and bandwidth of %u processors, %u round trips\n", Topology_GetNumberOfProcessors(pTopology), pLatencyMatrix->RoundTrips);
+    printf("*************************************\n\n");
+
+    printf("   Level           Processors      Latency (ns)   Bandwidth (MB/s)   Buffer\n");
+
+    for (LatencyLevel = 0; LatencyLevel < LatencyLevel_MaximumLevels; LatencyLevel++) 
+    {
+        pLatencyCost = &pLatencyMatrix->Cost[LatencyLevel];
+
+        printf("   %-15s ", pszLatencyLevel[LatencyLevel]);
+
+        if (pLatencyCost->PairFound == BOOL_FALSE) 
+        {
+            printf("No pair\n");
+        }
+        else
+        {
+            printf("%5u <-> %-5u ", pLatencyCost->FirstProcessor, pLatencyCost->SecondProcessor);
+
+            if (pLatencyCost->Measured) 
+            {
+                printf("%9llu.%03llu   %16llu   ", pLatencyCost->LatencyPicoseconds / 1000ULL, pLatencyCost->LatencyPicoseconds % 1000ULL, pLatencyCost->BandwidthMegabytesPerSecond);
+                Display_Internal_DisplaySize(pLatencyCost->BufferBytes);
+                printf("\n");
+            }
+            else
+            {
+                printf("Failed, the workers could not run together on the pair\n");
+            }
+        }
+    }
+
+    printf("\n");
+}
+
+
+/*
+ * Display_Internal_DisplaySize
+ *
+ * Display a size in the largest of KB, MB or GB it is a whole number of.
+ *
+ * Arguments:
+ *     Size in Bytes
+ *     
+ * Return:
+ *     None
+ */
+void Display_Internal_DisplaySize(unsigned long long SizeInBytes)
+{
+    if (SizeInBytes >= (1ULL<<30) && (SizeInBytes % (1ULL<<30)) == 0) 
+    {
+        printf("%llu GB", SizeInBytes>>30);
+    }
+    else if (SizeInBytes >= (1ULL<<20) && (SizeInBytes % (1ULL<<20)) == 0) 
+    {
+        printf("%llu MB", SizeInBytes>>20);
+    }
+    else
+    {
+        printf("%llu KB", SizeInBytes>>10);
+    }
+}
+
+
+/*
+ * Display_DisplayNumaTopology
+ *
+ * Display the OS NUMA node of each processor with the CPUID package and die it is in,
+ * then a summary of the processors, packages and dies in each NUMA node.
+ *
+ * Arguments:
+ *     Topology
+ *     
+ * Return:
+ *     None
+ */
+void Display_DisplayNumaTopology(PCPUID_TOPOLOGY pTopology)
+{
+    unsigned int NumberOfProcessors;
+    unsigned int PackageDomainIndex;
+    unsigned int DieDomainIndex;
+    unsigned int DomainIndex;
+    unsigned int ProcessorIndex;
+    unsigned int NumaNode;
+    unsigned int MaxNumaNode;
+    unsigned int NumberOfUnknown;
+
+    NumberOfProcessors = Topology_GetNumberOfProcessors(pTopology);
+    PackageDomainIndex = Topology_GetNumberOfDomains(pTopology) - 1;
+    DieDomainIndex     = PackageDomainIndex;
+    MaxNumaNode        = 0;
+    NumberOfUnknown    = 0;
+
+    for (DomainIndex = 0; DomainIndex < PackageDomainIndex; DomainIndex++) 
+    {
+        if (Topology_GetDomainType(pTopology, DomainIndex) == DieDomain) 
+        {
+            DieDomainIndex = DomainIndex;
+        }
+    }
+
+    printf("\n*************************************\n");
+    printf(" NUMA Nodes of the CPUID Packages and Dies\n");
+    printf("*************************************\n\n");
+
+    for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
+    {
+        printf(" Processor %u APIC ID(0x%08x) PKG_ID(%u)", ProcessorIndex, Topology_GetApicId(pTopology, ProcessorIndex), Topology_GetDomainId(pTopology, ProcessorIndex, PackageDomainIndex, PackageDomainIndex));
+
+        if (DieDomainIndex != PackageDomainIndex) 
+        {
+            printf(" DIE_ID(%u)", Topology_GetDomainId(pTopology, ProcessorIndex, DieDomainIndex, DieDomainIndex));
+        }
+
+        NumaNode = Topology_GetNumaNode(pTopology, ProcessorIndex);
+
+        if (NumaNode == INVALID_NUMA_NODE) 
+        {
+            printf(" NUMA_NODE(Unknown)\n");
+            NumberOfUnknown++;
+        }
+        else
+        {
+            printf(" NUMA_NODE(%u)\n", NumaNode);
+
+            if (NumaNode > MaxNumaNode) 
+            {
+                MaxNumaNode = NumaNode;
+            }
+        }
+    }
+
+    printf("\n");
+
+    if (NumberOfUnknown == NumberOfProcessors) 
+    {
+        printf(" The OS did not report a NUMA node for any processor.\n\n");
+    }
+    else
+    {
+        /*
+         * Each node lists its processors then the packages and dies they are in.
+         */
+        for (NumaNode = 0; NumaNode <= MaxNumaNode; NumaNode++) 
+        {
+            if (Display_Internal_DisplayNumaDomainIds(pTopology, NumaNode, INVALID_DOMAIN_INDEX, " NUMA Node %u Processors: ")) 
+            {
+                Display_Internal_DisplayNumaDomainIds(pTopology, NumaNode, PackageDomainIndex, "   Package IDs: ");
+
+                if (DieDomainIndex != PackageDomainIndex) 
+                {
+                    Display_Internal_DisplayNumaDomainIds(pTopology, NumaNode, DieDomainIndex, "   Die IDs: ");
+                }
+
+                printf("\n");
+            }
+        }
+
+        if (NumberOfUnknown != 0) 
+        {
+            printf(" %u processors have no NUMA node reported by the OS.\n\n", NumberOfUnknown);
+        }
+    }
+}
+
+
+/*
+ * Display_Internal_DisplayNumaDomainIds
+ *
+ * Display one line for a NUMA node listing its processors, or the IDs of a domain
+ * its processors are in with each ID listed only the first time it is seen.
+ *
+ * Arguments:
+ *     Topology, NUMA Node, Domain Index or INVALID_DOMAIN_INDEX for the processors, Line Prefix
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the NUMA node has any processors.
+ */
+BOOL_TYPE Display_Internal_DisplayNumaDomainIds(PCPUID_TOPOLOGY pTopology, unsigned int NumaNode, unsigned int DomainIndex, char *pszPrefix)
+{
+    unsigned int NumberOfProcessors;
+    unsigned int ProcessorIndex;
+    unsigned int PreviousIndex;
+    unsigned int Value;
+    BOOL_TYPE FirstEntry;
+    BOOL_TYPE AlreadyListed;
+
+    NumberOfProcessors = Topology_GetNumberOfProcessors(pTopology);
+    FirstEntry = BOOL_TRUE;
+
+    for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
+    {
+        if (Topology_GetNumaNode(pTopology, ProcessorIndex) == NumaNode) 
+        {
+            AlreadyListed = BOOL_FALSE;
+            Value = ProcessorIndex;
+
+            if (DomainIndex != INVALID_DOMAIN_INDEX) 
+            {
+                Value = Topology_GetDomainId(pTopology, ProcessorIndex, DomainIndex, DomainIndex);
+
+                for (PreviousIndex = 0; PreviousIndex < ProcessorIndex && AlreadyListed == BOOL_FALSE; PreviousIndex++) 
+                {
+                    if (Topology_GetNumaNode(pTopology, PreviousIndex) == NumaNode && Topology_GetDomainId(pTopology, PreviousIndex, DomainIndex, DomainIndex) == Value) 
+                    {
+                        AlreadyListed = BOOL_TRUE;
+                    }
+                }
+            }
+
+            if (AlreadyListed == BOOL_FALSE) 
+            {
+                if (FirstEntry) 
+                {
+                    printf(pszPrefix, NumaNode);
+                }
+
+                printf("%s%u", FirstEntry ? "" : ",", Value);
+                FirstEntry = BOOL_FALSE;
+            }
+        }
+    }
+
+    if (FirstEntry == BOOL_FALSE) 
+    {
+        printf("\n");
+    }
+
+    return (FirstEntry == BOOL_FALSE) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/*
+ * Display_HybridCoreTypes
+ *
+ * Display the core type and native model ID of each processor on a hybrid
+ * platform, nothing is displayed on other platforms.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     None
+ */
+void Display_HybridCoreTypes(void)
+{
+    unsigned int *pApicIdArray;
+    unsigned int NumberOfLogicalProcessors;
+    unsigned int ProcessorIndex;
+    unsigned int NativeModelId;
+    CORE_TYPE CoreType;
+
+    if (Tools_IsHybridPlatform()) 
+    {
+        printf("Hybrid Core Types from CPUID.1AH\n");
+
+        pApicIdArray = Tools_AllocatePlatformApicIds(&NumberOfLogicalProcessors);
+
+        if (pApicIdArray) 
+        {
+            for (ProcessorIndex = 0; ProcessorIndex < NumberOfLogicalProcessors; ProcessorIndex++) 
+            {
+                CoreType = Tools_GetProcessorCoreType(ProcessorIndex, &NativeModelId);
+                printf(" - Processor %i APIC ID(0x%x)  %s (0x%02x), Native Model ID: 0x%06x\n", ProcessorIndex, pApicIdArray[ProcessorIndex], Display_Internal_CoreTypeName(CoreType), CoreType, NativeModelId);
+            }
+
+            free(pApicIdArray);
+        }
+
+        printf("\n");
+    }
+}
+
+
+/*
+ * Display_Internal_CoreTypeName
+ *
+ * The name of a hybrid core type.
+ *
+ * Arguments:
+ *     Core Type
+ *     
+ * Return:
+ *     Core Type Name
+ */
+char *Display_Internal_CoreTypeName(CORE_TYPE CoreType)
+{
+    char *pszCoreTypeName;
+
+    switch (CoreType) 
+    {
+        case CoreType_Core:
+             pszCoreTypeName = "Performance Core (Intel Core)";
+             break;
+
+        case CoreType_Atom:
+             pszCoreTypeName = "Efficient Core (Intel Atom)";
+             break;
+
+        case CoreType_NotHybrid:
+             pszCoreTypeName = "Not Hybrid";
+             break;
+
+        default:
+             pszCoreTypeName = "Unknown Core Type";
+    }
+
+    return pszCoreTypeName;
+}
+
+
+/*
+ * Display_Internal_DisplaySetCoreType
+ *
+ * Display the core type of the processors in a cache or TLB sharing set,
+ * this is only called on a hybrid platform.
+ *
+ * Arguments:
+ *     Processor Set, Number of Processors
+ *     
+ * Return:
+ *     None
+ */
+void Display_Internal_DisplaySetCoreType(PPROCESSOR_SET pProcessorSet, unsigned int NumberOfProcessors)
+{
+    unsigned int ProcessorIndex;
+    BOOL_TYPE CoreTypeDisplayed;
+
+    CoreTypeDisplayed = BOOL_FALSE;
+
+    for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors && CoreTypeDisplayed == BOOL_FALSE; ProcessorIndex++) 
+    {
+        if (Tools_IsProcessorInSet(pProcessorSet, ProcessorIndex)) 
+        {
+            printf(" Core Type: %s\n\n", Display_Internal_CoreTypeName(Tools_GetProcessorCoreType(ProcessorIndex, NULL)));
+            CoreTypeDisplayed = BOOL_TRUE;
+        }
+    }
+}
+
+
+/*
+ * Display_DisplayInstrumentation
+ *
+ * Display the CPUID instructions executed for each leaf with their time, the
+ * affinity calls and failures, the snapshot reads and the parser allocations.
+ *
+ * Arguments:
+ *     Instrumentation Counters
+ *     
+ * Return:
+ *     None
+ */
+void Display_DisplayInstrumentation(PINSTRUMENT_COUNTERS pCounters)
+{
+    unsigned long long TotalCalls;
+    unsigned long long TotalNanoseconds;
+    unsigned long long SnapshotReads;
+    unsigned int CounterIndex;
+    unsigned int Leaf;
+
+    TotalCalls       = 0;
+    TotalNanoseconds = 0;
+
+    printf("\n*************************************\n");
+    printf(" Instrumentation Counters\n");
+    printf("*************************************\n\n");
+    printf("   CPUID Leaf          Calls     Total(us)   Average(ns)\n");
+
+    for (CounterIndex = 0; CounterIndex < INSTRUMENT_LEAF_COUNTERS; CounterIndex++) 
+    {
+        if (pCounters->CpuidCalls[CounterIndex]) 
+        {
+            Leaf = Instrument_GetCounterLeaf(CounterIndex);
+
+            if (Leaf == INVALID_LEAF) 
+            {
+                printf("   Other     ");
+            }
+            else
+            {
+                printf("   0x%08x", Leaf);
+            }
+
+            printf(" %14llu %13.3f %13.1f\n", pCounters->CpuidCalls[CounterIndex], (double)pCounters->CpuidNanoseconds[CounterIndex]/1000.0, (double)pCounters->CpuidNanoseconds[CounterIndex]/(double)pCounters->CpuidCalls[CounterIndex]);
+
+            TotalCalls       += pCounters->CpuidCalls[CounterIndex];
+            TotalNanoseconds += pCounters->CpuidNanoseconds[CounterIndex];
+        }
+    }
+
+    printf("   Total      %14llu %13.3f\n\n", TotalCalls, (double)TotalNanoseconds/1000.0);
+
+    printf("   Os_SetAffinity calls %llu, %llu failed, %.3f us\n", pCounters->AffinityCalls, pCounters->AffinityFailures, (double)pCounters->AffinityNanoseconds/1000.0);
+
+    SnapshotReads = pCounters->SnapshotHits + pCounters->SnapshotMisses;
+
+    printf("   Snapshot reads %llu, %llu found and %llu not found in the snapshot", SnapshotReads, pCounters->SnapshotHits, pCounters->SnapshotMisses);
+
+    if (SnapshotReads) 
+    {
+        printf(" (%.1f%% found)", 100.0*(double)pCounters->SnapshotHits/(double)SnapshotReads);
+    }
+
+    printf("\n   Cache and TLB parser allocations %llu, %llu bytes\n\n", pCounters->ParserAllocations, pCounters->ParserBytesAllocated);
+}
@@ -0,0 +1,879 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The topology that is exported, built once by the topology library.
+ */
+typedef struct _EXPORT_CONTEXT
+{
+    TEXT_BUFFER Text;
+
+    PCPUID_TOPOLOGY pTopology;
+
+} EXPORT_CONTEXT, *PEXPORT_CONTEXT;
+
+
+/*
+ * Internal Export APIs
+ */
+char *Export_Internal_DomainName(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx, unsigned int DomainIndex);
+char *Export_Internal_CacheTypeName(unsigned int CacheType);
+char *Export_Internal_TlbTypeName(unsigned int TlbType);
+char *Export_Internal_BoolName(BOOL_TYPE Value);
+char *Export_Internal_CoreTypeName(CORE_TYPE CoreType);
+void Export_Internal_WriteProcessorSet(PTEXT_BUFFER pText, PPROCESSOR_SET pProcessorSet, unsigned int NumberOfProcessors, char *pszSeparator);
+void Export_Internal_WriteJson(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteJsonProcessors(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteJsonDomains(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteJsonCaches(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteJsonTlbs(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteCsv(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteCsvProcessors(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteCsvDomains(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteCsvCaches(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteCsvTlbs(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteHeader(PEXPORT_CONTEXT pExportContext);
+void Export_Internal_WriteHeaderDomain(PEXPORT_CONTEXT pExportContext, unsigned int DomainIndex);
+void Export_Internal_HeaderDomainName(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx, unsigned int DomainIndex, char *pszName, unsigned int NameSize);
+unsigned int Export_Internal_DomainIdShift(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx, unsigned int DomainIndex);
+
+
+
+/*
+ * Export_WriteTopology
+ *
+ *    Writes the per-processor domain IDs, the domain mask matrix and the
+ *    cache and TLB sharing sets in a machine readable format, or the domain
+ *    masks and shifts as a C header of constants.  The output is collected 
+ *    in memory and written to the stream at once.
+ *
+ * Arguments:
+ *     Stream, Export Format
+ *
+ * Return:
+ *     None
+ */
+void Export_WriteTopology(FILE *pStream, EXPORT_FORMAT ExportFormat)
+{
+    EXPORT_CONTEXT ExportContext;
+
+    memset(&ExportContext, 0, sizeof(EXPORT_CONTEXT));
+
+    Tools_InitializeTextBuffer(&ExportContext.Text, pStream);
+
+    ExportContext.pTopology = Topology_Create();
+
+    if (ExportContext.pTopology)
+    {
+        if (ExportFormat == ExportFormat_Csv)
+        {
+            Export_Internal_WriteCsv(&ExportContext);
+        }
+        else if (ExportFormat == ExportFormat_Header)
+        {
+            Export_Internal_WriteHeader(&ExportContext);
+        }
+        else
+        {
+            Export_Internal_WriteJson(&ExportContext);
+        }
+
+        Tools_FlushTextBuffer(&ExportContext.Text);
+
+        Topology_Destroy(ExportContext.pTopology);
+        ExportContext.pTopology = NULL;
+    }
+}
+
+
+
+/*
+ * Export_Internal_DomainName
+ *
+ *    The name used for a domain in the exported data.
+ *
+ * Arguments:
+ *     APIC Bit Layout Context, Domain Index
+ *
+ * Return:
+ *     Domain Name
+ */
+char *Export_Internal_DomainName(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx, unsigned int DomainIndex)
+{
+    char *pszDomainNames[] = { "invalid", "logical_processor", "core", "module", "tile", "die", "die_group" };
+    char *pszDomainName;
+
+    pszDomainName = "unknown";
+
+    if (DomainIndex == pApicidBitLayoutCtx->PackageDomainIndex)
+    {
+        pszDomainName = "package";
+    }
+    else
+    {
+        if (pApicidBitLayoutCtx->ShiftValueDomain[DomainIndex] <= DieGrpDomain)
+        {
+            pszDomainName = pszDomainNames[pApicidBitLayoutCtx->ShiftValueDomain[DomainIndex]];
+        }
+    }
+
+    return pszDomainName;
+}
+
+
+/*
+ * Export_Internal_CacheTypeName
+ *
+ *    The name used for a cache type in the exported data.
+ *
+ * Arguments:
+ *     Cache Type
+ *
+ * Return:
+ *     Cache Type Name
+ */
+char *Export_Internal_CacheTypeName(unsigned int CacheType)
+{
+    char *pszCacheType[] = { "data", "instruction", "unified" };
+    char *pszCacheTypeName;
+
+    pszCacheTypeName = "unknown";
+
+    switch (CacheType)
+    {
+        case CacheType_DataCache:
+        case CacheType_InstructionCache:
+        case CacheType_UnifiedCache:
+             pszCacheTypeName = pszCacheType[CacheType - 1];
+    }
+
+    return pszCacheTypeName;
+}
+
+
+/*
+ * Export_Internal_TlbTypeName
+ *
+ *    The name used for a TLB type in the exported data.
+ *
+ * Arguments:
+ *     TLB Type
+ *
+ * Return:
+ *     TLB Type Name
+ */
+char *Export_Internal_TlbTypeName(unsigned int TlbType)
+{
+    char *pszTlbType[] = { "data", "instruction", "unified", "load_only", "store_only" };
+    char *pszTlbTypeName;
+
+    pszTlbTypeName = "unknown";
+
+    switch (TlbType)
+    {
+        case TlbType_Data:
+        case TlbType_Instruction:
+        case TlbType_Unified:
+        case TlbType_LoadOnly:
+        case TlbType_StoreOnly:
+             pszTlbTypeName = pszTlbType[TlbType - 1];
+    }
+
+    return pszTlbTypeName;
+}
+
+
+/*
+ * Export_Internal_BoolName
+ *
+ *    The name used for a boolean in the exported data.
+ *
+ * Arguments:
+ *     Value
+ *
+ * Return:
+ *     "true" or "false"
+ */
+char *Export_Internal_BoolName(BOOL_TYPE Value)
+{
+    return (Value == BOOL_FALSE) ? "false" : "true";
+}
+
+
+/*
+ * Export_Internal_CoreTypeName
+ *
+ *    The name used for a hybrid core type in the exported data.
+ *
+ * Arguments:
+ *     Core Type
+ *
+ * Return:
+ *     Core Type Name
+ */
+char *Export_Internal_CoreTypeName(CORE_TYPE CoreType)
+{
+    char *pszCoreTypeName;
+
+    switch (CoreType)
+    {
+        case CoreType_Core:
+             pszCoreTypeName = "performance";
+             break;
+
+        case CoreType_Atom:
+             pszCoreTypeName = "efficient";
+             break;
+
+        case CoreType_NotHybrid:
+             pszCoreTypeName = "none";
+             break;
+
+        default:
+             pszCoreTypeName = "unknown";
+    }
+
+    return pszCoreTypeName;
+}
+
+
+/*
+ * Export_Internal_WriteProcessorSet
+ *
+ *    Write the processor indexes in a set.
+ *
+ * Arguments:
+ *     Text Buffer, Processor Set, Number of Processors, Separator
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteProcessorSet(PTEXT_BUFFER pText, PPROCESSOR_SET pProcessorSet, unsigned int NumberOfProcessors, char *pszSeparator)
+{
+    unsigned int ProcessorIndex;
+    char *pszNextSeparator;
+
+    pszNextSeparator = "";
+
+    for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++)
+    {
+        if (Tools_IsProcessorInSet(pProcessorSet, ProcessorIndex))
+        {
+            Tools_AppendText(pText, "%s%u", pszNextSeparator, ProcessorIndex);
+            pszNextSeparator = pszSeparator;
+        }
+    }
+}
+
+
+
+/*
+ * Export_Internal_WriteJson
+ *
+ *    Write the topology as a single JSON object.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteJson(PEXPORT_CONTEXT pExportContext)
+{
+    Tools_AppendText(&pExportContext->Text, "{\n");
+    Tools_AppendText(&pExportContext->Text, "  \"leaf\": %u,\n", pExportContext->pTopology->Leaf);
+    Tools_AppendText(&pExportContext->Text, "  \"number_of_processors\": %u,\n", pExportContext->pTopology->NumberOfProcessors);
+    Tools_AppendText(&pExportContext->Text, "  \"hybrid\": %s,\n", Export_Internal_BoolName(Topology_IsHybrid(pExportContext->pTopology)));
+
+    Export_Internal_WriteJsonDomains(pExportContext);
+    Export_Internal_WriteJsonProcessors(pExportContext);
+    Export_Internal_WriteJsonCaches(pExportContext);
+    Export_Internal_WriteJsonTlbs(pExportContext);
+
+    Tools_AppendText(&pExportContext->Text, "}\n");
+}
+
+
+/*
+ * Export_Internal_WriteJsonDomains
+ *
+ *    Write the domain mask matrix, each domain has its global mask and
+ *    its mask relative to every higher domain.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteJsonDomains(PEXPORT_CONTEXT pExportContext)
+{
+    PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx;
+    unsigned int DomainIndex;
+    unsigned int TopDomainIndex;
+
+    pApicidBitLayoutCtx = &pExportContext->pTopology->ApicidBitLayoutCtx;
+
+    Tools_AppendText(&pExportContext->Text, "  \"domains\": [\n");
+
+    for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        Tools_AppendText(&pExportContext->Text, "    { \"name\": \"%s\", \"mask\": \"0x%08x\", \"relative_masks\": {", Export_Internal_DomainName(pApicidBitLayoutCtx, DomainIndex),
+                                                                                                                pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][DomainIndex]);
+
+        for (TopDomainIndex = DomainIndex + 1; TopDomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; TopDomainIndex++)
+        {
+            Tools_AppendText(&pExportContext->Text, "%s \"%s\": \"0x%08x\"", (TopDomainIndex == DomainIndex + 1) ? "" : ",", Export_Internal_DomainName(pApicidBitLayoutCtx, TopDomainIndex),
+                                                                                                                      pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][TopDomainIndex]);
+        }
+
+        Tools_AppendText(&pExportContext->Text, " } }%s\n", (DomainIndex == pApicidBitLayoutCtx->PackageDomainIndex) ? "" : ",");
+    }
+
+    Tools_AppendText(&pExportContext->Text, "  ],\n");
+}
+
+
+/*
+ * Export_Internal_WriteJsonProcessors
+ *
+ *    Write every processor with the ID of each domain it is in, both
+ *    across the platform and within its package.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteJsonProcessors(PEXPORT_CONTEXT pExportContext)
+{
+    PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx;
+    unsigned int ProcessorIndex;
+    unsigned int DomainIndex;
+    unsigned int ApicId;
+    unsigned int NumaNode;
+
+    pApicidBitLayoutCtx = &pExportContext->pTopology->ApicidBitLayoutCtx;
+
+    Tools_AppendText(&pExportContext->Text, "  \"processors\": [\n");
+
+    for (ProcessorIndex = 0; ProcessorIndex < pExportContext->pTopology->NumberOfProcessors; ProcessorIndex++)
+    {
+        ApicId = pExportContext->pTopology->pApicIdList[ProcessorIndex];
+
+        Tools_AppendText(&pExportContext->Text, "    { \"processor\": %u, \"apic_id\": %u, \"core_type\": \"%s\", \"native_model_id\": %u,", ProcessorIndex, ApicId,
+                                                Export_Internal_CoreTypeName(Topology_GetCoreType(pExportContext->pTopology, ProcessorIndex)), Topology_GetNativeModelId(pExportContext->pTopology, ProcessorIndex));
+
+        /*
+         * The NUMA node comes from the OS and is null when it is not known.
+         */
+        NumaNode = Topology_GetNumaNode(pExportContext->pTopology, ProcessorIndex);
+
+        if (NumaNode == INVALID_NUMA_NODE)
+        {
+            Tools_AppendText(&pExportContext->Text, " \"numa_node\": null,");
+        }
+        else
+        {
+            Tools_AppendText(&pExportContext->Text, " \"numa_node\": %u,", NumaNode);
+        }
+
+        Tools_AppendText(&pExportContext->Text, " \"domain_ids\": {");
+
+        for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+        {
+            Tools_AppendText(&pExportContext->Text, "%s \"%s\": %u", (DomainIndex == 0) ? "" : ",", Export_Internal_DomainName(pApicidBitLayoutCtx, DomainIndex),
+                                                                                             Topology_GetDomainId(pExportContext->pTopology, ProcessorIndex, DomainIndex, DomainIndex));
+        }
+
+        Tools_AppendText(&pExportContext->Text, " }, \"package_relative_ids\": {");
+
+        for (DomainIndex = 0; DomainIndex < pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+        {
+            Tools_AppendText(&pExportContext->Text, "%s \"%s\": %u", (DomainIndex == 0) ? "" : ",", Export_Internal_DomainName(pApicidBitLayoutCtx, DomainIndex),
+                                                                                             Topology_GetDomainId(pExportContext->pTopology, ProcessorIndex, DomainIndex, pApicidBitLayoutCtx->PackageDomainIndex));
+        }
+
+        Tools_AppendText(&pExportContext->Text, " } }%s\n", (ProcessorIndex + 1 == pExportContext->pTopology->NumberOfProcessors) ? "" : ",");
+    }
+
+    Tools_AppendText(&pExportContext->Text, "  ],\n");
+}
+
+
+/*
+ * Export_Internal_WriteJsonCaches
+ *
+ *    Write every cache and the processors sharing it.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteJsonCaches(PEXPORT_CONTEXT pExportContext)
+{
+    PCPUID_CACHE_TOPOLOGY pCacheTopology;
+    PCPUID_CACHE_INFO pCacheInfo;
+    unsigned int CacheIndex;
+
+    pCacheTopology = &pExportContext->pTopology->CacheTopology;
+
+    Tools_AppendText(&pExportContext->Text, "  \"caches\": [\n");
+
+    for (CacheIndex = 0; CacheIndex < pCacheTopology->NumberOfCaches; CacheIndex++)
+    {
+        pCacheInfo = &pCacheTopology->pCacheInfo[CacheIndex];
+
+        Tools_AppendText(&pExportContext->Text, "    { \"level\": %u, \"type\": \"%s\", \"cache_id\": %u, \"cache_mask\": \"0x%08x\",", pCacheInfo->CacheLevel, Export_Internal_CacheTypeName(pCacheInfo->CacheType), pCacheInfo->CacheId, pCacheInfo->CacheMask);
+        Tools_AppendText(&pExportContext->Text, " \"size\": %u, \"line_size\": %u, \"ways\": %u, \"partitions\": %u, \"sets\": %u,", pCacheInfo->CacheSizeInBytes, pCacheInfo->CacheLineSize, pCacheInfo->CacheWays, pCacheInfo->CachePartitions, pCacheInfo->CacheSets);
+        Tools_AppendText(&pExportContext->Text, " \"self_initializing\": %s, \"fully_associative\": %s, \"inclusive\": %s, \"direct_mapped\": %s, \"complex\": %s, \"wbinvd_flushes_lower_levels\": %s,",
+                                                Export_Internal_BoolName(pCacheInfo->SelfInitializing), Export_Internal_BoolName(pCacheInfo->CacheIsFullyAssociative), Export_Internal_BoolName(pCacheInfo->CacheIsInclusive),
+                                                Export_Internal_BoolName(pCacheInfo->CacheIsDirectMapped), Export_Internal_BoolName(pCacheInfo->CacheIsComplex), Export_Internal_BoolName(pCacheInfo->WbinvdFlushsLowerLevelsSharing));
+        Tools_AppendText(&pExportContext->Text, " \"processors\": [");
+        Export_Internal_WriteProcessorSet(&pExportContext->Text, &pCacheInfo->LPsSharingThisCache, pCacheTopology->NumberOfProcessors, ", ");
+        Tools_AppendText(&pExportContext->Text, "] }%s\n", (CacheIndex + 1 == pCacheTopology->NumberOfCaches) ? "" : ",");
+    }
+
+    Tools_AppendText(&pExportContext->Text, "  ],\n");
+}
+
+
+/*
+ * Export_Internal_WriteJsonTlbs
+ *
+ *    Write every TLB and the processors sharing it.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteJsonTlbs(PEXPORT_CONTEXT pExportContext)
+{
+    PCPUID_TLB_TOPOLOGY pTlbTopology;
+    PCPUID_TLB_INFO pTlbInfo;
+    unsigned int TlbIndex;
+
+    pTlbTopology = &pExportContext->pTopology->TlbTopology;
+
+    Tools_AppendText(&pExportContext->Text, "  \"tlbs\": [\n");
+
+    for (TlbIndex = 0; TlbIndex < pTlbTopology->NumberOfTlbs; TlbIndex++)
+    {
+        pTlbInfo = &pTlbTopology->pTlbInfo[TlbIndex];
+
+        Tools_AppendText(&pExportContext->Text, "    { \"level\": %u, \"type\": \"%s\", \"tlb_id\": %u, \"tlb_mask\": \"0x%08x\",", pTlbInfo->TlbLevel, Export_Internal_TlbTypeName(pTlbInfo->TlbType), pTlbInfo->TlbId, pTlbInfo->TlbMask);
+        Tools_AppendText(&pExportContext->Text, " \"ways\": %u, \"partitioning\": %u, \"sets\": %u, \"fully_associative\": %s,", pTlbInfo->TlbWays, pTlbInfo->TlbParitioning, pTlbInfo->TlbSets, Export_Internal_BoolName(pTlbInfo->FullyAssociative));
+        Tools_AppendText(&pExportContext->Text, " \"page_4k\": %s, \"page_2m\": %s, \"page_4m\": %s, \"page_1g\": %s,", Export_Internal_BoolName(pTlbInfo->_4K_PageSizeEntries), Export_Internal_BoolName(pTlbInfo->_2MB_PageSizeEntries),
+                                                                                                                     Export_Internal_BoolName(pTlbInfo->_4MB_PageSizeEntries), Export_Internal_BoolName(pTlbInfo->_1GB_PageSizeEntries));
+        Tools_AppendText(&pExportContext->Text, " \"processors\": [");
+        Export_Internal_WriteProcessorSet(&pExportContext->Text, &pTlbInfo->LPsSharingThisTlb, pTlbTopology->NumberOfProcessors, ", ");
+        Tools_AppendText(&pExportContext->Text, "] }%s\n", (TlbIndex + 1 == pTlbTopology->NumberOfTlbs) ? "" : ",");
+    }
+
+    Tools_AppendText(&pExportContext->Text, "  ]\n");
+}
+
+
+
+/*
+ * Export_Internal_WriteCsv
+ *
+ *    Write the topology as CSV.  Each section starts with its own header
+ *    row and the first column of every row names the section, so a single
+ *    section can be selected by that column.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteCsv(PEXPORT_CONTEXT pExportContext)
+{
+    Export_Internal_WriteCsvDomains(pExportContext);
+    Export_Internal_WriteCsvProcessors(pExportContext);
+    Export_Internal_WriteCsvCaches(pExportContext);
+    Export_Internal_WriteCsvTlbs(pExportContext);
+}
+
+
+/*
+ * Export_Internal_WriteCsvDomains
+ *
+ *    Write the domain mask matrix, one row for each domain and the
+ *    domain the mask is relative to.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteCsvDomains(PEXPORT_CONTEXT pExportContext)
+{
+    PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx;
+    unsigned int DomainIndex;
+    unsigned int TopDomainIndex;
+
+    pApicidBitLayoutCtx = &pExportContext->pTopology->ApicidBitLayoutCtx;
+
+    Tools_AppendText(&pExportContext->Text, "domain,name,relative_to,mask\n");
+
+    for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        for (TopDomainIndex = DomainIndex; TopDomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; TopDomainIndex++)
+        {
+            Tools_AppendText(&pExportContext->Text, "domain,%s,%s,0x%08x\n", Export_Internal_DomainName(pApicidBitLayoutCtx, DomainIndex),
+                                                                             (TopDomainIndex == DomainIndex) ? "platform" : Export_Internal_DomainName(pApicidBitLayoutCtx, TopDomainIndex),
+                                                                             pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][TopDomainIndex]);
+        }
+    }
+}
+
+
+/*
+ * Export_Internal_WriteCsvProcessors
+ *
+ *    Write one row for every processor with the ID of each domain it is in,
+ *    both across the platform and within its package.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteCsvProcessors(PEXPORT_CONTEXT pExportContext)
+{
+    PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx;
+    unsigned int ProcessorIndex;
+    unsigned int DomainIndex;
+    unsigned int ApicId;
+    unsigned int NumaNode;
+
+    pApicidBitLayoutCtx = &pExportContext->pTopology->ApicidBitLayoutCtx;
+
+    Tools_AppendText(&pExportContext->Text, "processor,index,apic_id,core_type,native_model_id,numa_node");
+
+    for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        Tools_AppendText(&pExportContext->Text, ",%s_id", Export_Internal_DomainName(pApicidBitLayoutCtx, DomainIndex));
+    }
+
+    for (DomainIndex = 0; DomainIndex < pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        Tools_AppendText(&pExportContext->Text, ",%s_package_relative_id", Export_Internal_DomainName(pApicidBitLayoutCtx, DomainIndex));
+    }
+
+    Tools_AppendText(&pExportContext->Text, "\n");
+
+    for (ProcessorIndex = 0; ProcessorIndex < pExportContext->pTopology->NumberOfProcessors; ProcessorIndex++)
+    {
+        ApicId = pExportContext->pTopology->pApicIdList[ProcessorIndex];
+
+        Tools_AppendText(&pExportContext->Text, "processor,%u,%u,%s,%u", ProcessorIndex, ApicId, Export_Internal_CoreTypeName(Topology_GetCoreType(pExportContext->pTopology, ProcessorIndex)),
+                                                                         Topology_GetNativeModelId(pExportContext->pTopology, ProcessorIndex));
+
+        /*
+         * An unknown NUMA node is left as an empty field.
+         */
+        NumaNode = Topology_GetNumaNode(pExportContext->pTopology, ProcessorIndex);
+
+        if (NumaNode == INVALID_NUMA_NODE)
+        {
+            Tools_AppendText(&pExportContext->Text, ",");
+        }
+        else
+        {
+            Tools_AppendText(&pExportContext->Text, ",%u", NumaNode);
+        }
+
+        for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+        {
+            Tools_AppendText(&pExportContext->Text, ",%u", Topology_GetDomainId(pExportContext->pTopology, ProcessorIndex, DomainIndex, DomainIndex));
+        }
+
+        for (DomainIndex = 0; DomainIndex < pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+        {
+            Tools_AppendText(&pExportContext->Text, ",%u", Topology_GetDomainId(pExportContext->pTopology, ProcessorIndex, DomainIndex, pApicidBitLayoutCtx->PackageDomainIndex));
+        }
+
+        Tools_AppendText(&pExportContext->Text, "\n");
+    }
+}
+
+
+/*
+ * Export_Internal_WriteCsvCaches
+ *
+ *    Write one row for every cache, the sharing processors are a space
+ *    separated list of processor indexes.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteCsvCaches(PEXPORT_CONTEXT pExportContext)
+{
+    PCPUID_CACHE_TOPOLOGY pCacheTopology;
+    PCPUID_CACHE_INFO pCacheInfo;
+    unsigned int CacheIndex;
+
+    pCacheTopology = &pExportContext->pTopology->CacheTopology;
+
+    Tools_AppendText(&pExportContext->Text, "cache,index,level,type,cache_id,cache_mask,size,line_size,ways,partitions,sets,self_initializing,fully_associative,inclusive,direct_mapped,complex,wbinvd_flushes_lower_levels,processors\n");
+
+    for (CacheIndex = 0; CacheIndex < pCacheTopology->NumberOfCaches; CacheIndex++)
+    {
+        pCacheInfo = &pCacheTopology->pCacheInfo[CacheIndex];
+
+        Tools_AppendText(&pExportContext->Text, "cache,%u,%u,%s,%u,0x%08x,%u,%u,%u,%u,%u,", CacheIndex, pCacheInfo->CacheLevel, Export_Internal_CacheTypeName(pCacheInfo->CacheType), pCacheInfo->CacheId, pCacheInfo->CacheMask,
+                                                                                           pCacheInfo->CacheSizeInBytes, pCacheInfo->CacheLineSize, pCacheInfo->CacheWays, pCacheInfo->CachePartitions, pCacheInfo->CacheSets);
+        Tools_AppendText(&pExportContext->Text, "%s,%s,%s,%s,%s,%s,", Export_Internal_BoolName(pCacheInfo->SelfInitializing), Export_Internal_BoolName(pCacheInfo->CacheIsFullyAssociative), Export_Internal_BoolName(pCacheInfo->CacheIsInclusive),
+                                                                       Export_Internal_BoolName(pCacheInfo->CacheIsDirectMapped), Export_Internal_BoolName(pCacheInfo->CacheIsComplex), Export_Internal_BoolName(pCacheInfo->WbinvdFlushsLowerLevelsSharing));
+        Export_Internal_WriteProcessorSet(&pExportContext->Text, &pCacheInfo->LPsSharingThisCache, pCacheTopology->NumberOfProcessors, " ");
+        Tools_AppendText(&pExportContext->Text, "\n");
+    }
+}
+
+
+/*
+ * Export_Internal_WriteCsvTlbs
+ *
+ *    Write one row for every TLB, the sharing processors are a space
+ *    separated list of processor indexes.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteCsvTlbs(PEXPORT_CONTEXT pExportContext)
+{
+    PCPUID_TLB_TOPOLOGY pTlbTopology;
+    PCPUID_TLB_INFO pTlbInfo;
+    unsigned int TlbIndex;
+
+    pTlbTopology = &pExportContext->pTopology->TlbTopology;
+
+    Tools_AppendText(&pExportContext->Text, "tlb,index,level,type,tlb_id,tlb_mask,ways,partitioning,sets,fully_associative,page_4k,page_2m,page_4m,page_1g,processors\n");
+
+    for (TlbIndex = 0; TlbIndex < pTlbTopology->NumberOfTlbs; TlbIndex++)
+    {
+        pTlbInfo = &pTlbTopology->pTlbInfo[TlbIndex];
+
+        Tools_AppendText(&pExportContext->Text, "tlb,%u,%u,%s,%u,0x%08x,%u,%u,%u,%s,", TlbIndex, pTlbInfo->TlbLevel, Export_Internal_TlbTypeName(pTlbInfo->TlbType), pTlbInfo->TlbId, pTlbInfo->TlbMask,
+                                                                                      pTlbInfo->TlbWays, pTlbInfo->TlbParitioning, pTlbInfo->TlbSets, Export_Internal_BoolName(pTlbInfo->FullyAssociative));
+        Tools_AppendText(&pExportContext->Text, "%s,%s,%s,%s,", Export_Internal_BoolName(pTlbInfo->_4K_PageSizeEntries), Export_Internal_BoolName(pTlbInfo->_2MB_PageSizeEntries),
+                                                                 Export_Internal_BoolName(pTlbInfo->_4MB_PageSizeEntries), Export_Internal_BoolName(pTlbInfo->_1GB_PageSizeEntries));
+        Export_Internal_WriteProcessorSet(&pExportContext->Text, &pTlbInfo->LPsSharingThisTlb, pTlbTopology->NumberOfProcessors, " ");
+        Tools_AppendText(&pExportContext->Text, "\n");
+    }
+}
+
+
+/*
+ * Export_Internal_WriteHeader
+ *
+ *    Write the domain layout as a C header of constants.  Each domain has its
+ *    global mask, the shift of its ID and a macro to extract the ID from an APIC
+ *    ID, and the same for its ID relative to every higher domain.  The layout is
+ *    also written as an initializer for ParseCpu_MatchDomainLayout so the code
+ *    using the constants can check it is running on the same layout.
+ *
+ * Arguments:
+ *     Export Context
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteHeader(PEXPORT_CONTEXT pExportContext)
+{
+    PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx;
+    unsigned int DomainIndex;
+
+    pApicidBitLayoutCtx = &pExportContext->pTopology->ApicidBitLayoutCtx;
+
+    Tools_AppendText(&pExportContext->Text, "/*\n");
+    Tools_AppendText(&pExportContext->Text, " * The APIC ID layout of a platform with %u processors enumerated by CPUID.%XH.\n", pExportContext->pTopology->NumberOfProcessors, pExportContext->pTopology->Leaf);
+    Tools_AppendText(&pExportContext->Text, " *\n");
+    Tools_AppendText(&pExportContext->Text, " * Generated from the CPUID of the platform, the masks and shifts are only valid\n");
+    Tools_AppendText(&pExportContext->Text, " * when ParseCpu_MatchDomainLayout() of CPUID_LAYOUT_INITIALIZER returns true,\n");
+    Tools_AppendText(&pExportContext->Text, " * otherwise the Topology APIs must be used.\n");
+    Tools_AppendText(&pExportContext->Text, " */\n\n");
+    Tools_AppendText(&pExportContext->Text, "#ifndef __CPUID_LAYOUT_H__\n");
+    Tools_AppendText(&pExportContext->Text, "#define __CPUID_LAYOUT_H__\n\n");
+    Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_LEAF               (0x%X)\n", pExportContext->pTopology->Leaf);
+    Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_NUMBER_OF_DOMAINS  (%u)\n\n", pApicidBitLayoutCtx->PackageDomainIndex + 1);
+
+    Tools_AppendText(&pExportContext->Text, "/*\n");
+    Tools_AppendText(&pExportContext->Text, " * The global mask and ID shift of each domain from the logical processor to the package.\n");
+    Tools_AppendText(&pExportContext->Text, " */\n");
+    Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_MASKS   {");
+
+    for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        Tools_AppendText(&pExportContext->Text, "%s 0x%08XU", DomainIndex ? "," : "", pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][DomainIndex]);
+    }
+
+    Tools_AppendText(&pExportContext->Text, " }\n");
+    Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_SHIFTS  {");
+
+    for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        Tools_AppendText(&pExportContext->Text, "%s %u", DomainIndex ? "," : "", Export_Internal_DomainIdShift(pApicidBitLayoutCtx, DomainIndex));
+    }
+
+    Tools_AppendText(&pExportContext->Text, " }\n");
+
+    for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        Export_Internal_WriteHeaderDomain(pExportContext, DomainIndex);
+    }
+
+    Tools_AppendText(&pExportContext->Text, "\n/*\n");
+    Tools_AppendText(&pExportContext->Text, " * The CPUID_DOMAIN_LAYOUT to check with ParseCpu_MatchDomainLayout(), the leaf,\n");
+    Tools_AppendText(&pExportContext->Text, " * the number of domains and the shift value and type of each domain.\n");
+    Tools_AppendText(&pExportContext->Text, " */\n");
+    Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_INITIALIZER  { 0x%X, %u, {", pExportContext->pTopology->Leaf, pApicidBitLayoutCtx->PackageDomainIndex + 1);
+
+    for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        Tools_AppendText(&pExportContext->Text, "%s %u", DomainIndex ? "," : "", pApicidBitLayoutCtx->ShiftValues[DomainIndex]);
+    }
+
+    Tools_AppendText(&pExportContext->Text, " }, {");
+
+    for (DomainIndex = 0; DomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; DomainIndex++)
+    {
+        Tools_AppendText(&pExportContext->Text, "%s %u", DomainIndex ? "," : "", pApicidBitLayoutCtx->ShiftValueDomain[DomainIndex]);
+    }
+
+    Tools_AppendText(&pExportContext->Text, " } }\n\n");
+    Tools_AppendText(&pExportContext->Text, "#endif\n");
+}
+
+
+/*
+ * Export_Internal_WriteHeaderDomain
+ *
+ *    Write the constants of one domain, its global mask, the shift of its ID
+ *    and its mask relative to every higher domain with a macro for each ID.
+ *
+ * Arguments:
+ *     Export Context, Domain Index
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_WriteHeaderDomain(PEXPORT_CONTEXT pExportContext, unsigned int DomainIndex)
+{
+    PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx;
+    unsigned int TopDomainIndex;
+    char szDomainName[32];
+    char szTopDomainName[32];
+
+    pApicidBitLayoutCtx = &pExportContext->pTopology->ApicidBitLayoutCtx;
+
+    Export_Internal_HeaderDomainName(pApicidBitLayoutCtx, DomainIndex, szDomainName, sizeof(szDomainName));
+
+    Tools_AppendText(&pExportContext->Text, "\n#define CPUID_LAYOUT_%s_MASK  (0x%08XU)\n", szDomainName, pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][DomainIndex]);
+    Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_%s_SHIFT (%u)\n", szDomainName, Export_Internal_DomainIdShift(pApicidBitLayoutCtx, DomainIndex));
+    Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_%s_ID(ApicId) (((ApicId) & CPUID_LAYOUT_%s_MASK) >> CPUID_LAYOUT_%s_SHIFT)\n", szDomainName, szDomainName, szDomainName);
+
+    for (TopDomainIndex = DomainIndex + 1; TopDomainIndex <= pApicidBitLayoutCtx->PackageDomainIndex; TopDomainIndex++)
+    {
+        Export_Internal_HeaderDomainName(pApicidBitLayoutCtx, TopDomainIndex, szTopDomainName, sizeof(szTopDomainName));
+
+        Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_%s_IN_%s_MASK  (0x%08XU)\n", szDomainName, szTopDomainName, pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][TopDomainIndex]);
+        Tools_AppendText(&pExportContext->Text, "#define CPUID_LAYOUT_%s_IN_%s_ID(ApicId) (((ApicId) & CPUID_LAYOUT_%s_IN_%s_MASK) >> CPUID_LAYOUT_%s_SHIFT)\n", szDomainName, szTopDomainName, szDomainName, szTopDomainName, szDomainName);
+    }
+}
+
+
+/*
+ * Export_Internal_HeaderDomainName
+ *
+ *    The name used for a domain in the macros of the header, the export name in
+ *    upper case or the domain index for a domain with no known name.
+ *
+ * Arguments:
+ *     APIC Bit Layout Context, Domain Index, Name Buffer, Size of the Name Buffer
+ *
+ * Return:
+ *     None
+ */
+void Export_Internal_HeaderDomainName(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx, unsigned int DomainIndex, char *pszName, unsigned int NameSize)
+{
+    char *pszDomainName;
+    unsigned int Index;
+
+    pszDomainName = Export_Internal_DomainName(pApicidBitLayoutCtx, DomainIndex);
+
+    if (strcmp(pszDomainName, "unknown") == 0 || strcmp(pszDomainName, "invalid") == 0)
+    {
+        snprintf(pszName, NameSize, "DOMAIN%u", DomainIndex);
+    }
+    else
+    {
+        for (Index = 0; pszDomainName[Index] != 0 && Index < NameSize - 1; Index++)
+        {
+            pszName[Index] = (pszDomainName[Index] >= 'a' && pszDomainName[Index] <= 'z') ? (char)(pszDomainName[Index] - 0x20) : pszDomainName[Index];
+        }
+
+        pszName[Index] = 0;
+    }
+}
+
+
+/*
+ * Export_Internal_DomainIdShift
+ *
+ *    The shift of the ID of a domain, which is the shift value of the domain
+ *    below it since the ID starts at the first bit that domain does not use.
+ *
+ * Arguments:
+ *     APIC Bit Layout Context, Domain Index
+ *
+ * Return:
+ *     The number of bits the masked APIC ID is shifted by
+ */
+unsigned int Export_Internal_DomainIdShift(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx, unsigned int DomainIndex)
+{
+    unsigned int DomainIdShift;
+
+    DomainIdShift = 0;
+
+    if (DomainIndex)
+    {
+        DomainIdShift = pApicidBitLayoutCtx->ShiftValues[DomainIndex - 1];
+    }
+
+    return DomainIdShift;
+}
@@ -16,14 +16,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include "cpuid_topology.h"
 
 
-/*
- * Global application data variable
- */
-extern GLOBAL_DATA g_GlobalData;
-
 
 
 /*
@@ -33,6 +29,7 @@ extern GLOBAL_DATA g_GlobalData;
 typedef struct _FILE_READ_CONTEXT
 {
     FILE *CpuidFile;
+    TEXT_BUFFER Echo;
 
     /*
      * Maintains the current leaf state machine for reading subsequent subleafs.
@@ -49,23 +46,136 @@ typedef struct _FILE_READ_CONTEXT
      */ 
     unsigned int Leaf18Index;
 
+    /*
+     * Maintains the processor relation index of the current CPUID.1A reads
+     */ 
+    unsigned int Leaf1AIndex;
+
+    /*
+     * Maintains the processor relation index of the current CPUID.B reads
+     */ 
+    unsigned int Leaf0BIndex;
+
+    /*
+     * Maintains the processor relation index of the current CPUID.1F reads
+     */ 
+    unsigned int Leaf1FIndex;
+
+    /*
+     * The leafs that are described once for all processors; these are copied into 
+     * each processor's snapshot once all of the APIC IDs have been read. 
+     */
+    CPUID_PROCESSOR_SNAPSHOT SharedLeafs;
+
+    /*
+     * The APIC IDs in processor order, the array grows as they are read.
+     */
+    unsigned int *pApicIds;
+    unsigned int NumberOfApicIds;
+    unsigned int MaximumApicIds;
+
 } FILE_READ_CONTEXT, *PFILE_READ_CONTEXT;
 
 typedef struct _FILE_WRITE_CONTEXT
 {
     FILE *CpuidFile;
+    TEXT_BUFFER Text;
+    TEXT_BUFFER Echo;
     unsigned int NumberOfProcessors;
 
 } FILE_WRITE_CONTEXT, *PFILE_WRITE_CONTEXT;
 
+
+/*
+ * The binary capture format.  All values are 32 bits and the offsets are in bytes from 
+ * the start of the file.  The file is laid out the same as it is used in memory so it 
+ * is loaded with a single read and the subleafs are used in place. 
+ * 
+ *    CPUID_BINARY_HEADER
+ *    CPUID_BINARY_PROCESSOR   [NumberOfProcessors]
+ *    APIC ID                  [NumberOfProcessors]
+ *    CPUID_BINARY_LEAF        [NumberOfLeafs]
+ *    CPUID_REGISTERS          [NumberOfSubleafs]
+ * 
+ * Each processor describes a range of the leaf table and each leaf describes a range
+ * of the subleaf table.  The header size allows later versions to extend the header.
+ */
+#define CPUID_BINARY_SIGNATURE   0x44495043       /* "CPID" */
+#define CPUID_BINARY_VERSION     1
+
+typedef struct _CPUID_BINARY_HEADER
+{
+    unsigned int Signature;
+    unsigned int Version;
+    unsigned int HeaderSize;
+    unsigned int FileSize;
+
+    unsigned int NumberOfProcessors;
+    unsigned int NumberOfLeafs;
+    unsigned int NumberOfSubleafs;
+
+    unsigned int ProcessorTableOffset;
+    unsigned int ApicIdTableOffset;
+    unsigned int LeafTableOffset;
+    unsigned int SubleafTableOffset;
+
+} CPUID_BINARY_HEADER, *PCPUID_BINARY_HEADER;
+
+typedef struct _CPUID_BINARY_PROCESSOR
+{
+    unsigned int FirstLeaf;
+    unsigned int NumberOfLeafs;
+
+} CPUID_BINARY_PROCESSOR, *PCPUID_BINARY_PROCESSOR;
+
+typedef struct _CPUID_BINARY_LEAF
+{
+    unsigned int Leaf;
+    unsigned int FirstSubleaf;
+    unsigned int NumberOfSubleafs;
+
+} CPUID_BINARY_LEAF, *PCPUID_BINARY_LEAF;
+
+/*
+ * A topology cache is a binary capture of this platform with a fingerprint following 
+ * the header.  It is only used while the processors, the boot and the list of APIC IDs 
+ * match the fingerprint, otherwise the processors are captured again. 
+ */
+#define CPUID_BOOT_ID_SIZE        48
+
+typedef struct _CPUID_BINARY_FINGERPRINT
+{
+    CPUID_REGISTERS Leaf0;
+    unsigned int ProcessorSignature;
+    unsigned int NumberOfProcessors;
+    unsigned int ApicIdHash;
+    char szBootId[CPUID_BOOT_ID_SIZE];
+
+} CPUID_BINARY_FINGERPRINT, *PCPUID_BINARY_FINGERPRINT;
+
 /*
  *  Internal Prototypes
  */
+BOOL_TYPE File_Internal_IsBinaryFile(char *pszFileName);
+BOOL_TYPE File_Internal_ReadTextCpuidFromFile(char *pszFileName);
+BOOL_TYPE File_Internal_ReadBinaryCpuidFromFile(char *pszFileName, PCPUID_BINARY_FINGERPRINT pFingerprint);
+BOOL_TYPE File_Internal_IsBinaryTableValid(unsigned int FileSize, unsigned int TableOffset, unsigned int NumberOfEntries, unsigned int EntrySize);
+BOOL_TYPE File_Internal_IsBinaryRangeValid(unsigned int First, unsigned int Count, unsigned int Total);
 BOOL_TYPE File_Internal_DispatchReadLeaf(PFILE_READ_CONTEXT pFileContext, unsigned int LeafNumber);
 BOOL_TYPE File_Internal_DispatchReadSubleaf(PFILE_READ_CONTEXT pFileContext, unsigned int SubleafNumber);
 BOOL_TYPE File_Internal_DispatchReadApicId(PFILE_READ_CONTEXT pFileContext, unsigned int ApicIdNumber);
+BOOL_TYPE File_Internal_SetProcessorCpuid(unsigned int ProcessorNumber, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters);
+BOOL_TYPE File_Internal_SetExtendedTopologyCpuid(PFILE_READ_CONTEXT pFileContext, unsigned int ProcessorNumber, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters);
+BOOL_TYPE File_Internal_CreateSnapshot(PFILE_READ_CONTEXT pFileContext);
+BOOL_TYPE File_Internal_WriteTextCpuidToFile(char *pszFileName);
+BOOL_TYPE File_Internal_WriteBinaryCpuidToFile(char *pszFileName, PCPUID_BINARY_FINGERPRINT pFingerprint);
+BOOL_TYPE File_Internal_BuildFingerprint(PCPUID_BINARY_FINGERPRINT pFingerprint);
+BOOL_TYPE File_Internal_IsFingerprintMatch(PCPUID_BINARY_FINGERPRINT pFingerprint, PCPUID_BINARY_FINGERPRINT pFileFingerprint);
+unsigned int File_Internal_HashApicIds(unsigned int *pApicIds, unsigned int NumberOfProcessors);
+BOOL_TYPE File_Internal_IsCurrentApicIdInSnapshot(void);
 BOOL_TYPE File_Internal_WriteLeafToFile(PFILE_WRITE_CONTEXT pFileContext, unsigned int LeafNumber);
 BOOL_TYPE File_Internal_WriteApicIdsToFile(PFILE_WRITE_CONTEXT pFileContext);
+void File_Internal_Echo(PTEXT_BUFFER pEcho, char *pszFormat, ...);
 
 
 /*
@@ -76,6 +186,8 @@ BOOL_TYPE File_Internal_WriteApicIdsToFile(PFILE_WRITE_CONTEXT pFileContext);
  * with the fake CPUID data to be used with the CPUID
  * algorithms.
  * 
+ * Binary and compressed captures are recognized by their
+ * signature, anything else is read as the text format.
  *
  * Arguments:
  *     File Name
@@ -84,6 +196,314 @@ BOOL_TYPE File_Internal_WriteApicIdsToFile(PFILE_WRITE_CONTEXT pFileContext);
  *     Returns true if successful
  */
 BOOL_TYPE File_ReadCpuidFromFile(char *pszFileName)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    BOOL_TYPE FileReadStatus;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    /*
+    * Always switch to Virtual CPUID; if the file does not contain CPUID information 
+    * then it is invalid anyway. 
+    */
+    pCpuidContext->UseNativeCpuid = BOOL_FALSE;  
+
+    if (File_Internal_IsBinaryFile(pszFileName)) 
+    {
+        FileReadStatus = File_Internal_ReadBinaryCpuidFromFile(pszFileName, NULL);
+    }
+    else if (Compress_IsCompressedFile(pszFileName)) 
+    {
+        FileReadStatus = Compress_ReadCpuidFromFile(pszFileName);
+    }
+    else
+    {
+        FileReadStatus = File_Internal_ReadTextCpuidFromFile(pszFileName);
+    }
+
+    return FileReadStatus;
+}
+
+
+/*
+ * File_Internal_IsBinaryFile
+ *
+ * This function checks if the file starts with the binary capture signature.
+ *
+ * Arguments:
+ *     File Name
+ *     
+ * Return:
+ *     Returns true if this is a binary capture
+ */
+BOOL_TYPE File_Internal_IsBinaryFile(char *pszFileName)
+{
+    FILE *CpuidFile;
+    unsigned int Signature;
+    BOOL_TYPE BinaryFile;
+
+    BinaryFile = BOOL_FALSE;
+
+    CpuidFile = fopen(pszFileName, "rb");
+
+    if (CpuidFile) 
+    {
+        if (fread(&Signature, sizeof(Signature), 1, CpuidFile) == 1 && Signature == CPUID_BINARY_SIGNATURE) 
+        {
+            BinaryFile = BOOL_TRUE;
+        }
+
+        fclose(CpuidFile);
+    }
+
+    return BinaryFile;
+}
+
+
+/*
+ * File_Internal_ReadBinaryCpuidFromFile
+ *
+ * This function loads a binary capture.  The whole file is read into one block
+ * that the snapshot borrows the subleafs from, so there is nothing to parse 
+ * other than checking that the tables are within the file.  A topology cache
+ * is only loaded if its fingerprint matches the one given.
+ *
+ * Arguments:
+ *     File Name, Fingerprint to match or NULL for any binary capture
+ *     
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE File_Internal_ReadBinaryCpuidFromFile(char *pszFileName, PCPUID_BINARY_FINGERPRINT pFingerprint)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    CPUID_BINARY_HEADER BinaryHeader;
+    CPUID_BINARY_FINGERPRINT FileFingerprint;
+    PCPUID_BINARY_PROCESSOR pBinaryProcessors;
+    PCPUID_BINARY_LEAF pBinaryLeafs;
+    PCPUID_REGISTERS pSubleafs;
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshots;
+    unsigned int *pApicIds;
+    unsigned char *pImage;
+    unsigned int ImageSize;
+    unsigned int Index;
+    FILE *CpuidFile;
+    long FileSize;
+    BOOL_TYPE FileReadStatus;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    FileReadStatus = BOOL_FALSE;
+    pImage = NULL;
+
+    Capture_ReleaseSnapshot();
+
+    CpuidFile = fopen(pszFileName, "rb");
+
+    if (CpuidFile) 
+    {
+        fseek(CpuidFile, 0, SEEK_END);
+        FileSize = ftell(CpuidFile);
+        fseek(CpuidFile, 0, SEEK_SET);
+
+        if (fread(&BinaryHeader, sizeof(CPUID_BINARY_HEADER), 1, CpuidFile) == 1) 
+        {
+            FileReadStatus = BOOL_TRUE;
+
+            if (BinaryHeader.Version != CPUID_BINARY_VERSION || BinaryHeader.HeaderSize < sizeof(CPUID_BINARY_HEADER)) 
+            {
+                printf("Unsupported binary CPUID file version %u\n", BinaryHeader.Version);
+                FileReadStatus = BOOL_FALSE;
+            }
+        }
+
+        /*
+         * The fingerprint is checked before the rest of the file is read.
+         */
+        if (FileReadStatus && pFingerprint) 
+        {
+            FileReadStatus = BOOL_FALSE;
+
+            if (BinaryHeader.HeaderSize >= sizeof(CPUID_BINARY_HEADER) + sizeof(CPUID_BINARY_FINGERPRINT) && 
+                fread(&FileFingerprint, sizeof(CPUID_BINARY_FINGERPRINT), 1, CpuidFile) == 1) 
+            {
+                FileReadStatus = File_Internal_IsFingerprintMatch(pFingerprint, &FileFingerprint);
+            }
+        }
+
+        /*
+         * Every table must be within the file before anything is used.
+         */
+        if (FileReadStatus) 
+        {
+            if ((long)BinaryHeader.FileSize != FileSize || BinaryHeader.NumberOfProcessors == 0 ||
+                File_Internal_IsBinaryTableValid(BinaryHeader.FileSize, BinaryHeader.ProcessorTableOffset, BinaryHeader.NumberOfProcessors, sizeof(CPUID_BINARY_PROCESSOR)) == BOOL_FALSE ||
+                File_Internal_IsBinaryTableValid(BinaryHeader.FileSize, BinaryHeader.ApicIdTableOffset, BinaryHeader.NumberOfProcessors, sizeof(unsigned int)) == BOOL_FALSE ||
+                File_Internal_IsBinaryTableValid(BinaryHeader.FileSize, BinaryHeader.LeafTableOffset, BinaryHeader.NumberOfLeafs, sizeof(CPUID_BINARY_LEAF)) == BOOL_FALSE ||
+                File_Internal_IsBinaryTableValid(BinaryHeader.FileSize, BinaryHeader.SubleafTableOffset, BinaryHeader.NumberOfSubleafs, sizeof(CPUID_REGISTERS)) == BOOL_FALSE) 
+            {
+                printf("Binary CPUID file is corrupt\n");
+                FileReadStatus = BOOL_FALSE;
+            }
+        }
+
+        /*
+         * The file is read as a single block followed by room for the leaf snapshots 
+         * that point into it. 
+         */
+        if (FileReadStatus) 
+        {
+            ImageSize = (BinaryHeader.FileSize + 15) & ~15;
+            pImage = (unsigned char *)malloc(ImageSize + BinaryHeader.NumberOfLeafs*sizeof(CPUID_LEAF_SNAPSHOT));
+            FileReadStatus = BOOL_FALSE;
+
+            if (pImage) 
+            {
+                fseek(CpuidFile, 0, SEEK_SET);
+
+                if (fread(pImage, BinaryHeader.FileSize, 1, CpuidFile) == 1) 
+                {
+                    FileReadStatus = BOOL_TRUE;
+                }
+            }
+        }
+
+        fclose(CpuidFile);
+        CpuidFile = NULL;
+    }
+
+    if (FileReadStatus) 
+    {
+        pBinaryProcessors = (PCPUID_BINARY_PROCESSOR)(pImage + BinaryHeader.ProcessorTableOffset);
+        pApicIds          = (unsigned int *)(pImage + BinaryHeader.ApicIdTableOffset);
+        pBinaryLeafs      = (PCPUID_BINARY_LEAF)(pImage + BinaryHeader.LeafTableOffset);
+        pSubleafs         = (PCPUID_REGISTERS)(pImage + BinaryHeader.SubleafTableOffset);
+        pLeafSnapshots    = (PCPUID_LEAF_SNAPSHOT)(pImage + ImageSize);
+
+        for (Index = 0; Index < BinaryHeader.NumberOfLeafs && FileReadStatus; Index++) 
+        {
+            FileReadStatus = File_Internal_IsBinaryRangeValid(pBinaryLeafs[Index].FirstSubleaf, pBinaryLeafs[Index].NumberOfSubleafs, BinaryHeader.NumberOfSubleafs);
+
+            pLeafSnapshots[Index].Leaf             = pBinaryLeafs[Index].Leaf;
+            pLeafSnapshots[Index].NumberOfSubleafs = pBinaryLeafs[Index].NumberOfSubleafs;
+            pLeafSnapshots[Index].MaximumSubleafs  = 0;
+            pLeafSnapshots[Index].pSubleafs        = &pSubleafs[pBinaryLeafs[Index].FirstSubleaf];
+        }
+
+        for (Index = 0; Index < BinaryHeader.NumberOfProcessors && FileReadStatus; Index++) 
+        {
+            FileReadStatus = File_Internal_IsBinaryRangeValid(pBinaryProcessors[Index].FirstLeaf, pBinaryProcessors[Index].NumberOfLeafs, BinaryHeader.NumberOfLeafs);
+        }
+
+        if (FileReadStatus && pFingerprint && File_Internal_HashApicIds(pApicIds, BinaryHeader.NumberOfProcessors) != FileFingerprint.ApicIdHash) 
+        {
+            FileReadStatus = BOOL_FALSE;
+        }
+
+        if (FileReadStatus) 
+        {
+            FileReadStatus = Capture_AllocateSnapshot(BinaryHeader.NumberOfProcessors);
+        }
+
+        if (FileReadStatus) 
+        {
+            Capture_AdoptSnapshotStorage(pImage);
+            pImage = NULL;
+
+            for (Index = 0; Index < BinaryHeader.NumberOfProcessors; Index++) 
+            {
+                Capture_AttachProcessorLeafs(Index, &pLeafSnapshots[pBinaryProcessors[Index].FirstLeaf], pBinaryProcessors[Index].NumberOfLeafs, pApicIds[Index]);
+            }
+
+            if (pCpuidContext->QuietFileEcho == BOOL_FALSE) 
+            {
+                printf("Binary CPUID version %u, %u processors\n", BinaryHeader.Version, BinaryHeader.NumberOfProcessors);
+            }
+        }
+        else
+        {
+            printf("Binary CPUID file is corrupt\n");
+        }
+    }
+
+    if (pImage) 
+    {
+        free(pImage);
+        pImage = NULL;
+    }
+
+    return FileReadStatus;
+}
+
+
+/*
+ * File_Internal_IsBinaryTableValid
+ *
+ * This function checks that a table lies within the binary file.
+ *
+ * Arguments:
+ *     File Size, Table Offset, Number of Entries, Entry Size
+ *     
+ * Return:
+ *     Returns true if the table is within the file
+ */
+BOOL_TYPE File_Internal_IsBinaryTableValid(unsigned int FileSize, unsigned int TableOffset, unsigned int NumberOfEntries, unsigned int EntrySize)
+{
+    BOOL_TYPE TableValid;
+
+    TableValid = BOOL_FALSE;
+
+    if ((TableOffset & 3) == 0 && TableOffset >= sizeof(CPUID_BINARY_HEADER) && TableOffset <= FileSize) 
+    {
+        if (NumberOfEntries <= (FileSize - TableOffset) / EntrySize) 
+        {
+            TableValid = BOOL_TRUE;
+        }
+    }
+
+    return TableValid;
+}
+
+
+/*
+ * File_Internal_IsBinaryRangeValid
+ *
+ * This function checks that a range of entries lies within a table.
+ *
+ * Arguments:
+ *     First Entry, Number of Entries, Number of Entries in the table
+ *     
+ * Return:
+ *     Returns true if the range is within the table
+ */
+BOOL_TYPE File_Internal_IsBinaryRangeValid(unsigned int First, unsigned int Count, unsigned int Total)
+{
+    BOOL_TYPE RangeValid;
+
+    RangeValid = BOOL_FALSE;
+
+    if (Count <= Total && First <= Total - Count) 
+    {
+        RangeValid = BOOL_TRUE;
+    }
+
+    return RangeValid;
+}
+
+
+/*
+ * File_Internal_ReadTextCpuidFromFile
+ *
+ * This function will read a text file that contains
+ * CPUID data.
+ *
+ * Arguments:
+ *     File Name
+ *     
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE File_Internal_ReadTextCpuidFromFile(char *pszFileName)
 {
     FILE_READ_CONTEXT FileContext;
     char Character;
@@ -93,6 +513,7 @@ BOOL_TYPE File_ReadCpuidFromFile(char *pszFileName)
     FileReadStatus = BOOL_FALSE;
 
     memset(&FileContext, 0, sizeof(FILE_READ_CONTEXT));
+    Tools_InitializeTextBuffer(&FileContext.Echo, stdout);
 
     /* 
      * This is a simple file format for reading in data from a file and creating 
@@ -112,14 +533,18 @@ BOOL_TYPE File_ReadCpuidFromFile(char *pszFileName)
      *  
      *       S [Subleaf Number] [EAX] [EBX] [ECX] [EDX]
      *  
-     *    This simulation is very simple and only expects one entry for each Leaf except for Leaf 4 and Leaf 18H.
-     *    Each subsequent description of a new Leaf 4 or Leaf 18H will for that leaf associate it with an incremental
-     *    processor number thus creating an association between the list of APIC IDs and that leaf as tied to a specific
-     *    processor.
+     *    This simulation is very simple and only expects one entry for each Leaf except for Leaf 4, Leaf 0BH, Leaf 18H,
+     *    Leaf 1AH and Leaf 1FH.  Each subsequent description of a new Leaf 4, Leaf 0BH, Leaf 18H, Leaf 1AH or Leaf 1FH will
+     *    for that leaf associate it with an incremental processor number thus creating an association between the list of
+     *    APIC IDs and that leaf as tied to a specific processor.  A file with a single Leaf 0BH or Leaf 1FH uses it for every
+     *    processor with the APIC ID of each processor.
      *  
      *    The APIC IDs for the logical processors are represented by a line that starts with "A" followed by a space and
      *    then the APIC ID value in decimal.  Each subsequent APIC ID will be associated with the next numerical logical processor.
      *  
+     *    The leafs of a processor may be interleaved with the leafs and APIC IDs of other processors since each of these
+     *    is counted seperately.  The file is written one processor at a time.
+     *  
      *       A [APIC ID Value]
      *  
      *    These values must be capital.
@@ -139,11 +564,9 @@ BOOL_TYPE File_ReadCpuidFromFile(char *pszFileName)
     FileContext.CpuidFile = fopen(pszFileName, "r");
 
     /*
-    * Always switch to Virtual CPUID; if the file does not contain CPUID information 
-    * then it is invalid anyway. 
-    */
-    g_GlobalData.UseNativeCpuid = BOOL_FALSE;  
-
+     * The snapshot is built as the file is read and sized by what the file contains.
+     */
+    Capture_ReleaseSnapshot();
 
     if(FileContext.CpuidFile) 
     {
@@ -175,12 +598,185 @@ BOOL_TYPE File_ReadCpuidFromFile(char *pszFileName)
 
         fclose(FileContext.CpuidFile);
         FileContext.CpuidFile = NULL;
+
+        Tools_FlushTextBuffer(&FileContext.Echo);
+
+        if (FileReadStatus) 
+        {
+            FileReadStatus = File_Internal_CreateSnapshot(&FileContext);
+        }
+
+        if (FileReadStatus == BOOL_FALSE) 
+        {
+            Capture_ReleaseSnapshot();
+        }
+
+        Capture_ReleaseProcessor(&FileContext.SharedLeafs);
+
+        if (FileContext.pApicIds) 
+        {
+            free(FileContext.pApicIds);
+            FileContext.pApicIds = NULL;
+        }
     }
 
     return FileReadStatus;
 }
 
 
+/*
+ * File_Internal_CreateSnapshot
+ *
+ * This function completes the per-processor CPUID snapshot from the values read 
+ * from the file, so simulated CPUID is served the same way as native CPUID.
+ *
+ * The file stores a single copy of each CPUID except for CPUID.4, CPUID.B, CPUID.18, CPUID.1A and CPUID.1F.  To
+ * preserve asymmetric topology enumeration these are saved for every processor and so we have to dispatch those
+ * seperately and other leafs we rebuild just the APIC IDs.  Older files saved CPUID.B and CPUID.1F once, these are
+ * shared by every processor with just the APIC ID rebuilt (we do not rebuild EBX in the extended topology leaf, 
+ * which can also be asymmetric but it's only for reporting purposes and not used in this sample).
+ *
+ * The number of processors is the number of APIC IDs in the file.
+ *
+ * Arguments:
+ *     File Context
+ *     
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE File_Internal_CreateSnapshot(PFILE_READ_CONTEXT pFileContext)
+{
+    CPUID_REGISTERS CpuidRegisters;
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshot;
+    unsigned int ProcessorIndex;
+    unsigned int LeafIndex;
+    unsigned int Subleaf;
+    unsigned int ApicId;
+    BOOL_TYPE ProcessorLeaf;
+    BOOL_TYPE SnapshotCreated;
+
+    SnapshotCreated = Capture_ResizeSnapshot(pFileContext->NumberOfApicIds);
+
+    for (ProcessorIndex = 0; ProcessorIndex < pFileContext->NumberOfApicIds && SnapshotCreated; ProcessorIndex++) 
+    {
+        ApicId = pFileContext->pApicIds[ProcessorIndex];
+
+        for (LeafIndex = 0; LeafIndex < pFileContext->SharedLeafs.NumberOfLeafs && SnapshotCreated; LeafIndex++) 
+        {
+            pLeafSnapshot = &pFileContext->SharedLeafs.pLeafs[LeafIndex];
+
+            /*
+             * The extended topology leafs are only shared when the file saved them once.
+             */
+            ProcessorLeaf = BOOL_FALSE;
+
+            if ((pLeafSnapshot->Leaf == 0xB && pFileContext->Leaf0BIndex > 1 && ProcessorIndex < pFileContext->Leaf0BIndex) ||
+                (pLeafSnapshot->Leaf == 0x1F && pFileContext->Leaf1FIndex > 1 && ProcessorIndex < pFileContext->Leaf1FIndex))
+            {
+                ProcessorLeaf = BOOL_TRUE;
+            }
+
+            for (Subleaf = 0; Subleaf < pLeafSnapshot->NumberOfSubleafs && SnapshotCreated && ProcessorLeaf == BOOL_FALSE; Subleaf++) 
+            {
+                memcpy(&CpuidRegisters, &pLeafSnapshot->pSubleafs[Subleaf], sizeof(CPUID_REGISTERS));
+
+                if ((pLeafSnapshot->Leaf == 0xB || pLeafSnapshot->Leaf == 0x1F) && CpuidRegisters.x.Register.Ebx != 0)
+                {
+                    CpuidRegisters.x.Register.Edx = ApicId;
+                }
+
+                if (pLeafSnapshot->Leaf == 0x1)
+                {
+                    CpuidRegisters.x.Register.Ebx = CpuidRegisters.x.Register.Ebx & (~(0xFFu<<24));
+                    CpuidRegisters.x.Register.Ebx = CpuidRegisters.x.Register.Ebx | (ApicId<<24);
+                }
+
+                SnapshotCreated = Capture_SetSnapshotCpuid(ProcessorIndex, pLeafSnapshot->Leaf, Subleaf, &CpuidRegisters);
+            }
+        }
+
+        Capture_CompleteProcessor(ProcessorIndex);
+    }
+
+    return SnapshotCreated;
+}
+
+
+/*
+ * File_Internal_SetProcessorCpuid
+ *
+ * This function stores a CPUID.4, CPUID.18 or CPUID.1A subleaf for a processor, growing 
+ * the snapshot when the file describes more processors than seen so far.
+ *
+ * Arguments:
+ *     Processor Number, Leaf, Subleaf, CPUID Data Structure
+ *     
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE File_Internal_SetProcessorCpuid(unsigned int ProcessorNumber, unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    unsigned int NumberOfProcessors;
+    BOOL_TYPE SubleafStored;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    SubleafStored = BOOL_TRUE;
+
+    if (ProcessorNumber >= pCpuidContext->NumberOfSnapshotProcessors) 
+    {
+        /*
+         * The snapshot is doubled so large files are not copied once per processor, it 
+         * is trimmed to the number of APIC IDs once the file has been read. 
+         */
+        NumberOfProcessors = pCpuidContext->NumberOfSnapshotProcessors*2;
+
+        if (NumberOfProcessors <= ProcessorNumber) 
+        {
+            NumberOfProcessors = ProcessorNumber + 1;
+        }
+
+        SubleafStored = Capture_ResizeSnapshot(NumberOfProcessors);
+    }
+
+    if (SubleafStored) 
+    {
+        SubleafStored = Capture_SetSnapshotCpuid(ProcessorNumber, Leaf, Subleaf, pCpuidRegisters);
+    }
+
+    return SubleafStored;
+}
+
+
+/*
+ * File_Internal_SetExtendedTopologyCpuid
+ *
+ * This function stores a CPUID.B or CPUID.1F subleaf for a processor.  The first 
+ * processor's subleafs are also kept as shared leafs, these describe every processor 
+ * of files that only save the extended topology leaf once. 
+ *
+ * Arguments:
+ *     File Context, Processor Number, Subleaf, CPUID Data Structure
+ *     
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE File_Internal_SetExtendedTopologyCpuid(PFILE_READ_CONTEXT pFileContext, unsigned int ProcessorNumber, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
+{
+    BOOL_TYPE SubleafStored;
+
+    SubleafStored = File_Internal_SetProcessorCpuid(ProcessorNumber, pFileContext->CurrentLeaf, Subleaf, pCpuidRegisters);
+
+    if (SubleafStored && ProcessorNumber == 0) 
+    {
+        SubleafStored = Capture_SetProcessorCpuid(&pFileContext->SharedLeafs, pFileContext->CurrentLeaf, Subleaf, pCpuidRegisters);
+    }
+
+    return SubleafStored;
+}
+
+
 /*
  * File_Internal_DispatchReadLeaf
  *
@@ -206,6 +802,18 @@ BOOL_TYPE File_Internal_DispatchReadLeaf(PFILE_READ_CONTEXT pFileContext, unsign
         case 0x18:
              pFileContext->Leaf18Index++;
              break;
+
+        case 0x1A:
+             pFileContext->Leaf1AIndex++;
+             break;
+
+        case 0xB:
+             pFileContext->Leaf0BIndex++;
+             break;
+
+        case 0x1F:
+             pFileContext->Leaf1FIndex++;
+             break;
     }
 
     return BOOL_TRUE;
@@ -228,6 +836,7 @@ BOOL_TYPE File_Internal_DispatchReadLeaf(PFILE_READ_CONTEXT pFileContext, unsign
 BOOL_TYPE File_Internal_DispatchReadSubleaf(PFILE_READ_CONTEXT pFileContext, unsigned int SubleafNumber)
 {
     BOOL_TYPE SubleafSuccess;
+    CPUID_REGISTERS CpuidRegisters;
     unsigned int Eax;
     unsigned int Ebx;
     unsigned int Ecx;
@@ -237,83 +846,281 @@ BOOL_TYPE File_Internal_DispatchReadSubleaf(PFILE_READ_CONTEXT pFileContext, uns
 
     if (fscanf(pFileContext->CpuidFile, "%u %u %u %u", &Eax, &Ebx, &Ecx, &Edx) != 0) 
     {
-        SubleafSuccess = BOOL_TRUE;
+        CpuidRegisters.x.Register.Eax = Eax;
+        CpuidRegisters.x.Register.Ebx = Ebx;
+        CpuidRegisters.x.Register.Ecx = Ecx;
+        CpuidRegisters.x.Register.Edx = Edx;
 
         switch (pFileContext->CurrentLeaf) 
         {
             case 4:
-                 g_GlobalData.SimulatedCpuidLeaf4[pFileContext->Leaf4Index-1][SubleafNumber][0] = Eax;
-                 g_GlobalData.SimulatedCpuidLeaf4[pFileContext->Leaf4Index-1][SubleafNumber][1] = Ebx;
-                 g_GlobalData.SimulatedCpuidLeaf4[pFileContext->Leaf4Index-1][SubleafNumber][2] = Ecx;
-                 g_GlobalData.SimulatedCpuidLeaf4[pFileContext->Leaf4Index-1][SubleafNumber][3] = Edx;
-                 printf("Proc %i Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->Leaf4Index-1, pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
+                 SubleafSuccess = File_Internal_SetProcessorCpuid(pFileContext->Leaf4Index-1, 4, SubleafNumber, &CpuidRegisters);
+                 File_Internal_Echo(&pFileContext->Echo, "Proc %i Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->Leaf4Index-1, pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
                  break;
 
            case 0x18:
-                 g_GlobalData.SimulatedCpuidLeaf18[pFileContext->Leaf18Index-1][SubleafNumber][0] = Eax;
-                 g_GlobalData.SimulatedCpuidLeaf18[pFileContext->Leaf18Index-1][SubleafNumber][1] = Ebx;
-                 g_GlobalData.SimulatedCpuidLeaf18[pFileContext->Leaf18Index-1][SubleafNumber][2] = Ecx;
-                 g_GlobalData.SimulatedCpuidLeaf18[pFileContext->Leaf18Index-1][SubleafNumber][3] = Edx;
-                 printf("Proc %i Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->Leaf18Index-1, pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
+                 SubleafSuccess = File_Internal_SetProcessorCpuid(pFileContext->Leaf18Index-1, 0x18, SubleafNumber, &CpuidRegisters);
+                 File_Internal_Echo(&pFileContext->Echo, "Proc %i Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->Leaf18Index-1, pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
+                 break;
+
+           case 0x1A:
+                 SubleafSuccess = File_Internal_SetProcessorCpuid(pFileContext->Leaf1AIndex-1, 0x1A, SubleafNumber, &CpuidRegisters);
+                 File_Internal_Echo(&pFileContext->Echo, "Proc %i Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->Leaf1AIndex-1, pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
+                 break;
+
+           case 0xB:
+                 SubleafSuccess = File_Internal_SetExtendedTopologyCpuid(pFileContext, pFileContext->Leaf0BIndex-1, SubleafNumber, &CpuidRegisters);
+                 File_Internal_Echo(&pFileContext->Echo, "Proc %i Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->Leaf0BIndex-1, pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
+                 break;
+
+           case 0x1F:
+                 SubleafSuccess = File_Internal_SetExtendedTopologyCpuid(pFileContext, pFileContext->Leaf1FIndex-1, SubleafNumber, &CpuidRegisters);
+                 File_Internal_Echo(&pFileContext->Echo, "Proc %i Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->Leaf1FIndex-1, pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
                  break;
 
             default:
-                 if (pFileContext->CurrentLeaf < MAX_SIMULATED_LEAFS && SubleafNumber < MAX_SIMULATED_SUBLEAFS)
-                 {
-                     g_GlobalData.SimulatedCpuid[pFileContext->CurrentLeaf][SubleafNumber][0] = Eax;
-                     g_GlobalData.SimulatedCpuid[pFileContext->CurrentLeaf][SubleafNumber][1] = Ebx;
-                     g_GlobalData.SimulatedCpuid[pFileContext->CurrentLeaf][SubleafNumber][2] = Ecx;
-                     g_GlobalData.SimulatedCpuid[pFileContext->CurrentLeaf][SubleafNumber][3] = Edx;
-                     printf("Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
-                 }
-                 else
-                 {
-                     printf("Skipping entry beyond supported maximum leaf/subleafs 0x%x, %i\n", pFileContext->CurrentLeaf, SubleafNumber);
-                 }
+                 SubleafSuccess = Capture_SetProcessorCpuid(&pFileContext->SharedLeafs, pFileContext->CurrentLeaf, SubleafNumber, &CpuidRegisters);
+                 File_Internal_Echo(&pFileContext->Echo, "Leaf %08x Subleaf %u EAX: %08x EBX; %08x ECX: %08x EDX; %08x\n", pFileContext->CurrentLeaf, SubleafNumber, Eax, Ebx, Ecx, Edx);
         }
     }
 
-    return SubleafSuccess;
+    return SubleafSuccess;
+}
+
+
+
+/*
+ * File_Internal_DispatchReadApicId
+ *
+ * This function will update the APIC ID of the next processor
+ * 
+ * There is no error checking, same APIC ID could be submitted twice.
+ *
+ * Arguments:
+ *     File Context, APIC ID Number
+ *     
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE File_Internal_DispatchReadApicId(PFILE_READ_CONTEXT pFileContext, unsigned int ApicIdNumber)
+{
+     unsigned int *pApicIds;
+     unsigned int MaximumApicIds;
+     BOOL_TYPE ApicIdSuccess;
+
+     ApicIdSuccess = BOOL_TRUE;
+
+     if (pFileContext->NumberOfApicIds == pFileContext->MaximumApicIds) 
+     {
+         MaximumApicIds = pFileContext->MaximumApicIds ? pFileContext->MaximumApicIds*2 : 64;
+         pApicIds = (unsigned int *)realloc(pFileContext->pApicIds, MaximumApicIds*sizeof(unsigned int));
+
+         if (pApicIds) 
+         {
+             pFileContext->pApicIds = pApicIds;
+             pFileContext->MaximumApicIds = MaximumApicIds;
+         }
+         else
+         {
+             ApicIdSuccess = BOOL_FALSE;
+         }
+     }
+
+     if (ApicIdSuccess) 
+     {
+        pFileContext->pApicIds[pFileContext->NumberOfApicIds] = ApicIdNumber;
+        File_Internal_Echo(&pFileContext->Echo, "Processor %i  - ApicID - %08x\n", pFileContext->NumberOfApicIds, ApicIdNumber);
+        pFileContext->NumberOfApicIds++;
+     }
+
+     return ApicIdSuccess;
+}
+
+
+
+
+/*
+ * File_WriteCpuidToFile
+ *
+ * Write the CPUID values to a file.
+ *
+ * Arguments:
+ *     File Name, File Format
+ *     
+ * Return:
+ *     Returns true if successful
+ */
+BOOL_TYPE File_WriteCpuidToFile(char *pszFileName, CPUID_FILE_FORMAT FileFormat)
+{
+    BOOL_TYPE FileWritten;
+
+    if (FileFormat == CpuidFileFormat_Binary) 
+    {
+        FileWritten = File_Internal_WriteBinaryCpuidToFile(pszFileName, NULL);
+    }
+    else if (FileFormat == CpuidFileFormat_Compressed) 
+    {
+        FileWritten = Compress_WriteCpuidToFile(pszFileName);
+    }
+    else
+    {
+        FileWritten = File_Internal_WriteTextCpuidToFile(pszFileName);
+    }
+
+    return FileWritten;
 }
 
 
-
 /*
- * File_Internal_DispatchReadApicId
+ * File_Internal_WriteBinaryCpuidToFile
  *
- * This function will update the APIC ID of the next processor
- * 
- * There is no error checking, same APIC ID could be submitted twice.
+ * Write the CPUID snapshot of every processor to a binary capture.  The
+ * file image is built in memory and written with a single write.  A
+ * topology cache has the fingerprint after the header.
  *
  * Arguments:
- *     File Context, APIC ID Number
+ *     File Name, Fingerprint or NULL
  *     
  * Return:
  *     Returns true if successful
  */
-BOOL_TYPE File_Internal_DispatchReadApicId(PFILE_READ_CONTEXT pFileContext, unsigned int ApicIdNumber)
+BOOL_TYPE File_Internal_WriteBinaryCpuidToFile(char *pszFileName, PCPUID_BINARY_FINGERPRINT pFingerprint)
 {
-     if (g_GlobalData.NumberOfSimulatedProcessors < MAX_PROCESSORS) 
-     {
-        g_GlobalData.SimulatedApicIds[g_GlobalData.NumberOfSimulatedProcessors] = ApicIdNumber;
-        printf("Processor %i  - ApicID - %08x\n", g_GlobalData.NumberOfSimulatedProcessors, ApicIdNumber);
-        g_GlobalData.NumberOfSimulatedProcessors++;
-     }
-     else
-     {
-         printf("Too many processors in file, skipping APICID %0x\n", ApicIdNumber);
-     }
+    PCPUID_CONTEXT pCpuidContext;
+    PCPUID_BINARY_HEADER pBinaryHeader;
+    PCPUID_BINARY_FINGERPRINT pFileFingerprint;
+    PCPUID_BINARY_PROCESSOR pBinaryProcessors;
+    PCPUID_BINARY_LEAF pBinaryLeafs;
+    PCPUID_REGISTERS pSubleafs;
+    PCPUID_PROCESSOR_SNAPSHOT pProcessorSnapshot;
+    PCPUID_LEAF_SNAPSHOT pLeafSnapshot;
+    unsigned int *pApicIds;
+    unsigned char *pImage;
+    unsigned int NumberOfLeafs;
+    unsigned int NumberOfSubleafs;
+    unsigned int ProcessorIndex;
+    unsigned int LeafIndex;
+    unsigned int HeaderSize;
+    FILE *CpuidFile;
+    size_t FileSize;
+    BOOL_TYPE FileWritten;
 
-     return BOOL_TRUE;
-}
+    pCpuidContext = Tools_GetCpuidContext();
+
+    FileWritten = BOOL_FALSE;
+    HeaderSize = sizeof(CPUID_BINARY_HEADER);
+
+    if (pFingerprint) 
+    {
+        HeaderSize = HeaderSize + sizeof(CPUID_BINARY_FINGERPRINT);
+    }
+
+    Capture_CaptureProcessors();
+
+    if (pCpuidContext->pProcessorSnapshot) 
+    {
+        NumberOfLeafs = 0;
+        NumberOfSubleafs = 0;
+
+        for (ProcessorIndex = 0; ProcessorIndex < pCpuidContext->NumberOfSnapshotProcessors; ProcessorIndex++) 
+        {
+            pProcessorSnapshot = &pCpuidContext->pProcessorSnapshot[ProcessorIndex];
+            NumberOfLeafs = NumberOfLeafs + pProcessorSnapshot->NumberOfLeafs;
+
+            for (LeafIndex = 0; LeafIndex < pProcessorSnapshot->NumberOfLeafs; LeafIndex++) 
+            {
+                NumberOfSubleafs = NumberOfSubleafs + pProcessorSnapshot->pLeafs[LeafIndex].NumberOfSubleafs;
+            }
+        }
+
+        FileSize = HeaderSize + pCpuidContext->NumberOfSnapshotProcessors*(sizeof(CPUID_BINARY_PROCESSOR) + sizeof(unsigned int)) + 
+                   NumberOfLeafs*sizeof(CPUID_BINARY_LEAF) + NumberOfSubleafs*sizeof(CPUID_REGISTERS);
+
+        pImage = (unsigned char *)calloc(1, FileSize);
 
+        if (pImage) 
+        {
+            pBinaryHeader = (PCPUID_BINARY_HEADER)pImage;
+
+            pBinaryHeader->Signature            = CPUID_BINARY_SIGNATURE;
+            pBinaryHeader->Version              = CPUID_BINARY_VERSION;
+            pBinaryHeader->HeaderSize           = HeaderSize;
+            pBinaryHeader->FileSize             = (unsigned int)FileSize;
+            pBinaryHeader->NumberOfProcessors   = pCpuidContext->NumberOfSnapshotProcessors;
+            pBinaryHeader->NumberOfLeafs        = NumberOfLeafs;
+            pBinaryHeader->NumberOfSubleafs     = NumberOfSubleafs;
+            pBinaryHeader->ProcessorTableOffset = HeaderSize;
+            pBinaryHeader->ApicIdTableOffset    = pBinaryHeader->ProcessorTableOffset + pBinaryHeader->NumberOfProcessors*sizeof(CPUID_BINARY_PROCESSOR);
+            pBinaryHeader->LeafTableOffset      = pBinaryHeader->ApicIdTableOffset + pBinaryHeader->NumberOfProcessors*sizeof(unsigned int);
+            pBinaryHeader->SubleafTableOffset   = pBinaryHeader->LeafTableOffset + NumberOfLeafs*sizeof(CPUID_BINARY_LEAF);
+
+            pBinaryProcessors = (PCPUID_BINARY_PROCESSOR)(pImage + pBinaryHeader->ProcessorTableOffset);
+            pApicIds          = (unsigned int *)(pImage + pBinaryHeader->ApicIdTableOffset);
+            pBinaryLeafs      = (PCPUID_BINARY_LEAF)(pImage + pBinaryHeader->LeafTableOffset);
+            pSubleafs         = (PCPUID_REGISTERS)(pImage + pBinaryHeader->SubleafTableOffset);
+
+            NumberOfLeafs = 0;
+            NumberOfSubleafs = 0;
+
+            for (ProcessorIndex = 0; ProcessorIndex < pCpuidContext->NumberOfSnapshotProcessors; ProcessorIndex++) 
+            {
+                pProcessorSnapshot = &pCpuidContext->pProcessorSnapshot[ProcessorIndex];
+
+                pBinaryProcessors[ProcessorIndex].FirstLeaf     = NumberOfLeafs;
+                pBinaryProcessors[ProcessorIndex].NumberOfLeafs = pProcessorSnapshot->NumberOfLeafs;
+                pApicIds[ProcessorIndex] = pProcessorSnapshot->ApicId;
+
+                for (LeafIndex = 0; LeafIndex < pProcessorSnapshot->NumberOfLeafs; LeafIndex++) 
+                {
+                    pLeafSnapshot = &pProcessorSnapshot->pLeafs[LeafIndex];
+
+                    pBinaryLeafs[NumberOfLeafs].Leaf             = pLeafSnapshot->Leaf;
+                    pBinaryLeafs[NumberOfLeafs].FirstSubleaf     = NumberOfSubleafs;
+                    pBinaryLeafs[NumberOfLeafs].NumberOfSubleafs = pLeafSnapshot->NumberOfSubleafs;
+
+                    memcpy(&pSubleafs[NumberOfSubleafs], pLeafSnapshot->pSubleafs, pLeafSnapshot->NumberOfSubleafs*sizeof(CPUID_REGISTERS));
+
+                    NumberOfLeafs++;
+                    NumberOfSubleafs = NumberOfSubleafs + pLeafSnapshot->NumberOfSubleafs;
+                }
+            }
+
+            if (pFingerprint) 
+            {
+                pFileFingerprint = (PCPUID_BINARY_FINGERPRINT)(pImage + sizeof(CPUID_BINARY_HEADER));
+                memcpy(pFileFingerprint, pFingerprint, sizeof(CPUID_BINARY_FINGERPRINT));
+                pFileFingerprint->ApicIdHash = File_Internal_HashApicIds(pApicIds, pBinaryHeader->NumberOfProcessors);
+            }
+
+            CpuidFile = fopen(pszFileName, "wb");
+
+            if (CpuidFile) 
+            {
+                if (fwrite(pImage, FileSize, 1, CpuidFile) == 1) 
+                {
+                    FileWritten = BOOL_TRUE;
+
+                    if (pCpuidContext->QuietFileEcho == BOOL_FALSE) 
+                    {
+                        printf("Binary CPUID version %u, %u processors\n", CPUID_BINARY_VERSION, pCpuidContext->NumberOfSnapshotProcessors);
+                    }
+                }
+
+                fclose(CpuidFile);
+            }
+
+            free(pImage);
+        }
+    }
 
+    return FileWritten;
+}
 
 
 /*
- * File_WriteCpuidToFile
+ * File_Internal_WriteTextCpuidToFile
  *
- * Write the CPUID values to a file.
+ * Write the CPUID values to a text file.
  *
  * Arguments:
  *     File Name
@@ -321,7 +1128,7 @@ BOOL_TYPE File_Internal_DispatchReadApicId(PFILE_READ_CONTEXT pFileContext, unsi
  * Return:
  *     Returns true if successful
  */
-BOOL_TYPE File_WriteCpuidToFile(char *pszFileName)
+BOOL_TYPE File_Internal_WriteTextCpuidToFile(char *pszFileName)
 {
     FILE_WRITE_CONTEXT FileWriteContext;
     CPUID_REGISTERS CpuidRegisters;
@@ -333,6 +1140,7 @@ BOOL_TYPE File_WriteCpuidToFile(char *pszFileName)
     FileWritten = BOOL_FALSE;
 
     memset(&FileWriteContext, 0, sizeof(FILE_WRITE_CONTEXT));
+    Tools_InitializeTextBuffer(&FileWriteContext.Echo, stdout);
 
     /* 
      * This is a simple file format for reading in data from a file and creating 
@@ -352,14 +1160,18 @@ BOOL_TYPE File_WriteCpuidToFile(char *pszFileName)
      *  
      *       S [Subleaf Number] [EAX] [EBX] [ECX] [EDX]
      *  
-     *    This simulation is very simple and only expects one entry for each Leaf except for Leaf 4 and Leaf 18H.
-     *    Each subsequent description of a new Leaf 4 or Leaf 18H will for that leaf associate it with an incremental
-     *    processor number thus creating an association between the list of APIC IDs and that leaf as tied to a specific
-     *    processor.
+     *    This simulation is very simple and only expects one entry for each Leaf except for Leaf 4, Leaf 0BH, Leaf 18H,
+     *    Leaf 1AH and Leaf 1FH.  Each subsequent description of a new Leaf 4, Leaf 0BH, Leaf 18H, Leaf 1AH or Leaf 1FH will
+     *    for that leaf associate it with an incremental processor number thus creating an association between the list of
+     *    APIC IDs and that leaf as tied to a specific processor.  A file with a single Leaf 0BH or Leaf 1FH uses it for every
+     *    processor with the APIC ID of each processor.
      *  
      *    The APIC IDs for the logical processors are represented by a line that starts with "A" followed by a space and
      *    then the APIC ID value in decimal.  Each subsequent APIC ID will be associated with the next numerical logical processor.
      *  
+     *    The leafs of a processor may be interleaved with the leafs and APIC IDs of other processors since each of these
+     *    is counted seperately.  The file is written one processor at a time.
+     *  
      *       A [APIC ID Value]
      *  
      *    These values must be capital.
@@ -381,6 +1193,14 @@ BOOL_TYPE File_WriteCpuidToFile(char *pszFileName)
     {
         FileWritten = BOOL_TRUE;
 
+        /*
+         * The file is built in memory and written in large blocks instead of a write 
+         * for every record. 
+         */
+        Tools_InitializeTextBuffer(&FileWriteContext.Text, FileWriteContext.CpuidFile);
+
+        Capture_CaptureProcessors();
+
         Tools_ReadCpuid(0, 0, &CpuidRegisters);
         MaximumLeaf = CpuidRegisters.x.Register.Eax;
         FileWriteContext.NumberOfProcessors = Tools_GetNumberOfProcessors();
@@ -393,42 +1213,42 @@ BOOL_TYPE File_WriteCpuidToFile(char *pszFileName)
             File_Internal_WriteLeafToFile(&FileWriteContext, 1);
         }
 
-        if (MaximumLeaf >= 0x4)
+        /*
+         * Each processor is visited once and all of its per-processor leafs and its 
+         * APIC ID are written together, including the extended topology leafs which 
+         * may differ between processors on asymmetric platforms. 
+         */
+        for (Index = 0; Index < FileWriteContext.NumberOfProcessors; Index++) 
         {
-            for (Index = 0; Index < FileWriteContext.NumberOfProcessors; Index++) 
+            File_Internal_Echo(&FileWriteContext.Echo, "* Processor %i\n", Index);
+            Tools_SetAffinity(Index);
+
+            if (MaximumLeaf >= 0x4)
             {
-                printf("* Processor %i\n", Index);
-                Tools_SetAffinity(Index);
                 File_Internal_WriteLeafToFile(&FileWriteContext, 0x4);
             }
-        }
 
-        if (MaximumLeaf >= 0xB)
-        {
-            File_Internal_WriteLeafToFile(&FileWriteContext, 0xB);
-        }
+            if (MaximumLeaf >= 0xB)
+            {
+                File_Internal_WriteLeafToFile(&FileWriteContext, 0xB);
+            }
 
-        if (MaximumLeaf >= 0x18)
-        {
-            for (Index = 0; Index < FileWriteContext.NumberOfProcessors; Index++) 
+            if (MaximumLeaf >= 0x18)
             {
-                printf("* Processor %i\n", Index);
-                Tools_SetAffinity(Index);
                 File_Internal_WriteLeafToFile(&FileWriteContext, 0x18);
             }
-        }
-
-        if (MaximumLeaf >= 0x1F)
-        {
-            File_Internal_WriteLeafToFile(&FileWriteContext, 0x1F);
-        }
 
+            if (MaximumLeaf >= 0x1A)
+            {
+                File_Internal_WriteLeafToFile(&FileWriteContext, 0x1A);
+            }
 
-        for (Index = 0; Index < FileWriteContext.NumberOfProcessors; Index++) 
-        {
-            Tools_SetAffinity(Index);
+            if (MaximumLeaf >= 0x1F)
+            {
+                File_Internal_WriteLeafToFile(&FileWriteContext, 0x1F);
+            }
 
-            if (CpuidRegisters.x.Register.Eax >= 0xB)
+            if (MaximumLeaf >= 0xB)
             {
                 Tools_ReadCpuid(0xB, 0, &CpuidRegisters);
                 ApicId = CpuidRegisters.x.Register.Edx;
@@ -438,11 +1258,21 @@ BOOL_TYPE File_WriteCpuidToFile(char *pszFileName)
                 Tools_ReadCpuid(1, 0, &CpuidRegisters);
                 ApicId = (CpuidRegisters.x.Register.Ebx >> 24);
             }
-            fprintf(FileWriteContext.CpuidFile, "A %i\n", ApicId);
-            printf("A %i\n", ApicId);
+
+            Tools_AppendText(&FileWriteContext.Text, "A %i\n", ApicId);
+            File_Internal_Echo(&FileWriteContext.Echo, "A %i\n", ApicId);
+        }
+
+        Tools_FlushTextBuffer(&FileWriteContext.Text);
+
+        if (ferror(FileWriteContext.CpuidFile))
+        {
+            FileWritten = BOOL_FALSE;
         }
 
         fclose(FileWriteContext.CpuidFile);
+
+        Tools_FlushTextBuffer(&FileWriteContext.Echo);
     }
 
     return FileWritten;
@@ -470,8 +1300,8 @@ BOOL_TYPE File_Internal_WriteLeafToFile(PFILE_WRITE_CONTEXT pFileContext, unsign
     BOOL_TYPE LeafWritten;
     BOOL_TYPE NextSubleaf;
 
-    fprintf(pFileContext->CpuidFile, "L %i\n", LeafNumber);
-    printf("L %i\n", LeafNumber);
+    Tools_AppendText(&pFileContext->Text, "L %i\n", LeafNumber);
+    File_Internal_Echo(&pFileContext->Echo, "L %i\n", LeafNumber);
 
     CurrentSubleaf = 0;
 
@@ -483,8 +1313,8 @@ BOOL_TYPE File_Internal_WriteLeafToFile(PFILE_WRITE_CONTEXT pFileContext, unsign
 
         Tools_ReadCpuid(LeafNumber, CurrentSubleaf, pCpuidReadValues);
 
-        fprintf(pFileContext->CpuidFile, "S %u %u %u %u %u\n", CurrentSubleaf, pCpuidReadValues->x.Register.Eax, pCpuidReadValues->x.Register.Ebx, pCpuidReadValues->x.Register.Ecx, pCpuidReadValues->x.Register.Edx);
-        printf("S %u %u %u %u %u\n", CurrentSubleaf, pCpuidReadValues->x.Register.Eax, pCpuidReadValues->x.Register.Ebx, pCpuidReadValues->x.Register.Ecx, pCpuidReadValues->x.Register.Edx);
+        Tools_AppendText(&pFileContext->Text, "S %u %u %u %u %u\n", CurrentSubleaf, pCpuidReadValues->x.Register.Eax, pCpuidReadValues->x.Register.Ebx, pCpuidReadValues->x.Register.Ecx, pCpuidReadValues->x.Register.Edx);
+        File_Internal_Echo(&pFileContext->Echo, "S %u %u %u %u %u\n", CurrentSubleaf, pCpuidReadValues->x.Register.Eax, pCpuidReadValues->x.Register.Ebx, pCpuidReadValues->x.Register.Ecx, pCpuidReadValues->x.Register.Edx);
         CurrentSubleaf++;
 
         switch (LeafNumber) 
@@ -515,4 +1345,307 @@ BOOL_TYPE File_Internal_WriteLeafToFile(PFILE_WRITE_CONTEXT pFileContext, unsign
 
 
 
+/*
+ * File_ReadTopologyCache
+ *
+ * Loads the CPUID of this platform from a topology cache so the processors do not
+ * need to be captured again.  The cache is only used if it was saved on this boot
+ * with the same processors, its APIC IDs are intact and include the APIC ID of the
+ * processor this is running on.  The snapshot is used as native CPUID.
+ *
+ * Arguments:
+ *     File Name
+ *     
+ * Return:
+ *     Returns true if the cache matches and was loaded
+ */
+BOOL_TYPE File_ReadTopologyCache(char *pszFileName)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    CPUID_BINARY_FINGERPRINT Fingerprint;
+    BOOL_TYPE CacheLoaded;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    CacheLoaded = BOOL_FALSE;
+
+    pCpuidContext->UseNativeCpuid = BOOL_TRUE;
+
+    if (File_Internal_BuildFingerprint(&Fingerprint) && File_Internal_IsBinaryFile(pszFileName)) 
+    {
+        CacheLoaded = File_Internal_ReadBinaryCpuidFromFile(pszFileName, &Fingerprint);
+
+        if (CacheLoaded && File_Internal_IsCurrentApicIdInSnapshot() == BOOL_FALSE) 
+        {
+            Capture_ReleaseSnapshot();
+            CacheLoaded = BOOL_FALSE;
+        }
+    }
+
+    return CacheLoaded;
+}
+
+
+/*
+ * File_WriteTopologyCache
+ *
+ * Saves the CPUID of this platform as a topology cache with the fingerprint of
+ * the processors and this boot, the processors are captured if they have not been.
+ *
+ * Arguments:
+ *     File Name
+ *     
+ * Return:
+ *     Returns true if the cache was saved
+ */
+BOOL_TYPE File_WriteTopologyCache(char *pszFileName)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    CPUID_BINARY_FINGERPRINT Fingerprint;
+    BOOL_TYPE CacheWritten;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    CacheWritten = BOOL_FALSE;
+
+    if (pCpuidContext->UseNativeCpuid && File_Internal_BuildFingerprint(&Fingerprint)) 
+    {
+        CacheWritten = File_Internal_WriteBinaryCpuidToFile(pszFileName, &Fingerprint);
+    }
+
+    return CacheWritten;
+}
+
+
+/*
+ * File_Internal_BuildFingerprint
+ *
+ * Builds the fingerprint of this platform without migrating to other processors,
+ * from CPUID.0 and the CPUID.1 signature of this processor, the number of 
+ * processors and the boot ID.  The APIC ID hash is filled in from the snapshot.
+ *
+ * Arguments:
+ *     Fingerprint to fill in
+ *     
+ * Return:
+ *     Returns true if the fingerprint was built
+ */
+BOOL_TYPE File_Internal_BuildFingerprint(PCPUID_BINARY_FINGERPRINT pFingerprint)
+{
+    CPUID_REGISTERS CpuidRegisters;
+
+    memset(pFingerprint, 0, sizeof(CPUID_BINARY_FINGERPRINT));
+
+    Os_Platform_Read_Cpuid(0, 0, &pFingerprint->Leaf0);
+    Os_Platform_Read_Cpuid(1, 0, &CpuidRegisters);
+
+    pFingerprint->ProcessorSignature = CpuidRegisters.x.Register.Eax;
+    pFingerprint->NumberOfProcessors = Os_GetNumberOfProcessors();
+
+    return Os_GetBootId(pFingerprint->szBootId, CPUID_BOOT_ID_SIZE);
+}
+
+
+/*
+ * File_Internal_IsFingerprintMatch
+ *
+ * Compares the fingerprint of this platform with the one in a topology cache,
+ * the APIC ID hash is checked against the file once it is loaded.
+ *
+ * Arguments:
+ *     Fingerprint, File Fingerprint
+ *     
+ * Return:
+ *     Returns true if they match
+ */
+BOOL_TYPE File_Internal_IsFingerprintMatch(PCPUID_BINARY_FINGERPRINT pFingerprint, PCPUID_BINARY_FINGERPRINT pFileFingerprint)
+{
+    BOOL_TYPE FingerprintMatch;
+
+    FingerprintMatch = BOOL_FALSE;
+
+    pFileFingerprint->szBootId[CPUID_BOOT_ID_SIZE - 1] = 0;
+
+    if (memcmp(&pFingerprint->Leaf0, &pFileFingerprint->Leaf0, sizeof(CPUID_REGISTERS)) == 0 &&
+        pFingerprint->ProcessorSignature == pFileFingerprint->ProcessorSignature &&
+        pFingerprint->NumberOfProcessors == pFileFingerprint->NumberOfProcessors &&
+        strcmp(pFingerprint->szBootId, pFileFingerprint->szBootId) == 0) 
+    {
+        FingerprintMatch = BOOL_TRUE;
+    }
+
+    return FingerprintMatch;
+}
+
+
+/*
+ * File_Internal_HashApicIds
+ *
+ * Hashes the APIC IDs in processor order with FNV-1a.
+ *
+ * Arguments:
+ *     APIC ID List, Number of Processors
+ *     
+ * Return:
+ *     Hash of the APIC IDs
+ */
+unsigned int File_Internal_HashApicIds(unsigned int *pApicIds, unsigned int NumberOfProcessors)
+{
+    unsigned int ProcessorIndex;
+    unsigned int ByteIndex;
+    unsigned int Hash;
+
+    Hash = 0x811C9DC5;
+
+    for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
+    {
+        for (ByteIndex = 0; ByteIndex < sizeof(unsigned int); ByteIndex++) 
+        {
+            Hash = (Hash ^ ((pApicIds[ProcessorIndex] >> (ByteIndex*8)) & 0xFF))*0x01000193;
+        }
+    }
+
+    return Hash;
+}
+
+
+/*
+ * File_Internal_IsCurrentApicIdInSnapshot
+ *
+ * Checks that the APIC ID of the processor this is running on is one 
+ * of the processors in the snapshot.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     Returns true if the APIC ID is in the snapshot
+ */
+BOOL_TYPE File_Internal_IsCurrentApicIdInSnapshot(void)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    CPUID_REGISTERS CpuidRegisters;
+    unsigned int ProcessorIndex;
+    unsigned int ApicId;
+    unsigned int SnapshotApicId;
+    BOOL_TYPE ApicIdFound;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    ApicIdFound = BOOL_FALSE;
+
+    Os_Platform_Read_Cpuid(0, 0, &CpuidRegisters);
+
+    if (CpuidRegisters.x.Register.Eax >= 0xB) 
+    {
+        Os_Platform_Read_Cpuid(0xB, 0, &CpuidRegisters);
+    }
+    else
+    {
+        CpuidRegisters.x.Register.Ebx = 0;
+    }
+
+    if (CpuidRegisters.x.Register.Ebx != 0) 
+    {
+        ApicId = CpuidRegisters.x.Register.Edx;
+    }
+    else
+    {
+        Os_Platform_Read_Cpuid(1, 0, &CpuidRegisters);
+        ApicId = (CpuidRegisters.x.Register.Ebx >> 24);
+    }
+
+    for (ProcessorIndex = 0; ProcessorIndex < pCpuidContext->NumberOfSnapshotProcessors && ApicIdFound == BOOL_FALSE; ProcessorIndex++) 
+    {
+        if (Capture_GetSnapshotApicId(ProcessorIndex, &SnapshotApicId) && SnapshotApicId == ApicId) 
+        {
+            ApicIdFound = BOOL_TRUE;
+        }
+    }
+
+    return ApicIdFound;
+}
+
+
+/*
+ * File_SetQuietEcho
+ *
+ * Turns off echoing the records of a CPUID file to the console as
+ * it is loaded or saved.
+ *
+ * Arguments:
+ *     True to be quiet
+ *     
+ * Return:
+ *     None
+ */
+void File_SetQuietEcho(BOOL_TYPE QuietFileEcho)
+{
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    pCpuidContext->QuietFileEcho = QuietFileEcho;
+}
+
+
+/*
+ * File_SetEchoSink
+ *
+ * Streams the records of a CPUID file to a caller supplied sink as it 
+ * is loaded or saved instead of the console, NULL restores the console.
+ *
+ * Arguments:
+ *     Sink, Sink Context
+ *     
+ * Return:
+ *     None
+ */
+void File_SetEchoSink(PFN_FILE_ECHO_SINK pfnFileEchoSink, void *pContext)
+{
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    pCpuidContext->pfnFileEchoSink = pfnFileEchoSink;
+    pCpuidContext->pFileEchoContext = pContext;
+}
+
+
+/*
+ * File_Internal_Echo
+ *
+ * Echo one record of a CPUID file.  Records go straight to the sink if one is
+ * set, otherwise they are collected to be written to the console at once.
+ *
+ * Arguments:
+ *     Echo Buffer, Format, Arguments
+ *     
+ * Return:
+ *     None
+ */
+void File_Internal_Echo(PTEXT_BUFFER pEcho, char *pszFormat, ...)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    char szRecord[MAX_TEXT_RECORD];
+    va_list Arguments;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    if (pCpuidContext->pfnFileEchoSink || pCpuidContext->QuietFileEcho == BOOL_FALSE) 
+    {
+        va_start(Arguments, pszFormat);
+        vsprintf(szRecord, pszFormat, Arguments);
+        va_end(Arguments);
+
+        if (pCpuidContext->pfnFileEchoSink) 
+        {
+            pCpuidContext->pfnFileEchoSink(szRecord, pCpuidContext->pFileEchoContext);
+        }
+        else
+        {
+            Tools_AppendTextRecord(pEcho, szRecord);
+        }
+    }
+}
 
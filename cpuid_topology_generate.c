@@ -0,0 +1,643 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+
+/*
+ * Constants, values for local use
+ */
+#define GENERATE_MAXIMUM_PROCESSORS     65536
+#define GENERATE_MAXIMUM_GAP_BITS       8
+#define GENERATE_MAXIMUM_LEAF           0x1F
+#define GENERATE_MAXIMUM_TLB_SUBLEAF    3
+#define GENERATE_SIGNATURE              0x000806F8
+#define GENERATE_FEATURES_ECX           0x7FFEFBFF
+#define GENERATE_FEATURES_EDX           0xBFEBFBFF
+#define GENERATE_CACHE_LINE_SIZE        64
+#define GENERATE_L3_SETS_PER_CORE       2048
+
+
+/*
+ * The APIC ID layout of a synthetic platform.  The field of each level starts at
+ * its shift and the last entry is the width of the whole APIC ID, the processors
+ * of each level are the number of logical processors in one of that level.
+ */
+typedef struct _GENERATE_LAYOUT
+{
+    unsigned int FieldShift[GenerateLevel_MaximumLevels + 1];
+    unsigned int ProcessorsInLevel[GenerateLevel_MaximumLevels + 1];
+    unsigned int NumberOfProcessors;
+
+} GENERATE_LAYOUT, *PGENERATE_LAYOUT;
+
+
+/*
+ * The CPUID.1FH domain type each level is reported as.
+ */
+const unsigned int g_GenerateDomainType[GenerateLevel_Package] = { LogicalProcessorDomain, CoreDomain, ModuleDomain, DieDomain };
+
+/*
+ * The specification letter of each level.
+ */
+const char g_GenerateLevelLetter[GenerateLevel_MaximumLevels] = { 't', 'c', 'm', 'd', 'p' };
+
+
+/*
+ *  Internal Prototypes
+ */
+BOOL_TYPE Generate_Internal_ParseLevel(char Letter, PGENERATE_LEVEL pLevel);
+unsigned int Generate_Internal_BuildLayout(PGENERATE_SPECIFICATION pSpecification, PGENERATE_LAYOUT pLayout);
+unsigned int Generate_Internal_ComputeApicId(PGENERATE_SPECIFICATION pSpecification, PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex);
+BOOL_TYPE Generate_Internal_BuildProcessor(PGENERATE_SPECIFICATION pSpecification, PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex);
+BOOL_TYPE Generate_Internal_BuildCacheLeaf(PGENERATE_SPECIFICATION pSpecification, PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex);
+BOOL_TYPE Generate_Internal_BuildTopologyLeafs(PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex, unsigned int ApicId);
+BOOL_TYPE Generate_Internal_BuildTlbLeaf(PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex);
+BOOL_TYPE Generate_Internal_SetSubleaf(unsigned int ProcessorIndex, unsigned int Leaf, unsigned int Subleaf, unsigned int Eax, unsigned int Ebx, unsigned int Ecx, unsigned int Edx);
+unsigned int Generate_Internal_SharingMask(unsigned int Shift, unsigned int MaximumMask);
+
+
+
+/*
+ * Generate_ParseSpecification
+ *
+ *    Parses a synthetic platform specification of comma separated settings,
+ *    P, D, M, C and T set the number of packages, dies in each package, modules
+ *    in each die, cores in each module and threads in each core.  G sets the
+ *    bits of unused core IDs between each core and L2 and L3 set the level the
+ *    cache is shared across, i.e. P=8,D=2,M=4,C=4,T=2,G=1,L2=M,L3=D
+ *
+ *    Levels that are not set are one, the L2 is shared by a core and the L3 by
+ *    a package.
+ *
+ * Arguments:
+ *     Specification String, Specification to fill in
+ *
+ * Return:
+ *     Returns true if the specification describes a valid platform
+ */
+BOOL_TYPE Generate_ParseSpecification(char *pszSpecification, PGENERATE_SPECIFICATION pSpecification)
+{
+    GENERATE_LAYOUT Layout;
+    GENERATE_LEVEL Level;
+    unsigned int Value;
+    char *pszCursor;
+    char *pszEnd;
+    char Setting;
+    BOOL_TYPE SpecificationValid;
+
+    memset(pSpecification, 0, sizeof(GENERATE_SPECIFICATION));
+
+    for (Level = GenerateLevel_Thread; Level < GenerateLevel_MaximumLevels; Level++)
+    {
+        pSpecification->LevelCount[Level] = 1;
+    }
+
+    pSpecification->L2SharingLevel = GenerateLevel_Core;
+    pSpecification->L3SharingLevel = GenerateLevel_Package;
+
+    SpecificationValid = BOOL_TRUE;
+    pszCursor = pszSpecification;
+
+    while (*pszCursor != 0 && SpecificationValid)
+    {
+        Setting = (*pszCursor | ((char)0x20));
+        pszCursor++;
+
+        if (Setting == 'l' && (*pszCursor == '2' || *pszCursor == '3'))
+        {
+            Setting = *pszCursor;
+            pszCursor++;
+        }
+
+        if (*pszCursor == '=')
+        {
+            pszCursor++;
+
+            if (Setting == '2' || Setting == '3')
+            {
+                SpecificationValid = Generate_Internal_ParseLevel(*pszCursor, &Level);
+
+                if (SpecificationValid)
+                {
+                    pszCursor++;
+
+                    if (Setting == '2')
+                    {
+                        pSpecification->L2SharingLevel = Level;
+                    }
+                    else
+                    {
+                        pSpecification->L3SharingLevel = Level;
+                    }
+                }
+            }
+            else
+            {
+                Value = (unsigned int)strtoul(pszCursor, &pszEnd, 10);
+                SpecificationValid = (pszEnd != pszCursor) ? BOOL_TRUE : BOOL_FALSE;
+                pszCursor = pszEnd;
+
+                if (SpecificationValid)
+                {
+                    if (Setting == 'g')
+                    {
+                        pSpecification->CoreIdGapBits = Value;
+                    }
+                    else
+                    {
+                        SpecificationValid = Generate_Internal_ParseLevel(Setting, &Level);
+
+                        if (SpecificationValid)
+                        {
+                            pSpecification->LevelCount[Level] = Value;
+                        }
+                    }
+                }
+            }
+
+            if (*pszCursor == ',')
+            {
+                pszCursor++;
+            }
+            else if (*pszCursor != 0)
+            {
+                SpecificationValid = BOOL_FALSE;
+            }
+        }
+        else
+        {
+            SpecificationValid = BOOL_FALSE;
+        }
+    }
+
+    if (SpecificationValid)
+    {
+        SpecificationValid = Generate_Internal_BuildLayout(pSpecification, &Layout) ? BOOL_TRUE : BOOL_FALSE;
+    }
+
+    return SpecificationValid;
+}
+
+
+/*
+ * Generate_BuildSnapshot
+ *
+ *    Builds the CPUID snapshot of every processor of a synthetic platform, the
+ *    snapshot is then used the same as one loaded from a file and can be saved
+ *    in either file format.  CPUID.0, 1, 4, 0BH, 018H and 01FH are generated
+ *    consistent with the APIC IDs; each processor has the same caches and TLBs.
+ *
+ * Arguments:
+ *     Specification
+ *
+ * Return:
+ *     Returns true if the snapshot was built
+ */
+BOOL_TYPE Generate_BuildSnapshot(PGENERATE_SPECIFICATION pSpecification)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    GENERATE_LAYOUT Layout;
+    unsigned int ProcessorIndex;
+    BOOL_TYPE SnapshotBuilt;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    SnapshotBuilt = BOOL_FALSE;
+
+    if (Generate_Internal_BuildLayout(pSpecification, &Layout))
+    {
+        pCpuidContext->UseNativeCpuid = BOOL_FALSE;
+        SnapshotBuilt = Capture_AllocateSnapshot(Layout.NumberOfProcessors);
+
+        for (ProcessorIndex = 0; ProcessorIndex < Layout.NumberOfProcessors && SnapshotBuilt; ProcessorIndex++)
+        {
+            SnapshotBuilt = Generate_Internal_BuildProcessor(pSpecification, &Layout, ProcessorIndex);
+        }
+
+        if (SnapshotBuilt == BOOL_FALSE)
+        {
+            Capture_ReleaseSnapshot();
+        }
+    }
+
+    return SnapshotBuilt;
+}
+
+
+/*
+ * Generate_Internal_ParseLevel
+ *
+ *    Converts the specification letter of a level to the level.
+ *
+ * Arguments:
+ *     Letter, Level to fill in
+ *
+ * Return:
+ *     Returns true if the letter is a level
+ */
+BOOL_TYPE Generate_Internal_ParseLevel(char Letter, PGENERATE_LEVEL pLevel)
+{
+    GENERATE_LEVEL Level;
+    BOOL_TYPE LevelFound;
+
+    LevelFound = BOOL_FALSE;
+
+    for (Level = GenerateLevel_Thread; Level < GenerateLevel_MaximumLevels && LevelFound == BOOL_FALSE; Level++)
+    {
+        if (g_GenerateLevelLetter[Level] == (Letter | ((char)0x20)))
+        {
+            *pLevel = Level;
+            LevelFound = BOOL_TRUE;
+        }
+    }
+
+    return LevelFound;
+}
+
+
+/*
+ * Generate_Internal_BuildLayout
+ *
+ *    Builds the APIC ID layout of the specification.  Each level has a field of
+ *    the power of 2 bits inclusive of its count so counts that are not a power
+ *    of 2 leave gaps in the IDs, the core field also has the gap bits.
+ *
+ * Arguments:
+ *     Specification, Layout to fill in
+ *
+ * Return:
+ *     Number of processors or zero if the specification is not valid
+ */
+unsigned int Generate_Internal_BuildLayout(PGENERATE_SPECIFICATION pSpecification, PGENERATE_LAYOUT pLayout)
+{
+    unsigned int NumberOfProcessors;
+    unsigned int FieldBits;
+    GENERATE_LEVEL Level;
+
+    NumberOfProcessors = 0;
+    memset(pLayout, 0, sizeof(GENERATE_LAYOUT));
+
+    pLayout->ProcessorsInLevel[GenerateLevel_Thread] = 1;
+
+    if (pSpecification->CoreIdGapBits <= GENERATE_MAXIMUM_GAP_BITS && pSpecification->L2SharingLevel <= pSpecification->L3SharingLevel && pSpecification->L3SharingLevel < GenerateLevel_MaximumLevels)
+    {
+        NumberOfProcessors = 1;
+
+        for (Level = GenerateLevel_Thread; Level < GenerateLevel_MaximumLevels && NumberOfProcessors; Level++)
+        {
+            if (pSpecification->LevelCount[Level] == 0 || pSpecification->LevelCount[Level] > GENERATE_MAXIMUM_PROCESSORS/NumberOfProcessors)
+            {
+                NumberOfProcessors = 0;
+            }
+            else
+            {
+                FieldBits = Tools_CreateTopologyShift(pSpecification->LevelCount[Level]);
+
+                if (Level == GenerateLevel_Core)
+                {
+                    FieldBits = FieldBits + pSpecification->CoreIdGapBits;
+                }
+
+                NumberOfProcessors = NumberOfProcessors*pSpecification->LevelCount[Level];
+
+                pLayout->FieldShift[Level + 1]        = pLayout->FieldShift[Level] + FieldBits;
+                pLayout->ProcessorsInLevel[Level + 1] = NumberOfProcessors;
+            }
+        }
+
+        if (pLayout->FieldShift[GenerateLevel_MaximumLevels] > 32)
+        {
+            NumberOfProcessors = 0;
+        }
+    }
+
+    pLayout->NumberOfProcessors = NumberOfProcessors;
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * Generate_Internal_ComputeApicId
+ *
+ *    Computes the APIC ID of a processor, the threads of a core are next to each
+ *    other in processor order followed by the cores of a module and so on.
+ *
+ * Arguments:
+ *     Specification, Layout, Processor Index
+ *
+ * Return:
+ *     APIC ID
+ */
+unsigned int Generate_Internal_ComputeApicId(PGENERATE_SPECIFICATION pSpecification, PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex)
+{
+    unsigned int ApicId;
+    unsigned int LevelId;
+    GENERATE_LEVEL Level;
+
+    ApicId = 0;
+
+    for (Level = GenerateLevel_Thread; Level < GenerateLevel_MaximumLevels; Level++)
+    {
+        LevelId = (ProcessorIndex / pLayout->ProcessorsInLevel[Level]) % pSpecification->LevelCount[Level];
+
+        if (Level == GenerateLevel_Core)
+        {
+            LevelId = LevelId << pSpecification->CoreIdGapBits;
+        }
+
+        ApicId = ApicId | (LevelId << pLayout->FieldShift[Level]);
+    }
+
+    return ApicId;
+}
+
+
+/*
+ * Generate_Internal_BuildProcessor
+ *
+ *    Builds the CPUID snapshot of one processor.
+ *
+ * Arguments:
+ *     Specification, Layout, Processor Index
+ *
+ * Return:
+ *     Returns true if the processor was built
+ */
+BOOL_TYPE Generate_Internal_BuildProcessor(PGENERATE_SPECIFICATION pSpecification, PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex)
+{
+    unsigned int ApicId;
+    unsigned int LegacyIds;
+    BOOL_TYPE ProcessorBuilt;
+
+    ApicId = Generate_Internal_ComputeApicId(pSpecification, pLayout, ProcessorIndex);
+
+    /*
+     * "GenuineIntel" in EBX, EDX, ECX.
+     */
+    ProcessorBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0, 0, GENERATE_MAXIMUM_LEAF, 0x756E6547, 0x6C65746E, 0x49656E69);
+
+    if (ProcessorBuilt)
+    {
+        LegacyIds = (pLayout->FieldShift[GenerateLevel_Package] < 8) ? (1 << pLayout->FieldShift[GenerateLevel_Package]) : 0xFF;
+        ProcessorBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 1, 0, GENERATE_SIGNATURE, ((ApicId & 0xFF) << 24) | (LegacyIds << 16) | ((GENERATE_CACHE_LINE_SIZE/8) << 8), GENERATE_FEATURES_ECX, GENERATE_FEATURES_EDX);
+    }
+
+    if (ProcessorBuilt)
+    {
+        ProcessorBuilt = Generate_Internal_BuildCacheLeaf(pSpecification, pLayout, ProcessorIndex);
+    }
+
+    if (ProcessorBuilt)
+    {
+        ProcessorBuilt = Generate_Internal_BuildTopologyLeafs(pLayout, ProcessorIndex, ApicId);
+    }
+
+    if (ProcessorBuilt)
+    {
+        ProcessorBuilt = Generate_Internal_BuildTlbLeaf(pLayout, ProcessorIndex);
+    }
+
+    if (ProcessorBuilt)
+    {
+        Capture_CompleteProcessor(ProcessorIndex);
+    }
+
+    return ProcessorBuilt;
+}
+
+
+/*
+ * Generate_Internal_BuildCacheLeaf
+ *
+ *    Builds CPUID.4 for a processor; a 48K L1 data cache and 32K L1 instruction
+ *    cache per core, a 2M L2 and an L3 of 2M for each core that shares it.
+ *
+ * Arguments:
+ *     Specification, Layout, Processor Index
+ *
+ * Return:
+ *     Returns true if the leaf was built
+ */
+BOOL_TYPE Generate_Internal_BuildCacheLeaf(PGENERATE_SPECIFICATION pSpecification, PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex)
+{
+    unsigned int CoreIds;
+    unsigned int CoresSharingL3;
+    unsigned int L1Sharing;
+    unsigned int L2Sharing;
+    unsigned int L3Sharing;
+    BOOL_TYPE LeafBuilt;
+
+    /*
+     * EAX[31:26] is the number of core IDs in the package and EAX[25:14] the number of IDs sharing the cache, both less one.
+     */
+    CoreIds   = Generate_Internal_SharingMask(pLayout->FieldShift[GenerateLevel_Package] - pLayout->FieldShift[GenerateLevel_Core], 0x3F) << 26;
+    L1Sharing = Generate_Internal_SharingMask(pLayout->FieldShift[GenerateLevel_Core], 0xFFF) << 14;
+    L2Sharing = Generate_Internal_SharingMask(pLayout->FieldShift[pSpecification->L2SharingLevel], 0xFFF) << 14;
+    L3Sharing = Generate_Internal_SharingMask(pLayout->FieldShift[pSpecification->L3SharingLevel], 0xFFF) << 14;
+
+    CoresSharingL3 = pLayout->ProcessorsInLevel[pSpecification->L3SharingLevel] / pLayout->ProcessorsInLevel[GenerateLevel_Core];
+
+    if (CoresSharingL3 == 0)
+    {
+        CoresSharingL3 = 1;
+    }
+
+    /*
+     * EAX type and level, EBX ways, partitions and line size less one, ECX sets less one.
+     */
+    LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 4, 0, CoreIds | L1Sharing | (1<<8) | (1<<5) | 1, (11<<22) | (GENERATE_CACHE_LINE_SIZE - 1), 63, 0);
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 4, 1, CoreIds | L1Sharing | (1<<8) | (1<<5) | 2, (7<<22) | (GENERATE_CACHE_LINE_SIZE - 1), 63, 0);
+    }
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 4, 2, CoreIds | L2Sharing | (1<<8) | (2<<5) | 3, (15<<22) | (GENERATE_CACHE_LINE_SIZE - 1), 2047, 0);
+    }
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 4, 3, CoreIds | L3Sharing | (1<<8) | (3<<5) | 3, (15<<22) | (GENERATE_CACHE_LINE_SIZE - 1), (CoresSharingL3*GENERATE_L3_SETS_PER_CORE) - 1, 0);
+    }
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 4, 4, 0, 0, 0, 0);
+    }
+
+    return LeafBuilt;
+}
+
+
+/*
+ * Generate_Internal_BuildTopologyLeafs
+ *
+ *    Builds CPUID.0BH and CPUID.1FH for a processor.  CPUID.0BH reports the thread
+ *    and core levels, CPUID.1FH also reports the module and die levels when there
+ *    is more than one of them in the level above.  Each level reports the shift and the number of
+ *    processors of the next level reported.
+ *
+ * Arguments:
+ *     Layout, Processor Index, APIC ID
+ *
+ * Return:
+ *     Returns true if the leafs were built
+ */
+BOOL_TYPE Generate_Internal_BuildTopologyLeafs(PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex, unsigned int ApicId)
+{
+    GENERATE_LEVEL Level;
+    GENERATE_LEVEL NextLevel;
+    unsigned int Subleaf;
+    BOOL_TYPE LeafBuilt;
+
+    LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0xB, 0, pLayout->FieldShift[GenerateLevel_Core], pLayout->ProcessorsInLevel[GenerateLevel_Core] & 0xFFFF, (LogicalProcessorDomain<<8), ApicId);
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0xB, 1, pLayout->FieldShift[GenerateLevel_Package], pLayout->ProcessorsInLevel[GenerateLevel_Package] & 0xFFFF, (CoreDomain<<8) | 1, ApicId);
+    }
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0xB, 2, 0, 0, 2, ApicId);
+    }
+
+    Subleaf = 0;
+    Level = GenerateLevel_Thread;
+
+    while (Level < GenerateLevel_Package && LeafBuilt)
+    {
+        NextLevel = Level + 1;
+
+        while (NextLevel > GenerateLevel_Core && NextLevel < GenerateLevel_Package && pLayout->ProcessorsInLevel[NextLevel + 1] == pLayout->ProcessorsInLevel[NextLevel])
+        {
+            NextLevel++;
+        }
+
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0x1F, Subleaf, pLayout->FieldShift[NextLevel], pLayout->ProcessorsInLevel[NextLevel] & 0xFFFF, (g_GenerateDomainType[Level]<<8) | Subleaf, ApicId);
+
+        Subleaf++;
+        Level = NextLevel;
+    }
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0x1F, Subleaf, 0, 0, Subleaf, ApicId);
+    }
+
+    return LeafBuilt;
+}
+
+
+/*
+ * Generate_Internal_BuildTlbLeaf
+ *
+ *    Builds CPUID.018H for a processor; instruction, load and store TLBs and a
+ *    shared second level TLB per core.
+ *
+ * Arguments:
+ *     Layout, Processor Index
+ *
+ * Return:
+ *     Returns true if the leaf was built
+ */
+BOOL_TYPE Generate_Internal_BuildTlbLeaf(PGENERATE_LAYOUT pLayout, unsigned int ProcessorIndex)
+{
+    unsigned int TlbSharing;
+    BOOL_TYPE LeafBuilt;
+
+    /*
+     * EBX page sizes and ways, ECX sets, EDX type, level, fully associative and the IDs sharing the TLB less one.
+     */
+    TlbSharing = Generate_Internal_SharingMask(pLayout->FieldShift[GenerateLevel_Core], 0xFFF) << 14;
+
+    LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0x18, 0, GENERATE_MAXIMUM_TLB_SUBLEAF, (8<<16) | 0x7, 32, TlbSharing | (1<<5) | 2);
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0x18, 1, 0, (4<<16) | 0x7, 16, TlbSharing | (1<<5) | 4);
+    }
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0x18, 2, 0, (16<<16) | 0xF, 1, TlbSharing | (1<<8) | (1<<5) | 5);
+    }
+
+    if (LeafBuilt)
+    {
+        LeafBuilt = Generate_Internal_SetSubleaf(ProcessorIndex, 0x18, 3, 0, (8<<16) | 0xB, 256, TlbSharing | (2<<5) | 3);
+    }
+
+    return LeafBuilt;
+}
+
+
+/*
+ * Generate_Internal_SetSubleaf
+ *
+ *    Stores one subleaf of a processor into the snapshot.
+ *
+ * Arguments:
+ *     Processor Index, Leaf, Subleaf, EAX, EBX, ECX, EDX
+ *
+ * Return:
+ *     Returns true if the subleaf was stored
+ */
+BOOL_TYPE Generate_Internal_SetSubleaf(unsigned int ProcessorIndex, unsigned int Leaf, unsigned int Subleaf, unsigned int Eax, unsigned int Ebx, unsigned int Ecx, unsigned int Edx)
+{
+    CPUID_REGISTERS CpuidRegisters;
+
+    CpuidRegisters.x.Register.Eax = Eax;
+    CpuidRegisters.x.Register.Ebx = Ebx;
+    CpuidRegisters.x.Register.Ecx = Ecx;
+    CpuidRegisters.x.Register.Edx = Edx;
+
+    return Capture_SetSnapshotCpuid(ProcessorIndex, Leaf, Subleaf, &CpuidRegisters);
+}
+
+
+/*
+ * Generate_Internal_SharingMask
+ *
+ *    Converts the bits of the IDs sharing a resource to the count less one
+ *    that CPUID reports, limited to the width of the field.
+ *
+ * Arguments:
+ *     Shift, Maximum Field Value
+ *
+ * Return:
+ *     Number of IDs less one
+ */
+unsigned int Generate_Internal_SharingMask(unsigned int Shift, unsigned int MaximumMask)
+{
+    unsigned int SharingMask;
+
+    SharingMask = MaximumMask;
+
+    if (Shift < 31 && ((1u << Shift) - 1) < MaximumMask)
+    {
+        SharingMask = (1u << Shift) - 1;
+    }
+
+    return SharingMask;
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The first extended leaf.
+ */
+#define FIRST_EXTENDED_LEAF  (0x80000000)
+
+
+/*
+ * The instrumentation of the process, the counters are shared by every thread
+ * so they are only changed with atomic operations.
+ */
+typedef struct _INSTRUMENT_STATE {
+    volatile unsigned long long Enabled;
+    INSTRUMENT_COUNTERS Counters;
+} INSTRUMENT_STATE, *PINSTRUMENT_STATE;
+
+INSTRUMENT_STATE g_InstrumentState;
+
+
+/*
+ * Internal Instrumentation APIs
+ */
+unsigned int Instrument_Internal_GetLeafCounter(unsigned int Leaf);
+
+
+
+/*
+ * Instrument_Enable
+ *
+ *    Starts or stops counting, the counters keep their values when counting
+ *    is stopped.  The CPUID instructions and affinity calls are also timed
+ *    while counting, which adds the cost of reading the time to each one.
+ *    The snapshot reads of the calling thread are counted from the start,
+ *    those of other threads are added when their context is released.
+ *
+ * Arguments:
+ *     BOOL_TRUE to start counting
+ *
+ * Return:
+ *     None
+ */
+void Instrument_Enable(BOOL_TYPE Enable)
+{
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    if (Enable)
+    {
+        pCpuidContext->SnapshotHits   = 0;
+        pCpuidContext->SnapshotMisses = 0;
+    }
+    else
+    {
+        Instrument_AddSnapshotReads(pCpuidContext);
+    }
+
+    Os_AtomicStore64(&g_InstrumentState.Enabled, Enable ? 1 : 0);
+}
+
+
+/*
+ * Instrument_IsEnabled
+ *
+ *    Returns whether the instrumentation is counting.
+ *
+ * Arguments:
+ *     None
+ *
+ * Return:
+ *     Returns true if counting
+ */
+BOOL_TYPE Instrument_IsEnabled(void)
+{
+    return Os_AtomicLoad64(&g_InstrumentState.Enabled) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/*
+ * Instrument_Reset
+ *
+ *    Sets every counter back to zero, including the snapshot reads of the
+ *    calling thread that have not been added yet.
+ *
+ * Arguments:
+ *     None
+ *
+ * Return:
+ *     None
+ */
+void Instrument_Reset(void)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    unsigned long long *pCounter;
+    unsigned int CounterIndex;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    pCpuidContext->SnapshotHits   = 0;
+    pCpuidContext->SnapshotMisses = 0;
+
+    /*
+     * The counters are all 64 bit values.
+     */
+    pCounter = (unsigned long long *)&g_InstrumentState.Counters;
+
+    for (CounterIndex = 0; CounterIndex < sizeof(INSTRUMENT_COUNTERS)/sizeof(unsigned long long); CounterIndex++)
+    {
+        Os_AtomicStore64(&pCounter[CounterIndex], 0);
+    }
+}
+
+
+/*
+ * Instrument_GetCounters
+ *
+ *    Copies the counters after adding the snapshot reads of the calling thread,
+ *    each counter is read atomically while other threads may still be counting.
+ *
+ * Arguments:
+ *     Returned Counters
+ *
+ * Return:
+ *     None
+ */
+void Instrument_GetCounters(PINSTRUMENT_COUNTERS pCounters)
+{
+    unsigned long long *pCounter;
+    unsigned long long *pCopy;
+    unsigned int CounterIndex;
+
+    Instrument_AddSnapshotReads(Tools_GetCpuidContext());
+
+    pCounter = (unsigned long long *)&g_InstrumentState.Counters;
+    pCopy    = (unsigned long long *)pCounters;
+
+    for (CounterIndex = 0; CounterIndex < sizeof(INSTRUMENT_COUNTERS)/sizeof(unsigned long long); CounterIndex++)
+    {
+        pCopy[CounterIndex] = Os_AtomicLoad64(&pCounter[CounterIndex]);
+    }
+}
+
+
+/*
+ * Instrument_GetCounterLeaf
+ *
+ *    Returns the leaf counted by a CPUID counter.
+ *
+ * Arguments:
+ *     Counter Index
+ *
+ * Return:
+ *     The Leaf or INVALID_LEAF for the counter of every other leaf
+ */
+unsigned int Instrument_GetCounterLeaf(unsigned int CounterIndex)
+{
+    unsigned int Leaf;
+
+    Leaf = INVALID_LEAF;
+
+    if (CounterIndex < INSTRUMENT_BASIC_LEAFS)
+    {
+        Leaf = CounterIndex;
+    }
+    else
+    {
+        if (CounterIndex < INSTRUMENT_OTHER_LEAFS)
+        {
+            Leaf = FIRST_EXTENDED_LEAF + (CounterIndex - INSTRUMENT_BASIC_LEAFS);
+        }
+    }
+
+    return Leaf;
+}
+
+
+/*
+ * Instrument_StartTimer
+ *
+ *    Starts timing a call that will be counted, the time is only read while
+ *    counting so the calls cost nothing more when the instrumentation is off.
+ *
+ * Arguments:
+ *     None
+ *
+ * Return:
+ *     The start time or zero if not counting
+ */
+unsigned long long Instrument_StartTimer(void)
+{
+    unsigned long long StartTime;
+
+    StartTime = 0;
+
+    if (Os_AtomicLoad64(&g_InstrumentState.Enabled))
+    {
+        StartTime = Os_GetTimestampNanoseconds();
+    }
+
+    return StartTime;
+}
+
+
+/*
+ * Instrument_CountCpuid
+ *
+ *    Counts a CPUID instruction and its time against its leaf.
+ *
+ * Arguments:
+ *     Leaf, Start Time from Instrument_StartTimer
+ *
+ * Return:
+ *     None
+ */
+void Instrument_CountCpuid(unsigned int Leaf, unsigned long long StartTime)
+{
+    unsigned int CounterIndex;
+
+    if (StartTime)
+    {
+        CounterIndex = Instrument_Internal_GetLeafCounter(Leaf);
+
+        Os_AtomicAdd64(&g_InstrumentState.Counters.CpuidNanoseconds[CounterIndex], Os_GetTimestampNanoseconds() - StartTime);
+        Os_AtomicIncrement64(&g_InstrumentState.Counters.CpuidCalls[CounterIndex]);
+    }
+}
+
+
+/*
+ * Instrument_CountAffinity
+ *
+ *    Counts a call to set the affinity of a thread and its time, and whether
+ *    the OS failed to set it.
+ *
+ * Arguments:
+ *     BOOL_TRUE if the affinity was set, Start Time from Instrument_StartTimer
+ *
+ * Return:
+ *     None
+ */
+void Instrument_CountAffinity(BOOL_TYPE AffinitySet, unsigned long long StartTime)
+{
+    if (StartTime)
+    {
+        Os_AtomicAdd64(&g_InstrumentState.Counters.AffinityNanoseconds, Os_GetTimestampNanoseconds() - StartTime);
+        Os_AtomicIncrement64(&g_InstrumentState.Counters.AffinityCalls);
+
+        if (AffinitySet == BOOL_FALSE)
+        {
+            Os_AtomicIncrement64(&g_InstrumentState.Counters.AffinityFailures);
+        }
+    }
+}
+
+
+/*
+ * Instrument_AddSnapshotReads
+ *
+ *    Adds the CPUID reads a context found in its snapshot and those that had
+ *    to execute CPUID or return zero since the leaf was not in the snapshot.
+ *    The reads are counted in the context so the reads served from the snapshot
+ *    cost nothing more, the context counts start again from zero.
+ *
+ * Arguments:
+ *     CPUID Context
+ *
+ * Return:
+ *     None
+ */
+void Instrument_AddSnapshotReads(PCPUID_CONTEXT pCpuidContext)
+{
+    if (Os_AtomicLoad64(&g_InstrumentState.Enabled))
+    {
+        Os_AtomicAdd64(&g_InstrumentState.Counters.SnapshotHits, pCpuidContext->SnapshotHits);
+        Os_AtomicAdd64(&g_InstrumentState.Counters.SnapshotMisses, pCpuidContext->SnapshotMisses);
+    }
+
+    pCpuidContext->SnapshotHits   = 0;
+    pCpuidContext->SnapshotMisses = 0;
+}
+
+
+/*
+ * Instrument_CountAllocation
+ *
+ *    Counts an allocation of the cache and TLB parsers.
+ *
+ * Arguments:
+ *     Number of Bytes allocated
+ *
+ * Return:
+ *     None
+ */
+void Instrument_CountAllocation(unsigned long long Bytes)
+{
+    if (Os_AtomicLoad64(&g_InstrumentState.Enabled))
+    {
+        Os_AtomicAdd64(&g_InstrumentState.Counters.ParserBytesAllocated, Bytes);
+        Os_AtomicIncrement64(&g_InstrumentState.Counters.ParserAllocations);
+    }
+}
+
+
+/*
+ * Instrument_Internal_GetLeafCounter
+ *
+ *    Finds the counter of a leaf.
+ *
+ * Arguments:
+ *     Leaf
+ *
+ * Return:
+ *     Counter Index
+ */
+unsigned int Instrument_Internal_GetLeafCounter(unsigned int Leaf)
+{
+    unsigned int CounterIndex;
+
+    CounterIndex = INSTRUMENT_OTHER_LEAFS;
+
+    if (Leaf < INSTRUMENT_BASIC_LEAFS)
+    {
+        CounterIndex = Leaf;
+    }
+    else
+    {
+        if (Leaf >= FIRST_EXTENDED_LEAF && Leaf - FIRST_EXTENDED_LEAF < INSTRUMENT_EXTENDED_LEAFS)
+        {
+            CounterIndex = INSTRUMENT_BASIC_LEAFS + (Leaf - FIRST_EXTENDED_LEAF);
+        }
+    }
+
+    return CounterIndex;
+}
@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The round trips run before the timed ones so both cache lines and the code
+ * are warm, and the passes over the buffer the fastest transfer is taken from.
+ */
+#define LATENCY_WARMUP_ROUND_TRIPS    (1000)
+#define LATENCY_BANDWIDTH_PASSES      (8)
+
+/*
+ * The buffer is half of the closest cache the pair shares so it stays in it while
+ * it is transferred, with a default for processors with no enumerated caches.
+ */
+#define LATENCY_BUFFER_CACHE_DIVISOR  (2)
+#define LATENCY_DEFAULT_BUFFER_BYTES  (64*1024)
+
+/*
+ * A worker gives up when the other worker does not answer in time, which is
+ * checked only once every number of spins to keep the clock out of the loop.
+ */
+#define LATENCY_TIMEOUT_NANOSECONDS   (1000000000ULL)
+#define LATENCY_SPINS_PER_CHECK       (1024)
+
+
+/*
+ * A counter on a cache line of its own, so the only traffic on the line is the
+ * counter moving between the two processors.
+ */
+typedef struct _LATENCY_LINE {
+    volatile unsigned long long Value;
+    unsigned char Padding[CACHE_LINE_SIZE - sizeof(unsigned long long)];
+} LATENCY_LINE, *PLATENCY_LINE;
+
+
+/*
+ * The state shared by the two workers measuring a pair.  The first processor
+ * sends odd values of the ping pong counter and the second answers each with
+ * the next even value.  The context is cache line aligned.
+ */
+typedef struct _LATENCY_PAIR_CONTEXT {
+    LATENCY_LINE PingPong;
+    LATENCY_LINE WorkersReady;
+    volatile unsigned long long Abort;
+    unsigned int FirstProcessor;
+    unsigned int RoundTrips;
+    unsigned long long *pBuffer;
+    unsigned int BufferBytes;
+    unsigned long long RoundTripNanoseconds;
+    unsigned long long TransferNanoseconds;
+    unsigned long long Checksum;
+    BOOL_TYPE LatencyMeasured;
+    BOOL_TYPE BandwidthMeasured;
+} LATENCY_PAIR_CONTEXT, *PLATENCY_PAIR_CONTEXT;
+
+
+/*
+ * Internal Latency APIs
+ */
+void Latency_Internal_PairWorker(unsigned int ProcessorNumber, void *pContext);
+BOOL_TYPE Latency_Internal_WaitForValue(PLATENCY_PAIR_CONTEXT pPairContext, volatile unsigned long long *pTarget, unsigned long long Value);
+void Latency_Internal_MeasurePair(PCPUID_TOPOLOGY pTopology, unsigned int RoundTrips, PLATENCY_COST pLatencyCost);
+unsigned int Latency_Internal_GetBufferBytes(PCPUID_TOPOLOGY pTopology, unsigned int FirstProcessor, unsigned int SecondProcessor);
+BOOL_TYPE Latency_Internal_ShareCache(PCPUID_TOPOLOGY pTopology, unsigned int FirstProcessor, unsigned int SecondProcessor, unsigned int CacheLevel);
+
+
+
+/*
+ * Latency_CpuidLatencyExample
+ *
+ *    Measures and displays the latency and bandwidth matrix of this platform.
+ *
+ * Arguments:
+ *     Number of Round Trips timed for each pair
+ *
+ * Return:
+ *     None
+ */
+void Latency_CpuidLatencyExample(unsigned int RoundTrips)
+{
+    PCPUID_TOPOLOGY pTopology;
+    LATENCY_MATRIX LatencyMatrix;
+
+    pTopology = Topology_Create();
+
+    if (pTopology)
+    {
+        Latency_MeasureTopology(pTopology, RoundTrips, &LatencyMatrix);
+        Display_DisplayLatencyMatrix(pTopology, &LatencyMatrix);
+
+        Topology_Destroy(pTopology);
+    }
+}
+
+
+/*
+ * Latency_MeasureTopology
+ *
+ *    Measures the cost of communication at each level of the topology between
+ *    the first processor and the first processor found at that level from it.
+ *    The two processors of a pair each run a worker created on the processor.
+ *
+ *       Latency   - The first worker writes an odd value to a cache line and the
+ *                   second worker answers with the next even value, the time of
+ *                   a round trip halved is the time a cache line takes to move
+ *                   from one processor to the other.
+ *       Bandwidth - The first worker writes a buffer of half of the closest cache
+ *                   the pair shares and the second worker reads it, the fastest read
+ *                   of the passes is the rate lines move from one to the other.
+ *
+ *    This must run natively since the workers run on the processors of the
+ *    topology.  No pair is measured with zero round trips.
+ *
+ * Arguments:
+ *     Topology, Number of Round Trips timed for each pair, Latency Matrix to fill in
+ *
+ * Return:
+ *     Returns true if every pair found was measured, false if the round trips are zero
+ */
+BOOL_TYPE Latency_MeasureTopology(PCPUID_TOPOLOGY pTopology, unsigned int RoundTrips, PLATENCY_MATRIX pLatencyMatrix)
+{
+    unsigned int ProcessorIndex;
+    unsigned int LatencyLevel;
+    BOOL_TYPE PairsMeasured;
+
+    PairsMeasured = (RoundTrips != 0) ? BOOL_TRUE : BOOL_FALSE;
+    memset(pLatencyMatrix, 0, sizeof(LATENCY_MATRIX));
+
+    pLatencyMatrix->RoundTrips = RoundTrips;
+
+    for (ProcessorIndex = 1; ProcessorIndex < Topology_GetNumberOfProcessors(pTopology); ProcessorIndex++)
+    {
+        LatencyLevel = (unsigned int)Latency_GetPairLevel(pTopology, 0, ProcessorIndex);
+
+        if (LatencyLevel < LatencyLevel_MaximumLevels && pLatencyMatrix->Cost[LatencyLevel].PairFound == BOOL_FALSE)
+        {
+            pLatencyMatrix->Cost[LatencyLevel].PairFound       = BOOL_TRUE;
+            pLatencyMatrix->Cost[LatencyLevel].FirstProcessor  = 0;
+            pLatencyMatrix->Cost[LatencyLevel].SecondProcessor = ProcessorIndex;
+        }
+    }
+
+    for (LatencyLevel = 0; LatencyLevel < LatencyLevel_MaximumLevels && RoundTrips != 0; LatencyLevel++)
+    {
+        if (pLatencyMatrix->Cost[LatencyLevel].PairFound)
+        {
+            Latency_Internal_MeasurePair(pTopology, RoundTrips, &pLatencyMatrix->Cost[LatencyLevel]);
+
+            if (pLatencyMatrix->Cost[LatencyLevel].Measured == BOOL_FALSE)
+            {
+                PairsMeasured = BOOL_FALSE;
+            }
+        }
+    }
+
+    return PairsMeasured;
+}
+
+
+/*
+ * Latency_GetPairLevel
+ *
+ *    The level of the topology two logical processors first meet at.  A die is
+ *    only distinguished from its package when the die domain is enumerated.
+ *
+ * Arguments:
+ *     Topology, First Processor Index, Second Processor Index
+ *
+ * Return:
+ *     The latency level, LatencyLevel_MaximumLevels for the same processor
+ */
+LATENCY_LEVEL Latency_GetPairLevel(PCPUID_TOPOLOGY pTopology, unsigned int FirstProcessor, unsigned int SecondProcessor)
+{
+    LATENCY_LEVEL LatencyLevel;
+    unsigned int PackageDomainIndex;
+    unsigned int DieDomainIndex;
+    unsigned int CoreDomainIndex;
+
+    LatencyLevel = LatencyLevel_MaximumLevels;
+
+    if (FirstProcessor != SecondProcessor && FirstProcessor < Topology_GetNumberOfProcessors(pTopology) && SecondProcessor < Topology_GetNumberOfProcessors(pTopology))
+    {
+        PackageDomainIndex = Topology_GetNumberOfDomains(pTopology) - 1;
+        DieDomainIndex     = Topology_FindDomain(pTopology, DieDomain);
+        CoreDomainIndex    = Topology_FindDomain(pTopology, CoreDomain);
+
+        if (Topology_GetDomainId(pTopology, FirstProcessor, PackageDomainIndex, PackageDomainIndex) != Topology_GetDomainId(pTopology, SecondProcessor, PackageDomainIndex, PackageDomainIndex))
+        {
+            LatencyLevel = LatencyLevel_CrossPackage;
+        }
+        else if (DieDomainIndex != PackageDomainIndex && Topology_GetDomainId(pTopology, FirstProcessor, DieDomainIndex, DieDomainIndex) != Topology_GetDomainId(pTopology, SecondProcessor, DieDomainIndex, DieDomainIndex))
+        {
+            LatencyLevel = LatencyLevel_CrossDie;
+        }
+        else if (CoreDomainIndex != PackageDomainIndex && Topology_GetDomainId(pTopology, FirstProcessor, CoreDomainIndex, CoreDomainIndex) == Topology_GetDomainId(pTopology, SecondProcessor, CoreDomainIndex, CoreDomainIndex))
+        {
+            LatencyLevel = LatencyLevel_SmtSibling;
+        }
+        else if (Latency_Internal_ShareCache(pTopology, FirstProcessor, SecondProcessor, 2))
+        {
+            LatencyLevel = LatencyLevel_SharedL2;
+        }
+        else
+        {
+            LatencyLevel = LatencyLevel_SameDie;
+        }
+    }
+
+    return LatencyLevel;
+}
+
+
+/*
+ * Latency_Internal_MeasurePair
+ *
+ *    Runs the two workers on the processors of a pair and converts their times
+ *    into the one way latency and the transfer bandwidth.
+ *
+ * Arguments:
+ *     Topology, Number of Round Trips, Latency Cost of the pair
+ *
+ * Return:
+ *     None
+ */
+void Latency_Internal_MeasurePair(PCPUID_TOPOLOGY pTopology, unsigned int RoundTrips, PLATENCY_COST pLatencyCost)
+{
+    PLATENCY_PAIR_CONTEXT pPairContext;
+    unsigned int ProcessorNumbers[2];
+
+    pLatencyCost->BufferBytes = Latency_Internal_GetBufferBytes(pTopology, pLatencyCost->FirstProcessor, pLatencyCost->SecondProcessor);
+
+    pPairContext = (PLATENCY_PAIR_CONTEXT)Tools_AllocateAligned(sizeof(LATENCY_PAIR_CONTEXT), CACHE_LINE_SIZE);
+
+    if (pPairContext)
+    {
+        memset(pPairContext, 0, sizeof(LATENCY_PAIR_CONTEXT));
+
+        pPairContext->FirstProcessor = pLatencyCost->FirstProcessor;
+        pPairContext->RoundTrips     = RoundTrips;
+        pPairContext->BufferBytes    = pLatencyCost->BufferBytes;
+        pPairContext->pBuffer        = (unsigned long long *)Tools_AllocateAligned(pLatencyCost->BufferBytes, CACHE_LINE_SIZE);
+
+        ProcessorNumbers[0] = pLatencyCost->FirstProcessor;
+        ProcessorNumbers[1] = pLatencyCost->SecondProcessor;
+
+        if (pPairContext->pBuffer && Os_RunOnProcessors(2, ProcessorNumbers, Latency_Internal_PairWorker, pPairContext))
+        {
+            if (pPairContext->LatencyMeasured && pPairContext->BandwidthMeasured)
+            {
+                pLatencyCost->Measured = BOOL_TRUE;
+                pLatencyCost->LatencyPicoseconds = (pPairContext->RoundTripNanoseconds*1000ULL) / (2ULL*RoundTrips);
+
+                if (pPairContext->TransferNanoseconds)
+                {
+                    pLatencyCost->BandwidthMegabytesPerSecond = ((unsigned long long)pLatencyCost->BufferBytes*1000ULL) / pPairContext->TransferNanoseconds;
+                }
+            }
+        }
+
+        if (pPairContext->pBuffer)
+        {
+            Tools_FreeAligned(pPairContext->pBuffer);
+        }
+
+        Tools_FreeAligned(pPairContext);
+    }
+}
+
+
+/*
+ * Latency_Internal_PairWorker
+ *
+ *    The worker run on each processor of a pair, the first processor of the
+ *    pair sends and times the round trips and writes the buffer, the second
+ *    answers and times the reads of the buffer.  Both wait for the other to
+ *    be running before the first round trip.
+ *
+ * Arguments:
+ *     Processor Number, Pair Context
+ *
+ * Return:
+ *     None
+ */
+void Latency_Internal_PairWorker(unsigned int ProcessorNumber, void *pContext)
+{
+    PLATENCY_PAIR_CONTEXT pPairContext;
+    unsigned long long StartTime;
+    unsigned long long TransferTime;
+    unsigned long long Checksum;
+    unsigned long long Value;
+    unsigned int RoundTrip;
+    unsigned int Pass;
+    unsigned int Index;
+    BOOL_TYPE IsFirst;
+    BOOL_TYPE Answered;
+
+    pPairContext = (PLATENCY_PAIR_CONTEXT)pContext;
+    IsFirst      = (ProcessorNumber == pPairContext->FirstProcessor) ? BOOL_TRUE : BOOL_FALSE;
+    StartTime    = 0;
+    Checksum     = 0;
+
+    Os_AtomicIncrement64(&pPairContext->WorkersReady.Value);
+    Answered = Latency_Internal_WaitForValue(pPairContext, &pPairContext->WorkersReady.Value, 2);
+
+    for (RoundTrip = 0; RoundTrip < LATENCY_WARMUP_ROUND_TRIPS + pPairContext->RoundTrips && Answered; RoundTrip++)
+    {
+        Value = 2ULL*RoundTrip;
+
+        if (IsFirst)
+        {
+            if (RoundTrip == LATENCY_WARMUP_ROUND_TRIPS)
+            {
+                StartTime = Os_GetTimestampNanoseconds();
+            }
+
+            Os_AtomicStore64(&pPairContext->PingPong.Value, Value + 1);
+            Answered = Latency_Internal_WaitForValue(pPairContext, &pPairContext->PingPong.Value, Value + 2);
+        }
+        else
+        {
+            Answered = Latency_Internal_WaitForValue(pPairContext, &pPairContext->PingPong.Value, Value + 1);
+
+            if (Answered)
+            {
+                Os_AtomicStore64(&pPairContext->PingPong.Value, Value + 2);
+            }
+        }
+    }
+
+    if (IsFirst && Answered)
+    {
+        pPairContext->RoundTripNanoseconds = Os_GetTimestampNanoseconds() - StartTime;
+        pPairContext->LatencyMeasured = BOOL_TRUE;
+    }
+
+    /*
+     * The bandwidth passes continue the count of the ping pong counter to hand
+     * the buffer from the first worker to the second and back.
+     */
+    for (Pass = 0; Pass < LATENCY_BANDWIDTH_PASSES && Answered; Pass++)
+    {
+        Value = 2ULL*(LATENCY_WARMUP_ROUND_TRIPS + pPairContext->RoundTrips + Pass);
+
+        if (IsFirst)
+        {
+            for (Index = 0; Index < pPairContext->BufferBytes / sizeof(unsigned long long); Index++)
+            {
+                pPairContext->pBuffer[Index] = Value + Index;
+            }
+
+            Os_AtomicStore64(&pPairContext->PingPong.Value, Value + 1);
+            Answered = Latency_Internal_WaitForValue(pPairContext, &pPairContext->PingPong.Value, Value + 2);
+        }
+        else
+        {
+            Answered = Latency_Internal_WaitForValue(pPairContext, &pPairContext->PingPong.Value, Value + 1);
+
+            if (Answered)
+            {
+                StartTime = Os_GetTimestampNanoseconds();
+
+                for (Index = 0; Index < pPairContext->BufferBytes / sizeof(unsigned long long); Index++)
+                {
+                    Checksum += pPairContext->pBuffer[Index];
+                }
+
+                TransferTime = Os_GetTimestampNanoseconds() - StartTime;
+
+                if (Pass == 0 || TransferTime < pPairContext->TransferNanoseconds)
+                {
+                    pPairContext->TransferNanoseconds = TransferTime;
+                }
+
+                Os_AtomicStore64(&pPairContext->PingPong.Value, Value + 2);
+            }
+        }
+    }
+
+    if (IsFirst == BOOL_FALSE && Answered)
+    {
+        pPairContext->Checksum = Checksum;
+        pPairContext->BandwidthMeasured = BOOL_TRUE;
+    }
+}
+
+
+/*
+ * Latency_Internal_WaitForValue
+ *
+ *    Spins until the counter reaches a value, the wait is abandoned by both
+ *    workers when either of them times out.
+ *
+ * Arguments:
+ *     Pair Context, Counter, Value
+ *
+ * Return:
+ *     Returns true if the counter reached the value
+ */
+BOOL_TYPE Latency_Internal_WaitForValue(PLATENCY_PAIR_CONTEXT pPairContext, volatile unsigned long long *pTarget, unsigned long long Value)
+{
+    unsigned long long StartTime;
+    unsigned int Spins;
+    BOOL_TYPE ValueReached;
+
+    StartTime = 0;
+    Spins     = 0;
+
+    while (Os_AtomicLoad64(pTarget) != Value && Os_AtomicLoad64(&pPairContext->Abort) == 0)
+    {
+        Spins++;
+
+        if ((Spins % LATENCY_SPINS_PER_CHECK) == 0)
+        {
+            if (StartTime == 0)
+            {
+                StartTime = Os_GetTimestampNanoseconds();
+            }
+            else if (Os_GetTimestampNanoseconds() - StartTime > LATENCY_TIMEOUT_NANOSECONDS)
+            {
+                Os_AtomicStore64(&pPairContext->Abort, 1);
+            }
+        }
+    }
+
+    ValueReached = (Os_AtomicLoad64(pTarget) == Value) ? BOOL_TRUE : BOOL_FALSE;
+
+    return ValueReached;
+}
+
+
+/*
+ * Latency_Internal_GetBufferBytes
+ *
+ *    The size of the bandwidth buffer, half of the lowest level data or unified
+ *    cache the pair shares, or half of the largest one of the first processor when
+ *    they share none, rounded down to whole cache lines.
+ *
+ * Arguments:
+ *     Topology, First Processor Index, Second Processor Index
+ *
+ * Return:
+ *     The size of the buffer in bytes
+ */
+unsigned int Latency_Internal_GetBufferBytes(PCPUID_TOPOLOGY pTopology, unsigned int FirstProcessor, unsigned int SecondProcessor)
+{
+    PCPUID_CACHE_INFO pCacheInfo;
+    unsigned int CacheIndex;
+    unsigned int SharedCacheLevel;
+    unsigned int SharedCacheBytes;
+    unsigned int LargestCacheBytes;
+    unsigned int BufferBytes;
+
+    SharedCacheLevel  = 0;
+    SharedCacheBytes  = 0;
+    LargestCacheBytes = 0;
+
+    for (CacheIndex = 0; CacheIndex < Topology_GetNumberOfCaches(pTopology); CacheIndex++)
+    {
+        pCacheInfo = Topology_GetCache(pTopology, CacheIndex);
+
+        if (pCacheInfo->CacheType != CacheType_InstructionCache && Tools_IsProcessorInSet(&pCacheInfo->LPsSharingThisCache, FirstProcessor))
+        {
+            if (pCacheInfo->CacheSizeInBytes > LargestCacheBytes)
+            {
+                LargestCacheBytes = pCacheInfo->CacheSizeInBytes;
+            }
+
+            if ((SharedCacheLevel == 0 || pCacheInfo->CacheLevel < SharedCacheLevel) && Tools_IsProcessorInSet(&pCacheInfo->LPsSharingThisCache, SecondProcessor))
+            {
+                SharedCacheLevel = pCacheInfo->CacheLevel;
+                SharedCacheBytes = pCacheInfo->CacheSizeInBytes;
+            }
+        }
+    }
+
+    BufferBytes = (SharedCacheBytes ? SharedCacheBytes : LargestCacheBytes) / LATENCY_BUFFER_CACHE_DIVISOR;
+    BufferBytes = BufferBytes & ~(CACHE_LINE_SIZE - 1);
+
+    if (BufferBytes == 0)
+    {
+        BufferBytes = LATENCY_DEFAULT_BUFFER_BYTES;
+    }
+
+    return BufferBytes;
+}
+
+
+/*
+ * Latency_Internal_ShareCache
+ *
+ *    Determines if two processors share the data or unified cache of a level.
+ *
+ * Arguments:
+ *     Topology, First Processor Index, Second Processor Index, Cache Level
+ *
+ * Return:
+ *     Returns true if both processors use the same cache
+ */
+BOOL_TYPE Latency_Internal_ShareCache(PCPUID_TOPOLOGY pTopology, unsigned int FirstProcessor, unsigned int SecondProcessor, unsigned int CacheLevel)
+{
+    unsigned int CacheIndex;
+    BOOL_TYPE CacheShared;
+
+    CacheShared = BOOL_FALSE;
+
+    CacheIndex = Topology_FindProcessorCache(pTopology, FirstProcessor, CacheLevel, CacheType_NoMoreCaches);
+
+    if (CacheIndex != INVALID_CACHE_INDEX && CacheIndex == Topology_FindProcessorCache(pTopology, SecondProcessor, CacheLevel, CacheType_NoMoreCaches))
+    {
+        CacheShared = BOOL_TRUE;
+    }
+
+    return CacheShared;
+}
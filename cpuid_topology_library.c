@@ -0,0 +1,1100 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The library APIs build the topology once and then only answer queries from
+ * it, nothing is displayed so applications can link them in directly.
+ */
+
+
+/*
+ * Internal Topology APIs
+ */
+BOOL_TYPE Topology_Internal_BuildDomainIdTable(PCPUID_TOPOLOGY pTopology);
+BOOL_TYPE Topology_Internal_BuildApicIdMap(PCPUID_TOPOLOGY pTopology);
+BOOL_TYPE Topology_Internal_BuildCoreTypes(PCPUID_TOPOLOGY pTopology);
+BOOL_TYPE Topology_Internal_BuildNumaNodes(PCPUID_TOPOLOGY pTopology);
+BOOL_TYPE Topology_Internal_BuildOsProcessorMap(PCPUID_TOPOLOGY pTopology);
+unsigned int Topology_Internal_ReadCurrentApicId(PCPUID_TOPOLOGY pTopology);
+
+
+
+/*
+ * Topology_Create
+ *
+ *    Builds the topology of the platform: the logical processors, the
+ *    known domains and their mask matrix, the caches and the TLBs.  The
+ *    CPUID loaded from a file is used if there is one, otherwise the CPUID
+ *    of this platform is captured.
+ *
+ *    The topology must not be changed and is released with Topology_Destroy.
+ *
+ * Arguments:
+ *     None
+ *
+ * Return:
+ *     The topology or NULL on failure.
+ */
+PCPUID_TOPOLOGY Topology_Create(void)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    PCPUID_TOPOLOGY pTopology;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    if (pCpuidContext->pProcessorSnapshot == NULL)
+    {
+        pCpuidContext->UseNativeCpuid = BOOL_TRUE;
+    }
+
+    Capture_CaptureProcessors();
+
+    pTopology = (PCPUID_TOPOLOGY)calloc(1, sizeof(CPUID_TOPOLOGY));
+
+    if (pTopology)
+    {
+        pTopology->Leaf        = ParseCpu_BuildDomainLayout(&pTopology->ApicidBitLayoutCtx);
+        pTopology->pApicIdList = Tools_AllocatePlatformApicIds(&pTopology->NumberOfProcessors);
+
+        /*
+         * A platform without the cache or TLB leaf simply has none.
+         */
+        ParseCache_BuildCacheTopology(&pTopology->CacheTopology);
+        ParseTlb_BuildTlbTopology(&pTopology->TlbTopology);
+
+        if (pTopology->pApicIdList == NULL || Topology_Internal_BuildDomainIdTable(pTopology) == BOOL_FALSE || Topology_Internal_BuildApicIdMap(pTopology) == BOOL_FALSE || Topology_Internal_BuildCoreTypes(pTopology) == BOOL_FALSE || Topology_Internal_BuildNumaNodes(pTopology) == BOOL_FALSE || Topology_Internal_BuildOsProcessorMap(pTopology) == BOOL_FALSE)
+        {
+            Topology_Destroy(pTopology);
+            pTopology = NULL;
+        }
+    }
+
+    return pTopology;
+}
+
+
+/*
+ * Topology_Destroy
+ *
+ *    Releases a topology from Topology_Create.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     None
+ */
+void Topology_Destroy(PCPUID_TOPOLOGY pTopology)
+{
+    if (pTopology)
+    {
+        ParseCache_ReleaseCacheTopology(&pTopology->CacheTopology);
+        ParseTlb_ReleaseTlbTopology(&pTopology->TlbTopology);
+
+        if (pTopology->pApicIdList)
+        {
+            free(pTopology->pApicIdList);
+            pTopology->pApicIdList = NULL;
+        }
+
+        if (pTopology->pDomainIdTable)
+        {
+            Tools_FreeAligned(pTopology->pDomainIdTable);
+            pTopology->pDomainIdTable = NULL;
+        }
+
+        if (pTopology->pApicIdToProcessor)
+        {
+            free(pTopology->pApicIdToProcessor);
+            pTopology->pApicIdToProcessor = NULL;
+        }
+
+        if (pTopology->pOsProcessorToProcessor)
+        {
+            free(pTopology->pOsProcessorToProcessor);
+            pTopology->pOsProcessorToProcessor = NULL;
+        }
+
+        if (pTopology->pCoreTypeList)
+        {
+            free(pTopology->pCoreTypeList);
+            pTopology->pCoreTypeList = NULL;
+        }
+
+        if (pTopology->pNativeModelIdList)
+        {
+            free(pTopology->pNativeModelIdList);
+            pTopology->pNativeModelIdList = NULL;
+        }
+
+        if (pTopology->pNumaNodeList)
+        {
+            free(pTopology->pNumaNodeList);
+            pTopology->pNumaNodeList = NULL;
+        }
+
+        free(pTopology);
+    }
+}
+
+
+/*
+ * Topology_GetNumberOfProcessors
+ *
+ *    The number of logical processors in the topology.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Number of Processors
+ */
+unsigned int Topology_GetNumberOfProcessors(PCPUID_TOPOLOGY pTopology)
+{
+    return pTopology->NumberOfProcessors;
+}
+
+
+/*
+ * Topology_GetApicId
+ *
+ *    The APIC ID of a logical processor.
+ *
+ * Arguments:
+ *     Topology, Processor Index
+ *
+ * Return:
+ *     APIC ID
+ */
+unsigned int Topology_GetApicId(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex)
+{
+    unsigned int ApicId;
+
+    ApicId = 0;
+
+    if (ProcessorIndex < pTopology->NumberOfProcessors)
+    {
+        ApicId = pTopology->pApicIdList[ProcessorIndex];
+    }
+
+    return ApicId;
+}
+
+
+/*
+ * Topology_GetNumberOfDomains
+ *
+ *    The number of known domains including the package, which is always
+ *    the last domain.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Number of Domains
+ */
+unsigned int Topology_GetNumberOfDomains(PCPUID_TOPOLOGY pTopology)
+{
+    return pTopology->ApicidBitLayoutCtx.PackageDomainIndex + 1;
+}
+
+
+/*
+ * Topology_GetDomainType
+ *
+ *    The CPU_DOMAIN type of a domain, the package domain is reported as
+ *    InvalidDomain since it has no CPUID domain type.
+ *
+ * Arguments:
+ *     Topology, Domain Index
+ *
+ * Return:
+ *     Domain Type
+ */
+unsigned int Topology_GetDomainType(PCPUID_TOPOLOGY pTopology, unsigned int DomainIndex)
+{
+    unsigned int DomainType;
+
+    DomainType = InvalidDomain;
+
+    if (DomainIndex < pTopology->ApicidBitLayoutCtx.PackageDomainIndex)
+    {
+        DomainType = pTopology->ApicidBitLayoutCtx.ShiftValueDomain[DomainIndex];
+    }
+
+    return DomainType;
+}
+
+
+/*
+ * Topology_FindDomain
+ *
+ *    Finds the index of the first domain of a CPU_DOMAIN type below the package.
+ *
+ * Arguments:
+ *     Topology, Domain Type
+ *
+ * Return:
+ *     The domain index, or the package domain index if it is not enumerated
+ */
+unsigned int Topology_FindDomain(PCPUID_TOPOLOGY pTopology, unsigned int DomainType)
+{
+    unsigned int DomainIndex;
+    unsigned int FoundDomainIndex;
+
+    FoundDomainIndex = pTopology->ApicidBitLayoutCtx.PackageDomainIndex;
+
+    for (DomainIndex = 0; DomainIndex < pTopology->ApicidBitLayoutCtx.PackageDomainIndex && FoundDomainIndex == pTopology->ApicidBitLayoutCtx.PackageDomainIndex; DomainIndex++)
+    {
+        if (pTopology->ApicidBitLayoutCtx.ShiftValueDomain[DomainIndex] == DomainType)
+        {
+            FoundDomainIndex = DomainIndex;
+        }
+    }
+
+    return FoundDomainIndex;
+}
+
+
+/*
+ * Topology_GetDomainMask
+ *
+ *    The APIC ID mask of a domain relative to a higher domain, or the mask that
+ *    identifies the domain across the platform when both are the same domain.
+ *
+ * Arguments:
+ *     Topology, Domain Index, Relative Domain Index
+ *
+ * Return:
+ *     Domain Mask
+ */
+unsigned int Topology_GetDomainMask(PCPUID_TOPOLOGY pTopology, unsigned int DomainIndex, unsigned int RelativeDomainIndex)
+{
+    unsigned int DomainMask;
+
+    DomainMask = 0;
+
+    if (DomainIndex <= RelativeDomainIndex && RelativeDomainIndex <= pTopology->ApicidBitLayoutCtx.PackageDomainIndex)
+    {
+        DomainMask = pTopology->ApicidBitLayoutCtx.DomainRelativeMasks[DomainIndex][RelativeDomainIndex];
+    }
+
+    return DomainMask;
+}
+
+
+/*
+ * Topology_GetDomainId
+ *
+ *    The ID of the domain a logical processor is in.  The ID is unique across
+ *    the platform when the relative domain is the domain itself, otherwise it
+ *    is unique within the relative domain.
+ *
+ * Arguments:
+ *     Topology, Processor Index, Domain Index, Relative Domain Index
+ *
+ * Return:
+ *     Domain ID
+ */
+unsigned int Topology_GetDomainId(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int DomainIndex, unsigned int RelativeDomainIndex)
+{
+    unsigned int DomainId;
+
+    DomainId = 0;
+
+    if (ProcessorIndex < pTopology->NumberOfProcessors && DomainIndex < pTopology->NumberOfDomains && RelativeDomainIndex < pTopology->NumberOfDomains)
+    {
+        DomainId = pTopology->pDomainIdTable[ProcessorIndex*pTopology->DomainIdStride + DomainIndex*pTopology->NumberOfDomains + RelativeDomainIndex];
+    }
+
+    return DomainId;
+}
+
+
+/*
+ * Topology_GetProcessorDomainIds
+ *
+ *    The row of domain IDs of a logical processor for callers that look up
+ *    IDs on a hot path.  The ID of a domain relative to another domain is at
+ *    [DomainIndex*NumberOfDomains + RelativeDomainIndex], the global IDs are
+ *    where both are the same domain.  The row starts on a cache line.
+ *
+ * Arguments:
+ *     Topology, Processor Index
+ *
+ * Return:
+ *     Row of Domain IDs or NULL if the index is not valid
+ */
+unsigned int *Topology_GetProcessorDomainIds(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex)
+{
+    unsigned int *pDomainIds;
+
+    pDomainIds = NULL;
+
+    if (ProcessorIndex < pTopology->NumberOfProcessors)
+    {
+        pDomainIds = &pTopology->pDomainIdTable[ProcessorIndex*pTopology->DomainIdStride];
+    }
+
+    return pDomainIds;
+}
+
+
+/*
+ * Topology_GetProcessorIndex
+ *
+ *    The index of the logical processor with an APIC ID.
+ *
+ * Arguments:
+ *     Topology, APIC ID
+ *
+ * Return:
+ *     Processor Index or INVALID_PROCESSOR_INDEX
+ */
+unsigned int Topology_GetProcessorIndex(PCPUID_TOPOLOGY pTopology, unsigned int ApicId)
+{
+    unsigned int ProcessorIndex;
+    unsigned int SearchIndex;
+
+    ProcessorIndex = INVALID_PROCESSOR_INDEX;
+
+    if (pTopology->pApicIdToProcessor)
+    {
+        if (ApicId < pTopology->ApicIdMapSize)
+        {
+            ProcessorIndex = pTopology->pApicIdToProcessor[ApicId];
+        }
+    }
+    else
+    {
+        /*
+         * The APIC IDs are too sparse to map directly.
+         */
+        for (SearchIndex = 0; SearchIndex < pTopology->NumberOfProcessors && ProcessorIndex == INVALID_PROCESSOR_INDEX; SearchIndex++)
+        {
+            if (pTopology->pApicIdList[SearchIndex] == ApicId)
+            {
+                ProcessorIndex = SearchIndex;
+            }
+        }
+    }
+
+    return ProcessorIndex;
+}
+
+
+/*
+ * Topology_GetCurrentProcessorIndex
+ *
+ *    The index of the logical processor the calling thread is running on.  The
+ *    OS processor ID is read without CPUID, from RDPID or RDTSCP where the OS
+ *    provides it, and mapped through the table built with the topology.  CPUID
+ *    is only executed for the APIC ID when the OS cannot report the processor
+ *    or the topology was loaded from a file, which is only meaningful if the
+ *    file was captured on this platform.  The thread may be moved to another
+ *    processor as soon as this returns unless its affinity is a single processor.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Processor Index or INVALID_PROCESSOR_INDEX
+ */
+unsigned int Topology_GetCurrentProcessorIndex(PCPUID_TOPOLOGY pTopology)
+{
+    unsigned int ProcessorIndex;
+    unsigned int OsProcessorId;
+
+    ProcessorIndex = INVALID_PROCESSOR_INDEX;
+
+    if (pTopology->pOsProcessorToProcessor && Os_GetCurrentProcessorId(&OsProcessorId))
+    {
+        if (OsProcessorId < pTopology->OsProcessorMapSize)
+        {
+            ProcessorIndex = pTopology->pOsProcessorToProcessor[OsProcessorId];
+        }
+    }
+    else
+    {
+        ProcessorIndex = Topology_GetProcessorIndex(pTopology, Topology_Internal_ReadCurrentApicId(pTopology));
+    }
+
+    return ProcessorIndex;
+}
+
+
+/*
+ * Topology_GetCurrentProcessorDomainIds
+ *
+ *    The row of domain IDs of the logical processor the calling thread is
+ *    running on, the same as Topology_GetProcessorDomainIds of the index from
+ *    Topology_GetCurrentProcessorIndex.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Row of Domain IDs or NULL if the processor is not in the topology
+ */
+unsigned int *Topology_GetCurrentProcessorDomainIds(PCPUID_TOPOLOGY pTopology)
+{
+    return Topology_GetProcessorDomainIds(pTopology, Topology_GetCurrentProcessorIndex(pTopology));
+}
+
+
+/*
+ * Topology_GetProcessorsSharingDomain
+ *
+ *    Lists the logical processors that are in the same domain as a logical
+ *    processor, including that processor.
+ *
+ * Arguments:
+ *     Topology, Processor Index, Domain Index, List of Processors, Size of the list
+ *
+ * Return:
+ *     The number of processors sharing the domain, which may be more than the
+ *     size of the list.
+ */
+unsigned int Topology_GetProcessorsSharingDomain(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int DomainIndex, unsigned int *pProcessorList, unsigned int ListSize)
+{
+    unsigned int NumberOfSharing;
+    unsigned int OtherProcessorIndex;
+    unsigned int DomainMask;
+    unsigned int DomainId;
+
+    NumberOfSharing = 0;
+
+    if (ProcessorIndex < pTopology->NumberOfProcessors && DomainIndex <= pTopology->ApicidBitLayoutCtx.PackageDomainIndex)
+    {
+        DomainMask = Topology_GetDomainMask(pTopology, DomainIndex, DomainIndex);
+        DomainId = pTopology->pApicIdList[ProcessorIndex] & DomainMask;
+
+        for (OtherProcessorIndex = 0; OtherProcessorIndex < pTopology->NumberOfProcessors; OtherProcessorIndex++)
+        {
+            if ((pTopology->pApicIdList[OtherProcessorIndex] & DomainMask) == DomainId)
+            {
+                if (NumberOfSharing < ListSize)
+                {
+                    pProcessorList[NumberOfSharing] = OtherProcessorIndex;
+                }
+
+                NumberOfSharing++;
+            }
+        }
+    }
+
+    return NumberOfSharing;
+}
+
+
+/*
+ * Topology_IsHybrid
+ *
+ *    Determines if any processor in the topology reports a hybrid core type.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Returns true on a hybrid platform
+ */
+BOOL_TYPE Topology_IsHybrid(PCPUID_TOPOLOGY pTopology)
+{
+    return pTopology->IsHybrid;
+}
+
+
+/*
+ * Topology_GetCoreType
+ *
+ *    The hybrid core type of a logical processor from CPUID.1AH.
+ *
+ * Arguments:
+ *     Topology, Processor Index
+ *
+ * Return:
+ *     Core Type, CoreType_NotHybrid when the platform is not hybrid
+ */
+CORE_TYPE Topology_GetCoreType(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex)
+{
+    CORE_TYPE CoreType;
+
+    CoreType = CoreType_NotHybrid;
+
+    if (ProcessorIndex < pTopology->NumberOfProcessors)
+    {
+        CoreType = pTopology->pCoreTypeList[ProcessorIndex];
+    }
+
+    return CoreType;
+}
+
+
+/*
+ * Topology_GetNativeModelId
+ *
+ *    The native model ID of the core type of a logical processor from CPUID.1AH.
+ *
+ * Arguments:
+ *     Topology, Processor Index
+ *
+ * Return:
+ *     Native Model ID
+ */
+unsigned int Topology_GetNativeModelId(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex)
+{
+    unsigned int NativeModelId;
+
+    NativeModelId = 0;
+
+    if (ProcessorIndex < pTopology->NumberOfProcessors)
+    {
+        NativeModelId = pTopology->pNativeModelIdList[ProcessorIndex];
+    }
+
+    return NativeModelId;
+}
+
+
+/*
+ * Topology_GetNumaNode
+ *
+ *    The OS NUMA node of a logical processor.
+ *
+ * Arguments:
+ *     Topology, Processor Index
+ *
+ * Return:
+ *     NUMA Node, INVALID_NUMA_NODE if it is not known
+ */
+unsigned int Topology_GetNumaNode(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex)
+{
+    unsigned int NumaNode;
+
+    NumaNode = INVALID_NUMA_NODE;
+
+    if (ProcessorIndex < pTopology->NumberOfProcessors)
+    {
+        NumaNode = pTopology->pNumaNodeList[ProcessorIndex];
+    }
+
+    return NumaNode;
+}
+
+
+/*
+ * Topology_GetNumberOfCaches
+ *
+ *    The number of caches in the topology.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Number of Caches
+ */
+unsigned int Topology_GetNumberOfCaches(PCPUID_TOPOLOGY pTopology)
+{
+    return pTopology->CacheTopology.NumberOfCaches;
+}
+
+
+/*
+ * Topology_GetCache
+ *
+ *    The description of a cache, it must not be changed.
+ *
+ * Arguments:
+ *     Topology, Cache Index
+ *
+ * Return:
+ *     Cache or NULL if the index is not valid
+ */
+PCPUID_CACHE_INFO Topology_GetCache(PCPUID_TOPOLOGY pTopology, unsigned int CacheIndex)
+{
+    PCPUID_CACHE_INFO pCacheInfo;
+
+    pCacheInfo = NULL;
+
+    if (CacheIndex < pTopology->CacheTopology.NumberOfCaches)
+    {
+        pCacheInfo = &pTopology->CacheTopology.pCacheInfo[CacheIndex];
+    }
+
+    return pCacheInfo;
+}
+
+
+/*
+ * Topology_FindProcessorCache
+ *
+ *    Finds the cache of a level used by a logical processor.  The instruction
+ *    cache is only returned when the type asks for it, otherwise the data or
+ *    unified cache of that level is returned.
+ *
+ * Arguments:
+ *     Topology, Processor Index, Cache Level, Cache Type or CacheType_NoMoreCaches for data or unified
+ *
+ * Return:
+ *     Cache Index or INVALID_CACHE_INDEX
+ */
+unsigned int Topology_FindProcessorCache(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int CacheLevel, CACHE_TYPE CacheType)
+{
+    PCPUID_CACHE_INFO pCacheInfo;
+    unsigned int CacheIndex;
+    unsigned int FoundCacheIndex;
+
+    FoundCacheIndex = INVALID_CACHE_INDEX;
+
+    for (CacheIndex = 0; CacheIndex < pTopology->CacheTopology.NumberOfCaches && FoundCacheIndex == INVALID_CACHE_INDEX; CacheIndex++)
+    {
+        pCacheInfo = &pTopology->CacheTopology.pCacheInfo[CacheIndex];
+
+        if (pCacheInfo->CacheLevel == CacheLevel && Tools_IsProcessorInSet(&pCacheInfo->LPsSharingThisCache, ProcessorIndex))
+        {
+            if (pCacheInfo->CacheType == (unsigned int)CacheType || (CacheType == CacheType_NoMoreCaches && pCacheInfo->CacheType != CacheType_InstructionCache))
+            {
+                FoundCacheIndex = CacheIndex;
+            }
+        }
+    }
+
+    return FoundCacheIndex;
+}
+
+
+/*
+ * Topology_GetProcessorsSharingCache
+ *
+ *    Lists the logical processors that share the data or unified cache of a
+ *    level with a logical processor, i.e. the processors sharing L2 with it.
+ *
+ * Arguments:
+ *     Topology, Processor Index, Cache Level, List of Processors, Size of the list
+ *
+ * Return:
+ *     The number of processors sharing the cache, which may be more than the
+ *     size of the list, or zero if the processor has no such cache.
+ */
+unsigned int Topology_GetProcessorsSharingCache(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int CacheLevel, unsigned int *pProcessorList, unsigned int ListSize)
+{
+    PCPUID_CACHE_INFO pCacheInfo;
+    unsigned int CacheIndex;
+    unsigned int OtherProcessorIndex;
+    unsigned int NumberOfSharing;
+
+    NumberOfSharing = 0;
+
+    CacheIndex = Topology_FindProcessorCache(pTopology, ProcessorIndex, CacheLevel, CacheType_NoMoreCaches);
+
+    if (CacheIndex != INVALID_CACHE_INDEX)
+    {
+        pCacheInfo = &pTopology->CacheTopology.pCacheInfo[CacheIndex];
+
+        for (OtherProcessorIndex = 0; OtherProcessorIndex < pTopology->NumberOfProcessors; OtherProcessorIndex++)
+        {
+            if (Tools_IsProcessorInSet(&pCacheInfo->LPsSharingThisCache, OtherProcessorIndex))
+            {
+                if (NumberOfSharing < ListSize)
+                {
+                    pProcessorList[NumberOfSharing] = OtherProcessorIndex;
+                }
+
+                NumberOfSharing++;
+            }
+        }
+    }
+
+    return NumberOfSharing;
+}
+
+
+/*
+ * Topology_GetNumberOfTlbs
+ *
+ *    The number of TLBs in the topology.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Number of TLBs
+ */
+unsigned int Topology_GetNumberOfTlbs(PCPUID_TOPOLOGY pTopology)
+{
+    return pTopology->TlbTopology.NumberOfTlbs;
+}
+
+
+/*
+ * Topology_GetTlb
+ *
+ *    The description of a TLB, it must not be changed.
+ *
+ * Arguments:
+ *     Topology, TLB Index
+ *
+ * Return:
+ *     TLB or NULL if the index is not valid
+ */
+PCPUID_TLB_INFO Topology_GetTlb(PCPUID_TOPOLOGY pTopology, unsigned int TlbIndex)
+{
+    PCPUID_TLB_INFO pTlbInfo;
+
+    pTlbInfo = NULL;
+
+    if (TlbIndex < pTopology->TlbTopology.NumberOfTlbs)
+    {
+        pTlbInfo = &pTopology->TlbTopology.pTlbInfo[TlbIndex];
+    }
+
+    return pTlbInfo;
+}
+
+
+/*
+ * Topology_FindProcessorTlb
+ *
+ *    Finds the TLB of a level and type used by a logical processor.
+ *
+ * Arguments:
+ *     Topology, Processor Index, TLB Level, TLB Type
+ *
+ * Return:
+ *     TLB Index or INVALID_TLB_INDEX
+ */
+unsigned int Topology_FindProcessorTlb(PCPUID_TOPOLOGY pTopology, unsigned int ProcessorIndex, unsigned int TlbLevel, TLB_TYPE TlbType)
+{
+    PCPUID_TLB_INFO pTlbInfo;
+    unsigned int TlbIndex;
+    unsigned int FoundTlbIndex;
+
+    FoundTlbIndex = INVALID_TLB_INDEX;
+
+    for (TlbIndex = 0; TlbIndex < pTopology->TlbTopology.NumberOfTlbs && FoundTlbIndex == INVALID_TLB_INDEX; TlbIndex++)
+    {
+        pTlbInfo = &pTopology->TlbTopology.pTlbInfo[TlbIndex];
+
+        if (pTlbInfo->TlbLevel == TlbLevel && pTlbInfo->TlbType == (unsigned int)TlbType && Tools_IsProcessorInSet(&pTlbInfo->LPsSharingThisTlb, ProcessorIndex))
+        {
+            FoundTlbIndex = TlbIndex;
+        }
+    }
+
+    return FoundTlbIndex;
+}
+
+
+/*
+ * Topology_Internal_BuildDomainIdTable
+ *
+ *    Applies the domain mask matrix to the APIC ID of every processor once so
+ *    the IDs never need a mask and shift when they are looked up.  Each row is
+ *    padded to whole cache lines.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Returns true if the table was built
+ */
+BOOL_TYPE Topology_Internal_BuildDomainIdTable(PCPUID_TOPOLOGY pTopology)
+{
+    PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx;
+    unsigned int IdsPerCacheLine;
+    unsigned int ProcessorIndex;
+    unsigned int DomainIndex;
+    unsigned int RelativeDomainIndex;
+    unsigned int DomainShift;
+    unsigned int *pDomainIds;
+    BOOL_TYPE TableBuilt;
+
+    TableBuilt = BOOL_FALSE;
+    pApicidBitLayoutCtx = &pTopology->ApicidBitLayoutCtx;
+
+    IdsPerCacheLine = CACHE_LINE_SIZE/sizeof(unsigned int);
+
+    pTopology->NumberOfDomains = pApicidBitLayoutCtx->PackageDomainIndex + 1;
+    pTopology->DomainIdStride  = ((pTopology->NumberOfDomains*pTopology->NumberOfDomains + IdsPerCacheLine - 1)/IdsPerCacheLine)*IdsPerCacheLine;
+
+    pTopology->pDomainIdTable = (unsigned int *)Tools_AllocateAligned((size_t)pTopology->NumberOfProcessors*pTopology->DomainIdStride*sizeof(unsigned int), CACHE_LINE_SIZE);
+
+    if (pTopology->pDomainIdTable)
+    {
+        for (ProcessorIndex = 0; ProcessorIndex < pTopology->NumberOfProcessors; ProcessorIndex++)
+        {
+            pDomainIds = &pTopology->pDomainIdTable[ProcessorIndex*pTopology->DomainIdStride];
+
+            for (DomainIndex = 0; DomainIndex < pTopology->NumberOfDomains; DomainIndex++)
+            {
+                DomainShift = 0;
+
+                if (DomainIndex > 0)
+                {
+                    DomainShift = pApicidBitLayoutCtx->ShiftValues[DomainIndex - 1];
+                }
+
+                for (RelativeDomainIndex = DomainIndex; RelativeDomainIndex < pTopology->NumberOfDomains; RelativeDomainIndex++)
+                {
+                    pDomainIds[DomainIndex*pTopology->NumberOfDomains + RelativeDomainIndex] = (pApicidBitLayoutCtx->DomainRelativeMasks[DomainIndex][RelativeDomainIndex] & pTopology->pApicIdList[ProcessorIndex])>>DomainShift;
+                }
+            }
+        }
+
+        TableBuilt = BOOL_TRUE;
+    }
+
+    return TableBuilt;
+}
+
+
+/*
+ * Topology_Internal_BuildApicIdMap
+ *
+ *    Builds the direct map from APIC ID to processor index.  Sparse APIC IDs
+ *    are left unmapped and are searched for instead.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Returns false only if the map could not be allocated
+ */
+BOOL_TYPE Topology_Internal_BuildApicIdMap(PCPUID_TOPOLOGY pTopology)
+{
+    unsigned int ProcessorIndex;
+    unsigned int MaximumApicId;
+    unsigned int ApicId;
+    BOOL_TYPE MapBuilt;
+
+    MapBuilt = BOOL_TRUE;
+    MaximumApicId = 0;
+
+    for (ProcessorIndex = 0; ProcessorIndex < pTopology->NumberOfProcessors; ProcessorIndex++)
+    {
+        if (pTopology->pApicIdList[ProcessorIndex] > MaximumApicId)
+        {
+            MaximumApicId = pTopology->pApicIdList[ProcessorIndex];
+        }
+    }
+
+    if (MaximumApicId/MAX_APIC_ID_MAP_SLOTS_PER_LP < pTopology->NumberOfProcessors)
+    {
+        pTopology->ApicIdMapSize = MaximumApicId + 1;
+        pTopology->pApicIdToProcessor = (unsigned int *)malloc((size_t)pTopology->ApicIdMapSize*sizeof(unsigned int));
+
+        if (pTopology->pApicIdToProcessor)
+        {
+            for (ApicId = 0; ApicId < pTopology->ApicIdMapSize; ApicId++)
+            {
+                pTopology->pApicIdToProcessor[ApicId] = INVALID_PROCESSOR_INDEX;
+            }
+
+            /*
+             * Keep the first processor if an APIC ID were to be reported twice.
+             */
+            for (ProcessorIndex = pTopology->NumberOfProcessors; ProcessorIndex > 0; ProcessorIndex--)
+            {
+                pTopology->pApicIdToProcessor[pTopology->pApicIdList[ProcessorIndex - 1]] = ProcessorIndex - 1;
+            }
+        }
+        else
+        {
+            pTopology->ApicIdMapSize = 0;
+            MapBuilt = BOOL_FALSE;
+        }
+    }
+
+    return MapBuilt;
+}
+
+
+/*
+ * Topology_Internal_BuildCoreTypes
+ *
+ *    Reads the hybrid core type and native model ID of every processor.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Returns true if the core types were read
+ */
+BOOL_TYPE Topology_Internal_BuildCoreTypes(PCPUID_TOPOLOGY pTopology)
+{
+    unsigned int ProcessorIndex;
+    BOOL_TYPE CoreTypesBuilt;
+
+    CoreTypesBuilt = BOOL_FALSE;
+
+    pTopology->pCoreTypeList      = (CORE_TYPE *)calloc(pTopology->NumberOfProcessors ? pTopology->NumberOfProcessors : 1, sizeof(CORE_TYPE));
+    pTopology->pNativeModelIdList = (unsigned int *)calloc(pTopology->NumberOfProcessors ? pTopology->NumberOfProcessors : 1, sizeof(unsigned int));
+
+    if (pTopology->pCoreTypeList && pTopology->pNativeModelIdList)
+    {
+        for (ProcessorIndex = 0; ProcessorIndex < pTopology->NumberOfProcessors; ProcessorIndex++)
+        {
+            pTopology->pCoreTypeList[ProcessorIndex] = Tools_GetProcessorCoreType(ProcessorIndex, &pTopology->pNativeModelIdList[ProcessorIndex]);
+
+            if (pTopology->pCoreTypeList[ProcessorIndex] != CoreType_NotHybrid)
+            {
+                pTopology->IsHybrid = BOOL_TRUE;
+            }
+        }
+
+        CoreTypesBuilt = BOOL_TRUE;
+    }
+
+    return CoreTypesBuilt;
+}
+
+
+/*
+ * Topology_Internal_BuildNumaNodes
+ *
+ *    Reads the OS NUMA node of every processor.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Returns true if the NUMA node list was created
+ */
+BOOL_TYPE Topology_Internal_BuildNumaNodes(PCPUID_TOPOLOGY pTopology)
+{
+    unsigned int ProcessorIndex;
+    BOOL_TYPE NumaNodesBuilt;
+
+    NumaNodesBuilt = BOOL_FALSE;
+
+    pTopology->pNumaNodeList = (unsigned int *)calloc(pTopology->NumberOfProcessors ? pTopology->NumberOfProcessors : 1, sizeof(unsigned int));
+
+    if (pTopology->pNumaNodeList)
+    {
+        for (ProcessorIndex = 0; ProcessorIndex < pTopology->NumberOfProcessors; ProcessorIndex++)
+        {
+            if (Tools_GetProcessorNumaNode(ProcessorIndex, &pTopology->pNumaNodeList[ProcessorIndex]) == BOOL_FALSE)
+            {
+                pTopology->pNumaNodeList[ProcessorIndex] = INVALID_NUMA_NODE;
+            }
+        }
+
+        NumaNodesBuilt = BOOL_TRUE;
+    }
+
+    return NumaNodesBuilt;
+}
+
+
+/*
+ * Topology_Internal_BuildOsProcessorMap
+ *
+ *    Maps the OS processor ID each processor was captured on to its index.
+ *    There is no map when the CPUID was not captured on this platform since
+ *    the processor numbers of a file do not identify processors here.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     Returns true unless the map could not be allocated
+ */
+BOOL_TYPE Topology_Internal_BuildOsProcessorMap(PCPUID_TOPOLOGY pTopology)
+{
+    unsigned int ProcessorIndex;
+    unsigned int OsProcessorId;
+    unsigned int MaximumOsProcessorId;
+    BOOL_TYPE OsProcessorIdsFound;
+    BOOL_TYPE MapBuilt;
+
+    MapBuilt = BOOL_TRUE;
+    MaximumOsProcessorId = 0;
+    OsProcessorIdsFound = Tools_IsNative();
+
+    for (ProcessorIndex = 0; ProcessorIndex < pTopology->NumberOfProcessors && OsProcessorIdsFound; ProcessorIndex++)
+    {
+        OsProcessorIdsFound = Capture_GetSnapshotOsProcessorId(ProcessorIndex, &OsProcessorId);
+
+        if (OsProcessorIdsFound && OsProcessorId > MaximumOsProcessorId)
+        {
+            MaximumOsProcessorId = OsProcessorId;
+        }
+    }
+
+    if (OsProcessorIdsFound && pTopology->NumberOfProcessors)
+    {
+        pTopology->OsProcessorMapSize = MaximumOsProcessorId + 1;
+        pTopology->pOsProcessorToProcessor = (unsigned int *)malloc((size_t)pTopology->OsProcessorMapSize*sizeof(unsigned int));
+
+        if (pTopology->pOsProcessorToProcessor)
+        {
+            for (OsProcessorId = 0; OsProcessorId < pTopology->OsProcessorMapSize; OsProcessorId++)
+            {
+                pTopology->pOsProcessorToProcessor[OsProcessorId] = INVALID_PROCESSOR_INDEX;
+            }
+
+            for (ProcessorIndex = 0; ProcessorIndex < pTopology->NumberOfProcessors; ProcessorIndex++)
+            {
+                Capture_GetSnapshotOsProcessorId(ProcessorIndex, &OsProcessorId);
+                pTopology->pOsProcessorToProcessor[OsProcessorId] = ProcessorIndex;
+            }
+        }
+        else
+        {
+            pTopology->OsProcessorMapSize = 0;
+            MapBuilt = BOOL_FALSE;
+        }
+    }
+
+    return MapBuilt;
+}
+
+
+/*
+ * Topology_Internal_ReadCurrentApicId
+ *
+ *    Reads the APIC ID of the processor the calling thread is running on from
+ *    the same leaf the domain layout of the topology was built from.
+ *
+ * Arguments:
+ *     Topology
+ *
+ * Return:
+ *     X2APIC ID or legacy APIC ID
+ */
+unsigned int Topology_Internal_ReadCurrentApicId(PCPUID_TOPOLOGY pTopology)
+{
+    CPUID_REGISTERS CpuidRegisters;
+    unsigned int ApicId;
+
+    if (pTopology->Leaf == 0x1F || pTopology->Leaf == 0xB)
+    {
+        Os_Platform_Read_Cpuid(pTopology->Leaf, 0, &CpuidRegisters);
+        ApicId = CpuidRegisters.x.Register.Edx;
+    }
+    else
+    {
+        Os_Platform_Read_Cpuid(1, 0, &CpuidRegisters);
+        ApicId = (CpuidRegisters.x.Register.Ebx >> 24);
+    }
+
+    return ApicId;
+}
@@ -21,11 +21,6 @@
 #include "cpuid_topology.h"
 
 
-/*
- * Global application data variable
- */
-extern GLOBAL_DATA g_GlobalData;
-
 
 
 
@@ -33,10 +28,12 @@ extern GLOBAL_DATA g_GlobalData;
 /*
  *  Internal Prototype APIs
  */
-unsigned int ParseCache_Internal_FindMatchingCacheEntry(PCPUID_CACHE_INFO pCacheInfo, unsigned int NumberOfCaches, unsigned int CacheId, PCPUID_REGISTERS pCpuidRegisters);
-unsigned int ParseCache_Internal_AddCacheEntry(PCPUID_CACHE_INFO pCacheInfo, unsigned int *pNumberOfCaches, unsigned int CacheId, unsigned int CacheMask, PCPUID_REGISTERS pCpuidRegisters);
-unsigned int ParseTlb_Internal_FindMatchingTlbEntry(PCPUID_TLB_INFO pTlbInfo, unsigned int NumberOfTlbs, unsigned int TlbId, PCPUID_REGISTERS pCpuidRegisters);
-unsigned int ParseTlb_Internal_AddTlbEntry(PCPUID_TLB_INFO pTlbInfo, unsigned int *pNumberOfTlbs, unsigned int TlbId, unsigned int TlbMask, PCPUID_REGISTERS pCpuidRegisters);        
+unsigned int ParseCache_Internal_FindMatchingCacheEntry(PCPUID_REGISTER_INDEX pCacheIndex, unsigned int CacheId, PCPUID_REGISTERS pCpuidRegisters);
+BOOL_TYPE ParseCache_Internal_ReserveCacheEntry(PCPUID_CACHE_INFO *ppCacheInfo, unsigned int *pMaximumCaches, unsigned int NumberOfCaches, unsigned int NumberOfProcessors);
+unsigned int ParseCache_Internal_AddCacheEntry(PCPUID_CACHE_INFO pCacheInfo, PCPUID_REGISTER_INDEX pCacheIndex, unsigned int *pNumberOfCaches, unsigned int CacheId, unsigned int CacheMask, PCPUID_REGISTERS pCpuidRegisters);
+unsigned int ParseTlb_Internal_FindMatchingTlbEntry(PCPUID_REGISTER_INDEX pTlbIndex, unsigned int TlbId, PCPUID_REGISTERS pCpuidRegisters);
+BOOL_TYPE ParseTlb_Internal_ReserveTlbEntry(PCPUID_TLB_INFO *ppTlbInfo, unsigned int *pMaximumTlbs, unsigned int NumberOfTlbs, unsigned int NumberOfProcessors);
+unsigned int ParseTlb_Internal_AddTlbEntry(PCPUID_TLB_INFO pTlbInfo, PCPUID_REGISTER_INDEX pTlbIndex, unsigned int *pNumberOfTlbs, unsigned int TlbId, unsigned int TlbMask, PCPUID_REGISTERS pCpuidRegisters);        
 
 /*
  * ParseCache_CpuidCacheExample
@@ -51,20 +48,51 @@ unsigned int ParseTlb_Internal_AddTlbEntry(PCPUID_TLB_INFO pTlbInfo, unsigned in
  *     None
  */
 void ParseCache_CpuidCacheExample(void)
+{
+    CPUID_CACHE_TOPOLOGY CacheTopology;
+
+    if (ParseCache_BuildCacheTopology(&CacheTopology))
+    {
+        Display_DisplayProcessorCaches(CacheTopology.pCacheInfo, CacheTopology.NumberOfCaches, CacheTopology.pApicIdList, CacheTopology.NumberOfProcessors);
+        ParseCache_ReleaseCacheTopology(&CacheTopology);
+    }
+}
+
+
+/*
+ * ParseCache_BuildCacheTopology
+ *
+ *    Parses the CPUID Caching Information of every logical processor
+ *    via CPUID Leaf 4.  The caches are returned for any consumer, such as the display or
+ *    the export, and must be released with ParseCache_ReleaseCacheTopology.
+ *
+ * Arguments:
+ *     Cache Topology to fill in
+ *
+ * Return:
+ *     Returns true if the caches were enumerated
+ */
+BOOL_TYPE ParseCache_BuildCacheTopology(PCPUID_CACHE_TOPOLOGY pCacheTopology)
 {
     PCPUID_CACHE_INFO pCacheInfo;
+    CPUID_REGISTER_INDEX CacheRegisterIndex;
     unsigned int CacheIndex;
     unsigned int NumberOfCaches;
+    unsigned int MaximumCaches;
     unsigned int SubleafIndex;
     CPUID_REGISTERS CpuidRegisters;
     unsigned int NumberOfProcessors;
-    unsigned int ApicIdList[MAX_PROCESSORS];
+    unsigned int *pApicIdList;
     unsigned int ProcessorIndex;
     unsigned int MaxAddressibleIdSharingCache;
     unsigned int CacheShift;
     unsigned int CacheMask;
     unsigned int CacheId;
     CACHE_TYPE CacheType;
+    BOOL_TYPE TopologyBuilt;
+
+    TopologyBuilt = BOOL_FALSE;
+    memset(pCacheTopology, 0, sizeof(CPUID_CACHE_TOPOLOGY));
 
     /*
      *  Note that the SDM reccomends to look at CPUID.4 if CPUID.2 contains 0FFh.
@@ -75,19 +103,34 @@ void ParseCache_CpuidCacheExample(void)
      *  
      */
 
+    Capture_CaptureProcessors();
+
     Tools_ReadCpuid(0, 0, &CpuidRegisters);
 
     if (CpuidRegisters.x.Register.Eax >= 4) 
     {
         /*
-         * This is an example and the simplest thing is dynamically hardcode to 10 caches per logical processor 
-         * for simplicity. 
+         * Entries are only created for the caches that are found, starting with room for the caches 
+         * of a single logical processor and growing as needed. 
          */
 
-        NumberOfProcessors = Tools_GatherPlatformApicIds(ApicIdList, MAX_PROCESSORS);
+        pApicIdList = Tools_AllocatePlatformApicIds(&NumberOfProcessors);
         NumberOfCaches = 0;
 
-        pCacheInfo = (PCPUID_CACHE_INFO)calloc(NumberOfProcessors*MAX_CACHE_PER_LP, sizeof(CPUID_CACHE_INFO));
+        MaximumCaches = MAX_CACHE_PER_LP;
+
+        pCacheInfo = (PCPUID_CACHE_INFO)calloc(MaximumCaches, sizeof(CPUID_CACHE_INFO));
+
+        if (pCacheInfo) 
+        {
+            Instrument_CountAllocation(MaximumCaches*sizeof(CPUID_CACHE_INFO));
+        }
+
+        if (pCacheInfo && (pApicIdList == NULL || Tools_CreateRegisterIndex(&CacheRegisterIndex, MaximumCaches) == BOOL_FALSE)) 
+        {
+            free(pCacheInfo);
+            pCacheInfo = NULL;
+        }
 
         if (pCacheInfo) 
         {
@@ -147,19 +190,22 @@ void ParseCache_CpuidCacheExample(void)
                      * and continue on. 
                      *  
                      */
-                    CacheId = ApicIdList[ProcessorIndex] & CacheMask;
+                    CacheId = pApicIdList[ProcessorIndex] & CacheMask;
 
                     /*
                      * Find if this cache already exists in the cache list.
                      */
-                    CacheIndex = ParseCache_Internal_FindMatchingCacheEntry(pCacheInfo, NumberOfCaches, CacheId, &CpuidRegisters);
+                    CacheIndex = ParseCache_Internal_FindMatchingCacheEntry(&CacheRegisterIndex, CacheId, &CpuidRegisters);
 
                     if(CacheIndex == INVALID_CACHE_INDEX) 
                     {
                         /*
                          * This cache does not exist, so add this cache.
                          */
-                        CacheIndex = ParseCache_Internal_AddCacheEntry(pCacheInfo, &NumberOfCaches, CacheId, CacheMask, &CpuidRegisters);
+                        if (ParseCache_Internal_ReserveCacheEntry(&pCacheInfo, &MaximumCaches, NumberOfCaches, NumberOfProcessors)) 
+                        {
+                            CacheIndex = ParseCache_Internal_AddCacheEntry(pCacheInfo, &CacheRegisterIndex, &NumberOfCaches, CacheId, CacheMask, &CpuidRegisters);
+                        }
                     }
 
 
@@ -169,14 +215,13 @@ void ParseCache_CpuidCacheExample(void)
                      */
                     if(CacheIndex != INVALID_CACHE_INDEX) 
                     {
-                        pCacheInfo[CacheIndex].ListOfApicIDsSharingThisCache[pCacheInfo[CacheIndex].NumberOfLPsSharingThisCache] = ApicIdList[ProcessorIndex];
+                        Tools_AddProcessorToSet(&pCacheInfo[CacheIndex].LPsSharingThisCache, ProcessorIndex);
                         pCacheInfo[CacheIndex].NumberOfLPsSharingThisCache++;
                     }
                     else
                     {
                         /*
-                         * Should never reach here unless there were a lot of caches since 
-                         * we statically select a number. 
+                         * Should never reach here unless memory could not be allocated for another cache. 
                          */
 
                     }
@@ -187,10 +232,15 @@ void ParseCache_CpuidCacheExample(void)
                 }
             }
 
-            Display_DisplayProcessorCaches(pCacheInfo, NumberOfCaches);
+            Tools_DestroyRegisterIndex(&CacheRegisterIndex);
 
-            free(pCacheInfo);
-            pCacheInfo = NULL;
+            pCacheTopology->pCacheInfo = pCacheInfo;
+            pCacheTopology->NumberOfCaches = NumberOfCaches;
+            pCacheTopology->pApicIdList = pApicIdList;
+            pCacheTopology->NumberOfProcessors = NumberOfProcessors;
+            pApicIdList = NULL;
+
+            TopologyBuilt = BOOL_TRUE;
         }
         else
         {
@@ -199,6 +249,12 @@ void ParseCache_CpuidCacheExample(void)
              */
         }
 
+        if (pApicIdList) 
+        {
+            free(pApicIdList);
+            pApicIdList = NULL;
+        }
+
     }
     else
     {
@@ -206,6 +262,45 @@ void ParseCache_CpuidCacheExample(void)
          * Does not support CPUID.4 
          */
     }
+
+    return TopologyBuilt;
+}
+
+
+/*
+ * ParseCache_ReleaseCacheTopology
+ *
+ *    Release the caches returned by ParseCache_BuildCacheTopology.
+ *
+ * Arguments:
+ *     Cache Topology
+ *
+ * Return:
+ *     None
+ */
+void ParseCache_ReleaseCacheTopology(PCPUID_CACHE_TOPOLOGY pCacheTopology)
+{
+    unsigned int CacheIndex;
+
+    if (pCacheTopology->pCacheInfo)
+    {
+        for (CacheIndex = 0; CacheIndex < pCacheTopology->NumberOfCaches; CacheIndex++)
+        {
+            Tools_DestroyProcessorSet(&pCacheTopology->pCacheInfo[CacheIndex].LPsSharingThisCache);
+        }
+
+        free(pCacheTopology->pCacheInfo);
+        pCacheTopology->pCacheInfo = NULL;
+    }
+
+    if (pCacheTopology->pApicIdList)
+    {
+        free(pCacheTopology->pApicIdList);
+        pCacheTopology->pApicIdList = NULL;
+    }
+
+    pCacheTopology->NumberOfCaches = 0;
+    pCacheTopology->NumberOfProcessors = 0;
 }
 
 
@@ -213,62 +308,107 @@ void ParseCache_CpuidCacheExample(void)
 /*
  * ParseCache_Internal_FindMatchingCacheEntry
  *
- *    Searches the array to find a matching CacheID based on APIC ID parsing.
- * 
- *    Then there is a full CPUID Subleaf verification to determine this exactly
- *    matches the CPUID.4.n details.    
+ *    Looks up the CacheID based on APIC ID parsing together with the full 
+ *    CPUID Subleaf so only an entry that exactly matches the CPUID.4.n 
+ *    details is returned.
  * 
  * Arguments:
- *     Cache Array, Array Size, Cache ID to find, matching subleaf information for verification
+ *     Cache Index, Cache ID to find, matching subleaf information for verification
  *     
  * Return:
  *     Index if found
  */
-unsigned int ParseCache_Internal_FindMatchingCacheEntry(PCPUID_CACHE_INFO pCacheInfo, unsigned int NumberOfCaches, unsigned int CacheId, PCPUID_REGISTERS pCpuidRegisters)
+unsigned int ParseCache_Internal_FindMatchingCacheEntry(PCPUID_REGISTER_INDEX pCacheIndex, unsigned int CacheId, PCPUID_REGISTERS pCpuidRegisters)
 {
-    unsigned int CacheIndex;
     unsigned int CacheFoundIndex;
 
-    CacheFoundIndex = INVALID_CACHE_INDEX;
+    /*
+     * The index is keyed on both the Cache ID and the complete subleaf; we do not care 
+     * what the subleaf level was of the entry that created this cache or any that have been added, 
+     * only that they are a complete same description. 
+     *  
+     */
+    CacheFoundIndex = Tools_FindRegisterIndex(pCacheIndex, CacheId, pCpuidRegisters);
+
+    if (CacheFoundIndex == INVALID_REGISTER_INDEX) 
+    {
+        CacheFoundIndex = INVALID_CACHE_INDEX;
+    }
+
+    return CacheFoundIndex;
+}
+
+
+/*
+ * ParseCache_Internal_ReserveCacheEntry
+ *
+ *    Makes room for one more Cache entry.  Only the caches actually found are
+ *    stored so the array is doubled when it is full.
+ * 
+ * Arguments:
+ *     Pointer to the Cache Array, Pointer to the Array Capacity, Array Size, Number of Processors
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the next entry is available
+ */
+BOOL_TYPE ParseCache_Internal_ReserveCacheEntry(PCPUID_CACHE_INFO *ppCacheInfo, unsigned int *pMaximumCaches, unsigned int NumberOfCaches, unsigned int NumberOfProcessors)
+{
+    PCPUID_CACHE_INFO pNewCacheInfo;
+    BOOL_TYPE EntryReserved;
+
+    EntryReserved = BOOL_TRUE;
 
-    for (CacheIndex = 0; CacheIndex < NumberOfCaches && CacheFoundIndex == INVALID_CACHE_INDEX; CacheIndex++) 
+    if (NumberOfCaches == *pMaximumCaches) 
     {
-        if (pCacheInfo[CacheIndex].CacheId == CacheId) 
+        pNewCacheInfo = (PCPUID_CACHE_INFO)realloc(*ppCacheInfo, (*pMaximumCaches)*2*sizeof(CPUID_CACHE_INFO));
+
+        if (pNewCacheInfo) 
         {
-            /*
-             * Further verification this is the same by checking the complete subleaf matches, we do not care 
-             * what the subleaf level was of the entry that created this cache or any that have been added, 
-             * only that they are a complete same description. 
-             *  
-             */
-            if (memcmp(&pCacheInfo[CacheIndex].CachedCpuidRegisters, pCpuidRegisters, sizeof(CPUID_REGISTERS)) == 0) 
-            {
-                CacheFoundIndex = CacheIndex;
-            }
+            Instrument_CountAllocation((*pMaximumCaches)*2*sizeof(CPUID_CACHE_INFO));
+
+            *ppCacheInfo = pNewCacheInfo;
+            *pMaximumCaches = (*pMaximumCaches)*2;
+        }
+        else
+        {
+            EntryReserved = BOOL_FALSE;
         }
     }
 
-    return CacheFoundIndex;
+    /*
+     * The sharing set is sized to the processor count, a bit per logical processor.
+     */
+    if (EntryReserved) 
+    {
+        EntryReserved = Tools_CreateProcessorSet(&(*ppCacheInfo)[NumberOfCaches].LPsSharingThisCache, NumberOfProcessors);
+    }
+
+    if (EntryReserved) 
+    {
+        Instrument_CountAllocation(sizeof(unsigned int)*((NumberOfProcessors + PROCESSOR_SET_BITS_PER_WORD - 1)/PROCESSOR_SET_BITS_PER_WORD));
+    }
+
+    return EntryReserved;
 }
 
 
 /*
  * ParseCache_Internal_AddCacheEntry
  *
- *    Adds a new cache entry based on the CPUID Input.
+ *    Adds a new cache entry based on the CPUID Input into the entry reserved
+ *    by ParseCache_Internal_ReserveCacheEntry.
  * 
  * Arguments:
- *     Cache Array, Array Size, Cache ID to add, CPUID subleaf information describing this cache
+ *     Cache Array, Cache Index, Array Size, Cache ID to add, CPUID subleaf information describing this cache
  *     
  * Return:
- *     New Index
+ *     New Index or INVALID_CACHE_INDEX if it could not be indexed
  */
-unsigned int ParseCache_Internal_AddCacheEntry(PCPUID_CACHE_INFO pCacheInfo, unsigned int *pNumberOfCaches, unsigned int CacheId, unsigned int CacheMask, PCPUID_REGISTERS pCpuidRegisters)
+unsigned int ParseCache_Internal_AddCacheEntry(PCPUID_CACHE_INFO pCacheInfo, PCPUID_REGISTER_INDEX pCacheIndex, unsigned int *pNumberOfCaches, unsigned int CacheId, unsigned int CacheMask, PCPUID_REGISTERS pCpuidRegisters)
 {
     unsigned int NewCacheIndex;
 
     NewCacheIndex = *pNumberOfCaches;
-    *pNumberOfCaches = *pNumberOfCaches + 1;
 
     /*
      * Populate the cache base information from the CPUID descriptoin
@@ -309,6 +449,19 @@ unsigned int ParseCache_Internal_AddCacheEntry(PCPUID_CACHE_INFO pCacheInfo, uns
     pCacheInfo[NewCacheIndex].NumberOfLPsSharingThisCache = 0;
     memcpy(&pCacheInfo[NewCacheIndex].CachedCpuidRegisters, pCpuidRegisters, sizeof(CPUID_REGISTERS));
 
+    /*
+     * The entry only becomes part of the array once it can be found through the index.
+     */
+    if (Tools_InsertRegisterIndex(pCacheIndex, CacheId, pCpuidRegisters, NewCacheIndex)) 
+    {
+        *pNumberOfCaches = *pNumberOfCaches + 1;
+    }
+    else
+    {
+        Tools_DestroyProcessorSet(&pCacheInfo[NewCacheIndex].LPsSharingThisCache);
+        NewCacheIndex = INVALID_CACHE_INDEX;
+    }
+
     return NewCacheIndex;
 }
 
@@ -329,21 +482,54 @@ unsigned int ParseCache_Internal_AddCacheEntry(PCPUID_CACHE_INFO pCacheInfo, uns
  *     None
  */
 void ParseTlb_CpuidTlbExample(void)
+{
+    CPUID_TLB_TOPOLOGY TlbTopology;
+
+    if (ParseTlb_BuildTlbTopology(&TlbTopology))
+    {
+        Display_DisplayProcessorTlbs(TlbTopology.pTlbInfo, TlbTopology.NumberOfTlbs, TlbTopology.pApicIdList, TlbTopology.NumberOfProcessors);
+        ParseTlb_ReleaseTlbTopology(&TlbTopology);
+    }
+}
+
+
+/*
+ * ParseTlb_BuildTlbTopology
+ *
+ *    Parses the CPUID TLB Information of every logical processor
+ *    via CPUID Leaf 18H.  The TLBsare returned for any consumer, such as the display or
+ *    the export, and must be released with ParseTlb_ReleaseTlbTopology.
+ *
+ * Arguments:
+ *     Tlb Topology to fill in
+ *
+ * Return:
+ *     Returns true if the TLBs were enumerated
+ */
+BOOL_TYPE ParseTlb_BuildTlbTopology(PCPUID_TLB_TOPOLOGY pTlbTopology)
 {
     PCPUID_TLB_INFO pTlbInfo;
+    CPUID_REGISTER_INDEX TlbRegisterIndex;
     unsigned int TlbIndex;
     unsigned int NumberOfTlbs;
+    unsigned int MaximumTlbs;
     unsigned int SubleafIndex;
     unsigned int MaxSubleaf;
     CPUID_REGISTERS CpuidRegisters;
     unsigned int NumberOfProcessors;
-    unsigned int ApicIdList[MAX_PROCESSORS];
+    unsigned int *pApicIdList;
     unsigned int ProcessorIndex;
     unsigned int MaxAddressibleIdSharingTlb;
     unsigned int TlbShift;
     unsigned int TlbMask;
     unsigned int TlbId;
     TLB_TYPE TlbType;
+    BOOL_TYPE TopologyBuilt;
+
+    TopologyBuilt = BOOL_FALSE;
+    memset(pTlbTopology, 0, sizeof(CPUID_TLB_TOPOLOGY));
+
+    Capture_CaptureProcessors();
 
     Tools_ReadCpuid(0, 0, &CpuidRegisters);
 
@@ -359,14 +545,27 @@ void ParseTlb_CpuidTlbExample(void)
     if (CpuidRegisters.x.Register.Eax >= 0x18) 
     {
         /*
-         * This is an example and the simplest thing is dynamically hardcode to 10 TLBs per logical processor 
-         * for simplicity. 
+         * Entries are only created for the TLBs that are found, starting with room for the TLBs 
+         * of a single logical processor and growing as needed. 
          */
 
-        NumberOfProcessors = Tools_GatherPlatformApicIds(ApicIdList, MAX_PROCESSORS);
+        pApicIdList = Tools_AllocatePlatformApicIds(&NumberOfProcessors);
         NumberOfTlbs = 0;
 
-        pTlbInfo = (PCPUID_TLB_INFO)calloc(NumberOfProcessors*MAX_TLB_PER_LP, sizeof(CPUID_TLB_INFO));
+        MaximumTlbs = MAX_TLB_PER_LP;
+
+        pTlbInfo = (PCPUID_TLB_INFO)calloc(MaximumTlbs, sizeof(CPUID_TLB_INFO));
+
+        if (pTlbInfo) 
+        {
+            Instrument_CountAllocation(MaximumTlbs*sizeof(CPUID_TLB_INFO));
+        }
+
+        if (pTlbInfo && (pApicIdList == NULL || Tools_CreateRegisterIndex(&TlbRegisterIndex, MaximumTlbs) == BOOL_FALSE)) 
+        {
+            free(pTlbInfo);
+            pTlbInfo = NULL;
+        }
 
         if (pTlbInfo) 
         {
@@ -443,19 +642,22 @@ void ParseTlb_CpuidTlbExample(void)
                          * and continue on. 
                          *  
                          */
-                        TlbId = ApicIdList[ProcessorIndex] & TlbMask;
+                        TlbId = pApicIdList[ProcessorIndex] & TlbMask;
 
                         /*
                          * Find if this TLB already exists in the TLB list.
                          */
-                        TlbIndex = ParseTlb_Internal_FindMatchingTlbEntry(pTlbInfo, NumberOfTlbs, TlbId, &CpuidRegisters);
+                        TlbIndex = ParseTlb_Internal_FindMatchingTlbEntry(&TlbRegisterIndex, TlbId, &CpuidRegisters);
 
                         if(TlbIndex == INVALID_TLB_INDEX) 
                         {
                             /*
                              * This TLB does not exist, so add this TLB.
                              */
-                            TlbIndex = ParseTlb_Internal_AddTlbEntry(pTlbInfo, &NumberOfTlbs, TlbId, TlbMask, &CpuidRegisters);
+                            if (ParseTlb_Internal_ReserveTlbEntry(&pTlbInfo, &MaximumTlbs, NumberOfTlbs, NumberOfProcessors)) 
+                            {
+                                TlbIndex = ParseTlb_Internal_AddTlbEntry(pTlbInfo, &TlbRegisterIndex, &NumberOfTlbs, TlbId, TlbMask, &CpuidRegisters);
+                            }
                         }
 
 
@@ -465,14 +667,13 @@ void ParseTlb_CpuidTlbExample(void)
                          */
                         if(TlbIndex != INVALID_TLB_INDEX) 
                         {
-                            pTlbInfo[TlbIndex].ListOfApicIDsSharingThisTlb[pTlbInfo[TlbIndex].NumberOfLPsSharingThisTlb] = ApicIdList[ProcessorIndex];
+                            Tools_AddProcessorToSet(&pTlbInfo[TlbIndex].LPsSharingThisTlb, ProcessorIndex);
                             pTlbInfo[TlbIndex].NumberOfLPsSharingThisTlb++;
                         }
                         else
                         {
                             /*
-                             * Should never reach here unless there were a lot of TLBs since 
-                             * we statically select a number. 
+                             * Should never reach here unless memory could not be allocated for another TLB. 
                              */
 
                         }
@@ -480,10 +681,15 @@ void ParseTlb_CpuidTlbExample(void)
                 }
             }
 
-            Display_DisplayProcessorTlbs(pTlbInfo, NumberOfTlbs);
+            Tools_DestroyRegisterIndex(&TlbRegisterIndex);
 
-            free(pTlbInfo);
-            pTlbInfo = NULL;
+            pTlbTopology->pTlbInfo = pTlbInfo;
+            pTlbTopology->NumberOfTlbs = NumberOfTlbs;
+            pTlbTopology->pApicIdList = pApicIdList;
+            pTlbTopology->NumberOfProcessors = NumberOfProcessors;
+            pApicIdList = NULL;
+
+            TopologyBuilt = BOOL_TRUE;
         }
         else
         {
@@ -492,6 +698,12 @@ void ParseTlb_CpuidTlbExample(void)
              */
         }
 
+        if (pApicIdList) 
+        {
+            free(pApicIdList);
+            pApicIdList = NULL;
+        }
+
     }
     else
     {
@@ -499,6 +711,45 @@ void ParseTlb_CpuidTlbExample(void)
          * Does not support CPUID.18H
          */
     }
+
+    return TopologyBuilt;
+}
+
+
+/*
+ * ParseTlb_ReleaseTlbTopology
+ *
+ *    Release the TLBs returned by ParseTlb_BuildTlbTopology.
+ *
+ * Arguments:
+ *     Tlb Topology
+ *
+ * Return:
+ *     None
+ */
+void ParseTlb_ReleaseTlbTopology(PCPUID_TLB_TOPOLOGY pTlbTopology)
+{
+    unsigned int TlbIndex;
+
+    if (pTlbTopology->pTlbInfo)
+    {
+        for (TlbIndex = 0; TlbIndex < pTlbTopology->NumberOfTlbs; TlbIndex++)
+        {
+            Tools_DestroyProcessorSet(&pTlbTopology->pTlbInfo[TlbIndex].LPsSharingThisTlb);
+        }
+
+        free(pTlbTopology->pTlbInfo);
+        pTlbTopology->pTlbInfo = NULL;
+    }
+
+    if (pTlbTopology->pApicIdList)
+    {
+        free(pTlbTopology->pApicIdList);
+        pTlbTopology->pApicIdList = NULL;
+    }
+
+    pTlbTopology->NumberOfTlbs = 0;
+    pTlbTopology->NumberOfProcessors = 0;
 }
 
 
@@ -507,39 +758,31 @@ void ParseTlb_CpuidTlbExample(void)
 /*
  * ParseTlb_Internal_FindMatchingTlbEntry
  *
- *    Searches the array to find a matching TlbID based on APIC ID parsing.
- * 
- *    Then there is a full CPUID Subleaf verification to determine this exactly
- *    matches the CPUID.18.n details.    
+ *    Looks up the TlbID based on APIC ID parsing together with the full 
+ *    CPUID Subleaf so only an entry that exactly matches the CPUID.18.n 
+ *    details is returned.
  * 
  * Arguments:
- *     Tlb Array, Array Size, Tlb ID to find, matching subleaf information for verification
+ *     Tlb Index, Tlb ID to find, matching subleaf information for verification
  *     
  * Return:
  *     Index if found
  */
-unsigned int ParseTlb_Internal_FindMatchingTlbEntry(PCPUID_TLB_INFO pTlbInfo, unsigned int NumberOfTlbs, unsigned int TlbId, PCPUID_REGISTERS pCpuidRegisters)
+unsigned int ParseTlb_Internal_FindMatchingTlbEntry(PCPUID_REGISTER_INDEX pTlbIndex, unsigned int TlbId, PCPUID_REGISTERS pCpuidRegisters)
 {
-    unsigned int TlbIndex;
     unsigned int TlbFoundIndex;
 
-    TlbFoundIndex = INVALID_TLB_INDEX;
+    /*
+     * The index is keyed on both the Tlb ID and the complete subleaf; we do not care 
+     * what the subleaf level was of the entry that created this TLB or any that have been added, 
+     * only that they are a complete same description. 
+     *  
+     */
+    TlbFoundIndex = Tools_FindRegisterIndex(pTlbIndex, TlbId, pCpuidRegisters);
 
-    for (TlbIndex = 0; TlbIndex < NumberOfTlbs && TlbFoundIndex == INVALID_TLB_INDEX; TlbIndex++) 
+    if (TlbFoundIndex == INVALID_REGISTER_INDEX) 
     {
-        if (pTlbInfo[TlbIndex].TlbId == TlbId) 
-        {
-            /*
-             * Further verification this is the same by checking the complete subleaf matches, we do not care 
-             * what the subleaf level was of the entry that created this cache or any that have been added, 
-             * only that they are a complete same description. 
-             *  
-             */
-            if (memcmp(&pTlbInfo[TlbIndex].CachedCpuidRegisters, pCpuidRegisters, sizeof(CPUID_REGISTERS)) == 0) 
-            {
-                TlbFoundIndex = TlbIndex;
-            }
-        }
+        TlbFoundIndex = INVALID_TLB_INDEX;
     }
 
     return TlbFoundIndex;
@@ -551,23 +794,76 @@ unsigned int ParseTlb_Internal_FindMatchingTlbEntry(PCPUID_TLB_INFO pTlbInfo, un
 
 
 
+/*
+ * ParseTlb_Internal_ReserveTlbEntry
+ *
+ *    Makes room for one more Tlb entry.  Only the TLBs actually found are
+ *    stored so the array is doubled when it is full.
+ * 
+ * Arguments:
+ *     Pointer to the Tlb Array, Pointer to the Array Capacity, Array Size, Number of Processors
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the next entry is available
+ */
+BOOL_TYPE ParseTlb_Internal_ReserveTlbEntry(PCPUID_TLB_INFO *ppTlbInfo, unsigned int *pMaximumTlbs, unsigned int NumberOfTlbs, unsigned int NumberOfProcessors)
+{
+    PCPUID_TLB_INFO pNewTlbInfo;
+    BOOL_TYPE EntryReserved;
+
+    EntryReserved = BOOL_TRUE;
+
+    if (NumberOfTlbs == *pMaximumTlbs) 
+    {
+        pNewTlbInfo = (PCPUID_TLB_INFO)realloc(*ppTlbInfo, (*pMaximumTlbs)*2*sizeof(CPUID_TLB_INFO));
+
+        if (pNewTlbInfo) 
+        {
+            Instrument_CountAllocation((*pMaximumTlbs)*2*sizeof(CPUID_TLB_INFO));
+
+            *ppTlbInfo = pNewTlbInfo;
+            *pMaximumTlbs = (*pMaximumTlbs)*2;
+        }
+        else
+        {
+            EntryReserved = BOOL_FALSE;
+        }
+    }
+
+    /*
+     * The sharing set is sized to the processor count, a bit per logical processor.
+     */
+    if (EntryReserved) 
+    {
+        EntryReserved = Tools_CreateProcessorSet(&(*ppTlbInfo)[NumberOfTlbs].LPsSharingThisTlb, NumberOfProcessors);
+    }
+
+    if (EntryReserved) 
+    {
+        Instrument_CountAllocation(sizeof(unsigned int)*((NumberOfProcessors + PROCESSOR_SET_BITS_PER_WORD - 1)/PROCESSOR_SET_BITS_PER_WORD));
+    }
+
+    return EntryReserved;
+}
+
+
 /*
  * ParseTlb_Internal_AddTlbEntry
  *
- *    Adds a new Tlb entry based on the CPUID Input.
+ *    Adds a new Tlb entry based on the CPUID Input into the entry reserved
+ *    by ParseTlb_Internal_ReserveTlbEntry.
  * 
  * Arguments:
- *     Tlb Array, Array Size, Tlb ID to add, CPUID subleaf information describing this Tlb
+ *     Tlb Array, Tlb Index, Array Size, Tlb ID to add, CPUID subleaf information describing this Tlb
  *     
  * Return:
- *     New Index
+ *     New Index or INVALID_TLB_INDEX if it could not be indexed
  */
-unsigned int ParseTlb_Internal_AddTlbEntry(PCPUID_TLB_INFO pTlbInfo, unsigned int *pNumberOfTlbs, unsigned int TlbId, unsigned int TlbMask, PCPUID_REGISTERS pCpuidRegisters)
+unsigned int ParseTlb_Internal_AddTlbEntry(PCPUID_TLB_INFO pTlbInfo, PCPUID_REGISTER_INDEX pTlbIndex, unsigned int *pNumberOfTlbs, unsigned int TlbId, unsigned int TlbMask, PCPUID_REGISTERS pCpuidRegisters)
 {
     unsigned int NewTlbIndex;
 
     NewTlbIndex = *pNumberOfTlbs;
-    *pNumberOfTlbs = *pNumberOfTlbs + 1;
 
     /*
      * Populate the TLB base information from the CPUID descriptoin
@@ -601,6 +897,19 @@ unsigned int ParseTlb_Internal_AddTlbEntry(PCPUID_TLB_INFO pTlbInfo, unsigned in
     pTlbInfo[NewTlbIndex].NumberOfLPsSharingThisTlb = 0;
     memcpy(&pTlbInfo[NewTlbIndex].CachedCpuidRegisters, pCpuidRegisters, sizeof(CPUID_REGISTERS));
 
+    /*
+     * The entry only becomes part of the array once it can be found through the index.
+     */
+    if (Tools_InsertRegisterIndex(pTlbIndex, TlbId, pCpuidRegisters, NewTlbIndex)) 
+    {
+        *pNumberOfTlbs = *pNumberOfTlbs + 1;
+    }
+    else
+    {
+        Tools_DestroyProcessorSet(&pTlbInfo[NewTlbIndex].LPsSharingThisTlb);
+        NewTlbIndex = INVALID_TLB_INDEX;
+    }
+
     return NewTlbIndex;
 }
 
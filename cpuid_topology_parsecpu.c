@@ -20,11 +20,6 @@
 #include "cpuid_topology.h"
 
 
-/*
- * Global application data variable
- */
-extern GLOBAL_DATA g_GlobalData;
-
 
 
 
@@ -35,6 +30,8 @@ extern GLOBAL_DATA g_GlobalData;
 void ParseCpu_Internal_TopologyBitsFromLeaf(unsigned int Leaf);
 void ParseCpu_Internal_LegacyTopologyBits(void);
 void ParseCpu_Internal_CreateDomainMaskMatrix(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx);
+void ParseCpu_Internal_BuildManyDomainLayout(unsigned int Leaf, PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx);
+void ParseCpu_Internal_BuildLegacyLayout(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx);
 
 
 /*
@@ -242,15 +239,131 @@ void ParseCpu_CpuidThreeDomainExample(unsigned int Leaf)
  *     None
  */
 void ParseCpu_CpuidManyDomainExample(unsigned int Leaf)
+{
+    APICID_BIT_LAYOUT_CTX ApicidBitLayoutCtx;
+
+    ParseCpu_Internal_BuildManyDomainLayout(Leaf, &ApicidBitLayoutCtx);
+    Display_ManyDomainExample(Leaf, &ApicidBitLayoutCtx);
+}
+
+
+/*
+ * ParseCpu_BuildDomainLayout
+ *
+ *    Builds the layout of all known domains and their mask matrix from
+ *    the best topology leaf on this platform, CPUID.1F then CPUID.B and 
+ *    then the legacy CPUID.1 and CPUID.4 method.
+ * 
+ * Arguments:
+ *     APIC Bit Layout Context to fill in
+ *     
+ * Return:
+ *     The leaf the layout was built from
+ */
+unsigned int ParseCpu_BuildDomainLayout(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx)
+{
+    CPUID_REGISTERS CpuidRegisters;
+    CPUID_REGISTERS CpuidRegistersTopologyLeaf;
+    unsigned int Leaf;
+
+    Leaf = 1;
+
+    Tools_ReadCpuid(0, 0, &CpuidRegisters);
+
+    if (CpuidRegisters.x.Register.Eax >= 0x1F)
+    {
+        Tools_ReadCpuid(0x1F, 0, &CpuidRegistersTopologyLeaf);
+
+        if (CpuidRegistersTopologyLeaf.x.Register.Ebx != 0) 
+        {
+            Leaf = 0x1F;
+        }
+    }
+
+    if (CpuidRegisters.x.Register.Eax >= 0xB && Leaf == 1)
+    {
+        Tools_ReadCpuid(0xB, 0, &CpuidRegistersTopologyLeaf);
+
+        if (CpuidRegistersTopologyLeaf.x.Register.Ebx != 0) 
+        {
+            Leaf = 0xB;
+        }
+    }
+
+    if (Leaf == 1) 
+    {
+        ParseCpu_Internal_BuildLegacyLayout(pApicidBitLayoutCtx);
+        ParseCpu_Internal_CreateDomainMaskMatrix(pApicidBitLayoutCtx);
+    }
+    else
+    {
+        ParseCpu_Internal_BuildManyDomainLayout(Leaf, pApicidBitLayoutCtx);
+    }
+
+    return Leaf;
+}
+
+
+/*
+ * ParseCpu_MatchDomainLayout
+ *
+ *    Determines if the domain layout of the CPUID being read is the layout given,
+ *    which is usually one generated into a header for a known platform.  The
+ *    layout is built the same way as ParseCpu_BuildDomainLayout so this should 
+ *    be checked once and the result kept.
+ * 
+ * Arguments:
+ *     Domain Layout
+ *     
+ * Return:
+ *     Returns true if the leaf and the shift value and type of every domain match
+ */
+BOOL_TYPE ParseCpu_MatchDomainLayout(PCPUID_DOMAIN_LAYOUT pDomainLayout)
+{
+    APICID_BIT_LAYOUT_CTX ApicidBitLayoutCtx;
+    unsigned int DomainIndex;
+    BOOL_TYPE LayoutMatches;
+
+    LayoutMatches = BOOL_FALSE;
+
+    if (ParseCpu_BuildDomainLayout(&ApicidBitLayoutCtx) == pDomainLayout->Leaf && ApicidBitLayoutCtx.PackageDomainIndex + 1 == pDomainLayout->NumberOfDomains)
+    {
+        LayoutMatches = BOOL_TRUE;
+
+        for (DomainIndex = 0; DomainIndex < pDomainLayout->NumberOfDomains; DomainIndex++) 
+        {
+            if (ApicidBitLayoutCtx.ShiftValues[DomainIndex] != pDomainLayout->ShiftValues[DomainIndex] || ApicidBitLayoutCtx.ShiftValueDomain[DomainIndex] != pDomainLayout->ShiftValueDomain[DomainIndex])
+            {
+                LayoutMatches = BOOL_FALSE;
+            }
+        }
+    }
+
+    return LayoutMatches;
+}
+
+
+/*
+ * ParseCpu_Internal_BuildManyDomainLayout
+ *
+ *    Collapses the domains of CPUID.B or CPUID.1F to the known domains
+ *    and creates their mask matrix.
+ * 
+ * Arguments:
+ *     Leaf, APIC Bit Layout Context to fill in
+ *     
+ * Return:
+ *     None
+ */
+void ParseCpu_Internal_BuildManyDomainLayout(unsigned int Leaf, PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx)
 {
     CPUID_REGISTERS CpuidRegisters;
     unsigned int Subleaf;
     unsigned int DomainType;
     unsigned int DomainShift;
-    APICID_BIT_LAYOUT_CTX ApicidBitLayoutCtx;
 
-    memset(&ApicidBitLayoutCtx, 0, sizeof(APICID_BIT_LAYOUT_CTX));
-    ApicidBitLayoutCtx.NumberOfApicIdBits = 32;
+    memset(pApicidBitLayoutCtx, 0, sizeof(APICID_BIT_LAYOUT_CTX));
+    pApicidBitLayoutCtx->NumberOfApicIdBits = 32;
 
     Subleaf = 0;
 
@@ -283,24 +396,23 @@ void ParseCpu_CpuidManyDomainExample(unsigned int Leaf)
             case TileDomain:
             case DieDomain:
             case DieGrpDomain:
-                    ApicidBitLayoutCtx.ShiftValues[ApicidBitLayoutCtx.PackageDomainIndex] = DomainShift;
-                    ApicidBitLayoutCtx.ShiftValueDomain[ApicidBitLayoutCtx.PackageDomainIndex] = DomainType;
-                    ApicidBitLayoutCtx.PackageDomainIndex++;
+                    pApicidBitLayoutCtx->ShiftValues[pApicidBitLayoutCtx->PackageDomainIndex] = DomainShift;
+                    pApicidBitLayoutCtx->ShiftValueDomain[pApicidBitLayoutCtx->PackageDomainIndex] = DomainType;
+                    pApicidBitLayoutCtx->PackageDomainIndex++;
                     break;
 
             default: 
                     /*
                      * First Domain is always Logical Processor, so we will always have a valid previous.
                      */
-                    ApicidBitLayoutCtx.ShiftValues[ApicidBitLayoutCtx.PackageDomainIndex-1] = DomainShift;
+                    pApicidBitLayoutCtx->ShiftValues[pApicidBitLayoutCtx->PackageDomainIndex-1] = DomainShift;
         }
 
         Subleaf++;
         Tools_ReadCpuid(Leaf, Subleaf, &CpuidRegisters);
     }
 
-    ParseCpu_Internal_CreateDomainMaskMatrix(&ApicidBitLayoutCtx);
-    Display_ManyDomainExample(Leaf, &ApicidBitLayoutCtx);
+    ParseCpu_Internal_CreateDomainMaskMatrix(pApicidBitLayoutCtx);
 }
 
 
@@ -400,6 +512,8 @@ void ParseCpu_ApicIdTopologyLayout(void)
     }
 
     ParseCpu_Internal_LegacyTopologyBits();
+
+    Display_HybridCoreTypes();
 }
 
 /*
@@ -417,20 +531,40 @@ void ParseCpu_ApicIdTopologyLayout(void)
  */
 void ParseCpu_Internal_LegacyTopologyBits(void)
 {
-    CPUID_REGISTERS CpuidRegisters;
     APICID_BIT_LAYOUT_CTX ApicidBitLayoutCtx;
+
+    ParseCpu_Internal_BuildLegacyLayout(&ApicidBitLayoutCtx);
+    Display_ApicIdBitLayout(&ApicidBitLayoutCtx);
+}
+
+
+/*
+ * ParseCpu_Internal_BuildLegacyLayout
+ *
+ * Builds the APIC ID bit layout from the legacy CPUID.1 and
+ * CPUID.4 method.
+ *
+ * Arguments:
+ *     APIC Bit Layout Context to fill in
+ *     
+ * Return:
+ *     None
+ */
+void ParseCpu_Internal_BuildLegacyLayout(PAPICID_BIT_LAYOUT_CTX pApicidBitLayoutCtx)
+{
+    CPUID_REGISTERS CpuidRegisters;
     unsigned int MaximumAddressibleIdsPhysicalPackage;
     unsigned int MaximumAddressibleIdsCores;
     unsigned int PackageShift;
     unsigned int LogicalProcessorsPerCore;
     unsigned int LogicalProcessorShift;
 
-    memset(&ApicidBitLayoutCtx, 0, sizeof(ApicidBitLayoutCtx));
+    memset(pApicidBitLayoutCtx, 0, sizeof(APICID_BIT_LAYOUT_CTX));
 
-    ApicidBitLayoutCtx.ShiftValueDomain[0] = LogicalProcessorDomain;
-    ApicidBitLayoutCtx.ShiftValueDomain[1] = CoreDomain;
-    ApicidBitLayoutCtx.PackageDomainIndex  = 2;
-    ApicidBitLayoutCtx.NumberOfApicIdBits  = 8;
+    pApicidBitLayoutCtx->ShiftValueDomain[0] = LogicalProcessorDomain;
+    pApicidBitLayoutCtx->ShiftValueDomain[1] = CoreDomain;
+    pApicidBitLayoutCtx->PackageDomainIndex  = 2;
+    pApicidBitLayoutCtx->NumberOfApicIdBits  = 8;
 
     MaximumAddressibleIdsPhysicalPackage = 1;
     Tools_ReadCpuid(1, 0, &CpuidRegisters);
@@ -473,10 +607,10 @@ void ParseCpu_Internal_LegacyTopologyBits(void)
 
                 PackageShift = Tools_CreateTopologyShift(MaximumAddressibleIdsPhysicalPackage);
 
-                ApicidBitLayoutCtx.ShiftValues[0] = LogicalProcessorShift;
-                ApicidBitLayoutCtx.ShiftValues[1] = PackageShift;
+                pApicidBitLayoutCtx->ShiftValues[0] = LogicalProcessorShift;
+                pApicidBitLayoutCtx->ShiftValues[1] = PackageShift;
 
-                strncpy(ApicidBitLayoutCtx.szDescription, "Legacy path using CPUID.1 and CPUID.4 (May not be correct if Leaf B or Leaf 1F exist.)", sizeof(ApicidBitLayoutCtx.szDescription)-1);
+                strncpy(pApicidBitLayoutCtx->szDescription, "Legacy path using CPUID.1 and CPUID.4 (May not be correct if Leaf B or Leaf 1F exist.)", sizeof(pApicidBitLayoutCtx->szDescription)-1);
         }
         else
         {
@@ -485,9 +619,9 @@ void ParseCpu_Internal_LegacyTopologyBits(void)
              */
             PackageShift = Tools_CreateTopologyShift(MaximumAddressibleIdsPhysicalPackage);
 
-            ApicidBitLayoutCtx.ShiftValues[0] = PackageShift;
-            ApicidBitLayoutCtx.PackageDomainIndex  = 1;
-            strncpy(ApicidBitLayoutCtx.szDescription, "Legacy path using CPUID.1 and CPUID.HTT = 1 but no CPUID.4", sizeof(ApicidBitLayoutCtx.szDescription)-1);
+            pApicidBitLayoutCtx->ShiftValues[0] = PackageShift;
+            pApicidBitLayoutCtx->PackageDomainIndex  = 1;
+            strncpy(pApicidBitLayoutCtx->szDescription, "Legacy path using CPUID.1 and CPUID.HTT = 1 but no CPUID.4", sizeof(pApicidBitLayoutCtx->szDescription)-1);
         }
     }
     else
@@ -496,12 +630,10 @@ void ParseCpu_Internal_LegacyTopologyBits(void)
          * Without any enumeration of CPUID existing, then it's just one logical processor per package.
          */
         PackageShift = Tools_CreateTopologyShift(MaximumAddressibleIdsPhysicalPackage);
-        ApicidBitLayoutCtx.ShiftValues[0] = PackageShift;
-        ApicidBitLayoutCtx.PackageDomainIndex  = 1;
-        strncpy(ApicidBitLayoutCtx.szDescription, "Legacy path where CPUID.HTT = 0", sizeof(ApicidBitLayoutCtx.szDescription)-1);
+        pApicidBitLayoutCtx->ShiftValues[0] = PackageShift;
+        pApicidBitLayoutCtx->PackageDomainIndex  = 1;
+        strncpy(pApicidBitLayoutCtx->szDescription, "Legacy path where CPUID.HTT = 0", sizeof(pApicidBitLayoutCtx->szDescription)-1);
     }
-
-    Display_ApicIdBitLayout(&ApicidBitLayoutCtx);
 }
 
 /*
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The planner orders the processors by a sort key built from the topology and
+ * hands them to the workers in that order.  The first key is the core type so
+ * performance cores are used before efficient cores on hybrid platforms, then
+ * one key per domain or cache level plus the APIC ID to keep the order stable.
+ */
+#define MAX_PLACEMENT_KEYS  (MAXIMUM_DOMAINS + 3)
+#define CORE_TYPE_KEYS      1
+
+typedef struct _PLACEMENT_ENTRY
+{
+    unsigned int Keys[MAX_PLACEMENT_KEYS];
+    unsigned int ProcessorIndex;
+
+} PLACEMENT_ENTRY, *PPLACEMENT_ENTRY;
+
+
+/*
+ * Internal Planner APIs
+ */
+void Planner_Internal_SpreadKeys(PCPUID_TOPOLOGY pTopology, PPLACEMENT_ENTRY pPlacementEntry);
+void Planner_Internal_PackKeys(PCPUID_TOPOLOGY pTopology, PPLACEMENT_ENTRY pPlacementEntry);
+void Planner_Internal_NoSmtKeys(PCPUID_TOPOLOGY pTopology, PPLACEMENT_ENTRY pPlacementEntry);
+unsigned int Planner_Internal_CoreTypeRank(CORE_TYPE CoreType);
+int Planner_Internal_CompareEntries(const void *pFirst, const void *pSecond);
+
+
+
+/*
+ * Planner_CpuidPlacementExample
+ *
+ *    Plans the placement of a number of workers with a policy and displays
+ *    the ordered processor list and the affinity mask.
+ *
+ * Arguments:
+ *     Number of Workers, Placement Policy
+ *
+ * Return:
+ *     None
+ */
+void Planner_CpuidPlacementExample(unsigned int NumberOfWorkers, PLACEMENT_POLICY PlacementPolicy)
+{
+    PCPUID_TOPOLOGY pTopology;
+    unsigned int *pProcessorList;
+
+    pTopology = Topology_Create();
+
+    if (pTopology)
+    {
+        pProcessorList = (unsigned int *)malloc((size_t)NumberOfWorkers*sizeof(unsigned int));
+
+        if (pProcessorList)
+        {
+            if (Planner_PlaceWorkers(pTopology, NumberOfWorkers, PlacementPolicy, pProcessorList))
+            {
+                Display_DisplayPlacement(pTopology, NumberOfWorkers, PlacementPolicy, pProcessorList);
+            }
+
+            free(pProcessorList);
+        }
+
+        Topology_Destroy(pTopology);
+    }
+}
+
+
+/*
+ * Planner_PlaceWorkers
+ *
+ *    Chooses the processor for each worker.
+ *
+ *       Spread - Workers go to different packages first, then different dies
+ *                and so on down the domains, SMT siblings are used last.
+ *       Pack   - Workers fill the processors sharing the last level cache, and
+ *                within it the lower level caches, before moving on.
+ *       No SMT - One worker per core in APIC ID order, SMT siblings are only
+ *                used once every core has a worker.
+ *
+ *    Each policy uses the performance cores of a hybrid platform before its
+ *    efficient cores.  The processors are reused in the same order when there
+ *    are more workers than processors.
+ *
+ * Arguments:
+ *     Topology, Number of Workers, Placement Policy, Processor List for each worker
+ *
+ * Return:
+ *     Returns true if the workers were placed
+ */
+BOOL_TYPE Planner_PlaceWorkers(PCPUID_TOPOLOGY pTopology, unsigned int NumberOfWorkers, PLACEMENT_POLICY PlacementPolicy, unsigned int *pProcessorList)
+{
+    PPLACEMENT_ENTRY pPlacementEntries;
+    unsigned int NumberOfProcessors;
+    unsigned int ProcessorIndex;
+    unsigned int WorkerIndex;
+    BOOL_TYPE WorkersPlaced;
+
+    WorkersPlaced = BOOL_FALSE;
+    NumberOfProcessors = Topology_GetNumberOfProcessors(pTopology);
+
+    pPlacementEntries = (PPLACEMENT_ENTRY)calloc(NumberOfProcessors, sizeof(PLACEMENT_ENTRY));
+
+    if (pPlacementEntries)
+    {
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++)
+        {
+            pPlacementEntries[ProcessorIndex].ProcessorIndex = ProcessorIndex;
+            pPlacementEntries[ProcessorIndex].Keys[0] = Planner_Internal_CoreTypeRank(Topology_GetCoreType(pTopology, ProcessorIndex));
+
+            switch (PlacementPolicy)
+            {
+                case PlacementPolicy_Pack:
+                     Planner_Internal_PackKeys(pTopology, &pPlacementEntries[ProcessorIndex]);
+                     break;
+
+                case PlacementPolicy_NoSmt:
+                     Planner_Internal_NoSmtKeys(pTopology, &pPlacementEntries[ProcessorIndex]);
+                     break;
+
+                default:
+                     Planner_Internal_SpreadKeys(pTopology, &pPlacementEntries[ProcessorIndex]);
+            }
+        }
+
+        qsort(pPlacementEntries, NumberOfProcessors, sizeof(PLACEMENT_ENTRY), Planner_Internal_CompareEntries);
+
+        for (WorkerIndex = 0; WorkerIndex < NumberOfWorkers; WorkerIndex++)
+        {
+            pProcessorList[WorkerIndex] = pPlacementEntries[WorkerIndex % NumberOfProcessors].ProcessorIndex;
+        }
+
+        free(pPlacementEntries);
+        WorkersPlaced = BOOL_TRUE;
+    }
+
+    return WorkersPlaced;
+}
+
+
+/*
+ * Planner_Internal_SpreadKeys
+ *
+ *    The keys are the ID of each domain within the next domain from the
+ *    lowest domain up, ending with the package ID.  Sorting on them cycles
+ *    through the packages fastest and through SMT siblings slowest.
+ *
+ * Arguments:
+ *     Topology, Placement Entry
+ *
+ * Return:
+ *     None
+ */
+void Planner_Internal_SpreadKeys(PCPUID_TOPOLOGY pTopology, PPLACEMENT_ENTRY pPlacementEntry)
+{
+    unsigned int NumberOfDomains;
+    unsigned int DomainIndex;
+
+    NumberOfDomains = Topology_GetNumberOfDomains(pTopology);
+
+    for (DomainIndex = 0; DomainIndex + 1 < NumberOfDomains; DomainIndex++)
+    {
+        pPlacementEntry->Keys[CORE_TYPE_KEYS + DomainIndex] = Topology_GetDomainId(pTopology, pPlacementEntry->ProcessorIndex, DomainIndex, DomainIndex + 1);
+    }
+
+    pPlacementEntry->Keys[CORE_TYPE_KEYS + DomainIndex]     = Topology_GetDomainId(pTopology, pPlacementEntry->ProcessorIndex, DomainIndex, DomainIndex);
+    pPlacementEntry->Keys[CORE_TYPE_KEYS + DomainIndex + 1] = Topology_GetApicId(pTopology, pPlacementEntry->ProcessorIndex);
+}
+
+
+/*
+ * Planner_Internal_PackKeys
+ *
+ *    The keys are the package ID, then the data or unified cache used at each
+ *    level from the last level cache down, then the APIC ID.  Sorting on them
+ *    keeps the processors sharing a cache next to each other.
+ *
+ * Arguments:
+ *     Topology, Placement Entry
+ *
+ * Return:
+ *     None
+ */
+void Planner_Internal_PackKeys(PCPUID_TOPOLOGY pTopology, PPLACEMENT_ENTRY pPlacementEntry)
+{
+    unsigned int PackageDomainIndex;
+    unsigned int MaximumCacheLevel;
+    unsigned int CacheLevel;
+    unsigned int CacheIndex;
+    unsigned int KeyIndex;
+
+    PackageDomainIndex = Topology_GetNumberOfDomains(pTopology) - 1;
+    MaximumCacheLevel  = 0;
+
+    for (CacheIndex = 0; CacheIndex < Topology_GetNumberOfCaches(pTopology); CacheIndex++)
+    {
+        if (Topology_GetCache(pTopology, CacheIndex)->CacheLevel > MaximumCacheLevel)
+        {
+            MaximumCacheLevel = Topology_GetCache(pTopology, CacheIndex)->CacheLevel;
+        }
+    }
+
+    KeyIndex = CORE_TYPE_KEYS;
+    pPlacementEntry->Keys[KeyIndex++] = Topology_GetDomainId(pTopology, pPlacementEntry->ProcessorIndex, PackageDomainIndex, PackageDomainIndex);
+
+    for (CacheLevel = MaximumCacheLevel; CacheLevel > 0 && KeyIndex + 1 < MAX_PLACEMENT_KEYS; CacheLevel--)
+    {
+        pPlacementEntry->Keys[KeyIndex++] = Topology_FindProcessorCache(pTopology, pPlacementEntry->ProcessorIndex, CacheLevel, CacheType_NoMoreCaches);
+    }
+
+    pPlacementEntry->Keys[KeyIndex] = Topology_GetApicId(pTopology, pPlacementEntry->ProcessorIndex);
+}
+
+
+/*
+ * Planner_Internal_NoSmtKeys
+ *
+ *    The keys are the ID of the processor within its core and the APIC ID,
+ *    so the first processor of every core sorts ahead of any SMT sibling.
+ *    Without an enumerated core domain every processor is its own core.
+ *
+ * Arguments:
+ *     Topology, Placement Entry
+ *
+ * Return:
+ *     None
+ */
+void Planner_Internal_NoSmtKeys(PCPUID_TOPOLOGY pTopology, PPLACEMENT_ENTRY pPlacementEntry)
+{
+    pPlacementEntry->Keys[CORE_TYPE_KEYS] = 0;
+
+    if (Topology_GetDomainType(pTopology, 1) == CoreDomain)
+    {
+        pPlacementEntry->Keys[CORE_TYPE_KEYS] = Topology_GetDomainId(pTopology, pPlacementEntry->ProcessorIndex, 0, 1);
+    }
+
+    pPlacementEntry->Keys[CORE_TYPE_KEYS + 1] = Topology_GetApicId(pTopology, pPlacementEntry->ProcessorIndex);
+}
+
+
+/*
+ * Planner_Internal_CoreTypeRank
+ *
+ *    The order core types are used in, performance cores and processors that
+ *    are not hybrid first, efficient cores last.
+ *
+ * Arguments:
+ *     Core Type
+ *
+ * Return:
+ *     Rank of the core type
+ */
+unsigned int Planner_Internal_CoreTypeRank(CORE_TYPE CoreType)
+{
+    unsigned int CoreTypeRank;
+
+    switch (CoreType)
+    {
+        case CoreType_Core:
+        case CoreType_NotHybrid:
+             CoreTypeRank = 0;
+             break;
+
+        case CoreType_Atom:
+             CoreTypeRank = 2;
+             break;
+
+        default:
+             CoreTypeRank = 1;
+    }
+
+    return CoreTypeRank;
+}
+
+
+/*
+ * Planner_Internal_CompareEntries
+ *
+ *    Compare the keys of two placement entries for qsort.
+ *
+ * Arguments:
+ *     First Entry, Second Entry
+ *
+ * Return:
+ *     Less than, equal to or greater than zero
+ */
+int Planner_Internal_CompareEntries(const void *pFirst, const void *pSecond)
+{
+    PPLACEMENT_ENTRY pFirstEntry;
+    PPLACEMENT_ENTRY pSecondEntry;
+    unsigned int KeyIndex;
+    int Compare;
+
+    pFirstEntry  = (PPLACEMENT_ENTRY)pFirst;
+    pSecondEntry = (PPLACEMENT_ENTRY)pSecond;
+    Compare = 0;
+
+    for (KeyIndex = 0; KeyIndex < MAX_PLACEMENT_KEYS && Compare == 0; KeyIndex++)
+    {
+        if (pFirstEntry->Keys[KeyIndex] != pSecondEntry->Keys[KeyIndex])
+        {
+            Compare = (pFirstEntry->Keys[KeyIndex] < pSecondEntry->Keys[KeyIndex]) ? -1 : 1;
+        }
+    }
+
+    if (Compare == 0)
+    {
+        Compare = (pFirstEntry->ProcessorIndex < pSecondEntry->ProcessorIndex) ? -1 : ((pFirstEntry->ProcessorIndex > pSecondEntry->ProcessorIndex) ? 1 : 0);
+    }
+
+    return Compare;
+}
+
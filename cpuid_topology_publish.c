@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The first publication epoch, a reader epoch of zero means it is not reading.
+ */
+#define FIRST_PUBLICATION_EPOCH  (1ULL)
+
+
+/*
+ * Internal Publication APIs
+ */
+unsigned long long Publish_Internal_GetOldestReaderEpoch(PTOPOLOGY_PUBLISHER pPublisher);
+
+
+
+/*
+ * Publish_CreatePublisher
+ *
+ *    Creates a publisher with no topology for up to the number of readers
+ *    specified.  The topologies published are owned by the publisher and are
+ *    destroyed by it.
+ *
+ * Arguments:
+ *     Maximum Number of Readers
+ *
+ * Return:
+ *     The publisher or NULL on memory allocation failure
+ */
+PTOPOLOGY_PUBLISHER Publish_CreatePublisher(unsigned int MaximumReaders)
+{
+    PTOPOLOGY_PUBLISHER pPublisher;
+
+    pPublisher = (PTOPOLOGY_PUBLISHER)calloc(1, sizeof(TOPOLOGY_PUBLISHER));
+
+    if (pPublisher)
+    {
+        pPublisher->Epoch = FIRST_PUBLICATION_EPOCH;
+        pPublisher->MaximumReaders = MaximumReaders;
+
+        if (MaximumReaders)
+        {
+            pPublisher->pReaders = (PTOPOLOGY_READER)Tools_AllocateAligned(MaximumReaders*sizeof(TOPOLOGY_READER), CACHE_LINE_SIZE);
+
+            if (pPublisher->pReaders == NULL)
+            {
+                free(pPublisher);
+                pPublisher = NULL;
+            }
+        }
+    }
+
+    return pPublisher;
+}
+
+
+/*
+ * Publish_DestroyPublisher
+ *
+ *    Destroys a publisher with its current topology and every retired topology,
+ *    no reader may be reading.
+ *
+ * Arguments:
+ *     Publisher
+ *
+ * Return:
+ *     None
+ */
+void Publish_DestroyPublisher(PTOPOLOGY_PUBLISHER pPublisher)
+{
+    PRETIRED_TOPOLOGY pRetiredTopology;
+
+    if (pPublisher)
+    {
+        while (pPublisher->pRetiredTopologies)
+        {
+            pRetiredTopology = pPublisher->pRetiredTopologies;
+            pPublisher->pRetiredTopologies = pRetiredTopology->pNext;
+
+            Topology_Destroy(pRetiredTopology->pTopology);
+            free(pRetiredTopology);
+        }
+
+        if (pPublisher->pCurrentTopology)
+        {
+            Topology_Destroy((PCPUID_TOPOLOGY)pPublisher->pCurrentTopology);
+        }
+
+        if (pPublisher->pReaders)
+        {
+            Tools_FreeAligned(pPublisher->pReaders);
+        }
+
+        free(pPublisher);
+    }
+}
+
+
+/*
+ * Publish_RegisterReader
+ *
+ *    Claims a reader for the calling thread, any thread may register a reader
+ *    at any time.
+ *
+ * Arguments:
+ *     Publisher
+ *
+ * Return:
+ *     The reader index or INVALID_READER_INDEX if every reader is in use
+ */
+unsigned int Publish_RegisterReader(PTOPOLOGY_PUBLISHER pPublisher)
+{
+    unsigned int ReaderIndex;
+    unsigned int RegisteredIndex;
+
+    RegisteredIndex = INVALID_READER_INDEX;
+
+    for (ReaderIndex = 0; ReaderIndex < pPublisher->MaximumReaders && RegisteredIndex == INVALID_READER_INDEX; ReaderIndex++)
+    {
+        if (Os_AtomicCompareExchange64(&pPublisher->pReaders[ReaderIndex].InUse, 0, 1))
+        {
+            Os_AtomicStore64(&pPublisher->pReaders[ReaderIndex].Epoch, 0);
+            RegisteredIndex = ReaderIndex;
+        }
+    }
+
+    return RegisteredIndex;
+}
+
+
+/*
+ * Publish_UnregisterReader
+ *
+ *    Releases a reader that is not reading so it can be registered again.
+ *
+ * Arguments:
+ *     Publisher, Reader Index
+ *
+ * Return:
+ *     None
+ */
+void Publish_UnregisterReader(PTOPOLOGY_PUBLISHER pPublisher, unsigned int ReaderIndex)
+{
+    if (ReaderIndex < pPublisher->MaximumReaders)
+    {
+        Os_AtomicStore64(&pPublisher->pReaders[ReaderIndex].Epoch, 0);
+        Os_AtomicStore64(&pPublisher->pReaders[ReaderIndex].InUse, 0);
+    }
+}
+
+
+/*
+ * Publish_EnterRead
+ *
+ *    Starts a read of the current topology.  The reader records the epoch it is
+ *    entering before it loads the topology, so a topology replaced after this
+ *    is not destroyed until the reader calls Publish_ExitRead.  The topology is
+ *    immutable and may be queried with any Topology API until then.
+ *
+ * Arguments:
+ *     Publisher, Reader Index
+ *
+ * Return:
+ *     The current topology or NULL if none has been published
+ */
+PCPUID_TOPOLOGY Publish_EnterRead(PTOPOLOGY_PUBLISHER pPublisher, unsigned int ReaderIndex)
+{
+    PCPUID_TOPOLOGY pTopology;
+
+    pTopology = NULL;
+
+    if (ReaderIndex < pPublisher->MaximumReaders)
+    {
+        Os_AtomicStore64(&pPublisher->pReaders[ReaderIndex].Epoch, Os_AtomicLoad64(&pPublisher->Epoch));
+
+        pTopology = (PCPUID_TOPOLOGY)Os_AtomicLoadPointer(&pPublisher->pCurrentTopology);
+    }
+
+    return pTopology;
+}
+
+
+/*
+ * Publish_ExitRead
+ *
+ *    Ends a read, the topology returned by Publish_EnterRead may no longer be used.
+ *
+ * Arguments:
+ *     Publisher, Reader Index
+ *
+ * Return:
+ *     None
+ */
+void Publish_ExitRead(PTOPOLOGY_PUBLISHER pPublisher, unsigned int ReaderIndex)
+{
+    if (ReaderIndex < pPublisher->MaximumReaders)
+    {
+        Os_AtomicStore64(&pPublisher->pReaders[ReaderIndex].Epoch, 0);
+    }
+}
+
+
+/*
+ * Publish_PublishTopology
+ *
+ *    Replaces the current topology with a new one in a single pointer swap, so
+ *    readers see either the old or the new topology and never a partial one.
+ *    The epoch is then advanced and the old topology is retired in the new epoch,
+ *    the retired topologies no reader can see are destroyed.  Only one thread
+ *    may publish at a time.
+ *
+ * Arguments:
+ *     Publisher, Topology from Topology_Create
+ *
+ * Return:
+ *     Returns true if the topology was published, it is then owned by the publisher
+ */
+BOOL_TYPE Publish_PublishTopology(PTOPOLOGY_PUBLISHER pPublisher, PCPUID_TOPOLOGY pTopology)
+{
+    PRETIRED_TOPOLOGY pRetiredTopology;
+    BOOL_TYPE TopologyPublished;
+
+    TopologyPublished = BOOL_FALSE;
+
+    /*
+     * The retired entry is allocated first so a topology is never published
+     * without a way to retire the topology it replaces.
+     */
+    pRetiredTopology = (PRETIRED_TOPOLOGY)calloc(1, sizeof(RETIRED_TOPOLOGY));
+
+    if (pRetiredTopology && pTopology)
+    {
+        pRetiredTopology->pTopology = (PCPUID_TOPOLOGY)Os_AtomicExchangePointer(&pPublisher->pCurrentTopology, pTopology);
+        pRetiredTopology->RetireEpoch = Os_AtomicIncrement64(&pPublisher->Epoch);
+
+        if (pRetiredTopology->pTopology)
+        {
+            pRetiredTopology->pNext = pPublisher->pRetiredTopologies;
+            pPublisher->pRetiredTopologies = pRetiredTopology;
+            pPublisher->NumberOfRetiredTopologies++;
+            pRetiredTopology = NULL;
+        }
+
+        pPublisher->Generation++;
+        TopologyPublished = BOOL_TRUE;
+
+        Publish_ReclaimTopologies(pPublisher);
+    }
+
+    if (pRetiredTopology)
+    {
+        free(pRetiredTopology);
+    }
+
+    return TopologyPublished;
+}
+
+
+/*
+ * Publish_ReclaimTopologies
+ *
+ *    Destroys the retired topologies that no reader can still see.  A topology
+ *    retired in an epoch can only be seen by a reader that entered in an earlier
+ *    epoch, so it is destroyed once every reader is either not reading or has
+ *    entered in that epoch or later.  This is called by the publishing thread.
+ *
+ * Arguments:
+ *     Publisher
+ *
+ * Return:
+ *     The number of retired topologies still waiting for readers
+ */
+unsigned int Publish_ReclaimTopologies(PTOPOLOGY_PUBLISHER pPublisher)
+{
+    PRETIRED_TOPOLOGY *ppRetiredTopology;
+    PRETIRED_TOPOLOGY pRetiredTopology;
+    unsigned long long OldestReaderEpoch;
+
+    OldestReaderEpoch = Publish_Internal_GetOldestReaderEpoch(pPublisher);
+
+    ppRetiredTopology = &pPublisher->pRetiredTopologies;
+
+    while (*ppRetiredTopology)
+    {
+        pRetiredTopology = *ppRetiredTopology;
+
+        if (pRetiredTopology->RetireEpoch <= OldestReaderEpoch)
+        {
+            *ppRetiredTopology = pRetiredTopology->pNext;
+            pPublisher->NumberOfRetiredTopologies--;
+
+            Topology_Destroy(pRetiredTopology->pTopology);
+            free(pRetiredTopology);
+        }
+        else
+        {
+            ppRetiredTopology = &pRetiredTopology->pNext;
+        }
+    }
+
+    return pPublisher->NumberOfRetiredTopologies;
+}
+
+
+/*
+ * Publish_Internal_GetOldestReaderEpoch
+ *
+ *    Finds the oldest epoch any reader is reading in.
+ *
+ * Arguments:
+ *     Publisher
+ *
+ * Return:
+ *     The oldest reader epoch or the maximum epoch if no reader is reading
+ */
+unsigned long long Publish_Internal_GetOldestReaderEpoch(PTOPOLOGY_PUBLISHER pPublisher)
+{
+    unsigned long long OldestReaderEpoch;
+    unsigned long long ReaderEpoch;
+    unsigned int ReaderIndex;
+
+    OldestReaderEpoch = (unsigned long long)-1;
+
+    for (ReaderIndex = 0; ReaderIndex < pPublisher->MaximumReaders; ReaderIndex++)
+    {
+        ReaderEpoch = Os_AtomicLoad64(&pPublisher->pReaders[ReaderIndex].Epoch);
+
+        if (ReaderEpoch != 0 && ReaderEpoch < OldestReaderEpoch)
+        {
+            OldestReaderEpoch = ReaderEpoch;
+        }
+    }
+
+    return OldestReaderEpoch;
+}
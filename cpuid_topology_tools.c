@@ -16,13 +16,171 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include "cpuid_topology.h"
 
 
 /*
- * Global application data variable
+ * The context of any thread that could not be given its own, it is only used if 
+ * the OS has no thread slot or memory allocation fails and is not thread safe.
  */
-GLOBAL_DATA g_GlobalData;
+CPUID_CONTEXT g_FallbackCpuidContext;
+
+
+/*
+ * Internal Prototypes
+ */
+unsigned int Tools_Internal_HashRegisterIndexKey(unsigned int Id, PCPUID_REGISTERS pCpuidRegisters);
+PCPUID_REGISTER_INDEX_ENTRY Tools_Internal_FindRegisterIndexSlot(PCPUID_REGISTER_INDEX pRegisterIndex, unsigned int Id, PCPUID_REGISTERS pCpuidRegisters);
+BOOL_TYPE Tools_Internal_GrowRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex);
+
+
+/*
+ * Tools_CreateCpuidContext
+ *
+ *    Creates an empty CPUID context, it has no snapshot until processors are
+ *    captured or a CPUID file is loaded while it is bound to a thread.
+ *
+ * Arguments:
+ *     Use Native CPUID
+ *     
+ * Return:
+ *     The CPUID context or NULL on memory allocation failure
+ */
+PCPUID_CONTEXT Tools_CreateCpuidContext(BOOL_TYPE UseNativeCpuid)
+{
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = (PCPUID_CONTEXT)calloc(1, sizeof(CPUID_CONTEXT));
+
+    if (pCpuidContext) 
+    {
+        pCpuidContext->UseNativeCpuid = UseNativeCpuid;
+    }
+
+    return pCpuidContext;
+}
+
+
+/*
+ * Tools_ReleaseCpuidContext
+ *
+ *    Releases a CPUID context and its snapshot.  A context that is bound to the
+ *    calling thread is unbound, it must not be bound to any other thread.
+ *
+ * Arguments:
+ *     CPUID Context
+ *     
+ * Return:
+ *     None
+ */
+void Tools_ReleaseCpuidContext(PCPUID_CONTEXT pCpuidContext)
+{
+    if (pCpuidContext) 
+    {
+        if (Os_GetThreadContext() == pCpuidContext) 
+        {
+            Os_SetThreadContext(NULL);
+        }
+
+        Instrument_AddSnapshotReads(pCpuidContext);
+        Capture_ReleaseContextSnapshot(pCpuidContext);
+
+        if (pCpuidContext != &g_FallbackCpuidContext) 
+        {
+            free(pCpuidContext);
+        }
+    }
+}
+
+
+/*
+ * Tools_SetCpuidContext
+ *
+ *    Binds a CPUID context to the calling thread, every CPUID read, capture, file
+ *    and topology API called on this thread then uses it.  The context that was 
+ *    bound is returned so it can be bound again when the caller is done.
+ *
+ * Arguments:
+ *     CPUID Context or NULL to unbind the current context
+ *     
+ * Return:
+ *     The CPUID context that was bound or NULL if there was none
+ */
+PCPUID_CONTEXT Tools_SetCpuidContext(PCPUID_CONTEXT pCpuidContext)
+{
+    PCPUID_CONTEXT pPreviousCpuidContext;
+
+    pPreviousCpuidContext = (PCPUID_CONTEXT)Os_GetThreadContext();
+
+    Os_SetThreadContext(pCpuidContext);
+
+    return pPreviousCpuidContext;
+}
+
+
+/*
+ * Tools_GetCpuidContext
+ *
+ *    Returns the CPUID context bound to the calling thread.  A thread that has 
+ *    none is given its own native context, which is released when it exits.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The CPUID context of this thread
+ */
+PCPUID_CONTEXT Tools_GetCpuidContext(void)
+{
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = (PCPUID_CONTEXT)Os_GetThreadContext();
+
+    if (pCpuidContext == NULL) 
+    {
+        pCpuidContext = Tools_CreateCpuidContext(BOOL_TRUE);
+
+        if (pCpuidContext) 
+        {
+            pCpuidContext->ThreadOwned = BOOL_TRUE;
+
+            if (Os_SetThreadContext(pCpuidContext) == BOOL_FALSE) 
+            {
+                free(pCpuidContext);
+                pCpuidContext = NULL;
+            }
+        }
+
+        if (pCpuidContext == NULL) 
+        {
+            pCpuidContext = &g_FallbackCpuidContext;
+        }
+    }
+
+    return pCpuidContext;
+}
+
+
+/*
+ * Tools_ReleaseThreadCpuidContext
+ *
+ *    Called by the OS layer when a thread exits with the context that was bound 
+ *    to it, only a context that was created for the thread is released.
+ *
+ * Arguments:
+ *     CPUID Context
+ *     
+ * Return:
+ *     None
+ */
+void Tools_ReleaseThreadCpuidContext(void *pCpuidContext)
+{
+    if (pCpuidContext && ((PCPUID_CONTEXT)pCpuidContext)->ThreadOwned) 
+    {
+        Tools_ReleaseCpuidContext((PCPUID_CONTEXT)pCpuidContext);
+    }
+}
 
 
 /*
@@ -40,63 +198,43 @@ GLOBAL_DATA g_GlobalData;
  */
 void Tools_ReadCpuid(unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
 {
-    if (g_GlobalData.UseNativeCpuid) 
+    PCPUID_CONTEXT pCpuidContext;
+    BOOL_TYPE LeafFound;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    /*
+     * Both native and simulated CPUID are served from the per-processor snapshot for the 
+     * processor that the affinity was last set to.  Only native leafs that are not held in 
+     * the snapshot will execute CPUID, simulated leafs that were not in the file are zero. 
+     */
+    LeafFound = Capture_ReadSnapshotCpuid(pCpuidContext, pCpuidContext->CurrentProcessorAffinity, Leaf, Subleaf, pCpuidRegisters);
+
+    if (LeafFound) 
     {
-        Os_Platform_Read_Cpuid(Leaf, Subleaf, pCpuidRegisters);
+        pCpuidContext->SnapshotHits++;
     }
     else
     {
-        memset(pCpuidRegisters, 0, sizeof(CPUID_REGISTERS));
+        if (pCpuidContext->pProcessorSnapshot) 
+        {
+            pCpuidContext->SnapshotMisses++;
+        }
 
-        if (Leaf < MAX_SIMULATED_LEAFS) 
+        if (pCpuidContext->UseNativeCpuid) 
         {
-            if (Subleaf < MAX_SIMULATED_SUBLEAFS) 
+            if (pCpuidContext->pProcessorSnapshot) 
             {
-                /*
-                 *  The file stores a single copy of each CPUID except for CPUID.4 and CPUID.18.  Although the others
-                 *  have some asymmetric aspects in CPUID.1F and CPUID.B; they are not important to this sample code. However, to
-                 *  ensure we reserve asymmetric topology enumeration we save all of CPUID.4 and CPUID.18 values and so we
-                 *  have to dispatch those seperately and other leafs we rebuild just the APIC IDs (we do not rebuild EBX in extended
-                 *  topology leaf, which can also be asymmetric but it's only for reporting purposes and not used in this sample).
-                 */
-                if (Leaf == 0x4) 
-                {
-                    pCpuidRegisters->x.Registers[0] = g_GlobalData.SimulatedCpuidLeaf4[g_GlobalData.CurrentProcessorAffinity][Subleaf][0];
-                    pCpuidRegisters->x.Registers[1] = g_GlobalData.SimulatedCpuidLeaf4[g_GlobalData.CurrentProcessorAffinity][Subleaf][1];
-                    pCpuidRegisters->x.Registers[2] = g_GlobalData.SimulatedCpuidLeaf4[g_GlobalData.CurrentProcessorAffinity][Subleaf][2];
-                    pCpuidRegisters->x.Registers[3] = g_GlobalData.SimulatedCpuidLeaf4[g_GlobalData.CurrentProcessorAffinity][Subleaf][3];
-                }
-                else
-                {
-                    if (Leaf == 0x18) 
-                    {
-                        pCpuidRegisters->x.Registers[0] = g_GlobalData.SimulatedCpuidLeaf18[g_GlobalData.CurrentProcessorAffinity][Subleaf][0];
-                        pCpuidRegisters->x.Registers[1] = g_GlobalData.SimulatedCpuidLeaf18[g_GlobalData.CurrentProcessorAffinity][Subleaf][1];
-                        pCpuidRegisters->x.Registers[2] = g_GlobalData.SimulatedCpuidLeaf18[g_GlobalData.CurrentProcessorAffinity][Subleaf][2];
-                        pCpuidRegisters->x.Registers[3] = g_GlobalData.SimulatedCpuidLeaf18[g_GlobalData.CurrentProcessorAffinity][Subleaf][3];
-                    }
-                    else
-                    {
-                        pCpuidRegisters->x.Registers[0] = g_GlobalData.SimulatedCpuid[Leaf][Subleaf][0];
-                        pCpuidRegisters->x.Registers[1] = g_GlobalData.SimulatedCpuid[Leaf][Subleaf][1];
-                        pCpuidRegisters->x.Registers[2] = g_GlobalData.SimulatedCpuid[Leaf][Subleaf][2];
-                        pCpuidRegisters->x.Registers[3] = g_GlobalData.SimulatedCpuid[Leaf][Subleaf][3];
-
-                        if ((Leaf == 0xB || Leaf == 0x1F) && pCpuidRegisters->x.Registers[1] != 0)
-                        {
-                            pCpuidRegisters->x.Registers[3] = g_GlobalData.SimulatedApicIds[g_GlobalData.CurrentProcessorAffinity];
-                        }
-
-                        if (Leaf == 0x1)
-                        {
-                            pCpuidRegisters->x.Registers[2] = pCpuidRegisters->x.Registers[2] & (~(0xFF<<24));
-                            pCpuidRegisters->x.Registers[2] = pCpuidRegisters->x.Registers[2] | (g_GlobalData.SimulatedApicIds[g_GlobalData.CurrentProcessorAffinity]<<24);
-                        }
-                    }
-                }
+                Os_SetAffinity(pCpuidContext->CurrentProcessorAffinity);
             }
+
+            Os_Platform_Read_Cpuid(Leaf, Subleaf, pCpuidRegisters);
         }
-     }
+        else
+        {
+            memset(pCpuidRegisters, 0, sizeof(CPUID_REGISTERS));
+        }
+    }
 }
 
 
@@ -151,7 +289,11 @@ unsigned int Tools_CreateTopologyShift(unsigned int count)
  */
 BOOL_TYPE Tools_IsNative(void)
 {
-    return g_GlobalData.UseNativeCpuid;
+    PCPUID_CONTEXT pCpuidContext;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    return pCpuidContext->UseNativeCpuid;
 }
 
 
@@ -166,21 +308,35 @@ BOOL_TYPE Tools_IsNative(void)
  *     Processor to set affinity
  *     
  * Return:
- *     None
+ *     Returns true if the affinity was set
  */
-void Tools_SetAffinity(unsigned int ProcessorNumber)
+BOOL_TYPE Tools_SetAffinity(unsigned int ProcessorNumber)
 {
-    if (g_GlobalData.UseNativeCpuid)
+    PCPUID_CONTEXT pCpuidContext;
+    BOOL_TYPE AffinitySet;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    AffinitySet = BOOL_FALSE;
+
+    /*
+     * When the processors are in the snapshot there is no need to migrate, the 
+     * CPUID reads will be served from that processor's snapshot. 
+     */
+    if (pCpuidContext->pProcessorSnapshot && ProcessorNumber < pCpuidContext->NumberOfSnapshotProcessors) 
     {
-        Os_SetAffinity(ProcessorNumber);
+        pCpuidContext->CurrentProcessorAffinity = ProcessorNumber;
+        AffinitySet = BOOL_TRUE;
     }
     else
     {
-        if (ProcessorNumber < g_GlobalData.NumberOfSimulatedProcessors) 
+        if (pCpuidContext->UseNativeCpuid)
         {
-            g_GlobalData.CurrentProcessorAffinity = ProcessorNumber;
+            AffinitySet = Os_SetAffinity(ProcessorNumber);
         }
     }
+
+    return AffinitySet;
 }
 
 
@@ -199,15 +355,18 @@ void Tools_SetAffinity(unsigned int ProcessorNumber)
  */
 unsigned int Tools_GetNumberOfProcessors(void)
 {
+    PCPUID_CONTEXT pCpuidContext;
     unsigned int NumberOfProcessors;
 
-    if (g_GlobalData.UseNativeCpuid)
+    pCpuidContext = Tools_GetCpuidContext();
+
+    if (pCpuidContext->UseNativeCpuid)
     {
         NumberOfProcessors = Os_GetNumberOfProcessors();
     }
     else
     {
-        NumberOfProcessors = g_GlobalData.NumberOfSimulatedProcessors;
+        NumberOfProcessors = pCpuidContext->NumberOfSnapshotProcessors;
     }
 
     return NumberOfProcessors;
@@ -256,6 +415,9 @@ BOOL_TYPE Tools_IsDomainKnownEnumeration(unsigned int Domain)
  *
  *    Creates and returns a cache of the APIC IDs.
  *    
+ *    The APIC IDs are cached in the snapshot when the processors are 
+ *    captured, so they are only derived from CPUID once.
+ *    
  *
  * Arguments:
  *     APIC ID array, Size of the array
@@ -272,12 +434,9 @@ unsigned int Tools_GatherPlatformApicIds(unsigned int *pApicIdArray, unsigned in
     CPUID_REGISTERS CpuidRegisters;
     CPUID_REGISTERS CpuidRegistersApicid;
 
-    NumberOfProcessors = Tools_GetNumberOfProcessors();
+    Capture_CaptureProcessors();
 
-    if (NumberOfProcessors > MAX_PROCESSORS) 
-    {
-        NumberOfProcessors = MAX_PROCESSORS;
-    }
+    NumberOfProcessors = Tools_GetNumberOfProcessors();
 
     /*
      * Determine X2APIC ID or fall back to APIC ID.
@@ -287,10 +446,14 @@ unsigned int Tools_GatherPlatformApicIds(unsigned int *pApicIdArray, unsigned in
     for (Index = 0; Index < NumberOfProcessors && Index < ArraySize; Index++) 
     {
         ApicId = 0;
-        bApicIdFound = BOOL_FALSE;
+        bApicIdFound = Capture_GetSnapshotApicId(Index, &ApicId);
+
+        if (bApicIdFound == BOOL_FALSE) 
+        {
+            Tools_SetAffinity(Index);
+        }
 
-        Tools_SetAffinity(Index);
-        if (CpuidRegisters.x.Register.Eax >= 0x1F) 
+        if (bApicIdFound == BOOL_FALSE && CpuidRegisters.x.Register.Eax >= 0x1F) 
         {
             Tools_ReadCpuid(0x1F, 0, &CpuidRegistersApicid);
 
@@ -331,3 +494,708 @@ unsigned int Tools_GatherPlatformApicIds(unsigned int *pApicIdArray, unsigned in
     return Index;
 }
 
+
+/*
+ * Tools_AllocatePlatformApicIds
+ *
+ *    Allocates an array sized to the number of processors on the 
+ *    platform and gathers the APIC IDs into it.  The caller frees
+ *    the array.
+ *
+ * Arguments:
+ *     Returned Number of APIC IDs
+ *     
+ * Return:
+ *     APIC ID array or NULL on failure
+ */
+unsigned int *Tools_AllocatePlatformApicIds(unsigned int *pNumberOfProcessors)
+{
+    unsigned int *pApicIdArray;
+    unsigned int NumberOfProcessors;
+
+    *pNumberOfProcessors = 0;
+
+    Capture_CaptureProcessors();
+
+    NumberOfProcessors = Tools_GetNumberOfProcessors();
+
+    pApicIdArray = (unsigned int *)calloc(NumberOfProcessors ? NumberOfProcessors : 1, sizeof(unsigned int));
+
+    if (pApicIdArray) 
+    {
+        *pNumberOfProcessors = Tools_GatherPlatformApicIds(pApicIdArray, NumberOfProcessors);
+    }
+
+    return pApicIdArray;
+}
+
+
+
+
+/*
+ * Tools_GetProcessorCoreType
+ *
+ *    Reads the hybrid core type and native model ID of a processor from
+ *    CPUID.1AH, processors that do not enumerate the leaf are not hybrid.
+ *
+ * Arguments:
+ *     Processor Number, Returned Native Model ID (may be NULL)
+ *     
+ * Return:
+ *     Core Type
+ */
+CORE_TYPE Tools_GetProcessorCoreType(unsigned int ProcessorNumber, unsigned int *pNativeModelId)
+{
+    CPUID_REGISTERS CpuidRegisters;
+    CORE_TYPE CoreType;
+    unsigned int NativeModelId;
+
+    CoreType = CoreType_NotHybrid;
+    NativeModelId = 0;
+
+    Tools_SetAffinity(ProcessorNumber);
+    Tools_ReadCpuid(0, 0, &CpuidRegisters);
+
+    if (CpuidRegisters.x.Register.Eax >= 0x1A) 
+    {
+        Tools_ReadCpuid(0x1A, 0, &CpuidRegisters);
+
+        CoreType      = (CORE_TYPE)(CpuidRegisters.x.Register.Eax >> 24);
+        NativeModelId = CpuidRegisters.x.Register.Eax & 0xFFFFFF;
+    }
+
+    if (pNativeModelId) 
+    {
+        *pNativeModelId = NativeModelId;
+    }
+
+    return CoreType;
+}
+
+
+/*
+ * Tools_IsHybridPlatform
+ *
+ *    Determines if any processor on the platform reports a hybrid core type.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     Returns BOOL_TRUE on a hybrid platform.
+ */
+BOOL_TYPE Tools_IsHybridPlatform(void)
+{
+    unsigned int NumberOfProcessors;
+    unsigned int ProcessorIndex;
+    BOOL_TYPE IsHybrid;
+
+    IsHybrid = BOOL_FALSE;
+
+    Capture_CaptureProcessors();
+
+    NumberOfProcessors = Tools_GetNumberOfProcessors();
+
+    for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors && IsHybrid == BOOL_FALSE; ProcessorIndex++) 
+    {
+        if (Tools_GetProcessorCoreType(ProcessorIndex, NULL) != CoreType_NotHybrid) 
+        {
+            IsHybrid = BOOL_TRUE;
+        }
+    }
+
+    return IsHybrid;
+}
+
+
+/*
+ * Tools_GetProcessorNumaNode
+ *
+ *    Get the OS NUMA node of a processor.  The OS is only asked when
+ *    running natively; a CPUID file carries no NUMA information.
+ *
+ * Arguments:
+ *     Processor Number, Returned NUMA Node
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the NUMA node is known.
+ */
+BOOL_TYPE Tools_GetProcessorNumaNode(unsigned int ProcessorNumber, unsigned int *pNumaNode)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    BOOL_TYPE NodeFound;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    NodeFound = BOOL_FALSE;
+
+    if (pCpuidContext->UseNativeCpuid && ProcessorNumber < Tools_GetNumberOfProcessors()) 
+    {
+        NodeFound = Os_GetProcessorNumaNode(ProcessorNumber, pNumaNode);
+    }
+
+    return NodeFound;
+}
+
+
+
+
+/*
+ * Tools_CreateRegisterIndex
+ *
+ *    Creates an empty register index with room for the expected
+ *    number of entries.  The index will grow if more are added.
+ *
+ * Arguments:
+ *     Register Index, Expected Number of Entries
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the index was created.
+ */
+BOOL_TYPE Tools_CreateRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex, unsigned int ExpectedEntries)
+{
+    unsigned int SlotIndex;
+    BOOL_TYPE IndexCreated;
+
+    IndexCreated = BOOL_FALSE;
+
+    /*
+     * Keep the index at most half full so probe sequences stay short.
+     */
+    pRegisterIndex->NumberOfSlots = 16;
+
+    while (pRegisterIndex->NumberOfSlots < ExpectedEntries*2) 
+    {
+        pRegisterIndex->NumberOfSlots = pRegisterIndex->NumberOfSlots*2;
+    }
+
+    pRegisterIndex->NumberOfEntries = 0;
+    pRegisterIndex->pSlots = (PCPUID_REGISTER_INDEX_ENTRY)malloc(pRegisterIndex->NumberOfSlots*sizeof(CPUID_REGISTER_INDEX_ENTRY));
+
+    if (pRegisterIndex->pSlots) 
+    {
+        /*
+         * The register index is counted as a parser allocation, it is mostly used 
+         * by the cache and TLB parsers. 
+         */
+        Instrument_CountAllocation(pRegisterIndex->NumberOfSlots*sizeof(CPUID_REGISTER_INDEX_ENTRY));
+
+        for (SlotIndex = 0; SlotIndex < pRegisterIndex->NumberOfSlots; SlotIndex++) 
+        {
+            pRegisterIndex->pSlots[SlotIndex].Value = INVALID_REGISTER_INDEX;
+        }
+
+        IndexCreated = BOOL_TRUE;
+    }
+    else
+    {
+        pRegisterIndex->NumberOfSlots = 0;
+    }
+
+    return IndexCreated;
+}
+
+
+/*
+ * Tools_FindRegisterIndex
+ *
+ *    Finds the value stored for an ID and the complete CPUID subleaf.
+ *
+ * Arguments:
+ *     Register Index, ID, CPUID subleaf information
+ *     
+ * Return:
+ *     The value stored or INVALID_REGISTER_INDEX if it was not found.
+ */
+unsigned int Tools_FindRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex, unsigned int Id, PCPUID_REGISTERS pCpuidRegisters)
+{
+    PCPUID_REGISTER_INDEX_ENTRY pSlot;
+    unsigned int Value;
+
+    Value = INVALID_REGISTER_INDEX;
+
+    pSlot = Tools_Internal_FindRegisterIndexSlot(pRegisterIndex, Id, pCpuidRegisters);
+
+    if (pSlot) 
+    {
+        Value = pSlot->Value;
+    }
+
+    return Value;
+}
+
+
+/*
+ * Tools_InsertRegisterIndex
+ *
+ *    Stores a value for an ID and the complete CPUID subleaf, replacing
+ *    any value already stored for that key.
+ *
+ * Arguments:
+ *     Register Index, ID, CPUID subleaf information, Value
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the value was stored.
+ */
+BOOL_TYPE Tools_InsertRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex, unsigned int Id, PCPUID_REGISTERS pCpuidRegisters, unsigned int Value)
+{
+    PCPUID_REGISTER_INDEX_ENTRY pSlot;
+    BOOL_TYPE ValueInserted;
+
+    ValueInserted = BOOL_TRUE;
+
+    if ((pRegisterIndex->NumberOfEntries + 1)*2 > pRegisterIndex->NumberOfSlots) 
+    {
+        ValueInserted = Tools_Internal_GrowRegisterIndex(pRegisterIndex);
+    }
+
+    if (ValueInserted) 
+    {
+        pSlot = Tools_Internal_FindRegisterIndexSlot(pRegisterIndex, Id, pCpuidRegisters);
+
+        if (pSlot->Value == INVALID_REGISTER_INDEX) 
+        {
+            pSlot->Id = Id;
+            memcpy(&pSlot->CpuidRegisters, pCpuidRegisters, sizeof(CPUID_REGISTERS));
+            pRegisterIndex->NumberOfEntries++;
+        }
+
+        pSlot->Value = Value;
+    }
+
+    return ValueInserted;
+}
+
+
+/*
+ * Tools_DestroyRegisterIndex
+ *
+ *    Frees the register index.
+ *
+ * Arguments:
+ *     Register Index
+ *     
+ * Return:
+ *     None
+ */
+void Tools_DestroyRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex)
+{
+    if (pRegisterIndex->pSlots) 
+    {
+        free(pRegisterIndex->pSlots);
+        pRegisterIndex->pSlots = NULL;
+    }
+
+    pRegisterIndex->NumberOfSlots = 0;
+    pRegisterIndex->NumberOfEntries = 0;
+}
+
+
+/*
+ * Tools_CreateProcessorSet
+ *
+ *    Creates an empty processor set able to hold every processor index.
+ *
+ * Arguments:
+ *     Processor Set, Number of Processors
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the set was created.
+ */
+BOOL_TYPE Tools_CreateProcessorSet(PPROCESSOR_SET pProcessorSet, unsigned int NumberOfProcessors)
+{
+    unsigned int NumberOfWords;
+    BOOL_TYPE SetCreated;
+
+    SetCreated = BOOL_FALSE;
+
+    NumberOfWords = (NumberOfProcessors + PROCESSOR_SET_BITS_PER_WORD - 1) / PROCESSOR_SET_BITS_PER_WORD;
+
+    if (NumberOfWords == 0) 
+    {
+        NumberOfWords = 1;
+    }
+
+    pProcessorSet->pBitmap = (unsigned int *)calloc(NumberOfWords, sizeof(unsigned int));
+
+    if (pProcessorSet->pBitmap) 
+    {
+        pProcessorSet->NumberOfProcessors = NumberOfProcessors;
+        SetCreated = BOOL_TRUE;
+    }
+    else
+    {
+        pProcessorSet->NumberOfProcessors = 0;
+    }
+
+    return SetCreated;
+}
+
+
+/*
+ * Tools_AddProcessorToSet
+ *
+ *    Adds a processor index to the set.
+ *
+ * Arguments:
+ *     Processor Set, Processor Index
+ *     
+ * Return:
+ *     None
+ */
+void Tools_AddProcessorToSet(PPROCESSOR_SET pProcessorSet, unsigned int ProcessorIndex)
+{
+    if (ProcessorIndex < pProcessorSet->NumberOfProcessors) 
+    {
+        pProcessorSet->pBitmap[ProcessorIndex / PROCESSOR_SET_BITS_PER_WORD] |= (1u<<(ProcessorIndex % PROCESSOR_SET_BITS_PER_WORD));
+    }
+}
+
+
+/*
+ * Tools_IsProcessorInSet
+ *
+ *    Checks if a processor index is a member of the set.
+ *
+ * Arguments:
+ *     Processor Set, Processor Index
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the processor is in the set.
+ */
+BOOL_TYPE Tools_IsProcessorInSet(PPROCESSOR_SET pProcessorSet, unsigned int ProcessorIndex)
+{
+    BOOL_TYPE ProcessorInSet;
+
+    ProcessorInSet = BOOL_FALSE;
+
+    if (ProcessorIndex < pProcessorSet->NumberOfProcessors) 
+    {
+        if (pProcessorSet->pBitmap[ProcessorIndex / PROCESSOR_SET_BITS_PER_WORD] & (1u<<(ProcessorIndex % PROCESSOR_SET_BITS_PER_WORD))) 
+        {
+            ProcessorInSet = BOOL_TRUE;
+        }
+    }
+
+    return ProcessorInSet;
+}
+
+
+/*
+ * Tools_DestroyProcessorSet
+ *
+ *    Frees the processor set.
+ *
+ * Arguments:
+ *     Processor Set
+ *     
+ * Return:
+ *     None
+ */
+void Tools_DestroyProcessorSet(PPROCESSOR_SET pProcessorSet)
+{
+    if (pProcessorSet->pBitmap) 
+    {
+        free(pProcessorSet->pBitmap);
+        pProcessorSet->pBitmap = NULL;
+    }
+
+    pProcessorSet->NumberOfProcessors = 0;
+}
+
+
+/*
+ * Tools_Internal_HashRegisterIndexKey
+ *
+ *    Hashes the ID and all four CPUID registers.
+ *
+ * Arguments:
+ *     ID, CPUID subleaf information
+ *     
+ * Return:
+ *     Hash value
+ */
+unsigned int Tools_Internal_HashRegisterIndexKey(unsigned int Id, PCPUID_REGISTERS pCpuidRegisters)
+{
+    unsigned int RegisterIndex;
+    unsigned int Hash;
+
+    /*
+     * FNV-1a style combine of each 32 bit value followed by a final avalanche 
+     * so the low bits used to select a slot depend on all of the input. 
+     */
+    Hash = 2166136261u ^ Id;
+    Hash = Hash * 16777619u;
+
+    for (RegisterIndex = 0; RegisterIndex < 4; RegisterIndex++) 
+    {
+        Hash = Hash ^ pCpuidRegisters->x.Registers[RegisterIndex];
+        Hash = Hash * 16777619u;
+    }
+
+    Hash = Hash ^ (Hash >> 16);
+    Hash = Hash * 0x85EBCA6Bu;
+    Hash = Hash ^ (Hash >> 13);
+
+    return Hash;
+}
+
+
+/*
+ * Tools_Internal_FindRegisterIndexSlot
+ *
+ *    Linear probes for the slot holding the key or the empty slot where
+ *    the key would be inserted.
+ *
+ * Arguments:
+ *     Register Index, ID, CPUID subleaf information
+ *     
+ * Return:
+ *     The slot for this key; NULL only if the index has no slots.
+ */
+PCPUID_REGISTER_INDEX_ENTRY Tools_Internal_FindRegisterIndexSlot(PCPUID_REGISTER_INDEX pRegisterIndex, unsigned int Id, PCPUID_REGISTERS pCpuidRegisters)
+{
+    PCPUID_REGISTER_INDEX_ENTRY pSlot;
+    unsigned int SlotIndex;
+    unsigned int SlotMask;
+
+    pSlot = NULL;
+
+    if (pRegisterIndex->NumberOfSlots) 
+    {
+        SlotMask = pRegisterIndex->NumberOfSlots - 1;
+        SlotIndex = Tools_Internal_HashRegisterIndexKey(Id, pCpuidRegisters) & SlotMask;
+
+        /*
+         * The index is never allowed to be full so an empty slot always ends the probe.
+         */
+        while (pRegisterIndex->pSlots[SlotIndex].Value != INVALID_REGISTER_INDEX) 
+        {
+            if (pRegisterIndex->pSlots[SlotIndex].Id == Id && memcmp(&pRegisterIndex->pSlots[SlotIndex].CpuidRegisters, pCpuidRegisters, sizeof(CPUID_REGISTERS)) == 0) 
+            {
+                break;
+            }
+
+            SlotIndex = (SlotIndex + 1) & SlotMask;
+        }
+
+        pSlot = &pRegisterIndex->pSlots[SlotIndex];
+    }
+
+    return pSlot;
+}
+
+
+/*
+ * Tools_Internal_GrowRegisterIndex
+ *
+ *    Doubles the number of slots and reinserts all of the entries.
+ *
+ * Arguments:
+ *     Register Index
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the index was grown.
+ */
+BOOL_TYPE Tools_Internal_GrowRegisterIndex(PCPUID_REGISTER_INDEX pRegisterIndex)
+{
+    CPUID_REGISTER_INDEX NewRegisterIndex;
+    unsigned int SlotIndex;
+    BOOL_TYPE IndexGrown;
+
+    IndexGrown = Tools_CreateRegisterIndex(&NewRegisterIndex, pRegisterIndex->NumberOfSlots);
+
+    if (IndexGrown) 
+    {
+        for (SlotIndex = 0; SlotIndex < pRegisterIndex->NumberOfSlots; SlotIndex++) 
+        {
+            if (pRegisterIndex->pSlots[SlotIndex].Value != INVALID_REGISTER_INDEX) 
+            {
+                Tools_InsertRegisterIndex(&NewRegisterIndex, pRegisterIndex->pSlots[SlotIndex].Id, &pRegisterIndex->pSlots[SlotIndex].CpuidRegisters, pRegisterIndex->pSlots[SlotIndex].Value);
+            }
+        }
+
+        Tools_DestroyRegisterIndex(pRegisterIndex);
+        *pRegisterIndex = NewRegisterIndex;
+    }
+
+    return IndexGrown;
+}
+
+
+
+/*
+ * Tools_InitializeTextBuffer
+ *
+ *    Initialize an empty text buffer for a stream.
+ *
+ * Arguments:
+ *     Text Buffer, Stream
+ *     
+ * Return:
+ *     None
+ */
+void Tools_InitializeTextBuffer(PTEXT_BUFFER pTextBuffer, FILE *pStream)
+{
+    memset(pTextBuffer, 0, sizeof(TEXT_BUFFER));
+    pTextBuffer->pStream = pStream;
+}
+
+
+/*
+ * Tools_AppendText
+ *
+ *    Format text and add it to a text buffer, the text must be shorter
+ *    than MAX_TEXT_RECORD.
+ *
+ * Arguments:
+ *     Text Buffer, Format, Arguments
+ *     
+ * Return:
+ *     None
+ */
+void Tools_AppendText(PTEXT_BUFFER pTextBuffer, char *pszFormat, ...)
+{
+    char szRecord[MAX_TEXT_RECORD];
+    va_list Arguments;
+
+    va_start(Arguments, pszFormat);
+    vsprintf(szRecord, pszFormat, Arguments);
+    va_end(Arguments);
+
+    Tools_AppendTextRecord(pTextBuffer, szRecord);
+}
+
+
+/*
+ * Tools_AppendTextRecord
+ *
+ *    Add text to a text buffer, growing the buffer as needed.
+ *
+ * Arguments:
+ *     Text Buffer, Text
+ *     
+ * Return:
+ *     None
+ */
+void Tools_AppendTextRecord(PTEXT_BUFFER pTextBuffer, char *pszRecord)
+{
+    char *pBuffer;
+    size_t RecordLength;
+    size_t Maximum;
+
+    RecordLength = strlen(pszRecord);
+
+    if (pTextBuffer->Length + RecordLength > pTextBuffer->Maximum) 
+    {
+        Maximum = pTextBuffer->Maximum ? pTextBuffer->Maximum*2 : 64*1024;
+
+        while (Maximum < pTextBuffer->Length + RecordLength)
+        {
+            Maximum = Maximum*2;
+        }
+
+        pBuffer = (char *)realloc(pTextBuffer->pBuffer, Maximum);
+
+        if (pBuffer) 
+        {
+            pTextBuffer->pBuffer = pBuffer;
+            pTextBuffer->Maximum = Maximum;
+        }
+        else
+        {
+            /*
+             * Memory Allocation Failure, write what has been collected so far.
+             */
+            Tools_FlushTextBuffer(pTextBuffer);
+        }
+    }
+
+    if (pTextBuffer->Length + RecordLength <= pTextBuffer->Maximum) 
+    {
+        memcpy(pTextBuffer->pBuffer + pTextBuffer->Length, pszRecord, RecordLength);
+        pTextBuffer->Length = pTextBuffer->Length + RecordLength;
+    }
+    else
+    {
+        fputs(pszRecord, pTextBuffer->pStream);
+    }
+}
+
+
+/*
+ * Tools_FlushTextBuffer
+ *
+ *    Write the collected text to the stream and release the buffer.
+ *
+ * Arguments:
+ *     Text Buffer
+ *     
+ * Return:
+ *     None
+ */
+void Tools_FlushTextBuffer(PTEXT_BUFFER pTextBuffer)
+{
+    if (pTextBuffer->pBuffer) 
+    {
+        fwrite(pTextBuffer->pBuffer, 1, pTextBuffer->Length, pTextBuffer->pStream);
+        fflush(pTextBuffer->pStream);
+
+        free(pTextBuffer->pBuffer);
+        pTextBuffer->pBuffer = NULL;
+    }
+
+    pTextBuffer->Length = 0;
+    pTextBuffer->Maximum = 0;
+}
+
+
+/*
+ * Tools_AllocateAligned
+ *
+ *    Allocate zeroed memory that starts on the alignment, the alignment must be a
+ *    power of two.  The original allocation is kept just before the aligned memory.
+ *
+ * Arguments:
+ *     Size, Alignment
+ *     
+ * Return:
+ *     The aligned memory or NULL, released with Tools_FreeAligned.
+ */
+void *Tools_AllocateAligned(size_t Size, size_t Alignment)
+{
+    unsigned char *pAllocation;
+    void **ppAligned;
+
+    ppAligned = NULL;
+
+    pAllocation = (unsigned char *)calloc(1, Size + Alignment + sizeof(void *));
+
+    if (pAllocation) 
+    {
+        ppAligned    = (void **)(((size_t)(pAllocation + sizeof(void *)) + Alignment - 1) & ~(Alignment - 1));
+        ppAligned[-1] = pAllocation;
+    }
+
+    return (void *)ppAligned;
+}
+
+
+/*
+ * Tools_FreeAligned
+ *
+ *    Release memory from Tools_AllocateAligned.
+ *
+ * Arguments:
+ *     Aligned Memory
+ *     
+ * Return:
+ *     None
+ */
+void Tools_FreeAligned(void *pMemory)
+{
+    if (pMemory) 
+    {
+        free(((void **)pMemory)[-1]);
+    }
+}
@@ -0,0 +1,445 @@
+/*
+ * Copyright (C) 2023 by Intel Corporation
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpuid_topology.h"
+
+
+/*
+ * The state of one comparison, the OS processor index of each CPUID processor
+ * and a set and list reused for the CPUID side of every relationship compared.
+ */
+typedef struct _VALIDATION_CONTEXT
+{
+    PCPUID_TOPOLOGY pTopology;
+    POS_TOPOLOGY pOsTopology;
+    unsigned int *pOsProcessorIndex;
+    unsigned int *pProcessorList;
+    PROCESSOR_SET CpuidProcessors;
+    BOOL_TYPE DisplayMismatches;
+    unsigned int NumberOfMismatches;
+
+} VALIDATION_CONTEXT, *PVALIDATION_CONTEXT;
+
+
+/*
+ * Internal Validation APIs
+ */
+void Validate_Internal_CompareDomain(PVALIDATION_CONTEXT pValidationContext, unsigned int ProcessorIndex, unsigned int DomainIndex, OS_RELATIONSHIP Relationship, char *pszName);
+void Validate_Internal_CompareCaches(PVALIDATION_CONTEXT pValidationContext, unsigned int ProcessorIndex);
+POS_TOPOLOGY_ENTRY Validate_Internal_FindOsEntry(POS_TOPOLOGY pOsTopology, unsigned int OsProcessorIndex, OS_RELATIONSHIP Relationship, unsigned int CacheLevel, unsigned int CacheType);
+void Validate_Internal_CompareSets(PVALIDATION_CONTEXT pValidationContext, unsigned int ProcessorIndex, char *pszName, PPROCESSOR_SET pCpuidProcessors, POS_TOPOLOGY_ENTRY pOsTopologyEntry);
+void Validate_Internal_DisplaySet(PVALIDATION_CONTEXT pValidationContext, PPROCESSOR_SET pProcessorSet, BOOL_TYPE OsIndexes);
+
+
+
+/*
+ * Validate_CpuidValidationExample
+ *
+ *    Compares the topology from CPUID with the topology the OS reports and
+ *    displays every processor whose core, die, package or cache sharing does
+ *    not agree.  The exit status of the application is set on a mismatch.
+ *
+ * Arguments:
+ *     None
+ *
+ * Return:
+ *     None
+ */
+void Validate_CpuidValidationExample(void)
+{
+    PCPUID_CONTEXT pCpuidContext;
+    PCPUID_TOPOLOGY pTopology;
+    OS_TOPOLOGY OsTopology;
+    unsigned int NumberOfMismatches;
+
+    pCpuidContext = Tools_GetCpuidContext();
+
+    printf("\n*************************************\n");
+    printf(" Validating the CPUID Topology against the OS\n");
+    printf("*************************************\n\n");
+
+    pTopology = Topology_Create();
+
+    if (pTopology)
+    {
+        if (Os_BuildTopology(&OsTopology))
+        {
+            NumberOfMismatches = Validate_CompareTopology(pTopology, &OsTopology, BOOL_TRUE);
+
+            if (NumberOfMismatches == 0)
+            {
+                printf(" PASSED: the %u processors agree on the core, die, package and cache sharing.\n\n", Topology_GetNumberOfProcessors(pTopology));
+            }
+            else
+            {
+                printf("\n FAILED: %u mismatches between the CPUID and OS topology.\n\n", NumberOfMismatches);
+                pCpuidContext->ExitStatus = 1;
+            }
+
+            Os_ReleaseTopology(&OsTopology);
+        }
+        else
+        {
+            printf(" FAILED: the OS topology could not be read.\n\n");
+            pCpuidContext->ExitStatus = 1;
+        }
+
+        Topology_Destroy(pTopology);
+    }
+    else
+    {
+        printf(" FAILED: the CPUID topology could not be created.\n\n");
+        pCpuidContext->ExitStatus = 1;
+    }
+}
+
+
+/*
+ * Validate_CompareTopology
+ *
+ *    Compares the processors sharing each core, die, package and cache of every
+ *    processor between the CPUID topology and the OS topology.  The processors
+ *    are matched by their ordered processor number, which both number densely 
+ *    over the online processors so an offline CPU does not shift the others.  
+ *    The OS CPU number is only used to display the OS processors.  A die is only
+ *    compared when both report dies and a cache of an unknown type to the OS is 
+ *    not compared.
+ *
+ * Arguments:
+ *     Topology, OS Topology, TRUE to display each mismatch
+ *
+ * Return:
+ *     The number of mismatches
+ */
+unsigned int Validate_CompareTopology(PCPUID_TOPOLOGY pTopology, POS_TOPOLOGY pOsTopology, BOOL_TYPE DisplayMismatches)
+{
+    VALIDATION_CONTEXT ValidationContext;
+    unsigned int NumberOfProcessors;
+    unsigned int ProcessorIndex;
+    unsigned int PackageDomainIndex;
+    unsigned int DomainIndex;
+    unsigned int EntryIndex;
+    BOOL_TYPE OsReportsDies;
+
+    memset(&ValidationContext, 0, sizeof(ValidationContext));
+
+    ValidationContext.pTopology         = pTopology;
+    ValidationContext.pOsTopology       = pOsTopology;
+    ValidationContext.DisplayMismatches = DisplayMismatches;
+
+    NumberOfProcessors = Topology_GetNumberOfProcessors(pTopology);
+    PackageDomainIndex = Topology_GetNumberOfDomains(pTopology) - 1;
+
+    ValidationContext.pOsProcessorIndex = (unsigned int *)malloc(sizeof(unsigned int)*(NumberOfProcessors + 1));
+    ValidationContext.pProcessorList    = (unsigned int *)malloc(sizeof(unsigned int)*(NumberOfProcessors + 1));
+
+    if (ValidationContext.pOsProcessorIndex && ValidationContext.pProcessorList && Tools_CreateProcessorSet(&ValidationContext.CpuidProcessors, NumberOfProcessors))
+    {
+        if (NumberOfProcessors != pOsTopology->NumberOfProcessors)
+        {
+            if (DisplayMismatches)
+            {
+                printf(" CPUID enumerates %u processors and the OS reports %u processors.\n", NumberOfProcessors, pOsTopology->NumberOfProcessors);
+            }
+
+            ValidationContext.NumberOfMismatches++;
+        }
+
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++)
+        {
+            ValidationContext.pOsProcessorIndex[ProcessorIndex] = (ProcessorIndex < pOsTopology->NumberOfProcessors) ? ProcessorIndex : INVALID_PROCESSOR_INDEX;
+        }
+
+        OsReportsDies = BOOL_FALSE;
+
+        for (EntryIndex = 0; EntryIndex < pOsTopology->NumberOfEntries; EntryIndex++)
+        {
+            if (pOsTopology->pEntries[EntryIndex].Relationship == OsRelationship_Die)
+            {
+                OsReportsDies = BOOL_TRUE;
+            }
+        }
+
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++)
+        {
+            if (ValidationContext.pOsProcessorIndex[ProcessorIndex] == INVALID_PROCESSOR_INDEX)
+            {
+                if (DisplayMismatches)
+                {
+                    printf(" Processor %u APIC ID(0x%08x) is not reported by the OS.\n", ProcessorIndex, Topology_GetApicId(pTopology, ProcessorIndex));
+                }
+
+                ValidationContext.NumberOfMismatches++;
+            }
+            else
+            {
+                DomainIndex = Topology_FindDomain(pTopology, CoreDomain);
+
+                if (DomainIndex != PackageDomainIndex)
+                {
+                    Validate_Internal_CompareDomain(&ValidationContext, ProcessorIndex, DomainIndex, OsRelationship_Core, "Core");
+                }
+
+                DomainIndex = Topology_FindDomain(pTopology, DieDomain);
+
+                if (DomainIndex != PackageDomainIndex && OsReportsDies)
+                {
+                    Validate_Internal_CompareDomain(&ValidationContext, ProcessorIndex, DomainIndex, OsRelationship_Die, "Die");
+                }
+
+                Validate_Internal_CompareDomain(&ValidationContext, ProcessorIndex, PackageDomainIndex, OsRelationship_Package, "Package");
+                Validate_Internal_CompareCaches(&ValidationContext, ProcessorIndex);
+            }
+        }
+
+        Tools_DestroyProcessorSet(&ValidationContext.CpuidProcessors);
+    }
+    else
+    {
+        /*
+         * Nothing could be compared, which is not a match.
+         */
+        ValidationContext.NumberOfMismatches++;
+    }
+
+    if (ValidationContext.pOsProcessorIndex)
+    {
+        free(ValidationContext.pOsProcessorIndex);
+    }
+
+    if (ValidationContext.pProcessorList)
+    {
+        free(ValidationContext.pProcessorList);
+    }
+
+    return ValidationContext.NumberOfMismatches;
+}
+
+
+/*
+ * Validate_Internal_CompareDomain
+ *
+ *    Compares the processors in a CPUID domain of a processor with the
+ *    processors of the OS relationship it is in.
+ *
+ * Arguments:
+ *     Validation Context, Processor Index, Domain Index, OS Relationship, Name of the relationship
+ *
+ * Return:
+ *     None
+ */
+void Validate_Internal_CompareDomain(PVALIDATION_CONTEXT pValidationContext, unsigned int ProcessorIndex, unsigned int DomainIndex, OS_RELATIONSHIP Relationship, char *pszName)
+{
+    unsigned int NumberOfSharing;
+    unsigned int SharingIndex;
+    unsigned int NumberOfWords;
+
+    NumberOfWords = (pValidationContext->CpuidProcessors.NumberOfProcessors + PROCESSOR_SET_BITS_PER_WORD - 1) / PROCESSOR_SET_BITS_PER_WORD;
+    memset(pValidationContext->CpuidProcessors.pBitmap, 0, sizeof(unsigned int)*(NumberOfWords ? NumberOfWords : 1));
+
+    NumberOfSharing = Topology_GetProcessorsSharingDomain(pValidationContext->pTopology, ProcessorIndex, DomainIndex, pValidationContext->pProcessorList, Topology_GetNumberOfProcessors(pValidationContext->pTopology));
+
+    for (SharingIndex = 0; SharingIndex < NumberOfSharing; SharingIndex++)
+    {
+        Tools_AddProcessorToSet(&pValidationContext->CpuidProcessors, pValidationContext->pProcessorList[SharingIndex]);
+    }
+
+    Validate_Internal_CompareSets(pValidationContext, ProcessorIndex, pszName, &pValidationContext->CpuidProcessors,
+                                  Validate_Internal_FindOsEntry(pValidationContext->pOsTopology, pValidationContext->pOsProcessorIndex[ProcessorIndex], Relationship, 0, 0));
+}
+
+
+/*
+ * Validate_Internal_CompareCaches
+ *
+ *    Compares the processors sharing each cache of a processor, every CPUID
+ *    cache must be reported by the OS and every OS cache must be in CPUID.
+ *
+ * Arguments:
+ *     Validation Context, Processor Index
+ *
+ * Return:
+ *     None
+ */
+void Validate_Internal_CompareCaches(PVALIDATION_CONTEXT pValidationContext, unsigned int ProcessorIndex)
+{
+    PCPUID_CACHE_INFO pCacheInfo;
+    POS_TOPOLOGY_ENTRY pOsTopologyEntry;
+    unsigned int OsProcessorIndex;
+    unsigned int CacheIndex;
+    unsigned int EntryIndex;
+    char szName[32];
+    char *pszCacheType[] = { "Unknown", "Data", "Instruction", "Unified" };
+
+    OsProcessorIndex = pValidationContext->pOsProcessorIndex[ProcessorIndex];
+
+    for (CacheIndex = 0; CacheIndex < Topology_GetNumberOfCaches(pValidationContext->pTopology); CacheIndex++)
+    {
+        pCacheInfo = Topology_GetCache(pValidationContext->pTopology, CacheIndex);
+
+        if (Tools_IsProcessorInSet(&pCacheInfo->LPsSharingThisCache, ProcessorIndex))
+        {
+            snprintf(szName, sizeof(szName), "L%u %s Cache", pCacheInfo->CacheLevel, pszCacheType[pCacheInfo->CacheType <= CacheType_UnifiedCache ? pCacheInfo->CacheType : 0]);
+
+            Validate_Internal_CompareSets(pValidationContext, ProcessorIndex, szName, &pCacheInfo->LPsSharingThisCache,
+                                          Validate_Internal_FindOsEntry(pValidationContext->pOsTopology, OsProcessorIndex, OsRelationship_Cache, pCacheInfo->CacheLevel, pCacheInfo->CacheType));
+        }
+    }
+
+    /*
+     * The caches only the OS reports.
+     */
+    for (EntryIndex = 0; EntryIndex < pValidationContext->pOsTopology->NumberOfEntries; EntryIndex++)
+    {
+        pOsTopologyEntry = &pValidationContext->pOsTopology->pEntries[EntryIndex];
+
+        if (pOsTopologyEntry->Relationship == OsRelationship_Cache && pOsTopologyEntry->CacheInfo.CacheType != CacheType_NoMoreCaches && Tools_IsProcessorInSet(&pOsTopologyEntry->Processors, OsProcessorIndex))
+        {
+            if (Topology_FindProcessorCache(pValidationContext->pTopology, ProcessorIndex, pOsTopologyEntry->CacheInfo.CacheLevel, (CACHE_TYPE)pOsTopologyEntry->CacheInfo.CacheType) == INVALID_CACHE_INDEX)
+            {
+                if (pValidationContext->DisplayMismatches)
+                {
+                    printf(" Processor %u APIC ID(0x%08x) L%u %s Cache is reported by the OS but not by CPUID.\n", ProcessorIndex, Topology_GetApicId(pValidationContext->pTopology, ProcessorIndex),
+                                                                                                                 pOsTopologyEntry->CacheInfo.CacheLevel, pszCacheType[pOsTopologyEntry->CacheInfo.CacheType <= CacheType_UnifiedCache ? pOsTopologyEntry->CacheInfo.CacheType : 0]);
+                }
+
+                pValidationContext->NumberOfMismatches++;
+            }
+        }
+    }
+}
+
+
+/*
+ * Validate_Internal_FindOsEntry
+ *
+ *    Finds the OS relationship of a type that a processor is in.
+ *
+ * Arguments:
+ *     OS Topology, OS Processor Index, Relationship, Cache Level and Cache Type for caches
+ *
+ * Return:
+ *     The entry or NULL if the OS does not report one
+ */
+POS_TOPOLOGY_ENTRY Validate_Internal_FindOsEntry(POS_TOPOLOGY pOsTopology, unsigned int OsProcessorIndex, OS_RELATIONSHIP Relationship, unsigned int CacheLevel, unsigned int CacheType)
+{
+    POS_TOPOLOGY_ENTRY pOsTopologyEntry;
+    unsigned int EntryIndex;
+
+    pOsTopologyEntry = NULL;
+
+    for (EntryIndex = 0; EntryIndex < pOsTopology->NumberOfEntries && pOsTopologyEntry == NULL; EntryIndex++)
+    {
+        if (pOsTopology->pEntries[EntryIndex].Relationship == Relationship && Tools_IsProcessorInSet(&pOsTopology->pEntries[EntryIndex].Processors, OsProcessorIndex))
+        {
+            if (Relationship != OsRelationship_Cache || (pOsTopology->pEntries[EntryIndex].CacheInfo.CacheLevel == CacheLevel && pOsTopology->pEntries[EntryIndex].CacheInfo.CacheType == CacheType))
+            {
+                pOsTopologyEntry = &pOsTopology->pEntries[EntryIndex];
+            }
+        }
+    }
+
+    return pOsTopologyEntry;
+}
+
+
+/*
+ * Validate_Internal_CompareSets
+ *
+ *    Compares the processors CPUID shares a relationship with to the processors
+ *    the OS reports in it, counting and displaying a mismatch.
+ *
+ * Arguments:
+ *     Validation Context, Processor Index, Name of the relationship, CPUID Processors, OS Entry or NULL
+ *
+ * Return:
+ *     None
+ */
+void Validate_Internal_CompareSets(PVALIDATION_CONTEXT pValidationContext, unsigned int ProcessorIndex, char *pszName, PPROCESSOR_SET pCpuidProcessors, POS_TOPOLOGY_ENTRY pOsTopologyEntry)
+{
+    unsigned int OtherProcessorIndex;
+    unsigned int OsProcessorIndex;
+    BOOL_TYPE InOsEntry;
+    BOOL_TYPE SetsMatch;
+
+    SetsMatch = (pOsTopologyEntry != NULL) ? BOOL_TRUE : BOOL_FALSE;
+
+    for (OtherProcessorIndex = 0; OtherProcessorIndex < Topology_GetNumberOfProcessors(pValidationContext->pTopology) && SetsMatch; OtherProcessorIndex++)
+    {
+        OsProcessorIndex = pValidationContext->pOsProcessorIndex[OtherProcessorIndex];
+        InOsEntry = (OsProcessorIndex != INVALID_PROCESSOR_INDEX && Tools_IsProcessorInSet(&pOsTopologyEntry->Processors, OsProcessorIndex)) ? BOOL_TRUE : BOOL_FALSE;
+
+        if (Tools_IsProcessorInSet(pCpuidProcessors, OtherProcessorIndex) != InOsEntry)
+        {
+            SetsMatch = BOOL_FALSE;
+        }
+    }
+
+    if (SetsMatch == BOOL_FALSE)
+    {
+        if (pValidationContext->DisplayMismatches)
+        {
+            printf(" Processor %u APIC ID(0x%08x) %s\n", ProcessorIndex, Topology_GetApicId(pValidationContext->pTopology, ProcessorIndex), pszName);
+            printf("     CPUID: ");
+            Validate_Internal_DisplaySet(pValidationContext, pCpuidProcessors, BOOL_FALSE);
+            printf("     OS:    ");
+
+            if (pOsTopologyEntry)
+            {
+                Validate_Internal_DisplaySet(pValidationContext, &pOsTopologyEntry->Processors, BOOL_TRUE);
+            }
+            else
+            {
+                printf("Not Reported\n");
+            }
+        }
+
+        pValidationContext->NumberOfMismatches++;
+    }
+}
+
+
+/*
+ * Validate_Internal_DisplaySet
+ *
+ *    Displays the processors of a set as ordered processor numbers.
+ *
+ * Arguments:
+ *     Validation Context, Processor Set, TRUE if the set is of OS processor indexes
+ *
+ * Return:
+ *     None
+ */
+void Validate_Internal_DisplaySet(PVALIDATION_CONTEXT pValidationContext, PPROCESSOR_SET pProcessorSet, BOOL_TYPE OsIndexes)
+{
+    unsigned int ProcessorIndex;
+    BOOL_TYPE FirstProcessor;
+
+    FirstProcessor = BOOL_TRUE;
+
+    for (ProcessorIndex = 0; ProcessorIndex < pProcessorSet->NumberOfProcessors; ProcessorIndex++)
+    {
+        if (Tools_IsProcessorInSet(pProcessorSet, ProcessorIndex))
+        {
+            printf("%s%u", FirstProcessor ? "" : ",", OsIndexes ? pValidationContext->pOsTopology->pProcessorNumbers[ProcessorIndex] : ProcessorIndex);
+            FirstProcessor = BOOL_FALSE;
+        }
+    }
+
+    printf("\n");
+}
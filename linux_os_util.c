@@ -15,8 +15,16 @@
 
 #define _GNU_SOURCE
 #include <sched.h>
+#include <pthread.h>
 #include <sys/sysinfo.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "cpuid_topology.h"
@@ -27,6 +35,140 @@
  */
 #define BYTES_IN_KB  (1024)
 #define BYTES_IN_MB  (1048576)
+#define SYSFS_CPU_PATH        "/sys/devices/system/cpu"
+#define SYSFS_BUFFER_SIZE     (4096)
+#define SYSFS_MAXIMUM_CACHES  (32)
+#define UEVENT_BUFFER_SIZE    (4096)
+#define HOTPLUG_POLL_MILLISECONDS (250)
+#define HOTPLUG_UEVENT_MILLISECONDS (1000)
+#define TSC_AUX_CPU_MASK      (0xFFF)
+#define TSC_AUX_MAXIMUM_CPUS  (4096)
+#define CURRENT_PROCESSOR_CHECKS (4)
+
+
+/*
+ * The context for a worker thread pinned to a specific processor.
+ */
+typedef struct _LINUX_PROCESSOR_WORKER {
+    pthread_t WorkerThread;
+    BOOL_TYPE WorkerStarted;
+    unsigned int ProcessorNumber;
+    PFN_PROCESSOR_WORKER pfnWorker;
+    void *pContext;
+} LINUX_PROCESSOR_WORKER, *PLINUX_PROCESSOR_WORKER;
+
+
+/*
+ * The state used while the sysfs topology is parsed, the buffer is reused
+ * for every attribute so each one is a single read into memory.  The CPU
+ * directory is opened once for each processor, its attributes and cache
+ * directories are opened relative to it so their paths are not looked up 
+ * from the root each time.
+ */
+typedef struct _LINUX_SYSFS_CONTEXT {
+    POS_TOPOLOGY pOsTopology;
+    int CpuDirectory;
+    unsigned int MaximumCpus;
+    unsigned int *pCpuToProcessorIndex;
+    PROCESSOR_SET ListedProcessors;
+    char szPath[256];
+    char szBuffer[SYSFS_BUFFER_SIZE];
+} LINUX_SYSFS_CONTEXT, *PLINUX_SYSFS_CONTEXT;
+
+
+/*
+ * The CPU number of each ordered processor number, only the online CPUs are
+ * listed and they do not need to be contiguous.  A table is one allocation
+ * with the CPU numbers after it and is never changed once it is published.
+ */
+typedef struct _LINUX_PROCESSOR_TABLE {
+    struct _LINUX_PROCESSOR_TABLE *pRetiredTable;
+    unsigned int NumberOfProcessors;
+    unsigned int *pCpuNumbers;
+} LINUX_PROCESSOR_TABLE, *PLINUX_PROCESSOR_TABLE;
+
+/*
+ * The processor table in use.  It is built once by the first thread that needs
+ * it and a refresh publishes a new table with one atomic pointer swap, so a 
+ * reader always sees a matching count and list.  A reader may still be using 
+ * a replaced table so it is kept on the retired list rather than freed, the 
+ * online CPUs rarely change so this is only a few tables.  The refresh lock 
+ * only orders refreshes with each other, readers never take it.  The uevent 
+ * socket is opened once and is -1 if the uevents are not available.
+ */
+typedef struct _LINUX_PROCESSORS {
+    pthread_once_t TableOnce;
+    pthread_once_t UeventOnce;
+    pthread_mutex_t RefreshLock;
+    void * volatile pCurrentTable;
+    PLINUX_PROCESSOR_TABLE pRetiredTables;
+    int UeventSocket;
+} LINUX_PROCESSORS, *PLINUX_PROCESSORS;
+
+LINUX_PROCESSORS g_LinuxProcessors = { PTHREAD_ONCE_INIT, PTHREAD_ONCE_INIT, PTHREAD_MUTEX_INITIALIZER, NULL, NULL, -1 };
+LINUX_PROCESSOR_TABLE g_LinuxEmptyProcessorTable;
+
+
+/*
+ * The thread slot that holds the context bound to each thread.  The context is
+ * read from a thread local variable since it is read for every CPUID read, the 
+ * key is created once by the first thread that binds a context and only holds 
+ * it so it can be released when the thread exits.
+ */
+typedef struct _LINUX_THREAD_CONTEXT_SLOT {
+    pthread_once_t KeyOnce;
+    pthread_key_t ContextKey;
+    BOOL_TYPE KeyCreated;
+} LINUX_THREAD_CONTEXT_SLOT, *PLINUX_THREAD_CONTEXT_SLOT;
+
+LINUX_THREAD_CONTEXT_SLOT g_LinuxThreadContextSlot = { PTHREAD_ONCE_INIT };
+__thread void *g_pLinuxThreadContext;
+
+
+/*
+ * How the CPU number of the calling thread is read.  Linux writes the CPU number
+ * in the low 12 bits of IA32_TSC_AUX of each CPU, which RDPID and RDTSCP read without
+ * a system call, otherwise sched_getcpu is used.  The method is chosen once.
+ */
+typedef enum _LINUX_CURRENT_CPU_METHOD {
+    LinuxCurrentCpuGetCpu = 0,
+    LinuxCurrentCpuRdtscp,
+    LinuxCurrentCpuRdpid
+} LINUX_CURRENT_CPU_METHOD;
+
+typedef struct _LINUX_CURRENT_CPU {
+    pthread_once_t MethodOnce;
+    LINUX_CURRENT_CPU_METHOD Method;
+} LINUX_CURRENT_CPU, *PLINUX_CURRENT_CPU;
+
+LINUX_CURRENT_CPU g_LinuxCurrentCpu = { PTHREAD_ONCE_INIT };
+
+
+/*
+ * Prototypes
+ */
+void *LinuxOs_ProcessorWorkerThread(void *pParameter);
+void LinuxOs_CreateThreadContextKey(void);
+void LinuxOs_ReleaseThreadContext(void *pContext);
+void LinuxOs_SelectCurrentCpuMethod(void);
+int LinuxOs_ReadCurrentCpu(LINUX_CURRENT_CPU_METHOD Method);
+BOOL_TYPE LinuxOs_ReadSysfsAttribute(PLINUX_SYSFS_CONTEXT pSysfsContext, int DirectoryDescriptor, char *pszAttribute);
+void LinuxOs_ParseCpuList(PLINUX_SYSFS_CONTEXT pSysfsContext, PPROCESSOR_SET pProcessorSet, BOOL_TYPE CpuNumbers);
+BOOL_TYPE LinuxOs_ReadOnlineCpus(PLINUX_SYSFS_CONTEXT pSysfsContext, PPROCESSOR_SET pOnlineCpus);
+PLINUX_PROCESSOR_TABLE LinuxOs_AllocateProcessorTable(unsigned int MaximumProcessors);
+PLINUX_PROCESSOR_TABLE LinuxOs_BuildProcessorTable(void);
+void LinuxOs_CreateProcessorTable(void);
+PLINUX_PROCESSOR_TABLE LinuxOs_GetProcessorTable(void);
+unsigned int LinuxOs_GetCpuNumber(PLINUX_PROCESSOR_TABLE pProcessorTable, unsigned int ProcessorNumber);
+void LinuxOs_OpenUeventSocket(void);
+BOOL_TYPE LinuxOs_ReceiveProcessorUevent(int UeventSocket, unsigned int TimeoutMilliseconds);
+unsigned int LinuxOs_ParseListedProcessors(PLINUX_SYSFS_CONTEXT pSysfsContext);
+POS_TOPOLOGY_ENTRY LinuxOs_AddRelationship(PLINUX_SYSFS_CONTEXT pSysfsContext, OS_RELATIONSHIP Relationship);
+BOOL_TYPE LinuxOs_ParseRelationship(PLINUX_SYSFS_CONTEXT pSysfsContext, OS_RELATIONSHIP Relationship, unsigned int ProcessorIndex, char *pszListAttribute, char *pszFallbackAttribute, char *pszIdAttribute);
+BOOL_TYPE LinuxOs_ParseCaches(PLINUX_SYSFS_CONTEXT pSysfsContext, unsigned int ProcessorIndex);
+unsigned int LinuxOs_ReadCacheValue(PLINUX_SYSFS_CONTEXT pSysfsContext, int CacheDirectory, char *pszAttribute);
+void LinuxOs_EnumerateAndDisplayTopology(POS_TOPOLOGY pOsTopology);
+void LinuxOs_DisplayProcessors(POS_TOPOLOGY pOsTopology, PPROCESSOR_SET pProcessorSet);
 
 
 
@@ -44,119 +186,1936 @@
  */
 void Os_DisplayTopology(void)
 {
-    /*
-     * One example, applications may parse the output.
-    */
-    printf("*********************************\n");
-    printf("****  Linux OS /proc/cpuinfo ****\n\n");
+    OS_TOPOLOGY OsTopology;
 
-    system("cat /proc/cpuinfo\n");
+    printf("**********************************\n");
+    printf("****  Linux OS sysfs Topology ****\n\n");
+
+    if (Os_BuildTopology(&OsTopology)) 
+    {
+        LinuxOs_EnumerateAndDisplayTopology(&OsTopology);
+        Os_ReleaseTopology(&OsTopology);
+    }
+    else
+    {
+        printf("Error; failed to read the topology from %s\n\n", SYSFS_CPU_PATH);
+    }
 
     printf("\n\n");
 }
 
 
 
+/*
+ * LinuxOs_EnumerateAndDisplayTopology
+ *
+ *    Itterates through the OS supplied topology information.
+ *
+ * Arguments:
+ *     OS Topology
+ *     
+ * Return:
+ *     None
+ */
+void LinuxOs_EnumerateAndDisplayTopology(POS_TOPOLOGY pOsTopology)
+{
+    POS_TOPOLOGY_ENTRY ptr;
+    unsigned int EntryIndex;
+    char *pszCacheTypeString[] = { "Unknown", "Data", "Instruction", "Unified" };
+
+    /*
+     * Example implementation that displays the data, however for applications it could cache the data and use it for any purpose
+     */
+    for (EntryIndex = 0; EntryIndex < pOsTopology->NumberOfEntries; EntryIndex++) 
+    {
+        ptr = &pOsTopology->pEntries[EntryIndex];
+
+        switch (ptr->Relationship) 
+        {
+            case OsRelationship_Core:
+                 printf(" - Processor Core: %u\n", ptr->Id);
+                 LinuxOs_DisplayProcessors(pOsTopology, &ptr->Processors);
+                 printf("+++++\n");
+                 break;
+
+            case OsRelationship_Cache:
+                 printf(" - Cache Type: %s\n", pszCacheTypeString[ptr->CacheInfo.CacheType <= CacheType_UnifiedCache ? ptr->CacheInfo.CacheType : 0]);
+                 printf("    CacheLevel: L%u\n", ptr->CacheInfo.CacheLevel);
+                 printf("    CacheSize: %u Bytes (%u Kilobytes) (%u Megabytes)\n", ptr->CacheInfo.CacheSizeInBytes, ptr->CacheInfo.CacheSizeInBytes / BYTES_IN_KB, ptr->CacheInfo.CacheSizeInBytes / BYTES_IN_MB);
+                 printf("    LineSize: %u\n", ptr->CacheInfo.CacheLineSize);
+                 if (ptr->CacheInfo.CacheIsFullyAssociative) 
+                 {
+                     printf("    Fully Associative\n\n");
+                 }
+                 else
+                 {
+                     printf("    Associativity: %u\n\n", ptr->CacheInfo.CacheWays);
+                 }
+                 LinuxOs_DisplayProcessors(pOsTopology, &ptr->Processors);
+                 printf("+++++\n");
+                 break;
+
+            case OsRelationship_Die:
+                 printf(" - Die: %u\n", ptr->Id);
+                 LinuxOs_DisplayProcessors(pOsTopology, &ptr->Processors);
+                 printf("+++++\n");
+                 break;
+
+            case OsRelationship_Package:
+                 printf(" - Package: %u\n", ptr->Id);
+                 LinuxOs_DisplayProcessors(pOsTopology, &ptr->Processors);
+                 printf("+++++\n");
+                 break;
+        }
+    }
+}
+
+
 
 /*
- * Os_Platform_Read_Cpuid
+ * LinuxOs_DisplayProcessors
  *
- *    OS/Compiler Specific implementation of reading CPUID.
+ *    Displays the OS processor numbers in a set.
  *
  * Arguments:
- *     Leaf, Subleaf, CPUID Data Structure
+ *     OS Topology, Processor Set
  *     
  * Return:
  *     None
  */
-void Os_Platform_Read_Cpuid(unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
+void LinuxOs_DisplayProcessors(POS_TOPOLOGY pOsTopology, PPROCESSOR_SET pProcessorSet)
 {
-    unsigned int ReturnEax;
-    unsigned int ReturnEbx;
-    unsigned int ReturnEcx;
-    unsigned int ReturnEdx;
-    
-    asm ("movl %4, %%eax\n"
-         "movl %5, %%ecx\n"
-         "CPUID\n"
-         "movl %%eax, %0\n"
-         "movl %%ebx, %1\n"
-         "movl %%ecx, %2\n"
-         "movl %%edx, %3\n"
-          : "=r" (ReturnEax), "=r" (ReturnEbx), "=r" (ReturnEcx), "=r" (ReturnEdx)
-          : "r" (Leaf), "r" (Subleaf)
-          : "%eax", "%ebx", "%ecx", "%edx"
-    );
+    unsigned int ProcessorIndex;
+    BOOL_TYPE FirstProcessor;
 
-     pCpuidRegisters->x.Register.Eax  = ReturnEax;
-     pCpuidRegisters->x.Register.Ebx  = ReturnEbx;
-     pCpuidRegisters->x.Register.Ecx  = ReturnEcx;
-     pCpuidRegisters->x.Register.Edx  = ReturnEdx;
+    FirstProcessor = BOOL_TRUE;
+
+    printf("     Processors: ");
+
+    for (ProcessorIndex = 0; ProcessorIndex < pOsTopology->NumberOfProcessors; ProcessorIndex++) 
+    {
+        if (Tools_IsProcessorInSet(pProcessorSet, ProcessorIndex)) 
+        {
+            printf("%s%u", FirstProcessor ? "" : ",", pOsTopology->pProcessorNumbers[ProcessorIndex]);
+            FirstProcessor = BOOL_FALSE;
+        }
+    }
+
+    printf("\n");
 }
 
+
+
 /*
- * Os_GetNumberOfProcessors
+ * Os_BuildTopology
  *
- *    Get the number of processors
+ *    Builds the topology of the online processors from sysfs.  Each core, die, package 
+ *    and cache is added once, by the first processor that is in it.
+ *
+ * Arguments:
+ *     OS Topology to fill in
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the topology was read
+ */
+BOOL_TYPE Os_BuildTopology(POS_TOPOLOGY pOsTopology)
+{
+    PLINUX_SYSFS_CONTEXT pSysfsContext;
+    PROCESSOR_SET OnlineCpus;
+    unsigned int CpuNumber;
+    unsigned int ProcessorIndex;
+    BOOL_TYPE TopologyBuilt;
+
+    TopologyBuilt = BOOL_FALSE;
+    memset(pOsTopology, 0, sizeof(OS_TOPOLOGY));
+
+    pSysfsContext = (PLINUX_SYSFS_CONTEXT)calloc(1, sizeof(LINUX_SYSFS_CONTEXT));
+
+    if (pSysfsContext) 
+    {
+        pSysfsContext->pOsTopology = pOsTopology;
+
+        if (LinuxOs_ReadOnlineCpus(pSysfsContext, &OnlineCpus)) 
+        {
+            pSysfsContext->pCpuToProcessorIndex = (unsigned int *)malloc(sizeof(unsigned int)*pSysfsContext->MaximumCpus);
+            pOsTopology->pProcessorNumbers = (unsigned int *)malloc(sizeof(unsigned int)*pSysfsContext->MaximumCpus);
+
+            if (pSysfsContext->pCpuToProcessorIndex && pOsTopology->pProcessorNumbers) 
+            {
+                for (CpuNumber = 0; CpuNumber < pSysfsContext->MaximumCpus; CpuNumber++) 
+                {
+                    pSysfsContext->pCpuToProcessorIndex[CpuNumber] = INVALID_PROCESSOR_INDEX;
+
+                    if (Tools_IsProcessorInSet(&OnlineCpus, CpuNumber)) 
+                    {
+                        pSysfsContext->pCpuToProcessorIndex[CpuNumber] = pOsTopology->NumberOfProcessors;
+                        pOsTopology->pProcessorNumbers[pOsTopology->NumberOfProcessors] = CpuNumber;
+                        pOsTopology->NumberOfProcessors++;
+                    }
+                }
+
+                TopologyBuilt = (pOsTopology->NumberOfProcessors != 0) ? Tools_CreateProcessorSet(&pSysfsContext->ListedProcessors, pOsTopology->NumberOfProcessors) : BOOL_FALSE;
+
+                for (ProcessorIndex = 0; ProcessorIndex < pOsTopology->NumberOfProcessors && TopologyBuilt; ProcessorIndex++) 
+                {
+                    snprintf(pSysfsContext->szPath, sizeof(pSysfsContext->szPath), "%s/cpu%u", SYSFS_CPU_PATH, pOsTopology->pProcessorNumbers[ProcessorIndex]);
+                    pSysfsContext->CpuDirectory = open(pSysfsContext->szPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+                    if (LinuxOs_ParseRelationship(pSysfsContext, OsRelationship_Core, ProcessorIndex, "topology/core_cpus_list", "topology/thread_siblings_list", "topology/core_id") == BOOL_FALSE ||
+                        LinuxOs_ParseRelationship(pSysfsContext, OsRelationship_Die, ProcessorIndex, "topology/die_cpus_list", NULL, "topology/die_id") == BOOL_FALSE ||
+                        LinuxOs_ParseRelationship(pSysfsContext, OsRelationship_Package, ProcessorIndex, "topology/package_cpus_list", "topology/core_siblings_list", "topology/physical_package_id") == BOOL_FALSE ||
+                        LinuxOs_ParseCaches(pSysfsContext, ProcessorIndex) == BOOL_FALSE) 
+                    {
+                        TopologyBuilt = BOOL_FALSE;
+                    }
+
+                    if (pSysfsContext->CpuDirectory >= 0) 
+                    {
+                        close(pSysfsContext->CpuDirectory);
+                    }
+                }
+
+                Tools_DestroyProcessorSet(&pSysfsContext->ListedProcessors);
+            }
+
+            if (pSysfsContext->pCpuToProcessorIndex) 
+            {
+                free(pSysfsContext->pCpuToProcessorIndex);
+            }
+
+            Tools_DestroyProcessorSet(&OnlineCpus);
+        }
+
+        free(pSysfsContext);
+    }
+
+    if (TopologyBuilt == BOOL_FALSE) 
+    {
+        Os_ReleaseTopology(pOsTopology);
+    }
+
+    return TopologyBuilt;
+}
+
+
+
+/*
+ * Os_ReleaseTopology
+ *
+ *    Releases the topology from Os_BuildTopology.
  *
  * Arguments:
+ *     OS Topology
+ *     
+ * Return:
  *     None
+ */
+void Os_ReleaseTopology(POS_TOPOLOGY pOsTopology)
+{
+    unsigned int EntryIndex;
+
+    if (pOsTopology->pEntries) 
+    {
+        for (EntryIndex = 0; EntryIndex < pOsTopology->NumberOfEntries; EntryIndex++) 
+        {
+            Tools_DestroyProcessorSet(&pOsTopology->pEntries[EntryIndex].Processors);
+        }
+
+        free(pOsTopology->pEntries);
+    }
+
+    if (pOsTopology->pProcessorNumbers) 
+    {
+        free(pOsTopology->pProcessorNumbers);
+    }
+
+    memset(pOsTopology, 0, sizeof(OS_TOPOLOGY));
+}
+
+
+
+/*
+ * LinuxOs_ReadSysfsAttribute
+ *
+ *    Reads a sysfs attribute into the context buffer with a single read, the
+ *    trailing newline is removed.  The attribute is opened relative to an open
+ *    directory, a NULL attribute reads the full path already in the context.
+ *
+ * Arguments:
+ *     Sysfs Context, Directory Descriptor, Attribute path within the directory
  *     
  * Return:
- *     Number of processors
+ *     Returns BOOL_TRUE if the attribute was read
  */
-unsigned int Os_GetNumberOfProcessors(void)
+BOOL_TYPE LinuxOs_ReadSysfsAttribute(PLINUX_SYSFS_CONTEXT pSysfsContext, int DirectoryDescriptor, char *pszAttribute)
 {
-    unsigned int NumberOfProcessors;
+    int FileDescriptor;
+    ssize_t BytesRead;
+    BOOL_TYPE AttributeRead;
 
-    NumberOfProcessors = (unsigned int)get_nprocs();
+    AttributeRead = BOOL_FALSE;
 
-    return NumberOfProcessors;
+    if (pszAttribute) 
+    {
+        FileDescriptor = openat(DirectoryDescriptor, pszAttribute, O_RDONLY | O_CLOEXEC);
+    }
+    else
+    {
+        FileDescriptor = open(pSysfsContext->szPath, O_RDONLY | O_CLOEXEC);
+    }
+
+    if (FileDescriptor >= 0) 
+    {
+        BytesRead = read(FileDescriptor, pSysfsContext->szBuffer, sizeof(pSysfsContext->szBuffer) - 1);
+
+        if (BytesRead > 0) 
+        {
+            pSysfsContext->szBuffer[BytesRead] = 0;
+
+            if (pSysfsContext->szBuffer[BytesRead - 1] == '\n') 
+            {
+                pSysfsContext->szBuffer[BytesRead - 1] = 0;
+            }
+
+            AttributeRead = BOOL_TRUE;
+        }
+
+        close(FileDescriptor);
+    }
+
+    return AttributeRead;
 }
 
 
+
 /*
- * Os_SetAffinity
+ * LinuxOs_ParseCpuList
  *
- *    Set the current thread affinity
+ *    Parses a CPU list such as 0-3,8,10-11 in the context buffer into a set.  
+ *    The set is either of CPU numbers or of the processor indexes of those CPUs,
+ *    CPUs that are not online are not added to a set of processor indexes.
  *
  * Arguments:
- *     Processor Number
+ *     Sysfs Context, Processor Set, TRUE to add CPU Numbers rather than Processor Indexes
  *     
  * Return:
  *     None
  */
-void Os_SetAffinity(unsigned int ProcessorNumber)
-{  
-    cpu_set_t *cpu_set;
-    unsigned int NumberOfProcessors;
-    unsigned int SetSize;
+void LinuxOs_ParseCpuList(PLINUX_SYSFS_CONTEXT pSysfsContext, PPROCESSOR_SET pProcessorSet, BOOL_TYPE CpuNumbers)
+{
+    char *pszList;
+    char *pszEnd;
+    unsigned int FirstCpu;
+    unsigned int LastCpu;
+    unsigned int CpuNumber;
 
-    /*
-     * Get the size of the maximum number of configured processors.
-    */
-    NumberOfProcessors = get_nprocs_conf();
+    pszList = pSysfsContext->szBuffer;
 
-    /*
-     * Something larger comes in we will just go with it.
-     */
-    if (ProcessorNumber > NumberOfProcessors) 
+    while (*pszList >= '0' && *pszList <= '9') 
     {
-        NumberOfProcessors = ProcessorNumber;
+        FirstCpu = (unsigned int)strtoul(pszList, &pszEnd, 10);
+        LastCpu  = FirstCpu;
+
+        if (*pszEnd == '-') 
+        {
+            pszList = pszEnd + 1;
+            LastCpu = (unsigned int)strtoul(pszList, &pszEnd, 10);
+        }
+
+        for (CpuNumber = FirstCpu; CpuNumber <= LastCpu && CpuNumber < pSysfsContext->MaximumCpus; CpuNumber++) 
+        {
+            if (CpuNumbers) 
+            {
+                Tools_AddProcessorToSet(pProcessorSet, CpuNumber);
+            }
+            else
+            {
+                if (pSysfsContext->pCpuToProcessorIndex[CpuNumber] != INVALID_PROCESSOR_INDEX) 
+                {
+                    Tools_AddProcessorToSet(pProcessorSet, pSysfsContext->pCpuToProcessorIndex[CpuNumber]);
+                }
+            }
+        }
+
+        pszList = (*pszEnd == ',') ? pszEnd + 1 : pszEnd;
     }
+}
 
-    cpu_set = CPU_ALLOC(NumberOfProcessors);
 
-    if (cpu_set) 
+
+/*
+ * LinuxOs_ReadOnlineCpus
+ *
+ *    Reads the single list of online CPUs into a set of CPU numbers.  The list 
+ *    is in ascending order so the set is sized for the configured CPUs or the
+ *    last CPU listed if it is beyond them.
+ *
+ * Arguments:
+ *     Sysfs Context, Online CPU Set to create
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the set was created, it must be destroyed by the caller
+ */
+BOOL_TYPE LinuxOs_ReadOnlineCpus(PLINUX_SYSFS_CONTEXT pSysfsContext, PPROCESSOR_SET pOnlineCpus)
+{
+    unsigned int CpuNumber;
+    char *pszLastCpu;
+    BOOL_TYPE CpusRead;
+
+    CpusRead = BOOL_FALSE;
+
+    snprintf(pSysfsContext->szPath, sizeof(pSysfsContext->szPath), "%s/online", SYSFS_CPU_PATH);
+
+    if (LinuxOs_ReadSysfsAttribute(pSysfsContext, AT_FDCWD, NULL)) 
     {
-        SetSize = CPU_ALLOC_SIZE(NumberOfProcessors);
-        CPU_ZERO_S(SetSize, cpu_set);
-        CPU_SET_S(ProcessorNumber, SetSize, cpu_set);
+        pSysfsContext->MaximumCpus = (unsigned int)get_nprocs_conf();
+        pszLastCpu = pSysfsContext->szBuffer + strlen(pSysfsContext->szBuffer);
 
-        sched_setaffinity(getpid(),SetSize, cpu_set);
+        while (pszLastCpu > pSysfsContext->szBuffer && pszLastCpu[-1] >= '0' && pszLastCpu[-1] <= '9') 
+        {
+            pszLastCpu--;
+        }
 
-        CPU_FREE(cpu_set);
+        CpuNumber = (unsigned int)strtoul(pszLastCpu, NULL, 10);
+
+        if (CpuNumber >= pSysfsContext->MaximumCpus) 
+        {
+            pSysfsContext->MaximumCpus = CpuNumber + 1;
+        }
+
+        if (Tools_CreateProcessorSet(pOnlineCpus, pSysfsContext->MaximumCpus)) 
+        {
+            LinuxOs_ParseCpuList(pSysfsContext, pOnlineCpus, BOOL_TRUE);
+            CpusRead = BOOL_TRUE;
+        }
+    }
+
+    return CpusRead;
+}
+
+
+
+/*
+ * LinuxOs_ParseListedProcessors
+ *
+ *    Parses the CPU list in the context buffer into the listed processors.
+ *
+ * Arguments:
+ *     Sysfs Context
+ *     
+ * Return:
+ *     The lowest processor index listed, INVALID_PROCESSOR_INDEX if none are online
+ */
+unsigned int LinuxOs_ParseListedProcessors(PLINUX_SYSFS_CONTEXT pSysfsContext)
+{
+    unsigned int ProcessorIndex;
+    unsigned int FirstIndex;
+
+    FirstIndex = INVALID_PROCESSOR_INDEX;
+
+    memset(pSysfsContext->ListedProcessors.pBitmap, 0, sizeof(unsigned int)*((pSysfsContext->ListedProcessors.NumberOfProcessors + PROCESSOR_SET_BITS_PER_WORD - 1) / PROCESSOR_SET_BITS_PER_WORD));
+
+    LinuxOs_ParseCpuList(pSysfsContext, &pSysfsContext->ListedProcessors, BOOL_FALSE);
+
+    for (ProcessorIndex = 0; ProcessorIndex < pSysfsContext->ListedProcessors.NumberOfProcessors && FirstIndex == INVALID_PROCESSOR_INDEX; ProcessorIndex++) 
+    {
+        if (Tools_IsProcessorInSet(&pSysfsContext->ListedProcessors, ProcessorIndex)) 
+        {
+            FirstIndex = ProcessorIndex;
+        }
+    }
+
+    return FirstIndex;
+}
+
+
+
+/*
+ * LinuxOs_AddRelationship
+ *
+ *    Adds an entry to the OS topology with the processors that were 
+ *    last listed.
+ *
+ * Arguments:
+ *     Sysfs Context, Relationship
+ *     
+ * Return:
+ *     The new entry or NULL if it could not be added
+ */
+POS_TOPOLOGY_ENTRY LinuxOs_AddRelationship(PLINUX_SYSFS_CONTEXT pSysfsContext, OS_RELATIONSHIP Relationship)
+{
+    POS_TOPOLOGY pOsTopology;
+    POS_TOPOLOGY_ENTRY pEntries;
+    POS_TOPOLOGY_ENTRY pOsTopologyEntry;
+    unsigned int MaximumEntries;
+
+    pOsTopology = pSysfsContext->pOsTopology;
+    pOsTopologyEntry = NULL;
+
+    if (pOsTopology->NumberOfEntries == pOsTopology->MaximumEntries) 
+    {
+        MaximumEntries = (pOsTopology->MaximumEntries == 0) ? (pOsTopology->NumberOfProcessors*2 + 8) : (pOsTopology->MaximumEntries*2);
+        pEntries = (POS_TOPOLOGY_ENTRY)realloc(pOsTopology->pEntries, sizeof(OS_TOPOLOGY_ENTRY)*MaximumEntries);
+
+        if (pEntries) 
+        {
+            pOsTopology->pEntries = pEntries;
+            pOsTopology->MaximumEntries = MaximumEntries;
+        }
+    }
+
+    if (pOsTopology->NumberOfEntries < pOsTopology->MaximumEntries) 
+    {
+        pOsTopologyEntry = &pOsTopology->pEntries[pOsTopology->NumberOfEntries];
+        memset(pOsTopologyEntry, 0, sizeof(OS_TOPOLOGY_ENTRY));
+
+        if (Tools_CreateProcessorSet(&pOsTopologyEntry->Processors, pOsTopology->NumberOfProcessors)) 
+        {
+            memcpy(pOsTopologyEntry->Processors.pBitmap, pSysfsContext->ListedProcessors.pBitmap, sizeof(unsigned int)*((pOsTopology->NumberOfProcessors + PROCESSOR_SET_BITS_PER_WORD - 1) / PROCESSOR_SET_BITS_PER_WORD));
+            pOsTopologyEntry->Relationship = Relationship;
+            pOsTopology->NumberOfEntries++;
+        }
+        else
+        {
+            pOsTopologyEntry = NULL;
+        }
     }
+
+    return pOsTopologyEntry;
 }
 
 
+
+/*
+ * LinuxOs_ParseRelationship
+ *
+ *    Adds the core, die or package of a processor when it is the first 
+ *    processor listed in it.  A relationship the kernel does not report
+ *    is skipped.
+ *
+ * Arguments:
+ *     Sysfs Context, Relationship, Processor Index, CPU List Attribute, Older Kernel CPU List Attribute, ID Attribute
+ *     
+ * Return:
+ *     Returns BOOL_FALSE only if memory could not be allocated
+ */
+BOOL_TYPE LinuxOs_ParseRelationship(PLINUX_SYSFS_CONTEXT pSysfsContext, OS_RELATIONSHIP Relationship, unsigned int ProcessorIndex, char *pszListAttribute, char *pszFallbackAttribute, char *pszIdAttribute)
+{
+    POS_TOPOLOGY_ENTRY pOsTopologyEntry;
+    unsigned int FirstIndex;
+    BOOL_TYPE ListRead;
+    BOOL_TYPE RelationshipParsed;
+
+    RelationshipParsed = BOOL_TRUE;
+
+    ListRead = LinuxOs_ReadSysfsAttribute(pSysfsContext, pSysfsContext->CpuDirectory, pszListAttribute);
+
+    if (ListRead == BOOL_FALSE && pszFallbackAttribute) 
+    {
+        ListRead = LinuxOs_ReadSysfsAttribute(pSysfsContext, pSysfsContext->CpuDirectory, pszFallbackAttribute);
+    }
+
+    if (ListRead) 
+    {
+        /*
+         * Only the first online processor in the list adds it.
+         */
+        FirstIndex = LinuxOs_ParseListedProcessors(pSysfsContext);
+
+        if (FirstIndex == ProcessorIndex) 
+        {
+            pOsTopologyEntry = LinuxOs_AddRelationship(pSysfsContext, Relationship);
+
+            if (pOsTopologyEntry) 
+            {
+                if (LinuxOs_ReadSysfsAttribute(pSysfsContext, pSysfsContext->CpuDirectory, pszIdAttribute)) 
+                {
+                    pOsTopologyEntry->Id = (unsigned int)strtoul(pSysfsContext->szBuffer, NULL, 10);
+                }
+            }
+            else
+            {
+                RelationshipParsed = BOOL_FALSE;
+            }
+        }
+    }
+
+    return RelationshipParsed;
+}
+
+
+
+/*
+ * LinuxOs_ParseCaches
+ *
+ *    Adds each cache of a processor that it is the first processor
+ *    listed as sharing.  Each cache directory is opened once and its
+ *    attributes are read relative to it.
+ *
+ * Arguments:
+ *     Sysfs Context, Processor Index
+ *     
+ * Return:
+ *     Returns BOOL_FALSE only if memory could not be allocated
+ */
+BOOL_TYPE LinuxOs_ParseCaches(PLINUX_SYSFS_CONTEXT pSysfsContext, unsigned int ProcessorIndex)
+{
+    POS_TOPOLOGY_ENTRY pOsTopologyEntry;
+    PCPUID_CACHE_INFO pCacheInfo;
+    char szCacheDirectory[32];
+    int CacheDirectory;
+    unsigned int CacheIndex;
+    unsigned int FirstIndex;
+    BOOL_TYPE CachesParsed;
+    BOOL_TYPE ListRead;
+
+    CachesParsed = BOOL_TRUE;
+    ListRead = BOOL_TRUE;
+
+    for (CacheIndex = 0; CacheIndex < SYSFS_MAXIMUM_CACHES && CachesParsed && ListRead; CacheIndex++) 
+    {
+        snprintf(szCacheDirectory, sizeof(szCacheDirectory), "cache/index%u", CacheIndex);
+
+        CacheDirectory = openat(pSysfsContext->CpuDirectory, szCacheDirectory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        /*
+         * The cache indexes are contiguous, the first missing one is the end.
+         */
+        ListRead = (CacheDirectory >= 0) ? LinuxOs_ReadSysfsAttribute(pSysfsContext, CacheDirectory, "shared_cpu_list") : BOOL_FALSE;
+
+        if (ListRead) 
+        {
+            FirstIndex = LinuxOs_ParseListedProcessors(pSysfsContext);
+
+            if (FirstIndex == ProcessorIndex) 
+            {
+                pOsTopologyEntry = LinuxOs_AddRelationship(pSysfsContext, OsRelationship_Cache);
+
+                if (pOsTopologyEntry) 
+                {
+                    pCacheInfo = &pOsTopologyEntry->CacheInfo;
+                    pCacheInfo->CacheLevel       = LinuxOs_ReadCacheValue(pSysfsContext, CacheDirectory, "level");
+                    pCacheInfo->CacheId          = LinuxOs_ReadCacheValue(pSysfsContext, CacheDirectory, "id");
+                    pCacheInfo->CacheWays        = LinuxOs_ReadCacheValue(pSysfsContext, CacheDirectory, "ways_of_associativity");
+                    pCacheInfo->CachePartitions  = LinuxOs_ReadCacheValue(pSysfsContext, CacheDirectory, "physical_line_partition");
+                    pCacheInfo->CacheLineSize    = LinuxOs_ReadCacheValue(pSysfsContext, CacheDirectory, "coherency_line_size");
+                    pCacheInfo->CacheSets        = LinuxOs_ReadCacheValue(pSysfsContext, CacheDirectory, "number_of_sets");
+                    pCacheInfo->CacheSizeInBytes = LinuxOs_ReadCacheValue(pSysfsContext, CacheDirectory, "size");
+                    pCacheInfo->CacheIsFullyAssociative = (pCacheInfo->CacheWays == 0 || pCacheInfo->CacheSets == 1) ? BOOL_TRUE : BOOL_FALSE;
+                    pCacheInfo->NumberOfLPsSharingThisCache = 0;
+                    pCacheInfo->CacheType = CacheType_NoMoreCaches;
+                    pOsTopologyEntry->Id = pCacheInfo->CacheId;
+
+                    if (LinuxOs_ReadSysfsAttribute(pSysfsContext, CacheDirectory, "type")) 
+                    {
+                        if (strcmp(pSysfsContext->szBuffer, "Data") == 0) 
+                        {
+                            pCacheInfo->CacheType = CacheType_DataCache;
+                        }
+                        else if (strcmp(pSysfsContext->szBuffer, "Instruction") == 0) 
+                        {
+                            pCacheInfo->CacheType = CacheType_InstructionCache;
+                        }
+                        else if (strcmp(pSysfsContext->szBuffer, "Unified") == 0) 
+                        {
+                            pCacheInfo->CacheType = CacheType_UnifiedCache;
+                        }
+                    }
+                }
+                else
+                {
+                    CachesParsed = BOOL_FALSE;
+                }
+            }
+        }
+
+        if (CacheDirectory >= 0) 
+        {
+            close(CacheDirectory);
+        }
+    }
+
+    return CachesParsed;
+}
+
+
+
+/*
+ * LinuxOs_ReadCacheValue
+ *
+ *    Reads a numeric attribute of a cache, sizes given in K or M are
+ *    converted to bytes.
+ *
+ * Arguments:
+ *     Sysfs Context, Cache Directory Descriptor, Attribute
+ *     
+ * Return:
+ *     The value or 0 if the attribute does not exist
+ */
+unsigned int LinuxOs_ReadCacheValue(PLINUX_SYSFS_CONTEXT pSysfsContext, int CacheDirectory, char *pszAttribute)
+{
+    unsigned int Value;
+    char *pszEnd;
+
+    Value = 0;
+
+    if (LinuxOs_ReadSysfsAttribute(pSysfsContext, CacheDirectory, pszAttribute)) 
+    {
+        Value = (unsigned int)strtoul(pSysfsContext->szBuffer, &pszEnd, 10);
+
+        if (*pszEnd == 'K') 
+        {
+            Value = Value*BYTES_IN_KB;
+        }
+        else if (*pszEnd == 'M') 
+        {
+            Value = Value*BYTES_IN_MB;
+        }
+    }
+
+    return Value;
+}
+
+
+
+
+/*
+ * Os_Platform_Read_Cpuid
+ *
+ *    OS/Compiler Specific implementation of reading CPUID, the instruction is
+ *    volatile so it stays between the instrumentation timestamps.
+ *
+ * Arguments:
+ *     Leaf, Subleaf, CPUID Data Structure
+ *     
+ * Return:
+ *     None
+ */
+void Os_Platform_Read_Cpuid(unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
+{
+    unsigned long long StartTime;
+    unsigned int ReturnEax;
+    unsigned int ReturnEbx;
+    unsigned int ReturnEcx;
+    unsigned int ReturnEdx;
+
+    StartTime = Instrument_StartTimer();
+    
+    asm volatile ("movl %4, %%eax\n"
+         "movl %5, %%ecx\n"
+         "CPUID\n"
+         "movl %%eax, %0\n"
+         "movl %%ebx, %1\n"
+         "movl %%ecx, %2\n"
+         "movl %%edx, %3\n"
+          : "=r" (ReturnEax), "=r" (ReturnEbx), "=r" (ReturnEcx), "=r" (ReturnEdx)
+          : "r" (Leaf), "r" (Subleaf)
+          : "%eax", "%ebx", "%ecx", "%edx"
+    );
+
+     pCpuidRegisters->x.Register.Eax  = ReturnEax;
+     pCpuidRegisters->x.Register.Ebx  = ReturnEbx;
+     pCpuidRegisters->x.Register.Ecx  = ReturnEcx;
+     pCpuidRegisters->x.Register.Edx  = ReturnEdx;
+
+     Instrument_CountCpuid(Leaf, StartTime);
+}
+
+/*
+ * Os_GetNumberOfProcessors
+ *
+ *    Get the number of processors
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     Number of processors
+ */
+unsigned int Os_GetNumberOfProcessors(void)
+{
+    unsigned int NumberOfProcessors;
+
+    NumberOfProcessors = LinuxOs_GetProcessorTable()->NumberOfProcessors;
+
+    return NumberOfProcessors;
+}
+
+
+/*
+ * LinuxOs_AllocateProcessorTable
+ *
+ *    Allocates an empty processor table with room for the CPU numbers
+ *    in the same allocation.
+ *
+ * Arguments:
+ *     Maximum Number of Processors
+ *     
+ * Return:
+ *     The processor table or NULL
+ */
+PLINUX_PROCESSOR_TABLE LinuxOs_AllocateProcessorTable(unsigned int MaximumProcessors)
+{
+    PLINUX_PROCESSOR_TABLE pProcessorTable;
+
+    pProcessorTable = (PLINUX_PROCESSOR_TABLE)calloc(1, sizeof(LINUX_PROCESSOR_TABLE) + sizeof(unsigned int)*MaximumProcessors);
+
+    if (pProcessorTable) 
+    {
+        pProcessorTable->pCpuNumbers = (unsigned int *)(pProcessorTable + 1);
+    }
+
+    return pProcessorTable;
+}
+
+
+/*
+ * LinuxOs_BuildProcessorTable
+ *
+ *    Builds a processor table from the online CPUs.  If the online list cannot
+ *    be read the processors are assumed to be the CPUs numbered from zero.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The processor table or NULL if it could not be built
+ */
+PLINUX_PROCESSOR_TABLE LinuxOs_BuildProcessorTable(void)
+{
+    PLINUX_PROCESSOR_TABLE pProcessorTable;
+    PLINUX_SYSFS_CONTEXT pSysfsContext;
+    PROCESSOR_SET OnlineCpus;
+    unsigned int NumberOfProcessors;
+    unsigned int CpuNumber;
+
+    pProcessorTable = NULL;
+
+    pSysfsContext = (PLINUX_SYSFS_CONTEXT)calloc(1, sizeof(LINUX_SYSFS_CONTEXT));
+
+    if (pSysfsContext) 
+    {
+        if (LinuxOs_ReadOnlineCpus(pSysfsContext, &OnlineCpus)) 
+        {
+            pProcessorTable = LinuxOs_AllocateProcessorTable(pSysfsContext->MaximumCpus);
+
+            if (pProcessorTable) 
+            {
+                for (CpuNumber = 0; CpuNumber < pSysfsContext->MaximumCpus; CpuNumber++) 
+                {
+                    if (Tools_IsProcessorInSet(&OnlineCpus, CpuNumber)) 
+                    {
+                        pProcessorTable->pCpuNumbers[pProcessorTable->NumberOfProcessors] = CpuNumber;
+                        pProcessorTable->NumberOfProcessors++;
+                    }
+                }
+            }
+
+            Tools_DestroyProcessorSet(&OnlineCpus);
+        }
+
+        free(pSysfsContext);
+    }
+
+    if (pProcessorTable && pProcessorTable->NumberOfProcessors == 0) 
+    {
+        free(pProcessorTable);
+        pProcessorTable = NULL;
+    }
+
+    if (pProcessorTable == NULL) 
+    {
+        NumberOfProcessors = (unsigned int)get_nprocs();
+
+        if (NumberOfProcessors) 
+        {
+            pProcessorTable = LinuxOs_AllocateProcessorTable(NumberOfProcessors);
+
+            if (pProcessorTable) 
+            {
+                for (CpuNumber = 0; CpuNumber < NumberOfProcessors; CpuNumber++) 
+                {
+                    pProcessorTable->pCpuNumbers[CpuNumber] = CpuNumber;
+                }
+
+                pProcessorTable->NumberOfProcessors = NumberOfProcessors;
+            }
+        }
+    }
+
+    return pProcessorTable;
+}
+
+
+/*
+ * LinuxOs_CreateProcessorTable
+ *
+ *    Builds and publishes the first processor table, it is called once
+ *    through pthread_once.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     None
+ */
+void LinuxOs_CreateProcessorTable(void)
+{
+    Os_AtomicExchangePointer(&g_LinuxProcessors.pCurrentTable, LinuxOs_BuildProcessorTable());
+}
+
+
+/*
+ * LinuxOs_GetProcessorTable
+ *
+ *    Returns the processor table in use, it is built from the online CPUs 
+ *    the first time it is needed.  The table returned is not changed by a 
+ *    refresh so a caller should use the same table for all of its lookups.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The processor table, empty if the processors could not be read
+ */
+PLINUX_PROCESSOR_TABLE LinuxOs_GetProcessorTable(void)
+{
+    PLINUX_PROCESSOR_TABLE pProcessorTable;
+
+    pthread_once(&g_LinuxProcessors.TableOnce, LinuxOs_CreateProcessorTable);
+
+    pProcessorTable = (PLINUX_PROCESSOR_TABLE)Os_AtomicLoadPointer(&g_LinuxProcessors.pCurrentTable);
+
+    if (pProcessorTable == NULL) 
+    {
+        pProcessorTable = &g_LinuxEmptyProcessorTable;
+    }
+
+    return pProcessorTable;
+}
+
+
+/*
+ * LinuxOs_GetCpuNumber
+ *
+ *    Converts an ordered processor number into the CPU number the kernel 
+ *    uses for it.  A processor number beyond the table is used as is.
+ *
+ * Arguments:
+ *     Processor Table, Processor Number
+ *     
+ * Return:
+ *     CPU Number
+ */
+unsigned int LinuxOs_GetCpuNumber(PLINUX_PROCESSOR_TABLE pProcessorTable, unsigned int ProcessorNumber)
+{
+    unsigned int CpuNumber;
+
+    CpuNumber = ProcessorNumber;
+
+    if (ProcessorNumber < pProcessorTable->NumberOfProcessors) 
+    {
+        CpuNumber = pProcessorTable->pCpuNumbers[ProcessorNumber];
+    }
+
+    return CpuNumber;
+}
+
+
+/*
+ * Os_GetProcessorId
+ *
+ *    Returns the CPU number of a processor, it identifies the processor
+ *    when other processors go online or offline.
+ *
+ * Arguments:
+ *     Processor Number
+ *     
+ * Return:
+ *     The CPU Number
+ */
+unsigned int Os_GetProcessorId(unsigned int ProcessorNumber)
+{
+    return LinuxOs_GetCpuNumber(LinuxOs_GetProcessorTable(), ProcessorNumber);
+}
+
+
+/*
+ * Os_RefreshProcessors
+ *
+ *    Rebuilds the processor table from the CPUs that are online now, a
+ *    changed table replaces the one in use and the old one is retired.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the online processors changed
+ */
+BOOL_TYPE Os_RefreshProcessors(void)
+{
+    PLINUX_PROCESSOR_TABLE pProcessorTable;
+    PLINUX_PROCESSOR_TABLE pRefreshedTable;
+    BOOL_TYPE ProcessorsChanged;
+
+    ProcessorsChanged = BOOL_FALSE;
+
+    LinuxOs_GetProcessorTable();
+
+    pthread_mutex_lock(&g_LinuxProcessors.RefreshLock);
+
+    pRefreshedTable = LinuxOs_BuildProcessorTable();
+
+    if (pRefreshedTable) 
+    {
+        pProcessorTable = LinuxOs_GetProcessorTable();
+
+        if (pRefreshedTable->NumberOfProcessors != pProcessorTable->NumberOfProcessors ||
+            memcmp(pRefreshedTable->pCpuNumbers, pProcessorTable->pCpuNumbers, sizeof(unsigned int)*pRefreshedTable->NumberOfProcessors) != 0) 
+        {
+            pProcessorTable = (PLINUX_PROCESSOR_TABLE)Os_AtomicExchangePointer(&g_LinuxProcessors.pCurrentTable, pRefreshedTable);
+
+            if (pProcessorTable) 
+            {
+                pProcessorTable->pRetiredTable = g_LinuxProcessors.pRetiredTables;
+                g_LinuxProcessors.pRetiredTables = pProcessorTable;
+            }
+
+            ProcessorsChanged = BOOL_TRUE;
+        }
+        else
+        {
+            free(pRefreshedTable);
+        }
+    }
+
+    pthread_mutex_unlock(&g_LinuxProcessors.RefreshLock);
+
+    return ProcessorsChanged;
+}
+
+
+/*
+ * LinuxOs_OpenUeventSocket
+ *
+ *    Opens the socket for the kernel hotplug uevents, it is called once 
+ *    through pthread_once and leaves the socket -1 if it cannot be opened.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     None
+ */
+void LinuxOs_OpenUeventSocket(void)
+{
+    struct sockaddr_nl UeventAddress;
+    int UeventSocket;
+
+    UeventSocket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+
+    if (UeventSocket >= 0) 
+    {
+        memset(&UeventAddress, 0, sizeof(UeventAddress));
+        UeventAddress.nl_family = AF_NETLINK;
+        UeventAddress.nl_groups = 1;
+
+        if (bind(UeventSocket, (struct sockaddr *)&UeventAddress, sizeof(UeventAddress)) != 0) 
+        {
+            close(UeventSocket);
+            UeventSocket = -1;
+        }
+    }
+
+    g_LinuxProcessors.UeventSocket = UeventSocket;
+}
+
+
+/*
+ * Os_WaitForProcessorChange
+ *
+ *    Waits for CPUs to go online or offline.  The kernel hotplug uevents are 
+ *    watched for a CPU event, the online CPUs are polled instead if the uevents 
+ *    are not available such as in a container.
+ *
+ * Arguments:
+ *     Timeout in Milliseconds
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the online processors changed before the timeout
+ */
+BOOL_TYPE Os_WaitForProcessorChange(unsigned int TimeoutMilliseconds)
+{
+    unsigned long long Deadline;
+    unsigned long long CurrentTime;
+    unsigned int WaitMilliseconds;
+    BOOL_TYPE ProcessorsChanged;
+
+    ProcessorsChanged = BOOL_FALSE;
+
+    pthread_once(&g_LinuxProcessors.UeventOnce, LinuxOs_OpenUeventSocket);
+
+    CurrentTime = Os_GetTimestampNanoseconds();
+    Deadline = CurrentTime + ((unsigned long long)TimeoutMilliseconds*1000000ULL);
+
+    do
+    {
+        WaitMilliseconds = (unsigned int)((Deadline - CurrentTime)/1000000ULL);
+
+        /*
+         * The online CPUs are always checked once the uevent is seen or on each 
+         * poll, and at least every second while waiting on the uevents, so any 
+         * change from before the socket was opened or a uevent that was dropped 
+         * is still found.
+         */
+        if (g_LinuxProcessors.UeventSocket >= 0) 
+        {
+            WaitMilliseconds = (WaitMilliseconds < HOTPLUG_UEVENT_MILLISECONDS) ? WaitMilliseconds : HOTPLUG_UEVENT_MILLISECONDS;
+            LinuxOs_ReceiveProcessorUevent(g_LinuxProcessors.UeventSocket, WaitMilliseconds);
+        }
+        else
+        {
+            WaitMilliseconds = (WaitMilliseconds < HOTPLUG_POLL_MILLISECONDS) ? WaitMilliseconds : HOTPLUG_POLL_MILLISECONDS;
+            usleep(WaitMilliseconds*1000);
+        }
+
+        ProcessorsChanged = Os_RefreshProcessors();
+        CurrentTime = Os_GetTimestampNanoseconds();
+
+    } while (ProcessorsChanged == BOOL_FALSE && CurrentTime < Deadline);
+
+    return ProcessorsChanged;
+}
+
+
+/*
+ * LinuxOs_ReceiveProcessorUevent
+ *
+ *    Receives kernel uevents until one is for a CPU or the timeout expires,
+ *    such as online@/devices/system/cpu/cpu3.
+ *
+ * Arguments:
+ *     Uevent Socket, Timeout in Milliseconds
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if a CPU uevent was received
+ */
+BOOL_TYPE LinuxOs_ReceiveProcessorUevent(int UeventSocket, unsigned int TimeoutMilliseconds)
+{
+    struct pollfd PollDescriptor;
+    char szUevent[UEVENT_BUFFER_SIZE];
+    ssize_t BytesReceived;
+    BOOL_TYPE UeventReceived;
+
+    UeventReceived = BOOL_FALSE;
+
+    PollDescriptor.fd = UeventSocket;
+    PollDescriptor.events = POLLIN;
+    PollDescriptor.revents = 0;
+
+    while (UeventReceived == BOOL_FALSE && poll(&PollDescriptor, 1, (int)TimeoutMilliseconds) > 0) 
+    {
+        BytesReceived = recv(UeventSocket, szUevent, sizeof(szUevent) - 1, 0);
+
+        if (BytesReceived > 0) 
+        {
+            /*
+             * The uevent starts with the action and the device path as one string.
+             */
+            szUevent[BytesReceived] = 0;
+
+            if (strstr(szUevent, "/devices/system/cpu/cpu")) 
+            {
+                UeventReceived = BOOL_TRUE;
+            }
+        }
+    }
+
+    return UeventReceived;
+}
+
+
+/*
+ * Os_SetAffinity
+ *
+ *    Set the current thread affinity, the thread ID of zero is the calling
+ *    thread rather than the main thread of the process.
+ *
+ * Arguments:
+ *     Processor Number
+ *     
+ * Return:
+ *     Returns true if the affinity was set
+ */
+BOOL_TYPE Os_SetAffinity(unsigned int ProcessorNumber)
+{  
+    cpu_set_t *cpu_set;
+    unsigned long long StartTime;
+    unsigned int NumberOfProcessors;
+    unsigned int SetSize;
+    unsigned int CpuNumber;
+    BOOL_TYPE AffinitySet;
+
+    AffinitySet = BOOL_FALSE;
+    StartTime = Instrument_StartTimer();
+
+    CpuNumber = LinuxOs_GetCpuNumber(LinuxOs_GetProcessorTable(), ProcessorNumber);
+
+    /*
+     * Get the size of the maximum number of configured processors.
+    */
+    NumberOfProcessors = get_nprocs_conf();
+
+    /*
+     * Something larger comes in we will just go with it.
+     */
+    if (CpuNumber >= NumberOfProcessors) 
+    {
+        NumberOfProcessors = CpuNumber + 1;
+    }
+
+    cpu_set = CPU_ALLOC(NumberOfProcessors);
+
+    if (cpu_set) 
+    {
+        SetSize = CPU_ALLOC_SIZE(NumberOfProcessors);
+        CPU_ZERO_S(SetSize, cpu_set);
+        CPU_SET_S(CpuNumber, SetSize, cpu_set);
+
+        if (sched_setaffinity(0, SetSize, cpu_set) == 0) 
+        {
+            AffinitySet = BOOL_TRUE;
+        }
+
+        CPU_FREE(cpu_set);
+    }
+
+    Instrument_CountAffinity(AffinitySet, StartTime);
+
+    return AffinitySet;
+}
+
+
+/*
+ * Os_GetTimestampNanoseconds
+ *
+ *    Reads the monotonic high resolution clock.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The time in nanoseconds from an arbitrary starting point
+ */
+unsigned long long Os_GetTimestampNanoseconds(void)
+{
+    struct timespec TimeSpec;
+    unsigned long long Timestamp;
+
+    Timestamp = 0;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &TimeSpec) == 0) 
+    {
+        Timestamp = ((unsigned long long)TimeSpec.tv_sec*1000000000ULL) + (unsigned long long)TimeSpec.tv_nsec;
+    }
+
+    return Timestamp;
+}
+
+
+/*
+ * Os_GetBootId
+ *
+ *    Reads the random ID the kernel creates on each boot.
+ *
+ * Arguments:
+ *     Returned Boot ID String, Size of the String
+ *     
+ * Return:
+ *     Returns true if the boot ID was read
+ */
+BOOL_TYPE Os_GetBootId(char *pszBootId, unsigned int BootIdSize)
+{
+    FILE *BootIdFile;
+    size_t Length;
+    BOOL_TYPE BootIdRead;
+
+    BootIdRead = BOOL_FALSE;
+
+    BootIdFile = fopen("/proc/sys/kernel/random/boot_id", "r");
+
+    if (BootIdFile) 
+    {
+        if (fgets(pszBootId, (int)BootIdSize, BootIdFile)) 
+        {
+            Length = strlen(pszBootId);
+
+            while (Length > 0 && (pszBootId[Length - 1] == '\n' || pszBootId[Length - 1] == '\r')) 
+            {
+                Length--;
+                pszBootId[Length] = 0;
+            }
+
+            BootIdRead = (Length > 0) ? BOOL_TRUE : BOOL_FALSE;
+        }
+
+        fclose(BootIdFile);
+    }
+
+    return BootIdRead;
+}
+
+
+/*
+ * Os_GetProcessorNumaNode
+ *
+ *    Get the NUMA node of a processor from the node link sysfs
+ *    places in the directory of each cpu.
+ *
+ * Arguments:
+ *     Processor Number, Returned NUMA Node
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the OS reports a NUMA node for the processor.
+ */
+BOOL_TYPE Os_GetProcessorNumaNode(unsigned int ProcessorNumber, unsigned int *pNumaNode)
+{
+    char szCpuDirectory[64];
+    DIR *pDirectory;
+    struct dirent *pDirectoryEntry;
+    unsigned int NumaNode;
+    char TrailingCharacter;
+    BOOL_TYPE NodeFound;
+
+    NodeFound = BOOL_FALSE;
+
+    snprintf(szCpuDirectory, sizeof(szCpuDirectory), "%s/cpu%u", SYSFS_CPU_PATH, LinuxOs_GetCpuNumber(LinuxOs_GetProcessorTable(), ProcessorNumber));
+
+    pDirectory = opendir(szCpuDirectory);
+
+    if (pDirectory) 
+    {
+        while (NodeFound == BOOL_FALSE && (pDirectoryEntry = readdir(pDirectory)) != NULL) 
+        {
+            if (sscanf(pDirectoryEntry->d_name, "node%u%c", &NumaNode, &TrailingCharacter) == 1) 
+            {
+                *pNumaNode = NumaNode;
+                NodeFound = BOOL_TRUE;
+            }
+        }
+
+        closedir(pDirectory);
+    }
+
+    return NodeFound;
+}
+
+
+
+
+
+/*
+ * Os_RunOnEachProcessor
+ *
+ *    Executes the worker once on every processor.  A thread is created for each
+ *    processor with its affinity set at creation so it starts on that processor, 
+ *    then all of the threads are waited on.  Any processor that a worker could not 
+ *    be started on is handled by this thread migrating to it.
+ *
+ * Arguments:
+ *     Number of Processors, Worker Function, Worker Context
+ *     
+ * Return:
+ *     Returns true if the worker ran for every processor
+ */
+BOOL_TYPE Os_RunOnEachProcessor(unsigned int NumberOfProcessors, PFN_PROCESSOR_WORKER pfnWorker, void *pContext)
+{
+    PLINUX_PROCESSOR_TABLE pProcessorTable;
+    PLINUX_PROCESSOR_WORKER pProcessorWorkers;
+    pthread_attr_t ThreadAttributes;
+    cpu_set_t *cpu_set;
+    unsigned int ProcessorIndex;
+    unsigned int SetSize;
+    unsigned int SetProcessors;
+    BOOL_TYPE WorkersCompleted;
+
+    WorkersCompleted = BOOL_FALSE;
+
+    pProcessorTable = LinuxOs_GetProcessorTable();
+    pProcessorWorkers = (PLINUX_PROCESSOR_WORKER)calloc(NumberOfProcessors, sizeof(LINUX_PROCESSOR_WORKER));
+
+    SetProcessors = get_nprocs_conf();
+
+    for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
+    {
+        if (LinuxOs_GetCpuNumber(pProcessorTable, ProcessorIndex) >= SetProcessors) 
+        {
+            SetProcessors = LinuxOs_GetCpuNumber(pProcessorTable, ProcessorIndex) + 1;
+        }
+    }
+
+    cpu_set = CPU_ALLOC(SetProcessors);
+
+    if (pProcessorWorkers && cpu_set) 
+    {
+        SetSize = CPU_ALLOC_SIZE(SetProcessors);
+
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
+        {
+            pProcessorWorkers[ProcessorIndex].ProcessorNumber = ProcessorIndex;
+            pProcessorWorkers[ProcessorIndex].pfnWorker = pfnWorker;
+            pProcessorWorkers[ProcessorIndex].pContext = pContext;
+
+            CPU_ZERO_S(SetSize, cpu_set);
+            CPU_SET_S(LinuxOs_GetCpuNumber(pProcessorTable, ProcessorIndex), SetSize, cpu_set);
+
+            if (pthread_attr_init(&ThreadAttributes) == 0) 
+            {
+                if (pthread_attr_setaffinity_np(&ThreadAttributes, SetSize, cpu_set) == 0) 
+                {
+                    if (pthread_create(&pProcessorWorkers[ProcessorIndex].WorkerThread, &ThreadAttributes, LinuxOs_ProcessorWorkerThread, &pProcessorWorkers[ProcessorIndex]) == 0) 
+                    {
+                        pProcessorWorkers[ProcessorIndex].WorkerStarted = BOOL_TRUE;
+                    }
+                }
+
+                pthread_attr_destroy(&ThreadAttributes);
+            }
+        }
+
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
+        {
+            if (pProcessorWorkers[ProcessorIndex].WorkerStarted) 
+            {
+                pthread_join(pProcessorWorkers[ProcessorIndex].WorkerThread, NULL);
+            }
+        }
+
+        /*
+         * Complete any processor that could not be given its own worker.
+         */
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
+        {
+            if (pProcessorWorkers[ProcessorIndex].WorkerStarted == BOOL_FALSE && Os_SetAffinity(ProcessorIndex)) 
+            {
+                pfnWorker(ProcessorIndex, pContext);
+            }
+        }
+
+        WorkersCompleted = BOOL_TRUE;
+    }
+
+    if (cpu_set) 
+    {
+        CPU_FREE(cpu_set);
+    }
+
+    if (pProcessorWorkers) 
+    {
+        free(pProcessorWorkers);
+    }
+
+    return WorkersCompleted;
+}
+
+
+/*
+ * LinuxOs_ProcessorWorkerThread
+ *
+ *    The thread entry for a worker that was created on its processor.
+ *
+ * Arguments:
+ *     Processor Worker Context
+ *     
+ * Return:
+ *     NULL
+ */
+void *LinuxOs_ProcessorWorkerThread(void *pParameter)
+{
+    PLINUX_PROCESSOR_WORKER pProcessorWorker;
+
+    pProcessorWorker = (PLINUX_PROCESSOR_WORKER)pParameter;
+
+    pProcessorWorker->pfnWorker(pProcessorWorker->ProcessorNumber, pProcessorWorker->pContext);
+
+    return NULL;
+}
+
+
+/*
+ * Os_RunOnProcessors
+ *
+ *    Executes the worker on each of the processors listed at the same time.  A 
+ *    thread is created for each one with its affinity set at creation, unlike 
+ *    Os_RunOnEachProcessor no worker is run by migrating this thread since the 
+ *    workers are expected to run together, then all of the threads are waited on.
+ *
+ * Arguments:
+ *     Number of Processors Listed, Processor Numbers, Worker Function, Worker Context
+ *     
+ * Return:
+ *     Returns true if a worker was started on every processor listed
+ */
+BOOL_TYPE Os_RunOnProcessors(unsigned int NumberOfProcessors, unsigned int *pProcessorNumbers, PFN_PROCESSOR_WORKER pfnWorker, void *pContext)
+{
+    PLINUX_PROCESSOR_TABLE pProcessorTable;
+    PLINUX_PROCESSOR_WORKER pProcessorWorkers;
+    pthread_attr_t ThreadAttributes;
+    cpu_set_t *cpu_set;
+    unsigned int WorkerIndex;
+    unsigned int SetSize;
+    unsigned int SetProcessors;
+    BOOL_TYPE WorkersStarted;
+
+    WorkersStarted = BOOL_FALSE;
+
+    pProcessorTable = LinuxOs_GetProcessorTable();
+    pProcessorWorkers = (PLINUX_PROCESSOR_WORKER)calloc(NumberOfProcessors + 1, sizeof(LINUX_PROCESSOR_WORKER));
+
+    SetProcessors = get_nprocs_conf();
+
+    for (WorkerIndex = 0; WorkerIndex < NumberOfProcessors; WorkerIndex++) 
+    {
+        if (LinuxOs_GetCpuNumber(pProcessorTable, pProcessorNumbers[WorkerIndex]) >= SetProcessors) 
+        {
+            SetProcessors = LinuxOs_GetCpuNumber(pProcessorTable, pProcessorNumbers[WorkerIndex]) + 1;
+        }
+    }
+
+    cpu_set = CPU_ALLOC(SetProcessors);
+
+    if (pProcessorWorkers && cpu_set) 
+    {
+        SetSize = CPU_ALLOC_SIZE(SetProcessors);
+        WorkersStarted = BOOL_TRUE;
+
+        for (WorkerIndex = 0; WorkerIndex < NumberOfProcessors; WorkerIndex++) 
+        {
+            pProcessorWorkers[WorkerIndex].ProcessorNumber = pProcessorNumbers[WorkerIndex];
+            pProcessorWorkers[WorkerIndex].pfnWorker = pfnWorker;
+            pProcessorWorkers[WorkerIndex].pContext = pContext;
+
+            CPU_ZERO_S(SetSize, cpu_set);
+            CPU_SET_S(LinuxOs_GetCpuNumber(pProcessorTable, pProcessorNumbers[WorkerIndex]), SetSize, cpu_set);
+
+            if (pthread_attr_init(&ThreadAttributes) == 0) 
+            {
+                if (pthread_attr_setaffinity_np(&ThreadAttributes, SetSize, cpu_set) == 0) 
+                {
+                    if (pthread_create(&pProcessorWorkers[WorkerIndex].WorkerThread, &ThreadAttributes, LinuxOs_ProcessorWorkerThread, &pProcessorWorkers[WorkerIndex]) == 0) 
+                    {
+                        pProcessorWorkers[WorkerIndex].WorkerStarted = BOOL_TRUE;
+                    }
+                }
+
+                pthread_attr_destroy(&ThreadAttributes);
+            }
+
+            if (pProcessorWorkers[WorkerIndex].WorkerStarted == BOOL_FALSE) 
+            {
+                WorkersStarted = BOOL_FALSE;
+            }
+        }
+
+        for (WorkerIndex = 0; WorkerIndex < NumberOfProcessors; WorkerIndex++) 
+        {
+            if (pProcessorWorkers[WorkerIndex].WorkerStarted) 
+            {
+                pthread_join(pProcessorWorkers[WorkerIndex].WorkerThread, NULL);
+            }
+        }
+    }
+
+    if (cpu_set) 
+    {
+        CPU_FREE(cpu_set);
+    }
+
+    if (pProcessorWorkers) 
+    {
+        free(pProcessorWorkers);
+    }
+
+    return WorkersStarted;
+}
+
+
+/*
+ * Os_GetThreadContext
+ *
+ *    Returns the context bound to the calling thread.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The context or NULL if none is bound
+ */
+void *Os_GetThreadContext(void)
+{
+    return g_pLinuxThreadContext;
+}
+
+
+/*
+ * Os_SetThreadContext
+ *
+ *    Binds a context to the calling thread, a context still bound when the
+ *    thread exits is given to Tools_ReleaseThreadCpuidContext.
+ *
+ * Arguments:
+ *     Context or NULL
+ *     
+ * Return:
+ *     Returns true if the context is bound
+ */
+BOOL_TYPE Os_SetThreadContext(void *pContext)
+{
+    BOOL_TYPE ContextBound;
+
+    ContextBound = BOOL_FALSE;
+
+    pthread_once(&g_LinuxThreadContextSlot.KeyOnce, LinuxOs_CreateThreadContextKey);
+
+    if (g_LinuxThreadContextSlot.KeyCreated) 
+    {
+        if (pthread_setspecific(g_LinuxThreadContextSlot.ContextKey, pContext) == 0) 
+        {
+            g_pLinuxThreadContext = pContext;
+            ContextBound = BOOL_TRUE;
+        }
+    }
+
+    return ContextBound;
+}
+
+
+/*
+ * LinuxOs_CreateThreadContextKey
+ *
+ *    Creates the thread key of the context slot, this runs once.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     None
+ */
+void LinuxOs_CreateThreadContextKey(void)
+{
+    if (pthread_key_create(&g_LinuxThreadContextSlot.ContextKey, LinuxOs_ReleaseThreadContext) == 0) 
+    {
+        g_LinuxThreadContextSlot.KeyCreated = BOOL_TRUE;
+    }
+}
+
+
+/*
+ * LinuxOs_ReleaseThreadContext
+ *
+ *    The destructor of the thread key, the thread local variable is cleared
+ *    first as the thread may still read CPUID while the context is released.
+ *
+ * Arguments:
+ *     Context bound to the exiting thread
+ *     
+ * Return:
+ *     None
+ */
+void LinuxOs_ReleaseThreadContext(void *pContext)
+{
+    g_pLinuxThreadContext = NULL;
+
+    Tools_ReleaseThreadCpuidContext(pContext);
+}
+
+
+/*
+ * Os_GetCurrentProcessorId
+ *
+ *    Returns the CPU number of the processor the calling thread is running on,
+ *    the same CPU number as Os_GetProcessorId.
+ *
+ * Arguments:
+ *     Returned CPU Number
+ *     
+ * Return:
+ *     Returns true if the CPU number was read
+ */
+BOOL_TYPE Os_GetCurrentProcessorId(unsigned int *pProcessorId)
+{
+    BOOL_TYPE CpuFound;
+    int CpuNumber;
+
+    CpuFound = BOOL_FALSE;
+
+    pthread_once(&g_LinuxCurrentCpu.MethodOnce, LinuxOs_SelectCurrentCpuMethod);
+
+    CpuNumber = LinuxOs_ReadCurrentCpu(g_LinuxCurrentCpu.Method);
+
+    if (CpuNumber >= 0) 
+    {
+        *pProcessorId = (unsigned int)CpuNumber;
+        CpuFound = BOOL_TRUE;
+    }
+
+    return CpuFound;
+}
+
+
+/*
+ * LinuxOs_SelectCurrentCpuMethod
+ *
+ *    Selects RDPID from CPUID.07H.0:ECX[22] or RDTSCP from CPUID.80000001H:EDX[27]
+ *    if the CPU numbers fit in IA32_TSC_AUX and it agrees with sched_getcpu, this
+ *    runs once.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     None
+ */
+void LinuxOs_SelectCurrentCpuMethod(void)
+{
+    CPUID_REGISTERS CpuidRegisters;
+    LINUX_CURRENT_CPU_METHOD Method;
+    unsigned int CheckIndex;
+    BOOL_TYPE MethodChecked;
+    int CpuNumberBefore;
+    int CpuNumber;
+
+    Method = LinuxCurrentCpuGetCpu;
+
+    if (sysconf(_SC_NPROCESSORS_CONF) <= TSC_AUX_MAXIMUM_CPUS) 
+    {
+        Os_Platform_Read_Cpuid(0, 0, &CpuidRegisters);
+
+        if (CpuidRegisters.x.Register.Eax >= 7) 
+        {
+            Os_Platform_Read_Cpuid(7, 0, &CpuidRegisters);
+
+            if (CpuidRegisters.x.Register.Ecx & (1<<22)) 
+            {
+                Method = LinuxCurrentCpuRdpid;
+            }
+        }
+
+        if (Method == LinuxCurrentCpuGetCpu) 
+        {
+            Os_Platform_Read_Cpuid(0x80000000, 0, &CpuidRegisters);
+
+            if (CpuidRegisters.x.Register.Eax >= 0x80000001) 
+            {
+                Os_Platform_Read_Cpuid(0x80000001, 0, &CpuidRegisters);
+
+                if (CpuidRegisters.x.Register.Edx & (1<<27)) 
+                {
+                    Method = LinuxCurrentCpuRdtscp;
+                }
+            }
+        }
+
+        /*
+         * IA32_TSC_AUX is only used once it has been seen to hold the CPU number,
+         * a check is repeated if the thread moved to another CPU during it.
+         */
+        MethodChecked = BOOL_FALSE;
+
+        for (CheckIndex = 0; CheckIndex < CURRENT_PROCESSOR_CHECKS && Method != LinuxCurrentCpuGetCpu && MethodChecked == BOOL_FALSE; CheckIndex++) 
+        {
+            CpuNumberBefore = sched_getcpu();
+            CpuNumber = LinuxOs_ReadCurrentCpu(Method);
+
+            if (CpuNumberBefore == sched_getcpu()) 
+            {
+                MethodChecked = BOOL_TRUE;
+
+                if (CpuNumber != CpuNumberBefore) 
+                {
+                    Method = LinuxCurrentCpuGetCpu;
+                }
+            }
+        }
+
+        if (MethodChecked == BOOL_FALSE) 
+        {
+            Method = LinuxCurrentCpuGetCpu;
+        }
+    }
+
+    g_LinuxCurrentCpu.Method = Method;
+}
+
+
+/*
+ * LinuxOs_ReadCurrentCpu
+ *
+ *    Reads the CPU number of the calling thread with a method, RDPID is encoded
+ *    as bytes for assemblers that do not know it.
+ *
+ * Arguments:
+ *     Method
+ *     
+ * Return:
+ *     The CPU number or -1 on failure
+ */
+int LinuxOs_ReadCurrentCpu(LINUX_CURRENT_CPU_METHOD Method)
+{
+    unsigned long long TscAux;
+    unsigned int LowTsc;
+    unsigned int HighTsc;
+    unsigned int Aux;
+    int CpuNumber;
+
+    switch (Method) 
+    {
+        case LinuxCurrentCpuRdpid:
+            asm volatile (".byte 0xf3, 0x0f, 0xc7, 0xf8"
+                          : "=a" (TscAux));
+            CpuNumber = (int)(TscAux & TSC_AUX_CPU_MASK);
+            break;
+
+        case LinuxCurrentCpuRdtscp:
+            asm volatile ("rdtscp"
+                          : "=a" (LowTsc), "=d" (HighTsc), "=c" (Aux));
+            CpuNumber = (int)(Aux & TSC_AUX_CPU_MASK);
+            break;
+
+        default:
+            CpuNumber = sched_getcpu();
+            break;
+    }
+
+    return CpuNumber;
+}
+
+
+/*
+ * Os_AtomicExchangePointer
+ *
+ *    Atomically replaces a pointer, this is a full memory barrier.
+ *
+ * Arguments:
+ *     Target, Value
+ *     
+ * Return:
+ *     The previous value of the target
+ */
+void *Os_AtomicExchangePointer(void * volatile *ppTarget, void *pValue)
+{
+    return __atomic_exchange_n(ppTarget, pValue, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * Os_AtomicLoadPointer
+ *
+ *    Atomically reads a pointer, this is ordered with every other atomic.
+ *
+ * Arguments:
+ *     Target
+ *     
+ * Return:
+ *     The value of the target
+ */
+void *Os_AtomicLoadPointer(void * volatile *ppTarget)
+{
+    return __atomic_load_n(ppTarget, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * Os_AtomicLoad64
+ *
+ *    Atomically reads a 64 bit value, this is ordered with every other atomic.
+ *
+ * Arguments:
+ *     Target
+ *     
+ * Return:
+ *     The value of the target
+ */
+unsigned long long Os_AtomicLoad64(volatile unsigned long long *pTarget)
+{
+    return __atomic_load_n(pTarget, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * Os_AtomicStore64
+ *
+ *    Atomically writes a 64 bit value, this is a full memory barrier so the
+ *    reads that follow it are not performed before it.
+ *
+ * Arguments:
+ *     Target, Value
+ *     
+ * Return:
+ *     None
+ */
+void Os_AtomicStore64(volatile unsigned long long *pTarget, unsigned long long Value)
+{
+    __atomic_store_n(pTarget, Value, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * Os_AtomicIncrement64
+ *
+ *    Atomically increments a 64 bit value, this is a full memory barrier.
+ *
+ * Arguments:
+ *     Target
+ *     
+ * Return:
+ *     The incremented value
+ */
+unsigned long long Os_AtomicIncrement64(volatile unsigned long long *pTarget)
+{
+    return __atomic_add_fetch(pTarget, 1, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * Os_AtomicAdd64
+ *
+ *    Atomically adds to a 64 bit value, this is a full memory barrier.
+ *
+ * Arguments:
+ *     Target, Value
+ *     
+ * Return:
+ *     The value after the add
+ */
+unsigned long long Os_AtomicAdd64(volatile unsigned long long *pTarget, unsigned long long Value)
+{
+    return __atomic_add_fetch(pTarget, Value, __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * Os_AtomicCompareExchange64
+ *
+ *    Atomically replaces a 64 bit value if it holds the expected value, this 
+ *    is a full memory barrier.
+ *
+ * Arguments:
+ *     Target, Expected Value, Desired Value
+ *     
+ * Return:
+ *     Returns true if the target held the expected value and was replaced
+ */
+BOOL_TYPE Os_AtomicCompareExchange64(volatile unsigned long long *pTarget, unsigned long long Expected, unsigned long long Desired)
+{
+    BOOL_TYPE Exchanged;
+
+    Exchanged = BOOL_FALSE;
+
+    if (__atomic_compare_exchange_n(pTarget, &Expected, Desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) 
+    {
+        Exchanged = BOOL_TRUE;
+    }
+
+    return Exchanged;
+}
@@ -31,6 +31,102 @@ void __cpuidex(unsigned int *cpuinfo,int function_id,int subfunction_id);
 
 #define CACHE_INVALID_INDEX 4
 
+
+#define BITS_IN_KAFFINITY   (sizeof(KAFFINITY)*8)
+#define HOTPLUG_POLL_MILLISECONDS (250)
+
+
+/*
+ * The active processors of a processor group, the ordered processor number
+ * of each bit in the group mask or INVALID_PROCESSOR_INDEX if it is not active.
+ */
+typedef struct _WIN_GROUP_INFO {
+    WORD Group;
+    KAFFINITY ActiveProcessorMask;
+    unsigned int FirstProcessor;
+    unsigned int NumberOfProcessors;
+    unsigned int ProcessorOfBit[BITS_IN_KAFFINITY];
+} WIN_GROUP_INFO, *PWIN_GROUP_INFO;
+
+
+/*
+ * The group and bit of each ordered processor number.
+ */
+typedef struct _WIN_PROCESSOR_ENTRY {
+    WORD Group;
+    unsigned char Bit;
+} WIN_PROCESSOR_ENTRY, *PWIN_PROCESSOR_ENTRY;
+
+
+/*
+ * The processor group table is built from the active processor mask of every 
+ * group, groups and the processors within them do not need to be contiguous.  
+ * A table is never changed once it is published.
+ */
+typedef struct _WIN_PROCESSOR_TABLE {
+    struct _WIN_PROCESSOR_TABLE *pRetiredTable;
+    unsigned int NumberOfProcessors;
+    PWIN_PROCESSOR_ENTRY pProcessors;
+    WORD NumberOfGroups;
+    PWIN_GROUP_INFO pGroups;
+} WIN_PROCESSOR_TABLE, *PWIN_PROCESSOR_TABLE;
+
+
+/*
+ * The context for a worker thread pinned to a processor group, it runs the
+ * worker on each processor of its group in turn.
+ */
+typedef struct _WIN_GROUP_WORKER {
+    HANDLE hWorkerThread;
+    PWIN_GROUP_INFO pGroupInfo;
+    unsigned int NumberOfProcessors;
+    BOOL_TYPE *pProcessorCompleted;
+    PFN_PROCESSOR_WORKER pfnWorker;
+    void *pContext;
+} WIN_GROUP_WORKER, *PWIN_GROUP_WORKER;
+
+/*
+ * The context for a worker thread pinned to a specific processor.
+ */
+typedef struct _WIN_PROCESSOR_WORKER {
+    HANDLE hWorkerThread;
+    unsigned int ProcessorNumber;
+    PFN_PROCESSOR_WORKER pfnWorker;
+    void *pContext;
+} WIN_PROCESSOR_WORKER, *PWIN_PROCESSOR_WORKER;
+
+
+/*
+ * The processor group table in use.  It is built once by the first thread that
+ * needs it and a refresh publishes a new table with one atomic pointer swap, so
+ * a reader always sees a matching count and list.  A reader may still be using 
+ * a replaced table so it is kept on the retired list rather than freed, the 
+ * active processors rarely change so this is only a few tables.  The refresh 
+ * lock only orders refreshes with each other, readers never take it.
+ */
+typedef struct _WIN_PROCESSORS {
+    INIT_ONCE TableOnce;
+    SRWLOCK RefreshLock;
+    void * volatile pCurrentTable;
+    PWIN_PROCESSOR_TABLE pRetiredTables;
+} WIN_PROCESSORS, *PWIN_PROCESSORS;
+
+WIN_PROCESSORS g_WinProcessors = { INIT_ONCE_STATIC_INIT, SRWLOCK_INIT };
+WIN_PROCESSOR_TABLE g_WinEmptyProcessorTable;
+
+
+/*
+ * The fiber local slot that holds the context bound to each thread, it is 
+ * allocated once by the first thread that uses it.
+ */
+typedef struct _WIN_THREAD_CONTEXT_SLOT {
+    INIT_ONCE SlotOnce;
+    DWORD FlsIndex;
+    BOOL_TYPE SlotAllocated;
+} WIN_THREAD_CONTEXT_SLOT, *PWIN_THREAD_CONTEXT_SLOT;
+
+WIN_THREAD_CONTEXT_SLOT g_WinThreadContextSlot = { INIT_ONCE_STATIC_INIT };
+
 unsigned char *g_pszCacheTypeString[] = {
     "Unified",
     "Instruction",
@@ -45,6 +141,17 @@ unsigned char *g_pszCacheTypeString[] = {
 void WinOs_EnumerateAndDisplayTopology(PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pSystemLogicalProcInfoEx, DWORD BufferSize);
 void WinOs_DisplayGroupAffinity(WORD GroupCount, GROUP_AFFINITY *pGroupAffinityArray);
 unsigned char *WinOs_GetCacheTypeString(PROCESSOR_CACHE_TYPE  CacheType);
+BOOL WinOs_GetProcessorGroupAffinity(unsigned int ProcessorNumber, GROUP_AFFINITY *pGroupAffinity);
+DWORD WINAPI WinOs_GroupWorkerThread(LPVOID pParameter);
+DWORD WINAPI WinOs_ProcessorWorkerThread(LPVOID pParameter);
+BOOL CALLBACK WinOs_AllocateThreadContextSlot(PINIT_ONCE pInitOnce, PVOID pParameter, PVOID *ppContext);
+VOID WINAPI WinOs_ReleaseThreadContext(PVOID pContext);
+PWIN_PROCESSOR_TABLE WinOs_GetProcessorTable(void);
+BOOL_TYPE WinOs_BuildProcessorTable(PWIN_PROCESSOR_TABLE pProcessorTable);
+void WinOs_ReleaseProcessorTable(PWIN_PROCESSOR_TABLE pProcessorTable);
+PWIN_PROCESSOR_TABLE WinOs_CreateProcessorTable(void);
+BOOL CALLBACK WinOs_PublishProcessorTable(PINIT_ONCE pInitOnce, PVOID pParameter, PVOID *ppContext);
+POS_TOPOLOGY_ENTRY WinOs_AddRelationship(POS_TOPOLOGY pOsTopology, OS_RELATIONSHIP Relationship, WORD GroupCount, GROUP_AFFINITY *pGroupAffinityArray);
 
 /*
  * Os_DisplayTopology
@@ -238,7 +345,13 @@ unsigned char *WinOs_GetCacheTypeString(PROCESSOR_CACHE_TYPE  CacheType)
  */
 void Os_Platform_Read_Cpuid(unsigned int Leaf, unsigned int Subleaf, PCPUID_REGISTERS pCpuidRegisters)
 {
+    unsigned long long StartTime;
+
+    StartTime = Instrument_StartTimer();
+
     __cpuidex(&pCpuidRegisters->x.Registers[0], Leaf, Subleaf);
+
+    Instrument_CountCpuid(Leaf, StartTime);
 }
 
 /*
@@ -256,7 +369,16 @@ unsigned int Os_GetNumberOfProcessors(void)
 {
     unsigned int NumberOfProcessors;
 
-    NumberOfProcessors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    /*
+     * The processor table is refreshed when processors are added so it is 
+     * used over the active count.
+     */
+    NumberOfProcessors = WinOs_GetProcessorTable()->NumberOfProcessors;
+
+    if (NumberOfProcessors == 0) 
+    {
+        NumberOfProcessors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    }
 
     return NumberOfProcessors;
 }
@@ -271,37 +393,1271 @@ unsigned int Os_GetNumberOfProcessors(void)
  *     Processor Number
  *     
  * Return:
- *     None
+ *     Returns true if the affinity was set
  */
-void Os_SetAffinity(unsigned int ProcessorNumber)
+BOOL_TYPE Os_SetAffinity(unsigned int ProcessorNumber)
 {
     GROUP_AFFINITY GroupAffinity;
-    unsigned short GroupIndex;
-    unsigned short MaxGroups;
-    unsigned int NumberOfGroupProcessors;
+    unsigned long long StartTime;
+    BOOL_TYPE AffinitySet;
 
-    /*
-     * Assume the active groups are going to be contiguous.
-     */
-    MaxGroups = GetActiveProcessorGroupCount();
+    AffinitySet = BOOL_FALSE;
+    StartTime = Instrument_StartTimer();
+
+    if (WinOs_GetProcessorGroupAffinity(ProcessorNumber, &GroupAffinity) != FALSE) 
+    {
+        if (SetThreadGroupAffinity(GetCurrentThread(), &GroupAffinity, NULL) != FALSE) 
+        {
+            AffinitySet = BOOL_TRUE;
+        }
+    }
+
+    Instrument_CountAffinity(AffinitySet, StartTime);
+
+    return AffinitySet;
+}
+
+
+/*
+ * WinOs_BuildProcessorTable
+ *
+ *    Builds a processor group table from the active processor masks of 
+ *    the groups.
+ *
+ * Arguments:
+ *     Processor Table to fill in
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the table was built
+ */
+BOOL_TYPE WinOs_BuildProcessorTable(PWIN_PROCESSOR_TABLE pProcessorTable)
+{
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pSystemLogicalProcInfoEx;
+    PWIN_GROUP_INFO pGroupInfo;
+    DWORD BufferSize;
+    WORD GroupIndex;
+    unsigned int BitIndex;
+
+    memset(pProcessorTable, 0, sizeof(WIN_PROCESSOR_TABLE));
+    BufferSize = 0;
+
+    GetLogicalProcessorInformationEx(RelationGroup, NULL, &BufferSize);
+
+    pSystemLogicalProcInfoEx = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)malloc(BufferSize);
+
+    if (pSystemLogicalProcInfoEx) 
+    {
+        if (GetLogicalProcessorInformationEx(RelationGroup, pSystemLogicalProcInfoEx, &BufferSize) != FALSE && pSystemLogicalProcInfoEx->Relationship == RelationGroup)
+        {
+            pProcessorTable->pGroups     = (PWIN_GROUP_INFO)calloc(pSystemLogicalProcInfoEx->Group.ActiveGroupCount + 1, sizeof(WIN_GROUP_INFO));
+            pProcessorTable->pProcessors = (PWIN_PROCESSOR_ENTRY)calloc(pSystemLogicalProcInfoEx->Group.ActiveGroupCount*BITS_IN_KAFFINITY + 1, sizeof(WIN_PROCESSOR_ENTRY));
+
+            if (pProcessorTable->pGroups && pProcessorTable->pProcessors) 
+            {
+                /*
+                 * The processors are numbered in group order then bit order within 
+                 * the group, skipping any processor that is not active.
+                 */
+                for (GroupIndex = 0; GroupIndex < pSystemLogicalProcInfoEx->Group.ActiveGroupCount; GroupIndex++) 
+                {
+                    pGroupInfo = &pProcessorTable->pGroups[GroupIndex];
+                    pGroupInfo->Group = GroupIndex;
+                    pGroupInfo->ActiveProcessorMask = pSystemLogicalProcInfoEx->Group.GroupInfo[GroupIndex].ActiveProcessorMask;
+                    pGroupInfo->FirstProcessor = pProcessorTable->NumberOfProcessors;
+
+                    for (BitIndex = 0; BitIndex < BITS_IN_KAFFINITY; BitIndex++) 
+                    {
+                        pGroupInfo->ProcessorOfBit[BitIndex] = INVALID_PROCESSOR_INDEX;
+
+                        if (pGroupInfo->ActiveProcessorMask & ((KAFFINITY)1<<BitIndex)) 
+                        {
+                            pGroupInfo->ProcessorOfBit[BitIndex] = pProcessorTable->NumberOfProcessors;
+                            pProcessorTable->pProcessors[pProcessorTable->NumberOfProcessors].Group = GroupIndex;
+                            pProcessorTable->pProcessors[pProcessorTable->NumberOfProcessors].Bit   = (unsigned char)BitIndex;
+                            pProcessorTable->NumberOfProcessors++;
+                            pGroupInfo->NumberOfProcessors++;
+                        }
+                    }
+                }
+
+                pProcessorTable->NumberOfGroups = pSystemLogicalProcInfoEx->Group.ActiveGroupCount;
+            }
+        }
+
+        free(pSystemLogicalProcInfoEx);
+    }
+
+    return (pProcessorTable->NumberOfProcessors != 0) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/*
+ * WinOs_ReleaseProcessorTable
+ *
+ *    Frees a processor group table from WinOs_BuildProcessorTable.
+ *
+ * Arguments:
+ *     Processor Table
+ *     
+ * Return:
+ *     None
+ */
+void WinOs_ReleaseProcessorTable(PWIN_PROCESSOR_TABLE pProcessorTable)
+{
+    if (pProcessorTable->pGroups) 
+    {
+        free(pProcessorTable->pGroups);
+    }
+
+    if (pProcessorTable->pProcessors) 
+    {
+        free(pProcessorTable->pProcessors);
+    }
+
+    memset(pProcessorTable, 0, sizeof(WIN_PROCESSOR_TABLE));
+}
+
+
+/*
+ * WinOs_CreateProcessorTable
+ *
+ *    Allocates and builds a processor group table from the groups that 
+ *    are active now.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The processor table or NULL if it could not be built
+ */
+PWIN_PROCESSOR_TABLE WinOs_CreateProcessorTable(void)
+{
+    PWIN_PROCESSOR_TABLE pProcessorTable;
+
+    pProcessorTable = (PWIN_PROCESSOR_TABLE)malloc(sizeof(WIN_PROCESSOR_TABLE));
+
+    if (pProcessorTable) 
+    {
+        if (WinOs_BuildProcessorTable(pProcessorTable) == BOOL_FALSE) 
+        {
+            WinOs_ReleaseProcessorTable(pProcessorTable);
+            free(pProcessorTable);
+            pProcessorTable = NULL;
+        }
+    }
+
+    return pProcessorTable;
+}
+
+
+/*
+ * WinOs_PublishProcessorTable
+ *
+ *    Builds and publishes the first processor group table, this runs once.
+ *
+ * Arguments:
+ *     Init Once, Parameter, Returned Context
+ *     
+ * Return:
+ *     TRUE
+ */
+BOOL CALLBACK WinOs_PublishProcessorTable(PINIT_ONCE pInitOnce, PVOID pParameter, PVOID *ppContext)
+{
+    Os_AtomicExchangePointer(&g_WinProcessors.pCurrentTable, WinOs_CreateProcessorTable());
 
-    for (GroupIndex = 0; GroupIndex < MaxGroups; GroupIndex++) 
+    return TRUE;
+}
+
+
+/*
+ * WinOs_GetProcessorTable
+ *
+ *    Returns the processor group table in use, it is built from the active
+ *    processor masks of the groups the first time it is needed.  The table
+ *    returned is not changed by a refresh so a caller should use the same 
+ *    table for all of its lookups.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The processor table, empty if the groups could not be read
+ */
+PWIN_PROCESSOR_TABLE WinOs_GetProcessorTable(void)
+{
+    PWIN_PROCESSOR_TABLE pProcessorTable;
+
+    InitOnceExecuteOnce(&g_WinProcessors.TableOnce, WinOs_PublishProcessorTable, NULL, NULL);
+
+    pProcessorTable = (PWIN_PROCESSOR_TABLE)Os_AtomicLoadPointer(&g_WinProcessors.pCurrentTable);
+
+    if (pProcessorTable == NULL) 
+    {
+        pProcessorTable = &g_WinEmptyProcessorTable;
+    }
+
+    return pProcessorTable;
+}
+
+
+/*
+ * Os_GetProcessorId
+ *
+ *    Returns the group and bit of a processor as one number, it identifies 
+ *    the processor when other processors are added.
+ *
+ * Arguments:
+ *     Processor Number
+ *     
+ * Return:
+ *     The Group times the bits in a group plus the Bit
+ */
+unsigned int Os_GetProcessorId(unsigned int ProcessorNumber)
+{
+    PWIN_PROCESSOR_TABLE pProcessorTable;
+    unsigned int ProcessorId;
+
+    ProcessorId = ProcessorNumber;
+
+    pProcessorTable = WinOs_GetProcessorTable();
+
+    if (ProcessorNumber < pProcessorTable->NumberOfProcessors) 
+    {
+        ProcessorId = ((unsigned int)pProcessorTable->pProcessors[ProcessorNumber].Group*BITS_IN_KAFFINITY) + pProcessorTable->pProcessors[ProcessorNumber].Bit;
+    }
+
+    return ProcessorId;
+}
+
+
+/*
+ * Os_RefreshProcessors
+ *
+ *    Rebuilds the processor group table from the processors that are active
+ *    now, a changed table replaces the one in use and the old one is retired.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the active processors changed
+ */
+BOOL_TYPE Os_RefreshProcessors(void)
+{
+    PWIN_PROCESSOR_TABLE pProcessorTable;
+    PWIN_PROCESSOR_TABLE pRefreshedTable;
+    BOOL_TYPE ProcessorsChanged;
+
+    ProcessorsChanged = BOOL_FALSE;
+
+    WinOs_GetProcessorTable();
+
+    AcquireSRWLockExclusive(&g_WinProcessors.RefreshLock);
+
+    pRefreshedTable = WinOs_CreateProcessorTable();
+
+    if (pRefreshedTable) 
     {
-        NumberOfGroupProcessors = GetActiveProcessorCount(GroupIndex);
+        pProcessorTable = WinOs_GetProcessorTable();
 
-        if (ProcessorNumber < NumberOfGroupProcessors) 
+        if (pRefreshedTable->NumberOfProcessors != pProcessorTable->NumberOfProcessors ||
+            memcmp(pRefreshedTable->pProcessors, pProcessorTable->pProcessors, sizeof(WIN_PROCESSOR_ENTRY)*pRefreshedTable->NumberOfProcessors) != 0) 
         {
-            memset(&GroupAffinity, 0, sizeof(GroupAffinity));
-            GroupAffinity.Group = GroupIndex;
-            GroupAffinity.Mask = (KAFFINITY)((ULONG64)1<<(ULONG64)ProcessorNumber);
-            SetThreadGroupAffinity(GetCurrentThread(), &GroupAffinity, NULL);
-            break;
+            pProcessorTable = (PWIN_PROCESSOR_TABLE)Os_AtomicExchangePointer(&g_WinProcessors.pCurrentTable, pRefreshedTable);
+
+            if (pProcessorTable) 
+            {
+                pProcessorTable->pRetiredTable = g_WinProcessors.pRetiredTables;
+                g_WinProcessors.pRetiredTables = pProcessorTable;
+            }
+
+            ProcessorsChanged = BOOL_TRUE;
         }
         else
         {
-            ProcessorNumber = ProcessorNumber - NumberOfGroupProcessors;
+            WinOs_ReleaseProcessorTable(pRefreshedTable);
+            free(pRefreshedTable);
         }
     }
+
+    ReleaseSRWLockExclusive(&g_WinProcessors.RefreshLock);
+
+    return ProcessorsChanged;
+}
+
+
+/*
+ * Os_WaitForProcessorChange
+ *
+ *    Waits for processors to be added by polling the active processors of 
+ *    the groups.
+ *
+ * Arguments:
+ *     Timeout in Milliseconds
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the active processors changed before the timeout
+ */
+BOOL_TYPE Os_WaitForProcessorChange(unsigned int TimeoutMilliseconds)
+{
+    ULONGLONG Deadline;
+    ULONGLONG CurrentTime;
+    DWORD WaitMilliseconds;
+    BOOL_TYPE ProcessorsChanged;
+
+    ProcessorsChanged = BOOL_FALSE;
+
+    CurrentTime = GetTickCount64();
+    Deadline = CurrentTime + TimeoutMilliseconds;
+
+    do
+    {
+        WaitMilliseconds = (DWORD)(Deadline - CurrentTime);
+        WaitMilliseconds = (WaitMilliseconds < HOTPLUG_POLL_MILLISECONDS) ? WaitMilliseconds : HOTPLUG_POLL_MILLISECONDS;
+
+        Sleep(WaitMilliseconds);
+
+        ProcessorsChanged = Os_RefreshProcessors();
+        CurrentTime = GetTickCount64();
+
+    } while (ProcessorsChanged == BOOL_FALSE && CurrentTime < Deadline);
+
+    return ProcessorsChanged;
+}
+
+
+/*
+ * WinOs_GetProcessorGroupAffinity
+ *
+ *    Converts an ordered processor number into a group affinity for
+ *    only that processor.
+ *
+ * Arguments:
+ *     Processor Number, Group Affinity
+ *     
+ * Return:
+ *     TRUE if the processor was found
+ */
+BOOL WinOs_GetProcessorGroupAffinity(unsigned int ProcessorNumber, GROUP_AFFINITY *pGroupAffinity)
+{
+    PWIN_PROCESSOR_TABLE pProcessorTable;
+    BOOL ProcessorFound;
+
+    ProcessorFound = FALSE;
+
+    pProcessorTable = WinOs_GetProcessorTable();
+
+    if (ProcessorNumber < pProcessorTable->NumberOfProcessors) 
+    {
+        memset(pGroupAffinity, 0, sizeof(GROUP_AFFINITY));
+        pGroupAffinity->Group = pProcessorTable->pProcessors[ProcessorNumber].Group;
+        pGroupAffinity->Mask  = (KAFFINITY)1<<pProcessorTable->pProcessors[ProcessorNumber].Bit;
+        ProcessorFound = TRUE;
+    }
+
+    return ProcessorFound;
+}
+
+
+/*
+ * Os_GetTimestampNanoseconds
+ *
+ *    Reads the performance counter as the high resolution clock.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The time in nanoseconds from an arbitrary starting point
+ */
+unsigned long long Os_GetTimestampNanoseconds(void)
+{
+    LARGE_INTEGER Counter;
+    LARGE_INTEGER Frequency;
+    unsigned long long Timestamp;
+
+    Timestamp = 0;
+
+    if (QueryPerformanceFrequency(&Frequency) != FALSE && QueryPerformanceCounter(&Counter) != FALSE && Frequency.QuadPart != 0) 
+    {
+        /*
+         * Split the seconds from the remainder so the conversion does not overflow.
+         */
+        Timestamp = ((unsigned long long)(Counter.QuadPart / Frequency.QuadPart))*1000000000ULL + 
+                    ((unsigned long long)(Counter.QuadPart % Frequency.QuadPart))*1000000000ULL / (unsigned long long)Frequency.QuadPart;
+    }
+
+    return Timestamp;
 }
 
 
+/*
+ * Os_GetBootId
+ *
+ *    Creates an ID for this boot from the time the system started, the
+ *    system time less the time since boot rounded to a minute so the
+ *    drift between the two clocks does not change it.
+ *
+ * Arguments:
+ *     Returned Boot ID String, Size of the String
+ *     
+ * Return:
+ *     Returns true if the boot ID was created
+ */
+BOOL_TYPE Os_GetBootId(char *pszBootId, unsigned int BootIdSize)
+{
+    FILETIME SystemTime;
+    ULARGE_INTEGER CurrentTime;
+    unsigned long long BootMinute;
+    BOOL_TYPE BootIdCreated;
+
+    BootIdCreated = BOOL_FALSE;
+
+    GetSystemTimeAsFileTime(&SystemTime);
+    CurrentTime.LowPart  = SystemTime.dwLowDateTime;
+    CurrentTime.HighPart = SystemTime.dwHighDateTime;
+
+    /*
+     * The file time is in 100 nanosecond units and the tick count in milliseconds.
+     */
+    BootMinute = (CurrentTime.QuadPart/10000ULL - GetTickCount64() + 30000ULL)/60000ULL;
+
+    if (_snprintf(pszBootId, BootIdSize, "%I64u", BootMinute) > 0) 
+    {
+        pszBootId[BootIdSize - 1] = 0;
+        BootIdCreated = BOOL_TRUE;
+    }
+
+    return BootIdCreated;
+}
+
+
+/*
+ * Os_GetProcessorNumaNode
+ *
+ *    Get the NUMA node of a processor by finding the RelationNumaNode
+ *    entry whose group mask contains the processor.
+ *
+ * Arguments:
+ *     Processor Number, Returned NUMA Node
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the OS reports a NUMA node for the processor.
+ */
+BOOL_TYPE Os_GetProcessorNumaNode(unsigned int ProcessorNumber, unsigned int *pNumaNode)
+{
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pSystemLogicalProcInfoEx;
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX ptr;
+    GROUP_AFFINITY GroupAffinity;
+    DWORD BufferSize;
+    DWORD CurrentSize;
+    BOOL_TYPE NodeFound;
+
+    NodeFound = BOOL_FALSE;
+    BufferSize = 0;
+
+    if (WinOs_GetProcessorGroupAffinity(ProcessorNumber, &GroupAffinity) != FALSE) 
+    {
+        GetLogicalProcessorInformationEx(RelationNumaNode, NULL, &BufferSize);
+
+        pSystemLogicalProcInfoEx = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)malloc(BufferSize);
+
+        if (pSystemLogicalProcInfoEx) 
+        {
+            if (GetLogicalProcessorInformationEx(RelationNumaNode, pSystemLogicalProcInfoEx, &BufferSize) != FALSE)
+            {
+                ptr = pSystemLogicalProcInfoEx;
+                CurrentSize = 0;
+
+                while (NodeFound == BOOL_FALSE && CurrentSize < BufferSize) 
+                {
+                    if (ptr->Relationship == RelationNumaNode && 
+                        ptr->NumaNode.GroupMask.Group == GroupAffinity.Group &&
+                        (ptr->NumaNode.GroupMask.Mask & GroupAffinity.Mask) != 0) 
+                    {
+                        *pNumaNode = ptr->NumaNode.NodeNumber;
+                        NodeFound  = BOOL_TRUE;
+                    }
+
+                    CurrentSize += ptr->Size;
+                    ptr = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(((char *)ptr) + ptr->Size);
+                }
+            }
+
+            free(pSystemLogicalProcInfoEx);
+        }
+    }
+
+    return NodeFound;
+}
+
+
+/*
+ * Os_BuildTopology
+ *
+ *    Builds the topology by walking the buffer from GetLogicalProcessorInformationEx(),
+ *    each core, package and cache becomes an entry with the processors of its group masks.
+ *    Dies are not reported by every version of Windows and are not included.
+ *
+ * Arguments:
+ *     OS Topology to fill in
+ *     
+ * Return:
+ *     Returns BOOL_TRUE if the topology was read
+ */
+BOOL_TYPE Os_BuildTopology(POS_TOPOLOGY pOsTopology)
+{
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pSystemLogicalProcInfoEx;
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX ptr;
+    POS_TOPOLOGY_ENTRY pOsTopologyEntry;
+    unsigned int ProcessorIndex;
+    unsigned int NumberOfCores;
+    unsigned int NumberOfPackages;
+    unsigned int NumberOfCaches;
+    DWORD BufferSize;
+    DWORD CurrentSize;
+    WORD GroupCount;
+    BOOL_TYPE TopologyBuilt;
+
+    TopologyBuilt = BOOL_FALSE;
+    memset(pOsTopology, 0, sizeof(OS_TOPOLOGY));
+
+    BufferSize       = 0;
+    NumberOfCores    = 0;
+    NumberOfPackages = 0;
+    NumberOfCaches   = 0;
+
+    pOsTopology->NumberOfProcessors = Os_GetNumberOfProcessors();
+    pOsTopology->pProcessorNumbers  = (unsigned int *)malloc(sizeof(unsigned int)*(pOsTopology->NumberOfProcessors + 1));
+
+    GetLogicalProcessorInformationEx(RelationAll, NULL, &BufferSize);
+
+    pSystemLogicalProcInfoEx = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)malloc(BufferSize);
+
+    if (pSystemLogicalProcInfoEx && pOsTopology->pProcessorNumbers) 
+    {
+        for (ProcessorIndex = 0; ProcessorIndex < pOsTopology->NumberOfProcessors; ProcessorIndex++) 
+        {
+            pOsTopology->pProcessorNumbers[ProcessorIndex] = ProcessorIndex;
+        }
+
+        if (GetLogicalProcessorInformationEx(RelationAll, pSystemLogicalProcInfoEx, &BufferSize) != FALSE)
+        {
+            TopologyBuilt = BOOL_TRUE;
+            ptr = pSystemLogicalProcInfoEx;
+            CurrentSize = 0;
+
+            while (CurrentSize < BufferSize && TopologyBuilt) 
+            {
+                switch (ptr->Relationship) 
+                {
+                    case RelationProcessorCore:
+                         pOsTopologyEntry = WinOs_AddRelationship(pOsTopology, OsRelationship_Core, ptr->Processor.GroupCount, &ptr->Processor.GroupMask[0]);
+
+                         if (pOsTopologyEntry) 
+                         {
+                             pOsTopologyEntry->Id = NumberOfCores;
+                             NumberOfCores++;
+                         }
+                         else
+                         {
+                             TopologyBuilt = BOOL_FALSE;
+                         }
+                         break;
+
+                    case RelationCache:
+                         /*
+                          * Newer versions of Windows have added "GroupCount" here where it was 0 and reserved on older Versions, 
+                          * Convert it to 1 if it is 0. 
+                          */
+                         GroupCount = *((WORD *)(&ptr->Cache.Reserved[18]));
+                         if (GroupCount == 0) 
+                         {
+                             GroupCount = 1;
+                         }
+
+                         pOsTopologyEntry = WinOs_AddRelationship(pOsTopology, OsRelationship_Cache, GroupCount, &ptr->Cache.GroupMask);
+
+                         if (pOsTopologyEntry) 
+                         {
+                             pOsTopologyEntry->Id = NumberOfCaches;
+                             pOsTopologyEntry->CacheInfo.CacheLevel       = ptr->Cache.Level;
+                             pOsTopologyEntry->CacheInfo.CacheLineSize    = ptr->Cache.LineSize;
+                             pOsTopologyEntry->CacheInfo.CacheSizeInBytes = ptr->Cache.CacheSize;
+                             pOsTopologyEntry->CacheInfo.CacheIsFullyAssociative = (ptr->Cache.Associativity == CACHE_FULLY_ASSOCIATIVE) ? BOOL_TRUE : BOOL_FALSE;
+                             pOsTopologyEntry->CacheInfo.CacheWays        = (ptr->Cache.Associativity == CACHE_FULLY_ASSOCIATIVE) ? 0 : ptr->Cache.Associativity;
+
+                             switch (ptr->Cache.Type) 
+                             {
+                                 case CacheUnified:
+                                      pOsTopologyEntry->CacheInfo.CacheType = CacheType_UnifiedCache;
+                                      break;
+
+                                 case CacheInstruction:
+                                      pOsTopologyEntry->CacheInfo.CacheType = CacheType_InstructionCache;
+                                      break;
+
+                                 case CacheData:
+                                      pOsTopologyEntry->CacheInfo.CacheType = CacheType_DataCache;
+                                      break;
+
+                                 default:
+                                      pOsTopologyEntry->CacheInfo.CacheType = CacheType_NoMoreCaches;
+                                      break;
+                             }
+
+                             NumberOfCaches++;
+                         }
+                         else
+                         {
+                             TopologyBuilt = BOOL_FALSE;
+                         }
+                         break;
+
+                    case RelationProcessorPackage:
+                         pOsTopologyEntry = WinOs_AddRelationship(pOsTopology, OsRelationship_Package, ptr->Processor.GroupCount, &ptr->Processor.GroupMask[0]);
+
+                         if (pOsTopologyEntry) 
+                         {
+                             pOsTopologyEntry->Id = NumberOfPackages;
+                             NumberOfPackages++;
+                         }
+                         else
+                         {
+                             TopologyBuilt = BOOL_FALSE;
+                         }
+                         break;
+
+                    default:
+                         /* 
+                          * Silently ignore new enumerations that are unknown.
+                          */
+                         break;
+                }
+
+                ptr = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(((char *)ptr) + ptr->Size);
+                CurrentSize = (DWORD)(((ULONG64)ptr) - ((ULONG64)pSystemLogicalProcInfoEx));
+            }
+        }
+    }
+
+    if (pSystemLogicalProcInfoEx) 
+    {
+        free(pSystemLogicalProcInfoEx);
+    }
+
+    if (TopologyBuilt == BOOL_FALSE) 
+    {
+        Os_ReleaseTopology(pOsTopology);
+    }
+
+    return TopologyBuilt;
+}
+
+
+/*
+ * Os_ReleaseTopology
+ *
+ *    Releases the topology from Os_BuildTopology.
+ *
+ * Arguments:
+ *     OS Topology
+ *     
+ * Return:
+ *     None
+ */
+void Os_ReleaseTopology(POS_TOPOLOGY pOsTopology)
+{
+    unsigned int EntryIndex;
+
+    if (pOsTopology->pEntries) 
+    {
+        for (EntryIndex = 0; EntryIndex < pOsTopology->NumberOfEntries; EntryIndex++) 
+        {
+            Tools_DestroyProcessorSet(&pOsTopology->pEntries[EntryIndex].Processors);
+        }
+
+        free(pOsTopology->pEntries);
+    }
+
+    if (pOsTopology->pProcessorNumbers) 
+    {
+        free(pOsTopology->pProcessorNumbers);
+    }
+
+    memset(pOsTopology, 0, sizeof(OS_TOPOLOGY));
+}
+
+
+/*
+ * WinOs_AddRelationship
+ *
+ *    Adds an entry to the OS topology with the ordered processor numbers 
+ *    of each bit set in the group masks.
+ *
+ * Arguments:
+ *     OS Topology, Relationship, Number Of Groups, Group Affinity Array
+ *     
+ * Return:
+ *     The new entry or NULL if it could not be added
+ */
+POS_TOPOLOGY_ENTRY WinOs_AddRelationship(POS_TOPOLOGY pOsTopology, OS_RELATIONSHIP Relationship, WORD GroupCount, GROUP_AFFINITY *pGroupAffinityArray)
+{
+    POS_TOPOLOGY_ENTRY pEntries;
+    POS_TOPOLOGY_ENTRY pOsTopologyEntry;
+    PWIN_PROCESSOR_TABLE pProcessorTable;
+    unsigned int MaximumEntries;
+    unsigned int BitIndex;
+    WORD Index;
+
+    pOsTopologyEntry = NULL;
+    pProcessorTable = WinOs_GetProcessorTable();
+
+    if (pOsTopology->NumberOfEntries == pOsTopology->MaximumEntries) 
+    {
+        MaximumEntries = (pOsTopology->MaximumEntries == 0) ? (pOsTopology->NumberOfProcessors*2 + 8) : (pOsTopology->MaximumEntries*2);
+        pEntries = (POS_TOPOLOGY_ENTRY)realloc(pOsTopology->pEntries, sizeof(OS_TOPOLOGY_ENTRY)*MaximumEntries);
+
+        if (pEntries) 
+        {
+            pOsTopology->pEntries = pEntries;
+            pOsTopology->MaximumEntries = MaximumEntries;
+        }
+    }
+
+    if (pOsTopology->NumberOfEntries < pOsTopology->MaximumEntries) 
+    {
+        pOsTopologyEntry = &pOsTopology->pEntries[pOsTopology->NumberOfEntries];
+        memset(pOsTopologyEntry, 0, sizeof(OS_TOPOLOGY_ENTRY));
+
+        if (Tools_CreateProcessorSet(&pOsTopologyEntry->Processors, pOsTopology->NumberOfProcessors)) 
+        {
+            pOsTopologyEntry->Relationship = Relationship;
+            pOsTopology->NumberOfEntries++;
+
+            for (Index = 0; Index < GroupCount; Index++) 
+            {
+                if (pGroupAffinityArray[Index].Group < pProcessorTable->NumberOfGroups) 
+                {
+                    for (BitIndex = 0; BitIndex < BITS_IN_KAFFINITY; BitIndex++) 
+                    {
+                        if (pGroupAffinityArray[Index].Mask & ((KAFFINITY)1<<BitIndex)) 
+                        {
+                            Tools_AddProcessorToSet(&pOsTopologyEntry->Processors, pProcessorTable->pGroups[pGroupAffinityArray[Index].Group].ProcessorOfBit[BitIndex]);
+                        }
+                    }
+                }
+            }
+        }
+        else
+        {
+            pOsTopologyEntry = NULL;
+        }
+    }
+
+    return pOsTopologyEntry;
+}
+
+
+/*
+ * Os_RunOnEachProcessor
+ *
+ *    Executes the worker once on every processor.  A pool of one suspended thread 
+ *    per processor group is created and given its whole group as affinity before it
+ *    is allowed to run, each thread then moves through the processors of its group 
+ *    so the groups are enumerated in parallel and a thread only migrates within its
+ *    group.  Any processor that a worker could not be run on is handled by this 
+ *    thread migrating to it.
+ *
+ * Arguments:
+ *     Number of Processors, Worker Function, Worker Context
+ *     
+ * Return:
+ *     Returns true if the worker ran for every processor
+ */
+BOOL_TYPE Os_RunOnEachProcessor(unsigned int NumberOfProcessors, PFN_PROCESSOR_WORKER pfnWorker, void *pContext)
+{
+    PWIN_PROCESSOR_TABLE pProcessorTable;
+    PWIN_GROUP_WORKER pGroupWorkers;
+    BOOL_TYPE *pProcessorCompleted;
+    GROUP_AFFINITY GroupAffinity;
+    unsigned int ProcessorIndex;
+    WORD GroupIndex;
+    BOOL_TYPE WorkersCompleted;
+
+    WorkersCompleted = BOOL_FALSE;
+
+    pProcessorTable = WinOs_GetProcessorTable();
+
+    pGroupWorkers       = (PWIN_GROUP_WORKER)calloc(pProcessorTable->NumberOfGroups + 1, sizeof(WIN_GROUP_WORKER));
+    pProcessorCompleted = (BOOL_TYPE *)calloc(NumberOfProcessors + 1, sizeof(BOOL_TYPE));
+
+    if (pGroupWorkers && pProcessorCompleted) 
+    {
+        for (GroupIndex = 0; GroupIndex < pProcessorTable->NumberOfGroups; GroupIndex++) 
+        {
+            pGroupWorkers[GroupIndex].pGroupInfo = &pProcessorTable->pGroups[GroupIndex];
+            pGroupWorkers[GroupIndex].NumberOfProcessors = NumberOfProcessors;
+            pGroupWorkers[GroupIndex].pProcessorCompleted = pProcessorCompleted;
+            pGroupWorkers[GroupIndex].pfnWorker = pfnWorker;
+            pGroupWorkers[GroupIndex].pContext = pContext;
+
+            if (pProcessorTable->pGroups[GroupIndex].FirstProcessor < NumberOfProcessors) 
+            {
+                memset(&GroupAffinity, 0, sizeof(GROUP_AFFINITY));
+                GroupAffinity.Group = pProcessorTable->pGroups[GroupIndex].Group;
+                GroupAffinity.Mask  = pProcessorTable->pGroups[GroupIndex].ActiveProcessorMask;
+
+                pGroupWorkers[GroupIndex].hWorkerThread = CreateThread(NULL, 0, WinOs_GroupWorkerThread, &pGroupWorkers[GroupIndex], CREATE_SUSPENDED, NULL);
+
+                if (pGroupWorkers[GroupIndex].hWorkerThread) 
+                {
+                    if (SetThreadGroupAffinity(pGroupWorkers[GroupIndex].hWorkerThread, &GroupAffinity, NULL) != FALSE) 
+                    {
+                        ResumeThread(pGroupWorkers[GroupIndex].hWorkerThread);
+                    }
+                    else
+                    {
+                        TerminateThread(pGroupWorkers[GroupIndex].hWorkerThread, 0);
+                        CloseHandle(pGroupWorkers[GroupIndex].hWorkerThread);
+                        pGroupWorkers[GroupIndex].hWorkerThread = NULL;
+                    }
+                }
+            }
+        }
+
+        for (GroupIndex = 0; GroupIndex < pProcessorTable->NumberOfGroups; GroupIndex++) 
+        {
+            if (pGroupWorkers[GroupIndex].hWorkerThread) 
+            {
+                WaitForSingleObject(pGroupWorkers[GroupIndex].hWorkerThread, INFINITE);
+                CloseHandle(pGroupWorkers[GroupIndex].hWorkerThread);
+            }
+        }
+
+        /*
+         * Complete any processor that could not be run by its group worker.
+         */
+        for (ProcessorIndex = 0; ProcessorIndex < NumberOfProcessors; ProcessorIndex++) 
+        {
+            if (pProcessorCompleted[ProcessorIndex] == BOOL_FALSE && Os_SetAffinity(ProcessorIndex)) 
+            {
+                pfnWorker(ProcessorIndex, pContext);
+            }
+        }
+
+        WorkersCompleted = BOOL_TRUE;
+    }
+
+    if (pGroupWorkers) 
+    {
+        free(pGroupWorkers);
+    }
+
+    if (pProcessorCompleted) 
+    {
+        free(pProcessorCompleted);
+    }
+
+    return WorkersCompleted;
+}
+
+
+/*
+ * WinOs_GroupWorkerThread
+ *
+ *    The thread entry for a worker that was created on its processor group,
+ *    it sets its affinity to each processor of the group and runs the worker.
+ *
+ * Arguments:
+ *     Group Worker Context
+ *     
+ * Return:
+ *     Zero
+ */
+DWORD WINAPI WinOs_GroupWorkerThread(LPVOID pParameter)
+{
+    PWIN_GROUP_WORKER pGroupWorker;
+    GROUP_AFFINITY GroupAffinity;
+    unsigned int BitIndex;
+    unsigned int ProcessorNumber;
+
+    pGroupWorker = (PWIN_GROUP_WORKER)pParameter;
+
+    for (BitIndex = 0; BitIndex < BITS_IN_KAFFINITY; BitIndex++) 
+    {
+        ProcessorNumber = pGroupWorker->pGroupInfo->ProcessorOfBit[BitIndex];
+
+        if (ProcessorNumber < pGroupWorker->NumberOfProcessors) 
+        {
+            memset(&GroupAffinity, 0, sizeof(GROUP_AFFINITY));
+            GroupAffinity.Group = pGroupWorker->pGroupInfo->Group;
+            GroupAffinity.Mask  = (KAFFINITY)1<<BitIndex;
+
+            if (SetThreadGroupAffinity(GetCurrentThread(), &GroupAffinity, NULL) != FALSE) 
+            {
+                pGroupWorker->pfnWorker(ProcessorNumber, pGroupWorker->pContext);
+                pGroupWorker->pProcessorCompleted[ProcessorNumber] = BOOL_TRUE;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Os_RunOnProcessors
+ *
+ *    Executes the worker on each of the processors listed at the same time.  A 
+ *    thread is created suspended for each one and resumed once its affinity is 
+ *    set, unlike Os_RunOnEachProcessor no worker is run by migrating this thread
+ *    since the workers are expected to run together, then all of the threads are
+ *    waited on.
+ *
+ * Arguments:
+ *     Number of Processors Listed, Processor Numbers, Worker Function, Worker Context
+ *     
+ * Return:
+ *     Returns true if a worker was started on every processor listed
+ */
+BOOL_TYPE Os_RunOnProcessors(unsigned int NumberOfProcessors, unsigned int *pProcessorNumbers, PFN_PROCESSOR_WORKER pfnWorker, void *pContext)
+{
+    PWIN_PROCESSOR_WORKER pProcessorWorkers;
+    GROUP_AFFINITY GroupAffinity;
+    unsigned int WorkerIndex;
+    BOOL_TYPE WorkersStarted;
+
+    WorkersStarted = BOOL_FALSE;
+
+    pProcessorWorkers = (PWIN_PROCESSOR_WORKER)calloc(NumberOfProcessors + 1, sizeof(WIN_PROCESSOR_WORKER));
+
+    if (pProcessorWorkers) 
+    {
+        WorkersStarted = BOOL_TRUE;
+
+        for (WorkerIndex = 0; WorkerIndex < NumberOfProcessors; WorkerIndex++) 
+        {
+            pProcessorWorkers[WorkerIndex].ProcessorNumber = pProcessorNumbers[WorkerIndex];
+            pProcessorWorkers[WorkerIndex].pfnWorker = pfnWorker;
+            pProcessorWorkers[WorkerIndex].pContext = pContext;
+
+            if (WinOs_GetProcessorGroupAffinity(pProcessorNumbers[WorkerIndex], &GroupAffinity) != FALSE) 
+            {
+                pProcessorWorkers[WorkerIndex].hWorkerThread = CreateThread(NULL, 0, WinOs_ProcessorWorkerThread, &pProcessorWorkers[WorkerIndex], CREATE_SUSPENDED, NULL);
+
+                if (pProcessorWorkers[WorkerIndex].hWorkerThread) 
+                {
+                    if (SetThreadGroupAffinity(pProcessorWorkers[WorkerIndex].hWorkerThread, &GroupAffinity, NULL) != FALSE) 
+                    {
+                        ResumeThread(pProcessorWorkers[WorkerIndex].hWorkerThread);
+                    }
+                    else
+                    {
+                        TerminateThread(pProcessorWorkers[WorkerIndex].hWorkerThread, 0);
+                        CloseHandle(pProcessorWorkers[WorkerIndex].hWorkerThread);
+                        pProcessorWorkers[WorkerIndex].hWorkerThread = NULL;
+                    }
+                }
+            }
+
+            if (pProcessorWorkers[WorkerIndex].hWorkerThread == NULL) 
+            {
+                WorkersStarted = BOOL_FALSE;
+            }
+        }
+
+        for (WorkerIndex = 0; WorkerIndex < NumberOfProcessors; WorkerIndex++) 
+        {
+            if (pProcessorWorkers[WorkerIndex].hWorkerThread) 
+            {
+                WaitForSingleObject(pProcessorWorkers[WorkerIndex].hWorkerThread, INFINITE);
+                CloseHandle(pProcessorWorkers[WorkerIndex].hWorkerThread);
+            }
+        }
+
+        free(pProcessorWorkers);
+    }
+
+    return WorkersStarted;
+}
+
+
+/*
+ * WinOs_ProcessorWorkerThread
+ *
+ *    The thread entry for a worker that was created on its processor.
+ *
+ * Arguments:
+ *     Processor Worker Context
+ *     
+ * Return:
+ *     Zero
+ */
+DWORD WINAPI WinOs_ProcessorWorkerThread(LPVOID pParameter)
+{
+    PWIN_PROCESSOR_WORKER pProcessorWorker;
+
+    pProcessorWorker = (PWIN_PROCESSOR_WORKER)pParameter;
+
+    pProcessorWorker->pfnWorker(pProcessorWorker->ProcessorNumber, pProcessorWorker->pContext);
+
+    return 0;
+}
+
+
+/*
+ * Os_GetThreadContext
+ *
+ *    Returns the context bound to the calling thread.
+ *
+ * Arguments:
+ *     None
+ *     
+ * Return:
+ *     The context or NULL if none is bound
+ */
+void *Os_GetThreadContext(void)
+{
+    void *pContext;
+
+    pContext = NULL;
+
+    InitOnceExecuteOnce(&g_WinThreadContextSlot.SlotOnce, WinOs_AllocateThreadContextSlot, NULL, NULL);
+
+    if (g_WinThreadContextSlot.SlotAllocated) 
+    {
+        pContext = FlsGetValue(g_WinThreadContextSlot.FlsIndex);
+    }
+
+    return pContext;
+}
+
+
+/*
+ * Os_SetThreadContext
+ *
+ *    Binds a context to the calling thread, a context still bound when the
+ *    thread exits is given to Tools_ReleaseThreadCpuidContext.
+ *
+ * Arguments:
+ *     Context or NULL
+ *     
+ * Return:
+ *     Returns true if the context is bound
+ */
+BOOL_TYPE Os_SetThreadContext(void *pContext)
+{
+    BOOL_TYPE ContextBound;
+
+    ContextBound = BOOL_FALSE;
+
+    InitOnceExecuteOnce(&g_WinThreadContextSlot.SlotOnce, WinOs_AllocateThreadContextSlot, NULL, NULL);
+
+    if (g_WinThreadContextSlot.SlotAllocated) 
+    {
+        if (FlsSetValue(g_WinThreadContextSlot.FlsIndex, pContext)) 
+        {
+            ContextBound = BOOL_TRUE;
+        }
+    }
+
+    return ContextBound;
+}
+
+
+/*
+ * WinOs_AllocateThreadContextSlot
+ *
+ *    Allocates the fiber local slot of the context, this runs once.  A fiber
+ *    local slot is used rather than a thread local slot for its exit callback.
+ *
+ * Arguments:
+ *     Init Once, Parameter, Returned Context
+ *     
+ * Return:
+ *     TRUE
+ */
+BOOL CALLBACK WinOs_AllocateThreadContextSlot(PINIT_ONCE pInitOnce, PVOID pParameter, PVOID *ppContext)
+{
+    g_WinThreadContextSlot.FlsIndex = FlsAlloc(WinOs_ReleaseThreadContext);
+
+    if (g_WinThreadContextSlot.FlsIndex != FLS_OUT_OF_INDEXES) 
+    {
+        g_WinThreadContextSlot.SlotAllocated = BOOL_TRUE;
+    }
+
+    return TRUE;
+}
+
+
+/*
+ * WinOs_ReleaseThreadContext
+ *
+ *    The exit callback of the fiber local slot.
+ *
+ * Arguments:
+ *     Context bound to the exiting thread
+ *     
+ * Return:
+ *     None
+ */
+VOID WINAPI WinOs_ReleaseThreadContext(PVOID pContext)
+{
+    Tools_ReleaseThreadCpuidContext(pContext);
+}
+
+
+/*
+ * Os_GetCurrentProcessorId
+ *
+ *    Returns the group and bit of the processor the calling thread is running
+ *    on as one number, the same as Os_GetProcessorId.  Windows reads the current
+ *    processor in user mode without a system call.
+ *
+ * Arguments:
+ *     Returned Group times the bits in a group plus the Bit
+ *     
+ * Return:
+ *     Returns true
+ */
+BOOL_TYPE Os_GetCurrentProcessorId(unsigned int *pProcessorId)
+{
+    PROCESSOR_NUMBER ProcessorNumber;
+
+    GetCurrentProcessorNumberEx(&ProcessorNumber);
+
+    *pProcessorId = ((unsigned int)ProcessorNumber.Group*BITS_IN_KAFFINITY) + ProcessorNumber.Number;
+
+    return BOOL_TRUE;
+}
+
+
+/*
+ * Os_AtomicExchangePointer
+ *
+ *    Atomically replaces a pointer, this is a full memory barrier.
+ *
+ * Arguments:
+ *     Target, Value
+ *     
+ * Return:
+ *     The previous value of the target
+ */
+void *Os_AtomicExchangePointer(void * volatile *ppTarget, void *pValue)
+{
+    return InterlockedExchangePointer((PVOID volatile *)ppTarget, pValue);
+}
+
+
+/*
+ * Os_AtomicLoadPointer
+ *
+ *    Atomically reads a pointer, this is ordered with every other atomic.
+ *
+ * Arguments:
+ *     Target
+ *     
+ * Return:
+ *     The value of the target
+ */
+void *Os_AtomicLoadPointer(void * volatile *ppTarget)
+{
+    return InterlockedCompareExchangePointer((PVOID volatile *)ppTarget, NULL, NULL);
+}
+
+
+/*
+ * Os_AtomicLoad64
+ *
+ *    Atomically reads a 64 bit value, this is ordered with every other atomic.
+ *
+ * Arguments:
+ *     Target
+ *     
+ * Return:
+ *     The value of the target
+ */
+unsigned long long Os_AtomicLoad64(volatile unsigned long long *pTarget)
+{
+    return (unsigned long long)InterlockedCompareExchange64((LONG64 volatile *)pTarget, 0, 0);
+}
+
+
+/*
+ * Os_AtomicStore64
+ *
+ *    Atomically writes a 64 bit value, this is a full memory barrier so the
+ *    reads that follow it are not performed before it.
+ *
+ * Arguments:
+ *     Target, Value
+ *     
+ * Return:
+ *     None
+ */
+void Os_AtomicStore64(volatile unsigned long long *pTarget, unsigned long long Value)
+{
+    InterlockedExchange64((LONG64 volatile *)pTarget, (LONG64)Value);
+}
+
+
+/*
+ * Os_AtomicIncrement64
+ *
+ *    Atomically increments a 64 bit value, this is a full memory barrier.
+ *
+ * Arguments:
+ *     Target
+ *     
+ * Return:
+ *     The incremented value
+ */
+unsigned long long Os_AtomicIncrement64(volatile unsigned long long *pTarget)
+{
+    return (unsigned long long)InterlockedIncrement64((LONG64 volatile *)pTarget);
+}
+
+
+/*
+ * Os_AtomicAdd64
+ *
+ *    Atomically adds to a 64 bit value, this is a full memory barrier.
+ *
+ * Arguments:
+ *     Target, Value
+ *     
+ * Return:
+ *     The value after the add
+ */
+unsigned long long Os_AtomicAdd64(volatile unsigned long long *pTarget, unsigned long long Value)
+{
+    return (unsigned long long)InterlockedAdd64((LONG64 volatile *)pTarget, (LONG64)Value);
+}
+
+
+/*
+ * Os_AtomicCompareExchange64
+ *
+ *    Atomically replaces a 64 bit value if it holds the expected value, this 
+ *    is a full memory barrier.
+ *
+ * Arguments:
+ *     Target, Expected Value, Desired Value
+ *     
+ * Return:
+ *     Returns true if the target held the expected value and was replaced
+ */
+BOOL_TYPE Os_AtomicCompareExchange64(volatile unsigned long long *pTarget, unsigned long long Expected, unsigned long long Desired)
+{
+    BOOL_TYPE Exchanged;
+
+    Exchanged = BOOL_FALSE;
+
+    if ((unsigned long long)InterlockedCompareExchange64((LONG64 volatile *)pTarget, (LONG64)Desired, (LONG64)Expected) == Expected) 
+    {
+        Exchanged = BOOL_TRUE;
+    }
+
+    return Exchanged;
+}